@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <design.h>
+#include <dataset.h>
+#include <fisher.h>
+#include <random.h>
+
+/* changes of a search without any improvement, at most */
+#define MAXPASSES 100
+
+/* The information of a design is the sum of g*g' over its points, g being
+ * the derivatives of the model at the point with respect to the relative
+ * parameters, divided by the error. g is computed once for each combination
+ * of the levels of the variables (candidate), so the criterion of a design
+ * only takes a few operations per point, and changing a point only
+ * subtracts the g*g' of the old candidate and adds that of the new one.
+ */
+struct search {
+    struct design_space *sp;
+    int nvars, mfit, ncands;
+    int stride[MAX_INDEP];      /* candidate = sum(level[v] * stride[v]), as
+                                 * the points of dataset_grid */
+    int pos;                    /* position of sp->param among the adjusted
+                                 * parameters, for DESIGN_CV */
+    double *g;                  /* g[ncands][mfit] */
+    uint64_t seed;
+    struct design *starts;      /* result of each search */
+    pthread_mutex_t lock;       /* protects the following: */
+    pthread_cond_t cond;        /* signaled when the searches are done */
+    int left;                   /* searches not done yet */
+    int failed;
+};
+
+/* criterion: value of the criterion of the search with the information
+ * info[mfit][mfit] (INFINITY if it is singular) */
+static double criterion(struct search *s, double *info)
+{
+    int n = s->mfit, i, j, k;
+    double L[n][n], inv[n][n], sum, ret = 0;
+    /* Cholesky decomposition, info = L*L'. A pivot much smaller than the
+     * diagonal means that some combination of parameters is not determined
+     * by the points */
+    for (i = 0; i < n; i++) {
+        for (j = 0; j <= i; j++) {
+            sum = info[i*n + j];
+            for (k = 0; k < j; k++)
+                sum -= L[i][k] * L[j][k];
+            if (i == j) {
+                if (!(sum > info[i*n + i] / FISHER_MAXCOND))
+                    return INFINITY;
+                L[i][i] = sqrt(sum);
+            } else {
+                L[i][j] = sum / L[j][j];
+            }
+        }
+    }
+    if (s->sp->criterion == DESIGN_D) {
+        for (i = 0; i < n; i++)
+            ret -= 2 * log(L[i][i]);
+        return ret;
+    }
+    /* inverse of L; the diagonal of inv(info) is the sum of the squares of
+     * the columns of inv(L) */
+    for (j = 0; j < n; j++) {
+        for (i = 0; i < j; i++)
+            inv[i][j] = 0;
+        for (i = j; i < n; i++) {
+            sum = i == j;
+            for (k = j; k < i; k++)
+                sum -= L[i][k] * inv[k][j];
+            inv[i][j] = sum / L[i][i];
+        }
+    }
+    for (j = 0; j < n; j++) {
+        if (s->sp->criterion == DESIGN_CV && j != s->pos)
+            continue;
+        for (i = j; i < n; i++)
+            ret += inv[i][j] * inv[i][j];
+    }
+    return ret;
+}
+
+/* add: adds (sign 1) or subtracts (sign -1) the g*g' of a candidate to the
+ * information */
+static void add(struct search *s, double *info, int cand, double sign)
+{
+    int n = s->mfit, i, j;
+    double *g = &s->g[cand * n];
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            info[i*n + j] += sign * g[i] * g[j];
+}
+
+/* information: the information of a design of candidates cands[] */
+static void information(struct search *s, int cands[], double *info)
+{
+    int i;
+    memset(info, 0, s->mfit * s->mfit * sizeof(double));
+    for (i = 0; i < s->sp->npoints; i++)
+        add(s, info, cands[i], 1);
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+    int x = *(const int *) a, y = *(const int *) b;
+    return x < y ? -1 : x > y;
+}
+
+/* exchange: improves the design cands[] by coordinate exchange.
+ * returns its criterion */
+static double exchange(struct search *s, int cands[])
+{
+    struct design_space *sp = s->sp;
+    int n = s->mfit, i, v, l, cur, lv, cand, best, pass, improved;
+    double info[n * n], score, try, best_score;
+    information(s, cands, info);
+    score = criterion(s, info);
+    for (pass = 0, improved = 1; improved && pass < MAXPASSES; pass++) {
+        improved = 0;
+        for (i = 0; i < sp->npoints; i++) {
+            for (v = 0; v < s->nvars; v++) {
+                cur = cands[i];
+                lv = cur / s->stride[v] % sp->nlevels[v];
+                best = cur;
+                best_score = score;
+                add(s, info, cur, -1);
+                for (l = 0; l < sp->nlevels[v]; l++) {
+                    if (l == lv)
+                        continue;
+                    cand = cur + (l - lv) * s->stride[v];
+                    add(s, info, cand, 1);
+                    try = criterion(s, info);
+                    add(s, info, cand, -1);
+                    /* only clear improvements, so that rounding errors
+                     * do not make it cycle */
+                    if (try < best_score - 1e-9 * fabs(best_score) ||
+                        (isinf(best_score) && !isinf(try))) {
+                        best = cand;
+                        best_score = try;
+                    }
+                }
+                cands[i] = best;
+                if (best != cur) {
+                    improved = 1;
+                    /* recomputed, so that the errors do not build up */
+                    information(s, cands, info);
+                    score = criterion(s, info);
+                } else {
+                    add(s, info, cur, 1);
+                }
+            }
+        }
+    }
+    return score;
+}
+
+/* argument of a search task */
+struct search_task {
+    struct search *s;
+    int start;
+};
+
+/* run_search: runs a search, from a random design */
+static void run_search(void *arg, int thread)
+{
+    struct search_task *t = arg;
+    struct search *s = t->s;
+    struct design *d = &s->starts[t->start];
+    int i, v, np = s->sp->npoints, cands[np];
+    struct rng rng;
+    (void) thread;
+    rng_seed(&rng, s->seed, t->start);
+    for (i = 0; i < np; i++) {
+        for (v = cands[i] = 0; v < s->nvars; v++)
+            cands[i] += s->stride[v] *
+                        (int) (rng_uniform(&rng) * s->sp->nlevels[v]);
+    }
+    d->score = exchange(s, cands);
+    /* the points are sorted, to compare the designs */
+    qsort(cands, np, sizeof(int), compare_ints);
+    for (i = 0; i < np; i++)
+        for (v = 0; v < s->nvars; v++)
+            d->points[i * s->nvars + v] =
+                cands[i] / s->stride[v] % s->sp->nlevels[v];
+    free(t);
+    pthread_mutex_lock(&s->lock);
+    if (--s->left == 0)
+        pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/* candidates: computes the g of every candidate (see struct search), at
+ * the points of the grid of the levels (see dataset_grid).
+ * returns 0, or -1 on failure */
+static int candidates(struct search *s)
+{
+    struct design_space *sp = s->sp;
+    struct model *model = sp->model;
+    struct dataset data;
+    double *jac;
+    int m = model->nparams, c, j, k, ret = -1;
+    jac = malloc((size_t) s->ncands * m * sizeof(double));
+    s->g = malloc((size_t) s->ncands * s->mfit * sizeof(double));
+    if (!jac || !s->g) {
+        fprintf(stderr, "Error: not enough memory for %d candidate points.\n",
+                s->ncands);
+        goto end;
+    }
+    if (dataset_grid(&data, s->nvars, sp->nlevels, sp->levels, 1) < 0)
+        goto end;
+    if (fisher_jacobian(model, &data, sp->params, jac) == 0) {
+        for (c = 0; c < s->ncands; c++) {
+            for (j = k = 0; j < m; j++) {
+                if (sp->fit[j])
+                    s->g[c * s->mfit + k++] = jac[c*m + j] *
+                        (sp->params[j] ? fabs(sp->params[j]) : 1) / sp->error;
+            }
+        }
+        ret = 0;
+    }
+    dataset_free(&data);
+
+end:
+    free(jac);
+    return ret;
+}
+
+static int compare_designs(const void *a, const void *b)
+{
+    const struct design *x = a, *y = b;
+    /* NaN is not expected, but would sort last */
+    if (x->score < y->score)
+        return -1;
+    if (x->score > y->score)
+        return 1;
+    return x < y ? -1 : x > y;
+}
+
+/* design_search: runs nstarts searches of designs (in the threads of pool,
+ * or in the calling one if it is NULL), with the random numbers of seed, and
+ * sets top[ntop] to the best different designs found (their points are
+ * allocated, see design_free).
+ *
+ * returns the number of designs set in top, or -1 on failure (the error is
+ * reported in stderr)
+ */
+int design_search(struct design_space *sp, int nstarts, uint64_t seed,
+                  struct pool *pool, int ntop, struct design top[])
+{
+    struct search s;
+    struct search_task *t;
+    int i, j, v, n = 0, nvars = sp->model->nvars, size;
+    memset(&s, 0, sizeof(s));
+    s.sp = sp;
+    s.nvars = nvars;
+    s.seed = seed;
+    /* in the order of dataset_grid, the last variable changing fastest */
+    for (v = nvars - 1, s.ncands = 1; v >= 0; v--) {
+        s.stride[v] = s.ncands;
+        if (sp->nlevels[v] < 1 ||
+            s.ncands > DESIGN_MAXCANDS / sp->nlevels[v]) {
+            fprintf(stderr, "Error: too many combinations of the levels of "
+                    "the variables (the maximum is %d).\n", DESIGN_MAXCANDS);
+            return -1;
+        }
+        s.ncands *= sp->nlevels[v];
+    }
+    for (j = 0; j < sp->model->nparams; j++) {
+        if (j == sp->param)
+            s.pos = s.mfit;
+        s.mfit += sp->fit[j] != 0;
+    }
+    if (s.mfit == 0) {
+        fprintf(stderr, "Error: there are no parameters to adjust.\n");
+        return -1;
+    }
+    size = sp->npoints * nvars * sizeof(int);
+    if (candidates(&s) ||
+        !(s.starts = calloc(nstarts, sizeof(struct design))))
+        goto fail;
+    for (i = 0; i < nstarts; i++) {
+        if (!(s.starts[i].points = malloc(size)))
+            goto fail;
+    }
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+    s.left = nstarts;
+    for (i = 0; i < nstarts; i++) {
+        if (!(t = malloc(sizeof(struct search_task)))) {
+            pthread_mutex_lock(&s.lock);
+            s.left -= nstarts - i;
+            s.failed = 1;
+            pthread_mutex_unlock(&s.lock);
+            break;
+        }
+        t->s = &s;
+        t->start = i;
+        if (!pool || pool_submit(pool, run_search, t))
+            run_search(t, 0);
+    }
+    pthread_mutex_lock(&s.lock);
+    while (s.left > 0)
+        pthread_cond_wait(&s.cond, &s.lock);
+    pthread_mutex_unlock(&s.lock);
+    pthread_mutex_destroy(&s.lock);
+    pthread_cond_destroy(&s.cond);
+    if (s.failed) {
+        fprintf(stderr, "Error: not enough memory for the searches.\n");
+        goto fail;
+    }
+    /* the best ones, skipping those found by several searches */
+    qsort(s.starts, nstarts, sizeof(struct design), compare_designs);
+    for (i = 0; i < nstarts && n < ntop; i++) {
+        for (j = 0; j < n; j++) {
+            if (!memcmp(top[j].points, s.starts[i].points, size))
+                break;
+        }
+        if (j < n)
+            continue;
+        top[n] = s.starts[i];
+        s.starts[i].points = NULL;
+        n++;
+    }
+    for (i = 0; i < nstarts; i++)
+        free(s.starts[i].points);
+    free(s.starts);
+    free(s.g);
+    return n;
+
+fail:
+    for (i = 0; s.starts && i < nstarts; i++)
+        free(s.starts[i].points);
+    free(s.starts);
+    free(s.g);
+    return -1;
+}
+
+void design_free(struct design *d)
+{
+    free(d->points);
+    d->points = NULL;
+}
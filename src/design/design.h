@@ -0,0 +1,54 @@
+#ifndef __DESIGN_H__
+#define __DESIGN_H__
+
+#include <stdint.h>
+#include <models.h>
+#include <pool.h>
+
+/* Search of optimal designs (see --design): the points of an experiment
+ * (values of the independent variables) which give the most precise
+ * parameters, as predicted by the Fisher information of the points (see
+ * fisher.h). The values of each variable are taken out of a list of levels,
+ * and each search starts from a random design and changes one variable of
+ * one point at a time to the level which improves the criterion most
+ * (coordinate exchange), until no change improves it. The searches are run
+ * in the threads of a pool; each one uses its own stream of random numbers,
+ * so the results do not depend on the number of threads.
+ *
+ * The criteria are computed with the information of the relative parameters
+ * (each one divided by its value), so they do not depend on their units.
+ */
+
+/* criteria (all of them are minimized) */
+#define DESIGN_D 0      /* -log(det(information)) */
+#define DESIGN_A 1      /* sum of the squares of the predicted CVs */
+#define DESIGN_CV 2     /* square of the predicted CV of one parameter */
+
+struct design_space {
+  struct model *model;
+  double *params;         /* real values of the parameters */
+  int *fit;               /* whether each parameter is adjusted (1) or not */
+  double error;           /* deviation of the points */
+  int npoints;            /* points of each design */
+  int nlevels[MAX_INDEP]; /* number of levels of each variable */
+  double *levels[MAX_INDEP];  /* levels[v][nlevels[v]]: the values which
+                           * each variable can take */
+  int criterion;          /* DESIGN_... */
+  int param;              /* the parameter of DESIGN_CV */
+};
+
+struct design {
+  double score;           /* value of the criterion (INFINITY if the
+                           * parameters cannot be identified) */
+  int *points;            /* points[npoints][nvars]: level of each variable
+                           * at each point, the points sorted */
+};
+
+/* largest number of combinations of the levels of the variables */
+#define DESIGN_MAXCANDS (1 << 20)
+
+int design_search(struct design_space *sp, int nstarts, uint64_t seed,
+                  struct pool *pool, int ntop, struct design top[]);
+void design_free(struct design *d);
+
+#endif /* __DESIGN_H__ */
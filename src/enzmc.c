@@ -3,24 +3,146 @@
 #include <stdlib.h>
 #include <argp.h>
 #include <string.h>
-#include <regex.h>
+#include <strings.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <errno.h>
+#include <ctype.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include "include/montecarlo.h"
-#include "include/enzyme.h"
 #include "include/enzmc.h"
 #include "include/models.h"
 #include "include/matrix.h"
-#include "models/models.c"
+#include "include/dataset.h"
+#include "include/registry.h"
+#include "include/parse.h"
+#include "include/mapfile.h"
+#include "include/datafile.h"
+#include "include/pool.h"
+#include "include/writer.h"
+#include "include/trace.h"
+#include "include/state.h"
+#include "include/fisher.h"
+#include "include/design.h"
 
-/* MAX_INDEP, MAX_DATA_CHARS, MAX_PARAMS in models.h */
+/* MAX_INDEP, MAX_PARAMS in models.h */
 #define NREPS 10000
 
 const char *argp_program_bug_address = "alvaroabascar@gmail.com";
 const char *argp_program_version = "version 1.0";
 
+/* available models: the ones in models.c plus the ones of the plugins */
+static struct registry registry;
+
+/* how the simulations are run: threads, seed... (see --threads, --seed) */
+static struct mc_options sim_options;
+/* whether its seed was given (--seed or "- Seed:") rather than taken from the
+ * time, so that the run can be repeated */
+static int seed_given;
+
+/* format of the results, and writers of the results (stdout) and of the
+ * result of each simulation (see --format and --records) */
+static int output_format = OUTPUT_TEXT;
+static struct writer *results, *records;
+
+/* distribution of the parameters to print (see --interval and --histogram):
+ * percentage of the central interval and number of bins, or 0 */
+static double interval;
+static int hist_bins;
+/* whether to print the biases and correlations (see --correlation) */
+static int correlation;
+/* whether to predict the covariances instead of simulating (see --fisher) */
+static int predicting;
+/* whether to print the errors of the results due to the number of
+ * simulations (with --sampling) */
+static int mc_errors;
+
+/* noise shared by the runs of the same seed, number of simulations and
+ * points (see --common-noise and share_noise), up to NOISE_MAXDRAWS draws
+ * in all */
+#define NOISE_MAXDRAWS (1 << 25)
+#define NOISE_MAXSHARED 64
+static int common_noise;
+static struct mc_noise *noises[NOISE_MAXSHARED];
+static int nnoises;
+static size_t noise_draws;
+static pthread_mutex_t noises_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* directory of the states of the runs done (see --cache), or NULL. A run
+ * is looked up by a key with everything its results depend on but the
+ * number of simulations, so a longer run goes on from a shorter one */
+#define CACHE_KEYLEN 4096
+static char *cache_dir;
+
+/* file of the checkpoints of the run (see --checkpoint), taken every
+ * checkpoint_secs seconds, and whether to go on from it (see --resume). It
+ * is kept as a cached run, with the same key */
+static char *checkpoint_path;
+static int checkpoint_secs;
+static int resuming;
+/* files of the slices of the run to merge (see --merge and --shard), or
+ * NULL */
+static char *merge_files;
+
+struct cache {
+  char path[PATH_MAX];      /* file of the state, or "" if not cached */
+  int checkpoint;           /* whether it is the file of --checkpoint */
+  char key[CACHE_KEYLEN];
+  struct mc_state found;    /* state in the cache, if any... */
+  struct mc_state save;     /* ...and that of the run */
+};
+
+/* relative accuracy of the quantiles (see sketch.h) */
+#define QUANTILE_ACCURACY 0.001
+
+/* binary trace of the simulations (see --trace), created by records_begin */
+static char *trace_path;
+static int trace_flags;
+static struct trace *trace;
+
+/* what the records of a run belong to (see record_sim) */
+struct sim_records {
+  int scenario;             /* number of the scenario, or 0 */
+  int nparams;
+};
+
+static void record_sim(void *arg, struct mc_sim *sim);
+static int records_begin(int batch, int nparams, char *names[]);
+static int dist_init(struct mc_options *opts, int nparams, double params[],
+                     struct sketch quantiles[], struct histogram hists[],
+                     double covariance[], double mcerror[]);
+static void dist_free(struct mc_options *opts, int nparams);
+static void share_noise(struct mc_options *opts, int n);
+static void cache_begin(struct cache *c, struct model *model,
+                        struct dataset *data, double params[], int fit[],
+                        double error, struct mc_options *opts, int seeded);
+static void cache_end(struct cache *c, int nsuccess);
+static int checkpoint_begin(struct cache *c, struct model *model,
+                            struct dataset *data, double params[], int fit[],
+                            double error, struct mc_options *opts);
+static int merge_begin(struct cache *c, struct model *model,
+                       struct dataset *data, double params[], int fit[],
+                       double error, struct mc_options *opts);
+static void print_fisher(int scenario, char *model, struct results *r,
+                         double cond);
+static int predict(int scenario, struct model *model, struct dataset *data,
+                   double params[], int fit[], double error);
+static int predict_global(struct gfit *global, char *label, char *names[],
+                          double params[], int fit[], double error);
+
 static int parse_opt(int key, char *arg, struct argp_state *state)
 {
     struct arguments *args = state->input;
     static int nargs = 0;
+    int i;
+    char *end, *name;
     switch(key) {
         case 'f':
             args->mode = FILE_MODE;
@@ -30,33 +152,233 @@ static int parse_opt(int key, char *arg, struct argp_state *state)
             args->mode = TEMPLATE_MODE;
             args->model = arg;
             break;
+        case 'b':
+            args->mode = BATCH_MODE;
+            args->fileinput = arg;
+            break;
+        case 's':
+            args->mode = SERVE_MODE;
+            args->socket = arg;
+            break;
         case 'v':
             args->verbose = 1;
             break;
-        case 444: /* model */
-            args->model = arg;
+        case 748: /* threads */
+            args->threads = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->threads < 0)
+              argp_failure(state, 1, 0, "invalid number of threads: %s", arg);
+            break;
+        case 222: /* seed of the random numbers */
+            args->seed = strtoull(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0')
+              argp_failure(state, 1, 0, "invalid seed: %s", arg);
+            args->seeded = 1;
+            break;
+        case 444: /* model (a new dataset, if the last one has a model) */
+            if (args->sets[args->nsets - 1].model) {
+              if (args->nsets == MAX_SETS)
+                argp_failure(state, 1, 0, ERROR_TOO_MANY_SETS);
+              args->nsets++;
+            }
+            args->model = args->sets[args->nsets - 1].model = arg;
             break;
         case 555: /* parameters */
-            args->params = arg;
+            args->params = args->sets[args->nsets - 1].params = arg;
             break;
         case 666: /* error */
             args->error = arg;
             break;
         case 777: /* data points */
-            args->data = arg;
+            args->data = args->sets[args->nsets - 1].data = arg;
+            break;
+        case 776: /* file of data points */
+            args->datafile = args->sets[args->nsets - 1].datafile = arg;
+            break;
+        case 761: /* grid of data points */
+            args->grid = args->sets[args->nsets - 1].grid = arg;
+            break;
+        case 760: /* replicates of each point of the grid */
+            args->replicates = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->replicates < 1)
+              argp_failure(state, 1, 0, "invalid number of replicates: %s",
+                           arg);
+            break;
+        case 775: /* save the data points in a binary file */
+            args->savedata = arg;
             break;
         case 999: /* parameters to fix */
-            args->fixed_params = arg;
+            args->fixed_params = args->sets[args->nsets - 1].fixed_params = arg;
+            break;
+        case 333: /* parameters shared by the datasets */
+            args->shared = arg;
+            break;
+        case 888: /* directory of plugins */
+            args->plugins = arg;
+            break;
+        case 773: /* format of the results */
+            if (!strcmp(arg, "text"))
+              args->format = OUTPUT_TEXT;
+            else if (!strcmp(arg, "jsonl"))
+              args->format = OUTPUT_JSONL;
+            else if (!strcmp(arg, "csv"))
+              args->format = OUTPUT_CSV;
+            else
+              argp_failure(state, 1, 0, "invalid format: %s", arg);
+            break;
+        case 772: /* file for the result of each simulation */
+            args->records = arg;
+            break;
+        case 771: /* binary trace of the simulations */
+            args->trace = arg;
+            break;
+        case 770: /* with the covariances */
+            args->trace_covar = 1;
+            break;
+        case 769: /* central interval of the parameters */
+            args->interval = strtod(arg, &end);
+            if (*arg == '\0' || *end != '\0' || !(args->interval > 0) ||
+                args->interval >= 100)
+              argp_failure(state, 1, 0, "invalid interval: %s", arg);
+            break;
+        case 757: /* how the noise is drawn */
+            if (!strcmp(arg, "plain"))
+              args->sampling = MC_PLAIN;
+            else if (!strcmp(arg, "antithetic"))
+              args->sampling = MC_ANTITHETIC;
+            else if (!strcmp(arg, "sobol"))
+              args->sampling = MC_SOBOL;
+            else
+              argp_failure(state, 1, 0, "invalid sampling: %s", arg);
+            break;
+        case 758: /* share the noise of the simulations */
+            args->common_noise = 1;
+            break;
+        case 766: /* Fisher information instead of simulations */
+            args->fisher = 1;
+            break;
+        case 767: /* biases and correlations */
+            args->correlation = 1;
+            break;
+        case 768: /* bins of the histograms */
+            args->histogram = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->histogram < 1 ||
+                args->histogram > 10000)
+              argp_failure(state, 1, 0, "invalid number of bins: %s", arg);
+            break;
+        case 765: /* search designs of n points */
+            args->mode = DESIGN_MODE;
+            args->design = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->design < 1)
+              argp_failure(state, 1, 0, "invalid number of points: %s", arg);
+            break;
+        case 764: /* ranges of the variables of the designs */
+            args->ranges = arg;
+            break;
+        case 763: /* criterion of the designs */
+            args->criterion = arg;
+            break;
+        case 762: /* number of designs to print */
+            args->designs = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->designs < 1)
+              argp_failure(state, 1, 0, "invalid number of designs: %s", arg);
+            break;
+        case 759: /* real values of the parameters to simulate */
+            args->mode = SWEEP_MODE;
+            args->sweep = arg;
+            break;
+        case 756: /* target CVs of the parameters */
+            args->mode = PLAN_MODE;
+            args->plan = arg;
+            break;
+        case 755: /* what --plan grows */
+            args->plan_over = arg;
+            break;
+        case 754: /* directory of the cached runs */
+            args->cache = arg;
+            break;
+        case 753: /* file of the checkpoints */
+            args->checkpoint = arg;
+            break;
+        case 752: /* seconds between the checkpoints */
+            args->checkpoint_every = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '\0' || args->checkpoint_every < 1)
+              argp_failure(state, 1, 0, "invalid number of seconds: %s", arg);
+            break;
+        case 751: /* go on from the checkpoint */
+            args->resume = 1;
+            break;
+        case 750: /* slice of the simulations, k/N */
+            args->shard = strtol(arg, &end, 10);
+            if (*arg == '\0' || *end != '/' ||
+                (args->nshards = strtol(end + 1, &end, 10)) < 1 ||
+                *end != '\0' || args->shard < 1 ||
+                args->shard > args->nshards)
+              argp_failure(state, 1, 0, "invalid slice: %s", arg);
+            break;
+        case 749: /* slices to merge */
+            args->merge = arg;
             break;
         case ARGP_KEY_ARG:
             args->fileoutput = arg;
             nargs++;
         case ARGP_KEY_END:
+            if (args->mode == NORMAL_MODE && (args->shared || args->nsets > 1))
+              args->mode = GLOBAL_MODE;
+            if (args->mode == GLOBAL_MODE) {
+              for (i = 0; i < args->nsets; i++) {
+                if (!(args->sets[i].model && args->sets[i].params &&
+                      (args->sets[i].data || args->sets[i].datafile ||
+                       args->sets[i].grid) &&
+                      *args->error))
+                  argp_failure(state, 1, 0, ERROR_LACK_SET_OPTS);
+              }
+            }
             if (args->mode == NORMAL_MODE) {
               if (!(args->model && args->params && args->error &&
                     args->data))
                 argp_failure(state, 1, 0, ERROR_LACK_OPTS);
             }
+            if (args->mode == DESIGN_MODE) {
+              if (!(*args->model && *args->params && *args->error &&
+                    args->ranges))
+                argp_failure(state, 1, 0, ERROR_LACK_DESIGN_OPTS);
+            }
+            if (args->mode == SWEEP_MODE) {
+              if (!(*args->model && *args->params && *args->error &&
+                    (*args->data || args->datafile || args->grid)))
+                argp_failure(state, 1, 0, ERROR_LACK_OPTS);
+              if (args->fisher)
+                argp_failure(state, 1, 0, "--fisher cannot be used with "
+                             "--sweep");
+            }
+            if (args->mode == PLAN_MODE) {
+              if (!(*args->model && *args->params && *args->error &&
+                    (*args->data || args->datafile || args->grid)))
+                argp_failure(state, 1, 0, ERROR_LACK_OPTS);
+              if (args->fisher)
+                argp_failure(state, 1, 0, "--fisher cannot be used with "
+                             "--plan");
+            }
+            if (args->resume && !args->checkpoint)
+              argp_failure(state, 1, 0, "--resume needs --checkpoint");
+            if (args->shard && !args->checkpoint)
+              argp_failure(state, 1, 0, "--shard needs --checkpoint (the "
+                           "file of the slice)");
+            if (args->merge && args->checkpoint)
+              argp_failure(state, 1, 0, "--merge cannot be used with "
+                           "--checkpoint or --shard");
+            if (args->checkpoint || args->merge) {
+              name = args->merge ? "--merge" : "--checkpoint";
+              if (args->mode != NORMAL_MODE && args->mode != FILE_MODE)
+                argp_failure(state, 1, 0, "%s can only be used with the "
+                             "simulations of a model (--data or --file)",
+                             name);
+              if (args->cache || args->records || args->trace ||
+                  args->interval || args->histogram || args->sampling >= 0)
+                argp_failure(state, 1, 0, "%s cannot be used with --cache, "
+                             "--records, --trace, --interval, --histogram or "
+                             "--sampling", name);
+            }
             if (nargs > 1) {
               argp_failure(state, 1, 0, ERROR_TOO_MANY_ARGS);
             }
@@ -70,18 +392,51 @@ static int parse_opt(int key, char *arg, struct argp_state *state)
 
 int main(int argc, char *argv[])
 {
-  int result;
+  int result = 0;
   struct argp_option options[] = {
     {0, 0, 0, 0, "Other program modes:", 1},
     {"template", 't', "model", 0, "Create a template for the specified model"},
     {"file", 'f', "input file", 0, "Get input from file"},
+    {"batch", 'b', "batch file", 0, "Simulate all the scenarios of a file, each one given as in --file (starting with \"- Model:\")"},
+    {"sweep", 759, "\"Km=1:1000:7 KIa=0.1:10:5\"", 0, "Simulate at every combination of the real values of some parameters (lists, or ranges with the number of values, as in --grid), printing a map of the means, biases, CVs and successes"},
+    {"plan", 756, "\"Km=10 KIa=15\"", 0, "Find the smallest number of replicates of the points (or of levels of a variable of --grid, see --plan-over) which gives these CVs (%) of the parameters, printing the CVs of each design simulated"},
+    {"serve", 's', "socket", 0, "Serve the simulations of the scenarios sent (as in --file, each one ending with a line \".\") to a Unix socket"},
+    {"design", 765, "n", 0, "Search the designs of n points (values of the independent variables, within --ranges) which give the most precise parameters, and confirm them by simulation"},
     {0, 0, 0, 0, "Mandatory parameters:", 2},
     {"model", 444, "\"model name\"", 0, "Choose a model"},
     {"params", 555, "\"Vm=5 Km=17\"", 0, "Set the parameters of the model"},
     {"error", 666, "error", 0, "Set the estimated measurement error (absolute value)"},
     {"data", 777, "\"X1=[0.3,0.45,0.6,...] X2=[0.1,0.2,0.4...]\"", 0, "Set the values of the independent variables"},
+    {"data-file", 776, "file", 0, "Read the values of the independent variables from a file: a table (CSV, TSV...) with a header naming the columns, or a binary data file"},
+    {"grid", 761, "\"S=[1,2,5] I=0:20:5\"", 0, "Instead of --data, take as points all the combinations of the values of the independent variables, given as lists or as ranges with the number of values (spaced geometrically if the range is positive)"},
     {0, 0, 0, 0, "Optional parameters:", 3},
+    {"replicates", 760, "n", 0, "Repeat each point of --grid n times"},
     {"fixed", 999, "\"Vm Kd\"", 0, "Indicate what parameters are fixed"},
+    {"share", 333, "\"Vm Km\"", 0, "Fit together the datasets given by repeating --model, --params, --data and --fixed, sharing these parameters"},
+    {"save-data", 775, "file", 0, "Save the values of the independent variables in a binary data file, to be read with --data-file, instead of running the simulations"},
+    {"plugins", 888, "directory", 0, "Load the models of the plugins (*.so) in the directory (default: $" PLUGINS_ENV ")"},
+    {"threads", 748, "n", 0, "Run the simulations in n threads (default: one per processor)"},
+    {"seed", 222, "seed", 0, "Seed of the random numbers, to repeat the same simulations (default: the current time)"},
+    {"format", 773, "format", 0, "Format of the results: text (default), jsonl (a JSON object per line) or csv"},
+    {"records", 772, "file", 0, "Write the result of each simulation (adjusted parameters, chi square, iterations and status) to a file, as CSV (or JSON Lines, with --format jsonl)"},
+    {"trace", 771, "file", 0, "Write the result of each simulation to a binary trace file, with fixed size records (see montecarlo/trace.h)"},
+    {"trace-covar", 770, 0, 0, "Keep the covariances of the parameters in the trace"},
+    {"interval", 769, "P", 0, "Print the median of each parameter and the interval holding the central P% of its values (eg. 95)"},
+    {"histogram", 768, "bins", 0, "Print a histogram of each parameter, with that number of bins"},
+    {"common-noise", 758, 0, 0, "Draw the noise of the simulations once, and share it between all the runs of the same seed and number of points (the scenarios of --batch and --serve, the points of --sweep, the designs of --design)"},
+    {"sampling", 757, "sampling", 0, "How the noise of the simulations is drawn: plain (default), antithetic (in pairs of opposite sign) or sobol (quasi-random, for up to 21 points); also prints the standard errors of the means and CVs due to the number of simulations"},
+    {"correlation", 767, 0, 0, "Print the bias of each parameter and the correlations between them"},
+    {"fisher", 766, 0, 0, "Do not simulate: predict the standard errors and correlations of the parameters from the Fisher information of the points"},
+    {"ranges", 764, "\"S=1:100 I=0:20:5\"", 0, "Ranges of the independent variables of --design, with the number of levels to try (default: 32, spaced geometrically if the range is positive)"},
+    {"criterion", 763, "criterion", 0, "What --design minimizes: D (default, the volume of the confidence region), A (the sum of the squared CVs) or the name of a parameter (its CV)"},
+    {"plan-over", 755, "variable", 0, "What --plan grows: replicates (default) or the number of levels of a variable of --grid"},
+    {"designs", 762, "k", 0, "Print the k best designs found by --design (default: 5)"},
+    {"checkpoint", 753, "file", 0, "Keep the state of the simulations in a file every few minutes (see --checkpoint-every), and once they are done, so that a run which is stopped might go on with --resume"},
+    {"checkpoint-every", 752, "seconds", 0, "Seconds between the checkpoints (default: 60)"},
+    {"resume", 751, 0, 0, "Go on from the state of the --checkpoint file, if there is one, running only the simulations which are not in it (the results are those of a run from scratch)"},
+    {"shard", 750, "k/N", 0, "Run only the k-th of N slices of the simulations (with the same --seed in all of them), keeping their state in the file of --checkpoint, to be merged with --merge; each one might run in another process or machine"},
+    {"merge", 749, "\"1.state 2.state\"", 0, "Do not simulate: merge the files of all the slices of the simulations (see --shard), giving the results of a single run"},
+    {"cache", 754, "directory", 0, "Keep the results of the runs of a model in the directory, and reuse them (a run of more simulations only runs those which are missing); runs with --records, --trace, --interval, --histogram or --sampling are not cached"},
     {0, 0, 0, 0, "Informational options:", -1},
     {"verbose", 'v', 0, 0, "Display arguments on output"},
     {0}};
@@ -95,13 +450,104 @@ int main(int argc, char *argv[])
       .data = "",
       .fileoutput = "",
       .fileinput = "",
+      .datafile = NULL,
+      .grid = NULL,
+      .replicates = 1,
+      .savedata = NULL,
+      .plugins = getenv(PLUGINS_ENV),
+      .shared = NULL,
+      .nsets = 1,
+      .threads = 0,
+      .seed = time(NULL),
+      .seeded = 0,
+      .format = OUTPUT_TEXT,
+      .records = NULL,
+      .trace = NULL,
+      .trace_covar = 0,
+      .interval = 0,
+      .histogram = 0,
+      .correlation = 0,
+      .fisher = 0,
+      .design = 0,
+      .ranges = NULL,
+      .criterion = "D",
+      .designs = 5,
+      .sweep = NULL,
+      .common_noise = 0,
+      .sampling = -1,
+      .plan = NULL,
+      .plan_over = NULL,
+      .cache = NULL,
+      .checkpoint = NULL,
+      .checkpoint_every = 60,
+      .resume = 0,
+      .shard = 0,
+      .nshards = 0,
+      .merge = NULL,
       .verbose = 0
     };
+  FILE *records_fp = NULL;
     argp_parse(&argp, argc, argv, 0, 0, &args);
 
+    if (registry_init(&registry, models) ||
+        (args.plugins && *args.plugins &&
+         registry_load_dir(&registry, args.plugins) < 0)) {
+      return 1;
+    }
+
     /********************************************
      * create a simple API to contain the modes?
      * *******************************************/
+    /* threads for the simulations (none if there is only one: they are run
+     * in this one) */
+    sim_options.seed = args.seed;
+    seed_given = args.seeded;
+    sim_options.progress = args.format == OUTPUT_TEXT;
+    if (args.mode != TEMPLATE_MODE && !args.savedata && args.threads != 1 &&
+        !(sim_options.pool = pool_create(args.threads))) {
+      registry_free(&registry);
+      return 1;
+    }
+    /* the results are written by threads of their own, so that the threads
+     * of the simulations do not wait for them (the server sends its own) */
+    output_format = args.format;
+    interval = args.interval;
+    hist_bins = args.histogram;
+    correlation = args.correlation;
+    predicting = args.fisher;
+    common_noise = args.common_noise;
+    sim_options.sampling = args.sampling < 0 ? MC_PLAIN : args.sampling;
+    mc_errors = args.sampling >= 0;
+    cache_dir = args.cache;
+    checkpoint_path = args.checkpoint;
+    checkpoint_secs = args.checkpoint_every;
+    resuming = args.resume;
+    sim_options.shard = args.shard - 1;
+    sim_options.nshards = args.nshards;
+    merge_files = args.merge;
+    if (cache_dir && mkdir(cache_dir, 0777) && errno != EEXIST) {
+      fprintf(stderr, "Error: cannot create %s.\n", cache_dir);
+      result = 1;
+      goto end;
+    }
+    if (args.mode != TEMPLATE_MODE && args.mode != SERVE_MODE &&
+        !args.savedata) {
+      if (!(results = writer_open(stdout)))
+        result = 1;
+      else if (args.records && !(records_fp = fopen(args.records, "w"))) {
+        fprintf(stderr, "Error: cannot open %s.\n", args.records);
+        result = 1;
+      } else if (records_fp && !(records = writer_open(records_fp))) {
+        result = 1;
+      }
+      if (result) {
+        goto end;
+      }
+      trace_path = args.trace;
+      trace_flags = args.trace_covar ? TRACE_COVAR : 0;
+      sim_options.record = records || trace_path ? record_sim : NULL;
+    }
+
     switch(args.mode) {
     case NORMAL_MODE:
         result = run_cli_mode(&args);
@@ -109,10 +555,48 @@ int main(int argc, char *argv[])
     case FILE_MODE:
         result = run_file_mode(&args);
         break;
+    case GLOBAL_MODE:
+        result = run_global_mode(&args);
+        break;
+    case BATCH_MODE:
+        result = run_batch_mode(&args);
+        break;
+    case SERVE_MODE:
+        result = run_serve_mode(&args);
+        break;
+    case DESIGN_MODE:
+        result = run_design_mode(&args);
+        break;
+    case SWEEP_MODE:
+        result = run_sweep_mode(&args);
+        break;
+    case PLAN_MODE:
+        result = run_plan_mode(&args);
+        break;
     case TEMPLATE_MODE:
         result = create_template(args.model, args.fileoutput);
         break;
     }
+end:
+    if (results && writer_close(results)) {
+      fprintf(stderr, "Error: cannot write the results.\n");
+      result = 1;
+    }
+    if (records && writer_close(records)) {
+      fprintf(stderr, "Error: cannot write %s.\n", args.records);
+      result = 1;
+    }
+    if (trace && trace_close(trace))
+      result = 1;
+    if (records_fp && fclose(records_fp)) {
+      fprintf(stderr, "Error: cannot write %s.\n", args.records);
+      result = 1;
+    }
+    if (sim_options.pool)
+      pool_destroy(sim_options.pool);
+    while (nnoises > 0)
+      mc_noise_free(noises[--nnoises]);
+    registry_free(&registry);
     return result;
 }
 
@@ -129,31 +613,19 @@ int run_cli_mode(struct arguments *args)
     fprintf(stderr, "Unrecognized model name: %s\n", args->model);
     return -1;
   }
-  /* Array to store the arrays of values for the independent variables. nvars
-   * is the number of independent variables of the model.
-   */
-  double **data = malloc(model->nvars * sizeof(double *));
+  /* Points (values of the independent variables), and the file they were
+   * read from, if any */
+  struct dataset dataset;
+  struct mapfile mf;
   /* Array to hold the values of the parameters. */
   double params[model->nparams];
   /* Array to indicate the fixed/adjustable parameters. */
   int fixed_params[model->nparams];
   /* Standard deviation of the gaussian error. */
   double error;
-  /* Number of points (num of values of the each variable). */
-  int npoints;
   /* Number of parameters to fit or keep fixed */
   int nfit, nfix;
-  /* Means and variacnes of the adjusted parameters */
-  double means[model->nparams];
-  double variances[model->nparams];
-  /* Number of successful adjustments (returned by montecarlo) */
-  int nsuccess;
 
-  /* parse data passed in the --data option (values of the indep variables), and
-   * put it into the matrix "data"
-   */
-  if ((npoints = get_indep_vars(model, args->data, data)) < 0)
-    return npoints;
   /* parse parameters and place them in the array params */
   if ((ret_code = get_params(model, args->params, params)))
     return ret_code;
@@ -165,292 +637,2793 @@ int run_cli_mode(struct arguments *args)
     return nfix;
   }
   nfit = model->nparams - nfix;
-  /* This will store the same data as "data", but in an order understood by
-   * montecarlo
-   */
-  double **data_ord;
-  reorder_data(model->nvars, npoints, data, &data_ord);
-  free_matrix_double(&data, model->nvars);
+  /* read the points, given in --data, --data-file or --grid */
+  if (get_dataset(model, args->data, args->datafile, args->grid,
+                  args->replicates, &dataset, &mf) < 0)
+    return -1;
+  /* either convert the points to a binary data file, or simulate */
+  if (args->savedata) {
+    ret_code = datafile_write(args->savedata, model->nvars, model->indep_vars,
+                              dataset.n, dataset.cols);
+  } else {
+    ret_code = simulate(model, &dataset, params, fixed_params, nfit, error,
+                        NREPS) < 0 ? -1 : 0;
+  }
+  dataset_free(&dataset);
+  mapfile_close(&mf);
+  return ret_code;
+}
+
+/* Do the simulations of a model at the points of a dataset, and print the
+ * output.
+ *
+ * returns the number of successful adjustments, or -1 on failure
+ */
+int simulate(struct model *model, struct dataset *dataset, double *params,
+             int *fit, int nfit, double error, int nsims)
+{
+  struct mc_problem problem = {model, dataset, NULL};
+  struct mc_options opts = sim_options;
+  struct sim_records rec = {0, model->nparams};
+  /* Means and variances of the adjusted parameters, and their distribution */
+  double means[model->nparams];
+  double variances[model->nparams];
+  struct sketch quantiles[model->nparams];
+  struct histogram hists[model->nparams];
+  double covariance[model->nparams * model->nparams];
+  double mcerror[2 * model->nparams];
+  struct results r = {model->nparams, model->params, means, variances, 0,
+                      nsims, NULL, NULL, params, NULL, NULL};
+  struct cache cache;
+  int i, nsuccess, ret = 0;
+  if (predicting)
+    return predict(0, model, dataset, params, fit, error);
+  opts.nsims = nsims;
+  opts.record_arg = &rec;
+  if (records_begin(0, model->nparams, model->params) ||
+      dist_init(&opts, model->nparams, params, quantiles, hists, covariance,
+                mcerror))
+    return -1;
+  if (merge_files)
+    ret = merge_begin(&cache, model, dataset, params, fit, error, &opts);
+  else if (checkpoint_path)
+    ret = checkpoint_begin(&cache, model, dataset, params, fit, error, &opts);
+  else
+    cache_begin(&cache, model, dataset, params, fit, error, &opts,
+                seed_given);
+  if (ret) {
+    cache_end(&cache, -1);
+    dist_free(&opts, model->nparams);
+    return -1;
+  }
+  nsuccess = montecarlo(&problem, params, params, error, model->nparams,
+                        nfit, fit, &opts, means, variances);
+  /* the results of a slice are those of its simulations */
+  if (opts.nshards > 1)
+    for (i = r.nsims = 0; i < cache.save.nparts; i++)
+      r.nsims += cache.save.parts[i].nsims;
+  cache_end(&cache, nsuccess);
+  if (nsuccess >= 0) {
+    r.nsuccess = nsuccess;
+    r.quantiles = opts.quantiles;
+    r.hists = opts.hists;
+    r.covariance = opts.covariance;
+    r.mcerror = opts.mcerror;
+    print_results(0, model->name, &r);
+  }
+  dist_free(&opts, model->nparams);
+  return nsuccess;
+}
+
+/* Given a model, and the points either as a string (--data), as the name
+ * of a file (--data-file, see datafile.h) or as the levels of a grid, each
+ * point repeated "replicates" times (--grid, see dataset_grid), build the
+ * dataset of the points. "mf" is set to the mapped file, which must be closed
+ * (mapfile_close) after freeing the dataset.
+ *
+ * returns the number of points, or -1 on failure
+ */
+int get_dataset(struct model *model, char *raw_data, char *datafile,
+                char *grid, int replicates, struct dataset *dataset,
+                struct mapfile *mf)
+{
+  double **data;
+  int npoints;
+  mf->data = NULL;
+  mf->len = 0;
+  if (datafile && *datafile)
+    return datafile_read(datafile, model->nvars, model->indep_vars, dataset,
+                         mf);
+  if (grid)
+    return get_grid(model, grid, replicates, dataset);
+  data = malloc(model->nvars * sizeof(double *));
+  if ((npoints = get_indep_vars(model, raw_data, data)) >= 0)
+    dataset_init(dataset, model->nvars, npoints, data);
+  free(data);
+  return npoints;
+}
+
+int run_global_mode(struct arguments *args)
+{
+  int nsets = args->nsets, maxp = nsets * MAX_PARAMS;
+  int k, j, q, nsets_ok = 0, nparams = 0, nfit, nsuccess;
+  int ret_code = -1;
+  struct model *model;
+  struct dataset datasets[nsets];
+  struct mapfile mfs[nsets];
+  struct gfit_set sets[nsets];
+  struct gfit global;
+  struct mc_problem problem;
+  struct mc_options opts = sim_options;
+  struct sim_records rec;
+  double error;
+  /* parameters of the global fit: names, values, adjusted (1) or not (0),
+   * and whether they are shared */
+  char *names[maxp], labels[maxp][32], *list, *name, *label = NULL;
+  size_t len;
+  double params[maxp], set_params[MAX_PARAMS];
+  int fit[maxp], set_fit[MAX_PARAMS], shared[maxp];
+  double means[maxp], variances[maxp];
+  struct sketch quantiles[maxp];
+  struct histogram hists[maxp];
+  double covariance[maxp * maxp];
+  double mcerror[2 * maxp];
+  struct results r;
+
+  if (get_error(NULL, args->error, &error))
+    return -1;
+  for (k = 0; k < nsets; k++, nsets_ok++) {
+    if (!(model = get_model(args->sets[k].model))) {
+      fprintf(stderr, "Unrecognized model name: %s\n", args->sets[k].model);
+      goto cleanup;
+    }
+    if (get_params(model, args->sets[k].params, set_params) ||
+        get_fixed_params(model, args->sets[k].fixed_params ?
+                         args->sets[k].fixed_params : "", set_fit) < 0 ||
+        get_dataset(model, args->sets[k].data, args->sets[k].datafile,
+                    args->sets[k].grid, args->replicates, &datasets[k],
+                    &mfs[k]) < 0)
+      goto cleanup;
+    sets[k].model = model;
+    sets[k].data = &datasets[k];
+    /* place each parameter of the model in the global fit */
+    for (j = 0; j < model->nparams; j++) {
+      name = model->params[j];
+      q = nparams;
+      if (args->shared && in_list(args->shared, name)) {
+        for (q = 0; q < nparams; q++) {
+          if (shared[q] && !strcmp(names[q], name))
+            break;
+        }
+      }
+      if (q == nparams) { /* new parameter */
+        shared[q] = args->shared && in_list(args->shared, name);
+        if (shared[q]) {
+          names[q] = name;
+        } else {
+          snprintf(labels[q], sizeof(labels[q]), "%s[%d]", name, k + 1);
+          names[q] = labels[q];
+        }
+        params[q] = set_params[j];
+        fit[q] = set_fit[j];
+        nparams++;
+      } else if (params[q] != set_params[j]) {
+        fprintf(stderr, "Error: shared parameter %s has different values in "
+                "the datasets.\n", name);
+        goto cleanup;
+      } else {
+        fit[q] = fit[q] && set_fit[j]; /* fixed if fixed in any dataset */
+      }
+      sets[k].map[j] = q;
+    }
+  }
+  /* every shared parameter must belong to some model */
+  list = strdup(args->shared ? args->shared : "");
+  for (name = strtok(list, " ,"); name; name = strtok(NULL, " ,")) {
+    for (q = 0; q < nparams && !(shared[q] && !strcmp(names[q], name)); q++)
+      ;
+    if (q == nparams) {
+      fprintf(stderr, "Error: shared parameter %s is not a parameter of any "
+              "of the models.\n", name);
+      free(list);
+      goto cleanup;
+    }
+  }
+  free(list);
+  /* the models joined by "+", in place of the model in the results */
+  for (k = 0, len = 1; k < nsets; k++) {
+    len += strlen(sets[k].model->name) + 1;
+  }
+  if (!(label = malloc(len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    goto cleanup;
+  }
+  for (k = 0, *label = '\0'; k < nsets; k++) {
+    strcat(k ? strcat(label, "+") : label, sets[k].model->name);
+  }
+
+  global.nsets = nsets;
+  global.sets = sets;
+  global.nparams = nparams;
+  for (k = global.npoints = 0; k < nsets; k++) {
+    global.npoints += datasets[k].n;
+  }
+  for (q = nfit = 0; q < nparams; q++) {
+    nfit += fit[q];
+  }
+  problem.model = NULL;
+  problem.data = NULL;
+  problem.global = &global;
+  if (predicting) {
+    ret_code = predict_global(&global, label, names, params, fit, error);
+    goto cleanup;
+  }
+  opts.nsims = NREPS;
+  rec.scenario = 0;
+  rec.nparams = nparams;
+  opts.record_arg = &rec;
+  if (records_begin(0, nparams, names) ||
+      dist_init(&opts, nparams, params, quantiles, hists, covariance,
+                mcerror))
+    goto cleanup;
+  nsuccess = montecarlo(&problem, params, params, error, nparams, nfit, fit,
+                        &opts, means, variances);
+  if (nsuccess >= 0) {
+    r.nparams = nparams;
+    r.names = names;
+    r.means = means;
+    r.variances = variances;
+    r.nsuccess = nsuccess;
+    r.nsims = NREPS;
+    r.quantiles = opts.quantiles;
+    r.hists = opts.hists;
+    r.params = params;
+    r.covariance = opts.covariance;
+    r.mcerror = opts.mcerror;
+    print_results(0, label, &r);
+    ret_code = 0;
+  }
+  dist_free(&opts, nparams);
+
+cleanup:
+  for (k = 0; k < nsets_ok; k++) {
+    dataset_free(&datasets[k]);
+    mapfile_close(&mfs[k]);
+  }
+  free(label);
+  return ret_code;
+}
 
-  nsuccess = montecarlo(model->function, params, params, error, NREPS, npoints,
-             model->nvars, model->nparams, nfit, fixed_params, data_ord,
-             means, variances, NULL);
-  free_matrix_double(&data_ord, npoints);
-  print_output(model, variances, means, nsuccess);
-  return -1;
+/* Given a list of names separated by spaces or commas (eg. "Vm Km"), return
+ * 1 if "name" is one of them, 0 if not.
+ */
+int in_list(char *list, char *name)
+{
+  int len = strlen(name);
+  while (*list) {
+    list += strspn(list, " ,");
+    if (!strncmp(list, name, len) && (list[len] == '\0' || list[len] == ' ' ||
+                                      list[len] == ','))
+      return 1;
+    list += strcspn(list, " ,");
+  }
+  return 0;
 }
 
-void print_output(struct model *model, double *params_variance, double *params_mean, int nsuccess)
+void print_output(FILE *fp, int nparams, char *names[],
+                  double *params_variance, double *params_mean, int nsuccess,
+                  int nsims)
 {
   int i;
-  printf("\n Parameter     Mean      Standard Dev       CV(%%)\n");
-  printf("----------------------------------------------------\n");
-  for (i = 0; i < model->nparams; i++) {
+  fprintf(fp, "\n Parameter     Mean      Standard Dev       CV(%%)\n");
+  fprintf(fp, "----------------------------------------------------\n");
+  for (i = 0; i < nparams; i++) {
       if (params_variance[i] > 0.001) {
-          printf("%d | %-6s %10.6f   %10.4f    %10.2f%%\n", i, model->params[i],
+          fprintf(fp, "%d | %-6s %10.6f   %10.4f    %10.2f%%\n", i, names[i],
           params_mean[i], sqrt(params_variance[i]),
           100*sqrt(params_variance[i])/params_mean[i]);
       } else {
-          printf("%d | %-6s %10.6e   %10.4e    %10.2f%%\n", i, model->params[i],
+          fprintf(fp, "%d | %-6s %10.6e   %10.4e    %10.2f%%\n", i, names[i],
                   params_mean[i], sqrt(params_variance[i]),
                   100*sqrt(params_variance[i])/params_mean[i]);
       }
-      printf("----------------------------------------------------\n");
+      fprintf(fp, "----------------------------------------------------\n");
   }
-  printf("Number of succesful adjustments: %d of %d (%.2f%%)\n",
-          nsuccess, NREPS, 100*(float)nsuccess/(float)NREPS);
+  fprintf(fp, "Number of succesful adjustments: %d of %d (%.2f%%)\n",
+          nsuccess, nsims, 100*(float)nsuccess/(float)nsims);
+}
+
+/* json_number: writes x at buf as a JSON number (null if it is not finite).
+ * returns the number of characters written (at most 24) */
+static int json_number(char *buf, double x)
+{
+  return isfinite(x) ? sprintf(buf, "%.17g", x) : sprintf(buf, "null");
 }
 
-/* parses the data points, returns the number of values if this is
- * equal for all the independent variables, or -1 if they do not.
- * Fills S[] with "nvars" pointers to double arrays, being "nvars" the
- * number of independent variables of the model
+/* Prepare the distribution of the parameters of a run (see --interval,
+ * --histogram, --correlation and --sampling): set opts->quantiles,
+ * opts->hists, opts->covariance and opts->mcerror to the arrays given (of
+ * nparams elements, nparams^2 the covariance and 2*nparams the errors), or to
+ * NULL if they are not requested. The histograms are centered on the real
+ * values of the parameters.
+ *
+ * returns 0, or -1 if there is not enough memory
  */
-int run_file_mode(struct arguments *args)
+static int dist_init(struct mc_options *opts, int nparams, double params[],
+                     struct sketch quantiles[], struct histogram hists[],
+                     double covariance[], double mcerror[])
 {
+  int i;
+  opts->covariance = correlation ? covariance : NULL;
+  opts->mcerror = mc_errors ? mcerror : NULL;
+  opts->quantiles = interval ? quantiles : NULL;
+  opts->hists = NULL;
+  for (i = 0; interval && i < nparams; i++)
+    sketch_init(&quantiles[i], QUANTILE_ACCURACY);
+  for (i = 0; hist_bins && i < nparams; i++) {
+    if (hist_init(&hists[i], hist_bins, params[i],
+                  params[i] ? fabs(params[i]) * 0x1p-20 : 0x1p-20)) {
+      while (--i >= 0)
+        hist_free(&hists[i]);
+      dist_free(opts, nparams);
+      return -1;
+    }
+  }
+  opts->hists = hist_bins ? hists : NULL;
   return 0;
 }
 
-int create_template(char *modelname, char *fileout)
+static void dist_free(struct mc_options *opts, int nparams)
 {
-  return 0;
+  int i;
+  for (i = 0; opts->quantiles && i < nparams; i++)
+    sketch_free(&opts->quantiles[i]);
+  for (i = 0; opts->hists && i < nparams; i++)
+    hist_free(&opts->hists[i]);
+  opts->quantiles = NULL;
+  opts->hists = NULL;
+  opts->covariance = NULL;
+  opts->mcerror = NULL;
 }
 
-/* Given the name of a model, return a ptr to the struct model with all the
- * information necessary to use the model (see models.h).
- */
-struct model *get_model(char *modelname)
+/* Set opts->noise to the draws of the runs of its seed and number of
+ * simulations, with n points (see --common-noise), drawing them the first
+ * time. If they are not shared, or there is no room for them, it is left
+ * NULL and the run does its own draws, which are the same ones. */
+static void share_noise(struct mc_options *opts, int n)
 {
   int i;
-  /* models is an array of struct model, defined in models.c
-   * end of models is defined by a struct model with all its elements set to
-   * zero / NULL
-   */
-  for (i = 0; models[i].function != NULL; i++) {
-    if (!strcmp(models[i].name, modelname)) {
-      return &(models[i]);
-    }
+  size_t size = (size_t) opts->nsims * n;
+  opts->noise = NULL;
+  if (!common_noise)
+    return;
+  pthread_mutex_lock(&noises_lock);
+  for (i = 0; i < nnoises; i++) {
+    if (noises[i]->seed == opts->seed && noises[i]->nsims == opts->nsims &&
+        noises[i]->n == n)
+      break;
   }
-  return NULL;
+  if (i == nnoises && nnoises < NOISE_MAXSHARED &&
+      noise_draws + size <= NOISE_MAXDRAWS &&
+      (noises[i] = mc_noise_new(opts->seed, opts->nsims, n))) {
+    nnoises++;
+    noise_draws += size;
+  }
+  if (i < nnoises)
+    opts->noise = noises[i];
+  pthread_mutex_unlock(&noises_lock);
 }
 
-/* Given a struct model and raw data as a string, parse this string and place
- * the values of the independent variables in a matrix. A reference to this
- * matrix must be passed as third element.
- * 
- * eg. of raw data: a string with the format   "S=[1,2,3,4,5,6] I=[2,2,4,4,5,5]"
- * eg. of output:   array of arrays type double { {1,2,3,4,5,6}, {2,2,4,4,5,5} }
- *                  length of the arrays (in int pointed to by npoints)
- *
- * returns: 0 on success
- *         -1 on failure, if not all indep variables of the model have been
- *                        found in the data
- *         -2 on failure, if not all indep variables have the same number of
- *                        values
- */
-int get_indep_vars(struct model *model, char *raw_data,
-                   double *data[model->nvars])
+/* FNV-1a hash of n bytes, going on from h */
+static uint64_t fnv1a(uint64_t h, const void *buf, size_t n)
 {
-  int i, npoints, npoints_tmp;
-  /* simple regexp which will match a string of type:
-   * foo = [1, 2, 3, 4, 5, 6, 7], accepting commas, spaces and numbers either
-   * in decimal or exponential notation
-   */
-  char *regexp_base = "%s[ ]*=[ ]*[[eE., [:digit:]-]+]";
-  char regexp_complete[40];
-  char match_str[200]; // will store the matched string
-  /* for each independent variable in the model... */
-  for (i = 0; i < model->nvars; i++) {
-    /* build the full regex to match the ith indep. variable of the model */
-    sprintf(regexp_complete, regexp_base, model->indep_vars[i]);
-    if (extract_str(raw_data, match_str, regexp_complete)) {
-      fprintf(stderr, "Error: variable %s is required by the model %s, but it was not found.\n", model->indep_vars[i], model->name);
-      return -1;
-    }
-    npoints = parse_array_double(match_str, &(data[i]));
-    /* if indep variables have different number of values, cleanup and signal
-     * failure
-     */
-    if (i > 0 && (npoints != npoints_tmp)) {
-      //free_matrix_double(data, i);
-      fprintf(stderr, "Error: the number of values is not equal for all the independent variables.\n");
-      return -2;
-    }
-    npoints_tmp = npoints;
-  }
-  return npoints;
+  const unsigned char *p = buf;
+  while (n--)
+    h = (h ^ *p++) * 0x100000001b3ULL;
+  return h;
 }
 
-/* Given a struct model and raw data as a string, parse this string to find the
- * values of the parameters of the model. An array of type double must be passed
- * as third argument, in which the values of the parameters will be placed.
- * 
- * eg. of raw data: a string with the format   "Vm=[2,3,4,5,6] Km=[2,4,4,5,5]"
- * eg. of output:   array of arrays type double { {2,3,4,5,6}, {2,4,4,5,5} }
+/* Set the key of a run in the cache (see cache_begin): the version of the
+ * simulations, the model (and a hash of its plugin, if it comes from one, so
+ * that another model of the same name is not taken for it), the real values
+ * of the parameters (exactly, in hexadecimal), the adjusted ones, the error,
+ * the seed, the sampling and the points (their number and a hash of their
+ * values), but not the number of simulations.
  *
- * returns: 0 on success
- *         -1 on failure (not all parameters of the model have been found
- *                        in the data)
+ * returns 0, or -1 if it does not fit in c->key or the plugin cannot be read
  */
-int get_params(struct model *model, char *raw_data, double *params)
+static int cache_key(struct cache *c, struct model *model,
+                     struct dataset *data, double params[], int fit[],
+                     double error, struct mc_options *opts)
 {
-  /* simple regexp which will match a string of type foo = [1,3,4,5,6],
-   * accepting commas or spaces as separators, and numbers either in decimal or
-   * exponential notation
-   */
-  char *regexp_base = "%s[ ]*=[ ]*[eE.[:digit:]-]+";
-  char regexp_complete[40];
-  char match_str[200];
-  int i;
-  /* for each parameter in the model... */
-  for (i = 0; i < model->nparams; i++) {
-    /* build the full regex to match the ith parameter of the model */
-    sprintf(regexp_complete, regexp_base, model->params[i]);
-    if (extract_str(raw_data, match_str, regexp_complete)) {
-      fprintf(stderr, "Error: parameter %s is required by the model %s, but it was not found.\n", model->params[i], model->name);
+  uint64_t h = 0xcbf29ce484222325ULL;
+  const char *plugin = registry_origin(&registry, model);
+  struct mapfile mf;
+  int i, len;
+  len = snprintf(c->key, CACHE_KEYLEN, "engine %d\nmodel %s", MC_ENGINE,
+                 model->name);
+  if (plugin) {
+    if (mapfile_open(&mf, plugin))
       return -1;
-    }
-    /* place the number in the correct place of the array params */
-    sscanf(match_str, "%*[^0-9]%lf", &params[i]);
+    len += snprintf(c->key + len, CACHE_KEYLEN - len, " plugin %016llx",
+                    (unsigned long long) fnv1a(h, mf.data, mf.len));
+    mapfile_close(&mf);
   }
-  return 0;
+  if (len < CACHE_KEYLEN)
+    len += snprintf(c->key + len, CACHE_KEYLEN - len, "\nparams");
+  for (i = 0; i < model->nparams && len < CACHE_KEYLEN; i++)
+    len += snprintf(c->key + len, CACHE_KEYLEN - len, " %s=%a%s",
+                    model->params[i], params[i], fit[i] ? "" : "(fixed)");
+  for (i = 0; i < data->nvars; i++)
+    h = fnv1a(h, data->cols[i], data->n * sizeof(double));
+  if (len < CACHE_KEYLEN)
+    len += snprintf(c->key + len, CACHE_KEYLEN - len, "\nerror %a\nseed %llu"
+                    "\nsampling %d\npoints %d %d %016llx\n", error,
+                    (unsigned long long) opts->seed, opts->sampling, data->nvars,
+                    data->n, (unsigned long long) h);
+  return len < CACHE_KEYLEN ? 0 : -1;
 }
 
-/* Given a model, and a string containing the error, find the value
- * and store it in error (double)
+/* Look up the state of a run in the cache (see --cache), setting
+ * opts->resume to it if it is there, and opts->save so that the state of
+ * the run is kept (see cache_end). The runs whose results are not only
+ * their moments (records, quantiles...) are not cached, nor those whose seed
+ * was taken from the time (not seeded), which would never be found again.
+ * The file of a run is named after a hash of its key (see cache_key).
  */
-int get_error(struct model *model, char *raw_data, double *error)
+static void cache_begin(struct cache *c, struct model *model,
+                        struct dataset *data, double params[], int fit[],
+                        double error, struct mc_options *opts, int seeded)
 {
-  int d = sscanf(raw_data, "%lf", error);
-  if (d != 1) {
-    return -1;
+  c->path[0] = '\0';
+  c->checkpoint = 0;
+  memset(&c->found, 0, sizeof(struct mc_state));
+  memset(&c->save, 0, sizeof(struct mc_state));
+  if (!cache_dir || !seeded || opts->record || opts->quantiles ||
+      opts->hists || opts->mcerror ||
+      cache_key(c, model, data, params, fit, error, opts))
+    return;
+  if (snprintf(c->path, PATH_MAX, "%s/%016llx.state", cache_dir,
+               (unsigned long long) fnv1a(0xcbf29ce484222325ULL, c->key,
+                                          strlen(c->key))) >= PATH_MAX) {
+    c->path[0] = '\0';
+    return;
   }
-  return 0;
+  if (mc_state_read(c->path, c->key, &c->found) == 0)
+    opts->resume = &c->found;
+  opts->save = &c->save;
 }
 
-/* Given a model, and a string containing a list of parameters, find them and
- * fill the array pointed to by ptr in the following way: 
- *
- * *ptr is an int array with the length of model->nparams (one entry for each
- * parameter). If a given entry is 1, the parameter will be fitted; if it is 0,
- * it will be kept fixed.
+/* Keep the state of a run started with cache_begin (or checkpoint_begin) in
+ * its file, if it has more simulations than the one found there (or always,
+ * for a checkpoint), and free them */
+static void cache_end(struct cache *c, int nsuccess)
+{
+  if (c->path[0] && nsuccess >= 0 &&
+      (c->checkpoint || c->save.nsims > c->found.nsims))
+    mc_state_write(c->path, c->key, &c->save);
+  mc_state_free(&c->found);
+  mc_state_free(&c->save);
+  c->path[0] = '\0';
+}
+
+static int compare_parts(const void *a, const void *b)
+{
+  const struct mc_part *x = a, *y = b;
+  return x->first < y->first ? -1 : x->first > y->first;
+}
+
+/* Set opts->resume to the state of a run made of those of its slices, in
+ * the files of --merge (see --shard), so that it only merges them. They
+ * must be the states of the slices of this run, with all its simulations
+ * (and each one once), and the same seed, which is that of the run if none
+ * was given.
  *
- * return the number of parameters to keep fixed
+ * returns 0, or -1 if they are not (the error is reported in stderr)
  */
-int get_fixed_params(struct model *model, char *raw_data, int *ptr)
+static int merge_begin(struct cache *c, struct model *model,
+                       struct dataset *data, double params[], int fit[],
+                       double error, struct mc_options *opts)
 {
-  char str[100]; // useless but required by extract_str
-  int i, nfix;
-  /* for each parameter of the model... */
-  for (i = 0; i < model->nparams; i++) {
-    /* can we match params[i]? if not, then params[i] is not in the string
-     * raw_data, which means that it should be fited. If yes, then it should
-     * be fixed
-     */
-    if (extract_str(raw_data, str, model->params[i])) {
-      ptr[i] = 1; // not found --> fit it
-    } else {
-      ptr[i] = 0; // found --> fix it
-      nfix++;
+  struct mc_state st, *all = &c->found;
+  struct mc_part *parts;
+  char *list, *path;
+  uint64_t seed;
+  long sims = 0;
+  int i, end = 0, ret = -1;
+  c->path[0] = '\0';
+  c->checkpoint = 0;
+  memset(&c->found, 0, sizeof(struct mc_state));
+  memset(&c->save, 0, sizeof(struct mc_state));
+  if (!(list = strdup(merge_files))) {
+    fprintf(stderr, "Error: not enough memory.\n");
+    return -1;
+  }
+  /* the seed of the first slice, if none was given */
+  path = strtok(list, " ,");
+  if (!seed_given && path)
+    mc_state_seed(path, &opts->seed);
+  if (cache_key(c, model, data, params, fit, error, opts)) {
+    fprintf(stderr, "Error: the slices of this run cannot be merged.\n");
+    goto end;
+  }
+  for (; path; path = strtok(NULL, " ,")) {
+    if ((i = mc_state_read(path, c->key, &st)) > 0) {
+      if (access(path, F_OK))
+        fprintf(stderr, "Error: cannot open %s.\n", path);
+      else if (!mc_state_seed(path, &seed) && seed != opts->seed)
+        fprintf(stderr, "Error: %s is a slice of a run with another seed.\n",
+                path);
+      else
+        fprintf(stderr, "Error: %s is not a slice of this run.\n", path);
+    }
+    if (i)
+      goto end;
+    if (st.nsims != opts->nsims) {
+      fprintf(stderr, "Error: %s is a slice of a run of %d simulations.\n",
+              path, st.nsims);
+      mc_state_free(&st);
+      goto end;
     }
+    if (!(parts = realloc(all->parts, (all->nparts + st.nparts + 1) *
+                                      sizeof(struct mc_part)))) {
+      fprintf(stderr, "Error: not enough memory.\n");
+      mc_state_free(&st);
+      goto end;
+    }
+    /* the arrays of the parts are moved to the merged state */
+    memcpy(&parts[all->nparts], st.parts, st.nparts * sizeof(struct mc_part));
+    all->parts = parts;
+    all->nparts += st.nparts;
+    all->seed = st.seed;
+    all->sampling = st.sampling;
+    all->m = st.m;
+    all->nsims = st.nsims;
+    free(st.parts);
   }
-  return 0;
+  if (all->nparts)
+    qsort(all->parts, all->nparts, sizeof(struct mc_part), compare_parts);
+  for (i = 0; i < all->nparts; i++) {
+    if (all->parts[i].first < end) {
+      fprintf(stderr, "Error: some slices were given more than once.\n");
+      goto end;
+    }
+    end = all->parts[i].first + all->parts[i].nblocks;
+    sims += all->parts[i].nsims;
+  }
+  if (sims != opts->nsims) {
+    fprintf(stderr, "Error: the slices only hold %ld of the %d simulations "
+            "of the run.\n", sims, opts->nsims);
+    goto end;
+  }
+  opts->resume = all;
+  ret = 0;
+
+end:
+  free(list);
+  return ret;
 }
 
-/* Given a source and destiny string, and a regular expression, match the
- * regular expression in the source string and save the matched region in the
- * destiny string.
- */
-int extract_str(char *src, char *dst, char *regexp_str)
-{
-  size_t nchars; // to be used later
-  regex_t regex;
-  regmatch_t pmatch[1];
-  regcomp(&regex, regexp_str, REG_EXTENDED);
-  /* if didn't match... */
-  if (regexec(&regex, src, 1, pmatch, 0)) {
-    regfree(&regex);
-    return -1;
-  }
-  /* copy the matched string to the destiny string. pmatch[0].rm_so contains the
-   * starting position of the match, pmatch[0].rm_eo the ending position. So we
-   * copy (rm_eo - rm_so) chars from the string starting at rm_so.
-   */
-  nchars = pmatch[0].rm_eo - pmatch[0].rm_so;
-  strncpy(dst, &src[pmatch[0].rm_so], nchars);
-  dst[nchars] = '\0'; // end string!
-  regfree(&regex);
-  return 0;
+static void write_checkpoint(void *arg, struct mc_state *st)
+{
+  struct cache *c = arg;
+  mc_state_write(c->path, c->key, st);
 }
 
-/* Given a string in format [1,2,3,3,5.6, 3.2], and a pointer to ptr to double,
- * allocates space for a double array and fills it. Returns the number of
- * elements placed in the array.
- * 
- * Numbers might be separated by commas or spaces,
- * and exponential notation is accepted as well as decimal notation.
+/* Prepare the checkpoints of a run in the file of --checkpoint (as a cached
+ * run, see cache_begin), and with --resume, set opts->resume to the state
+ * of the file, if there is one. If no seed was given, the run goes on with
+ * that of the file (which was taken from the time when it started); the
+ * slices of --shard need one, so that they are slices of the same run.
  *
- * The array might be preceded or followed by something else (eg. "A = [1,2,3]")
- * In this case the function will consider as array the first match of a set of
- * numbers between brackets.
+ * returns 0, or -1 if the file is not a checkpoint of this run or cannot be
+ * read
  */
-int parse_array_double(char *array_raw, double **dst)
+static int checkpoint_begin(struct cache *c, struct model *model,
+                            struct dataset *data, double params[], int fit[],
+                            double error, struct mc_options *opts)
 {
-  int i, ndata;
-  char *token;
-  /* set result_tmp to maximum possible size */
-  double result_tmp[MAX_VALUES];
-  /* first step: clean the array, leave only the digits + brackets */
-  char array_clean[100];
-  if (extract_str(array_raw, array_clean, "\[[eE., [:digit:]-]+]")) {
+  int ret = 1;
+  c->path[0] = '\0';
+  c->checkpoint = 1;
+  memset(&c->found, 0, sizeof(struct mc_state));
+  memset(&c->save, 0, sizeof(struct mc_state));
+  if (opts->nshards > 0 && !seed_given) {
+    fprintf(stderr, "Error: the slices of a run (--shard) need its seed "
+            "(--seed or \"- Seed:\").\n");
     return -1;
   }
-  /* part 2: turn it into double array */
-  /* tokenize by commas, spaces and brackets (we remove brackets this way) */
-  token = strtok(array_clean, ", []");
-  for (i = ndata = 0; token; i++) {
-    result_tmp[i] = atof(token);
-    token = strtok(NULL, ", []");
-    ndata++;
+  if (resuming && !seed_given)
+    mc_state_seed(checkpoint_path, &opts->seed);
+  if (cache_key(c, model, data, params, fit, error, opts) ||
+      snprintf(c->path, PATH_MAX, "%s", checkpoint_path) >= PATH_MAX) {
+    fprintf(stderr, "Error: the checkpoints of this run cannot be kept.\n");
+    c->path[0] = '\0';
+    return -1;
+  }
+  if (resuming && (ret = mc_state_read(c->path, c->key, &c->found)) < 0)
+    return -1;
+  if (ret == 1 && resuming && access(c->path, F_OK) == 0) {
+    fprintf(stderr, "Error: %s is not a checkpoint of this run.\n", c->path);
+    return -1;
+  }
+  if (ret == 0)
+    opts->resume = &c->found;
+  opts->save = &c->save;
+  opts->checkpoint = write_checkpoint;
+  opts->checkpoint_arg = c;
+  opts->checkpoint_secs = checkpoint_secs;
+  return 0;
+}
+
+/* corr: returns the correlation between the parameters i and j of r, or NaN
+ * if one of them does not vary */
+static double corr(struct results *r, int i, int j)
+{
+  int n = r->nparams;
+  double d = r->covariance[i*n + i] * r->covariance[j*n + j];
+  return d > 0 ? r->covariance[i*n + j] / sqrt(d) : NAN;
+}
+
+/* print_correlations: prints the matrix of correlations of r as text */
+static void print_correlations(FILE *fp, struct results *r)
+{
+  int i, j;
+  double c;
+  fprintf(fp, "\nCorrelations:\n%-8s", "");
+  for (j = 0; j < r->nparams; j++)
+    fprintf(fp, " %8.8s", r->names[j]);
+  fprintf(fp, "\n");
+  for (i = 0; i < r->nparams; i++) {
+    fprintf(fp, "%-8.8s", r->names[i]);
+    for (j = 0; j < r->nparams; j++) {
+      c = corr(r, i, j);
+      if (isnan(c))
+        fprintf(fp, " %8s", "-");
+      else
+        fprintf(fp, " %8.4f", c);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
+/* json_correlations: writes the matrix of correlations of r as a JSON
+ * member */
+static void json_correlations(FILE *fp, struct results *r)
+{
+  char num[32];
+  int i, j;
+  fprintf(fp, ",\"correlation\":[");
+  for (i = 0; i < r->nparams; i++) {
+    for (j = 0; j < r->nparams; j++) {
+      json_number(num, corr(r, i, j));
+      fprintf(fp, "%s%s", j ? "," : i ? ",[" : "[", num);
+    }
+    fprintf(fp, "]");
   }
+  fprintf(fp, "]");
+}
 
-  *dst = malloc(ndata * sizeof(double));
-  copy_array_double(*dst, result_tmp, i);
-  return ndata;
+/* print_dist: prints the medians and intervals, the biases and correlations,
+ * the errors due to the number of simulations and the histograms, of the
+ * parameters (those of r which are not NULL) as text */
+static void print_dist(FILE *fp, struct results *r)
+{
+  struct histogram *h;
+  int i, j, bar;
+  int64_t top;
+  if (r->quantiles) {
+    fprintf(fp, "\n Parameter    Median      %5.2f%%      %5.2f%%\n",
+            (100 - interval) / 2, (100 + interval) / 2);
+    fprintf(fp, "----------------------------------------------------\n");
+    for (i = 0; i < r->nparams; i++) {
+      fprintf(fp, "%d | %-6s %10.6g  %10.6g  %10.6g\n", i, r->names[i],
+              sketch_quantile(&r->quantiles[i], 0.5),
+              sketch_quantile(&r->quantiles[i], (100 - interval) / 200),
+              sketch_quantile(&r->quantiles[i], (100 + interval) / 200));
+      fprintf(fp, "----------------------------------------------------\n");
+    }
+  }
+  if (r->covariance) {
+    fprintf(fp, "\n Parameter     Bias         Bias(%%)\n");
+    fprintf(fp, "----------------------------------------------------\n");
+    for (i = 0; i < r->nparams; i++) {
+      fprintf(fp, "%d | %-6s %10.4g   %10.2f%%\n", i, r->names[i],
+              r->means[i] - r->params[i],
+              100 * (r->means[i] - r->params[i]) / r->params[i]);
+      fprintf(fp, "----------------------------------------------------\n");
+    }
+    print_correlations(fp, r);
+  }
+  if (r->mcerror) {
+    fprintf(fp, "\n Parameter   Mean error    CV error(%%)\n");
+    fprintf(fp, "----------------------------------------------------\n");
+    for (i = 0; i < r->nparams; i++) {
+      fprintf(fp, "%d | %-6s +-%-10.4g  +-%.4g\n", i, r->names[i],
+              r->mcerror[i], r->mcerror[r->nparams + i]);
+      fprintf(fp, "----------------------------------------------------\n");
+    }
+  }
+  for (i = 0; r->hists && i < r->nparams; i++) {
+    h = &r->hists[i];
+    fprintf(fp, "\nHistogram of %s:\n", r->names[i]);
+    for (j = 0, top = 1; j < h->nbins; j++) {
+      if (h->counts[j] > top)
+        top = h->counts[j];
+    }
+    for (j = 0; h->count && j < h->nbins; j++) {
+      bar = (int) (40 * h->counts[j] / top);
+      fprintf(fp, "[%11.6g, %11.6g) %8lld%s%.*s\n",
+              hist_start(h) + j * hist_width(h),
+              hist_start(h) + (j + 1) * hist_width(h),
+              (long long) h->counts[j], bar ? " " : "", bar,
+              "########################################");
+    }
+  }
 }
 
-/* The data points are first obtained as a matrix data[nvars][npoints] (this is
- * the easiest way to parse the data provided by the user). However, the current
- * nonlinear regression algorithm requires the data to be stored as:
- * data[npoints][nvars]. This function fills a matrix with this new order.
+/* Print the results of a run (of scenario number "scenario" of a batch file,
+ * or 0 if it is the only one) in the format of --format: the table of
+ * print_output, a JSON object, or a CSV line per parameter. In a global fit,
+ * the model is the names of its models joined by "+". May be called from any
+ * thread, but not from two at once.
  */
-void reorder_data(int nvars, int npoints, double *data[],
-                  double ***data_ord)
+void print_results(int scenario, char *model, struct results *r)
 {
-  int var, point;
-  *data_ord = malloc(npoints * sizeof(double *));
-  for (point = 0; point < npoints; point++) {
-    (*data_ord)[point] = malloc(nvars * sizeof(double));
+  static int header = 0;
+  char *buf = NULL, num[32];
+  size_t len = 0;
+  int i, j, nparams = r->nparams, nsuccess = r->nsuccess, nsims = r->nsims;
+  char **names = r->names;
+  double *means = r->means, *variances = r->variances;
+  FILE *fp;
+  double sd;
+
+  if (!(fp = open_memstream(&buf, &len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    return;
   }
-  for (var = 0; var < nvars; var++) {
-    for (point = 0; point < npoints; point++) {
-      (*data_ord)[point][var] = data[var][point];
+  switch (output_format) {
+  case OUTPUT_TEXT:
+    if (scenario)
+      fprintf(fp, "\n- Scenario %d: %s\n", scenario, model);
+    print_output(fp, nparams, names, variances, means, nsuccess, nsims);
+    print_dist(fp, r);
+    break;
+  case OUTPUT_JSONL:
+    fprintf(fp, "{");
+    if (scenario)
+      fprintf(fp, "\"scenario\":%d,", scenario);
+    if (model)
+      fprintf(fp, "\"model\":\"%s\",", model);
+    fprintf(fp, "\"nsuccess\":%d,\"nsims\":%d,\"params\":[", nsuccess,
+            nsims);
+    for (i = 0; i < nparams; i++) {
+      sd = sqrt(variances[i]);
+      json_number(num, means[i]);
+      fprintf(fp, "%s{\"name\":\"%s\",\"mean\":%s", i ? "," : "",
+              names[i], num);
+      json_number(num, sd);
+      fprintf(fp, ",\"sd\":%s", num);
+      json_number(num, 100*sd/means[i]);
+      fprintf(fp, ",\"cv\":%s", num);
+      if (r->quantiles) {
+        json_number(num, sketch_quantile(&r->quantiles[i], 0.5));
+        fprintf(fp, ",\"median\":%s", num);
+        json_number(num, sketch_quantile(&r->quantiles[i],
+                                         (100 - interval) / 200));
+        fprintf(fp, ",\"lo\":%s", num);
+        json_number(num, sketch_quantile(&r->quantiles[i],
+                                         (100 + interval) / 200));
+        fprintf(fp, ",\"hi\":%s", num);
+      }
+      if (r->hists) {
+        json_number(num, hist_start(&r->hists[i]));
+        fprintf(fp, ",\"hist\":{\"start\":%s", num);
+        json_number(num, hist_width(&r->hists[i]));
+        fprintf(fp, ",\"width\":%s,\"counts\":[", num);
+        for (j = 0; j < r->hists[i].nbins; j++)
+          fprintf(fp, "%s%lld", j ? "," : "",
+                  (long long) r->hists[i].counts[j]);
+        fprintf(fp, "]}");
+      }
+      if (r->covariance) {
+        json_number(num, means[i] - r->params[i]);
+        fprintf(fp, ",\"bias\":%s", num);
+      }
+      if (r->mcerror) {
+        json_number(num, r->mcerror[i]);
+        fprintf(fp, ",\"mean_se\":%s", num);
+        json_number(num, r->mcerror[nparams + i]);
+        fprintf(fp, ",\"cv_se\":%s", num);
+      }
+      fprintf(fp, "}");
+    }
+    fprintf(fp, "]");
+    if (r->quantiles)
+      fprintf(fp, ",\"interval\":%.17g", interval);
+    if (r->covariance)
+      json_correlations(fp, r);
+    fprintf(fp, "}\n");
+    break;
+  case OUTPUT_CSV:
+    /* the histograms and correlations are left out */
+    if (!header) {
+      fprintf(fp, "%smodel,parameter,mean,sd,cv,nsuccess,nsims%s%s%s\n",
+              scenario ? "scenario," : "", interval ? ",median,lo,hi" : "",
+              correlation ? ",bias" : "", mc_errors ? ",mean_se,cv_se" : "");
+      header = 1;
+    }
+    for (i = 0; i < nparams; i++) {
+      sd = sqrt(variances[i]);
+      if (scenario)
+        fprintf(fp, "%d,", scenario);
+      fprintf(fp, "%s,%s,%.17g,%.17g,%.17g,%d,%d", model ? model : "",
+              names[i], means[i], sd, 100*sd/means[i], nsuccess, nsims);
+      if (r->quantiles)
+        fprintf(fp, ",%.17g,%.17g,%.17g",
+                sketch_quantile(&r->quantiles[i], 0.5),
+                sketch_quantile(&r->quantiles[i], (100 - interval) / 200),
+                sketch_quantile(&r->quantiles[i], (100 + interval) / 200));
+      if (r->covariance)
+        fprintf(fp, ",%.17g", means[i] - r->params[i]);
+      if (r->mcerror)
+        fprintf(fp, ",%.17g,%.17g", r->mcerror[i], r->mcerror[nparams + i]);
+      fprintf(fp, "\n");
     }
+    break;
   }
+  fclose(fp);
+  writer_write(results, buf, len);
+  writer_flush(results);
+  free(buf);
 }
 
-void free_matrix_double(double **matrix[], int n)
+/* Print the prediction of the Fisher information for a design (see
+ * --fisher) in the format of --format, as print_results: r holds the real
+ * values of the parameters in means, and the predicted variances and
+ * covariances. cond is the condition number of the information.
+ */
+static void print_fisher(int scenario, char *model, struct results *r,
+                         double cond)
 {
+  static int header = 0;
+  char *buf = NULL, num[32];
+  size_t len = 0;
   int i;
-  for (i = 0; i < n; i++) {
-    free((*matrix)[i]);
+  FILE *fp;
+  double sd;
+
+  if (!(fp = open_memstream(&buf, &len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    return;
   }
-  free(*matrix);
+  switch (output_format) {
+  case OUTPUT_TEXT:
+    if (scenario)
+      fprintf(fp, "\n- Scenario %d: %s\n", scenario, model);
+    fprintf(fp, "\n Parameter     Value     Standard Err       CV(%%)\n");
+    fprintf(fp, "----------------------------------------------------\n");
+    for (i = 0; i < r->nparams; i++) {
+      sd = sqrt(r->variances[i]);
+      fprintf(fp, "%d | %-6s %10.6g   %10.4g    %10.2f%%\n", i, r->names[i],
+              r->means[i], sd, 100*sd/r->means[i]);
+      fprintf(fp, "----------------------------------------------------\n");
+    }
+    fprintf(fp, "Condition number: %.4g\n", cond);
+    if (cond > FISHER_MAXCOND)
+      fprintf(fp, "The parameters cannot be identified with these points.\n");
+    else
+      print_correlations(fp, r);
+    break;
+  case OUTPUT_JSONL:
+    fprintf(fp, "{");
+    if (scenario)
+      fprintf(fp, "\"scenario\":%d,", scenario);
+    if (model)
+      fprintf(fp, "\"model\":\"%s\",", model);
+    fprintf(fp, "\"params\":[");
+    for (i = 0; i < r->nparams; i++) {
+      sd = sqrt(r->variances[i]);
+      json_number(num, r->means[i]);
+      fprintf(fp, "%s{\"name\":\"%s\",\"value\":%s", i ? "," : "",
+              r->names[i], num);
+      json_number(num, sd);
+      fprintf(fp, ",\"se\":%s", num);
+      json_number(num, 100*sd/r->means[i]);
+      fprintf(fp, ",\"cv\":%s}", num);
+    }
+    fprintf(fp, "]");
+    json_correlations(fp, r);
+    json_number(num, cond);
+    fprintf(fp, ",\"condition\":%s}\n", num);
+    break;
+  case OUTPUT_CSV:
+    if (!header) {
+      fprintf(fp, "%smodel,parameter,value,se,cv,condition\n",
+              scenario ? "scenario," : "");
+      header = 1;
+    }
+    for (i = 0; i < r->nparams; i++) {
+      sd = sqrt(r->variances[i]);
+      if (scenario)
+        fprintf(fp, "%d,", scenario);
+      fprintf(fp, "%s,%s,%.17g,%.17g,%.17g,%.17g\n", model ? model : "",
+              r->names[i], r->means[i], sd, 100*sd/r->means[i], cond);
+    }
+    break;
+  }
+  fclose(fp);
+  writer_write(results, buf, len);
+  writer_flush(results);
+  free(buf);
 }
 
-/* Copy n elements from src to dst */
-void copy_array_double(double *dst, double *src, int n)
-{
-  while (--n >= 0)
-    dst[n] = src[n];
+/* Predict the covariances of the parameters of a model at the points of a
+ * dataset from the Fisher information (see --fisher and fisher.h), instead
+ * of simulating, and print them.
+ *
+ * returns 0, or -1 on failure
+ */
+static int predict(int scenario, struct model *model, struct dataset *data,
+                   double params[], int fit[], double error)
+{
+  int m = model->nparams, i;
+  double covar[m][m], variances[m], cond;
+  double *jac = malloc(data->n * m * sizeof(double));
+  struct results r = {m, model->params, params, variances, 0, 0, NULL, NULL,
+                      params, &covar[0][0]};
+  if (!jac) {
+    fprintf(stderr, "Error: not enough memory for %d points.\n", data->n);
+    return -1;
+  }
+  if (fisher_jacobian(model, data, params, jac) ||
+      fisher(data->n, m, jac, params, fit, error, covar, &cond) < 0) {
+    free(jac);
+    return -1;
+  }
+  free(jac);
+  for (i = 0; i < m; i++)
+    variances[i] = covar[i][i];
+  print_fisher(scenario, model->name, &r, cond);
+  return 0;
+}
+
+/* As predict, for a global fit with the parameters names[] (see
+ * run_global_mode), whose models are given by label */
+static int predict_global(struct gfit *global, char *label, char *names[],
+                          double params[], int fit[], double error)
+{
+  int m = global->nparams, n = global->npoints, i;
+  double covar[m][m], variances[m], cond;
+  double *jac = malloc(n * m * sizeof(double));
+  struct results r = {m, names, params, variances, 0, 0, NULL, NULL, params,
+                      &covar[0][0]};
+  if (!jac) {
+    fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+    return -1;
+  }
+  if (gfit_jacobian(global, params, jac) ||
+      fisher(n, m, jac, params, fit, error, covar, &cond) < 0) {
+    free(jac);
+    return -1;
+  }
+  free(jac);
+  for (i = 0; i < m; i++)
+    variances[i] = covar[i][i];
+  print_fisher(0, label, &r, cond);
+  return 0;
+}
+
+/* Start the records of the simulations, given the names of the parameters:
+ * write the header of --records (as CSV), and create the trace of --trace.
+ * In a batch file (batch = 1), the scenarios might have different
+ * parameters, which are named p1, p2...
+ *
+ * returns 0, or -1 if the trace cannot be created
+ */
+static int records_begin(int batch, int nparams, char *names[])
+{
+  static int header = 0;
+  int i;
+  if (trace_path && !trace &&
+      !(trace = trace_create(trace_path, batch ? MAX_PARAMS : nparams,
+                             batch ? NULL : names, trace_flags)))
+    return -1;
+  if (!records || output_format == OUTPUT_JSONL || header)
+    return 0;
+  writer_printf(records, "%ssim,status,iters,chisq", batch ? "scenario," : "");
+  for (i = 0; i < (batch ? MAX_PARAMS : nparams); i++) {
+    if (batch)
+      writer_printf(records, ",p%d", i + 1);
+    else
+      writer_printf(records, ",%s", names[i]);
+  }
+  writer_write(records, "\n", 1);
+  header = 1;
+  return 0;
+}
+
+/* Write the result of a simulation to the records, as a line of CSV or JSON
+ * (see --records), and to the trace. Called by the threads of the
+ * simulations. */
+static void record_sim(void *arg, struct mc_sim *sim)
+{
+  static char *status[] = {"ok", "failed", "rejected"};
+  struct sim_records *rec = arg;
+  char buf[128 + 32 * rec->nparams + MAX_PARAMS];
+  int i, len = 0;
+  if (trace)
+    trace_add(trace, rec->scenario, rec->nparams, sim);
+  if (!records)
+    return;
+  if (output_format == OUTPUT_JSONL) {
+    len += sprintf(buf, "{");
+    if (rec->scenario)
+      len += sprintf(buf + len, "\"scenario\":%d,", rec->scenario);
+    len += sprintf(buf + len, "\"sim\":%d,\"status\":\"%s\",\"iters\":%d,"
+                   "\"chisq\":", sim->sim, status[sim->status], sim->iters);
+    len += json_number(buf + len, sim->chisq);
+    len += sprintf(buf + len, ",\"params\":[");
+    for (i = 0; i < rec->nparams; i++) {
+      if (i)
+        buf[len++] = ',';
+      len += json_number(buf + len, sim->params[i]);
+    }
+    len += sprintf(buf + len, "]}\n");
+  } else {
+    if (rec->scenario)
+      len += sprintf(buf, "%d,", rec->scenario);
+    len += sprintf(buf + len, "%d,%s,%d,%.17g", sim->sim, status[sim->status],
+                   sim->iters, sim->chisq);
+    for (i = 0; i < rec->nparams; i++)
+      len += sprintf(buf + len, ",%.17g", sim->params[i]);
+    /* the columns p1...pMAX_PARAMS of a batch file (see records_begin) */
+    for (; rec->scenario && i < MAX_PARAMS; i++)
+      buf[len++] = ',';
+    buf[len++] = '\n';
+  }
+  writer_write(records, buf, len);
+}
+
+/* Sections of the input files (see create_template). The points might be
+ * given either as "- Independent variables:" (S=[...] I=[...]), as a table
+ * in "- Data:", with a line per point, or as the levels of a grid in
+ * "- Grid:" (as --grid, each point repeated as given in "- Replicates:").
+ * "- Fixed parameters:", "- Simulations:" (the number of simulations, NREPS
+ * if not given) and "- Seed:" (of the random numbers, instead of that of
+ * --seed) are optional.
+ */
+enum {SEC_MODEL, SEC_VARS, SEC_DATA, SEC_GRID, SEC_REPS, SEC_PARAMS,
+      SEC_FIXED, SEC_ERROR, SEC_SIMS, SEC_SEED, NSECS};
+static char *section_titles[NSECS] = {"Model", "Independent variables", "Data",
+                                      "Grid", "Replicates", "Parameters",
+                                      "Fixed parameters", "Error",
+                                      "Simulations", "Seed"};
+
+/* A scenario to simulate, as read from the sections of an input file */
+struct scenario {
+  struct model *model;
+  struct dataset dataset;
+  double params[MAX_PARAMS];
+  int fit[MAX_PARAMS];
+  int nfit;
+  double error;
+  int nsims;
+  int seeded;               /* whether a seed was given... */
+  uint64_t seed;            /* ...and its value */
+};
+
+static int read_sections(struct parser *p, struct parser sec[], int batch);
+static int read_scenario(struct parser *p, struct parser sec[],
+                         struct scenario *s);
+
+/* Read the input from a file, with the format of the templates, and do the
+ * simulations. The file is mapped in memory and parsed in place, so that it
+ * might hold any number of points.
+ */
+int run_file_mode(struct arguments *args)
+{
+  struct mapfile mf;
+  struct parser p, sec[NSECS];
+  struct scenario s;
+  int ret = -1;
+
+  if (mapfile_open(&mf, args->fileinput))
+    return -1;
+  parse_init(&p, args->fileinput, mf.data, mf.len);
+  if (read_sections(&p, sec, 0) >= 0 && !read_scenario(&p, sec, &s)) {
+    if (s.seeded) {
+      sim_options.seed = s.seed;
+      seed_given = 1;
+    }
+    ret = simulate(s.model, &s.dataset, s.params, s.fit, s.nfit, s.error,
+                   s.nsims) < 0 ? -1 : 0;
+    dataset_free(&s.dataset);
+  }
+  mapfile_close(&mf);
+  return ret;
+}
+
+/* Scenarios of a batch file being simulated */
+struct batch {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;      /* signaled each time a scenario is done */
+  int running;              /* scenarios being simulated */
+  int failed;               /* scenarios which could not be simulated */
+};
+
+struct job {
+  int number;               /* number of the scenario in the file */
+  struct scenario s;
+  struct batch *batch;
+  struct sim_records rec;
+  struct mc_options opts;   /* with the distribution of the parameters: */
+  struct sketch quantiles[MAX_PARAMS];
+  struct histogram hists[MAX_PARAMS];
+  double covariance[MAX_PARAMS * MAX_PARAMS];
+  double mcerror[2 * MAX_PARAMS];
+  struct cache cache;
+};
+
+/* Print the results of a scenario of a batch file, as soon as it is done */
+static void job_done(void *arg, int nsuccess, double means[],
+                     double variances[])
+{
+  struct job *job = arg;
+  struct batch *batch = job->batch;
+  struct model *model = job->s.model;
+  struct results r = {model->nparams, model->params, means, variances,
+                      nsuccess, job->s.nsims, job->opts.quantiles,
+                      job->opts.hists, job->s.params, job->opts.covariance,
+                      job->opts.mcerror};
+  cache_end(&job->cache, nsuccess);
+  pthread_mutex_lock(&batch->lock);
+  if (nsuccess < 0) {
+    fprintf(stderr, "Error: the simulations of scenario %d failed.\n",
+            job->number);
+    batch->failed++;
+  } else {
+    print_results(job->number, model->name, &r);
+  }
+  if (records)
+    writer_flush(records);
+  batch->running--;
+  pthread_cond_signal(&batch->cond);
+  pthread_mutex_unlock(&batch->lock);
+  dist_free(&job->opts, model->nparams);
+  dataset_free(&job->s.dataset);
+  free(job);
+}
+
+/* Read the scenarios of a batch file, each one as an input file (a "- Model:"
+ * section starts a new one), and simulate all of them in the threads of the
+ * pool. The results are printed as the scenarios are done, so not
+ * necessarily in order. Only a few scenarios per thread are kept in memory,
+ * so the file might hold any number of them.
+ *
+ * returns 0 if all the scenarios were simulated, -1 if not
+ */
+int run_batch_mode(struct arguments *args)
+{
+  struct mapfile mf;
+  struct parser p, sec[NSECS];
+  struct batch batch = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                        0, 0};
+  struct mc_options opts = sim_options;
+  struct mc_problem problem;
+  struct job *job;
+  int nsecs, number = 0;
+  int maxrunning = 4 * (opts.pool ? pool_size(opts.pool) : 1);
+
+  if (mapfile_open(&mf, args->fileinput))
+    return -1;
+  parse_init(&p, args->fileinput, mf.data, mf.len);
+  opts.progress = 0;
+  if (records_begin(1, 0, NULL)) {
+    mapfile_close(&mf);
+    return -1;
+  }
+  while ((nsecs = read_sections(&p, sec, 1)) > 0) {
+    number++;
+    if (!(job = malloc(sizeof(struct job)))) {
+      fprintf(stderr, "Error: not enough memory for scenario %d.\n", number);
+      nsecs = -1;
+      break;
+    }
+    job->number = number;
+    job->batch = &batch;
+    if (read_scenario(&p, sec, &job->s)) {
+      fprintf(stderr, "Error: scenario %d skipped.\n", number);
+      free(job);
+      pthread_mutex_lock(&batch.lock);
+      batch.failed++;
+      pthread_mutex_unlock(&batch.lock);
+      continue;
+    }
+    /* the predictions are done at once, in this thread */
+    if (predicting) {
+      if (predict(job->number, job->s.model, &job->s.dataset, job->s.params,
+                  job->s.fit, job->s.error))
+        batch.failed++;
+      dataset_free(&job->s.dataset);
+      free(job);
+      continue;
+    }
+    /* wait until there is room for another scenario */
+    pthread_mutex_lock(&batch.lock);
+    while (batch.running >= maxrunning)
+      pthread_cond_wait(&batch.cond, &batch.lock);
+    batch.running++;
+    pthread_mutex_unlock(&batch.lock);
+    problem.model = job->s.model;
+    problem.data = &job->s.dataset;
+    problem.global = NULL;
+    job->opts = opts;
+    job->opts.nsims = job->s.nsims;
+    job->opts.seed = job->s.seeded ? job->s.seed : sim_options.seed;
+    share_noise(&job->opts, job->s.dataset.n);
+    job->rec.scenario = job->number;
+    job->rec.nparams = job->s.model->nparams;
+    job->opts.record_arg = &job->rec;
+    memset(&job->cache, 0, sizeof(struct cache));
+    if (dist_init(&job->opts, job->s.model->nparams, job->s.params,
+                  job->quantiles, job->hists, job->covariance,
+                  job->mcerror) ||
+        (cache_begin(&job->cache, job->s.model, &job->s.dataset,
+                     job->s.params, job->s.fit, job->s.error, &job->opts,
+                     job->s.seeded || seed_given),
+         mc_start(&problem, job->s.params, job->s.params, job->s.error,
+                 job->s.model->nparams, job->s.nfit, job->s.fit, &job->opts,
+                 job_done, job)))
+      job_done(job, -1, NULL, NULL);
+  }
+  /* wait for the scenarios being simulated */
+  pthread_mutex_lock(&batch.lock);
+  while (batch.running > 0)
+    pthread_cond_wait(&batch.cond, &batch.lock);
+  pthread_mutex_unlock(&batch.lock);
+  mapfile_close(&mf);
+  return nsecs < 0 || batch.failed ? -1 : 0;
+}
+
+/* Points of the grid of --sweep being simulated, and their results */
+struct sweep {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;      /* signaled each time a point is done */
+  int running;              /* points being simulated */
+  int failed;               /* points which could not be simulated */
+  int m;                    /* parameters of the model */
+  double *means;            /* means[npoints][m] of the adjusted parameters */
+  double *variances;        /* variances[npoints][m] (as those of
+                             * montecarlo) */
+  int *nsuccess;            /* nsuccess[npoints], -1 if the point failed */
+};
+
+struct sweep_job {
+  int point;                /* 0...npoints-1 */
+  struct sweep *sweep;
+  double params[MAX_PARAMS];  /* real values of the parameters... */
+  double error;             /* ...and error */
+  struct sim_records rec;
+};
+
+/* Keep the results of a point of the grid of --sweep */
+static void sweep_done(void *arg, int nsuccess, double means[],
+                       double variances[])
+{
+  struct sweep_job *job = arg;
+  struct sweep *sweep = job->sweep;
+  int m = sweep->m;
+  pthread_mutex_lock(&sweep->lock);
+  sweep->nsuccess[job->point] = nsuccess;
+  if (nsuccess < 0) {
+    sweep->failed++;
+  } else {
+    vcopy(m, &sweep->means[job->point * m], means);
+    vcopy(m, &sweep->variances[job->point * m], variances);
+  }
+  if (records)
+    writer_flush(records);
+  sweep->running--;
+  pthread_cond_signal(&sweep->cond);
+  pthread_mutex_unlock(&sweep->lock);
+  free(job);
+}
+
+/* Print the map of --sweep in the format of --format: a line (or row) per
+ * point of the grid, with the values swept[ns] (in grid->cols) out of
+ * names[m + 1] (the parameters and the error, whose values out of the grid
+ * are values[m + 1]), and the mean, bias and CV of each adjusted parameter */
+static void print_sweep(struct model *model, char *names[], double values[],
+                        int fit[], int ns, int swept[], struct dataset *grid,
+                        struct sweep *sweep, int nsims)
+{
+  char *buf = NULL, num[32];
+  size_t len = 0;
+  int m = model->nparams, i, j, k;
+  double p[m + 1], *means, *var, bias, cv;
+  FILE *fp;
+
+  if (!(fp = open_memstream(&buf, &len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    return;
+  }
+  /* header */
+  if (output_format == OUTPUT_TEXT) {
+    for (k = 0; k < ns; k++)
+      fprintf(fp, "%10s ", names[swept[k]]);
+    for (j = 0; j < m; j++)
+      if (fit[j])
+        fprintf(fp, "| %-19.19s ", model->params[j]);
+    fprintf(fp, "|\n");
+    for (k = 0; k < ns; k++)
+      fprintf(fp, "%10s ", "");
+    for (j = 0; j < m; j++)
+      if (fit[j])
+        fprintf(fp, "| %9s %9s ", "bias(%)", "CV(%)");
+    fprintf(fp, "| success(%%)\n");
+  } else if (output_format == OUTPUT_CSV) {
+    fprintf(fp, "point");
+    for (k = 0; k < ns; k++)
+      fprintf(fp, ",%s", names[swept[k]]);
+    for (j = 0; j < m; j++)
+      if (fit[j])
+        fprintf(fp, ",%s_mean,%s_bias,%s_cv", model->params[j],
+                model->params[j], model->params[j]);
+    fprintf(fp, ",nsuccess,nsims\n");
+  }
+  for (i = 0; i < grid->n; i++) {
+    vcopy(m + 1, p, values);
+    for (k = 0; k < ns; k++)
+      p[swept[k]] = grid->cols[k][i];
+    means = &sweep->means[i * m];
+    var = &sweep->variances[i * m];
+    switch (output_format) {
+    case OUTPUT_TEXT:
+      for (k = 0; k < ns; k++)
+        fprintf(fp, "%10.4g ", p[swept[k]]);
+      for (j = 0; j < m; j++) {
+        if (!fit[j])
+          continue;
+        if (sweep->nsuccess[i] < 0)
+          fprintf(fp, "| %9s %9s ", "-", "-");
+        else
+          fprintf(fp, "| %9.2f %9.2f ", 100*(means[j] - p[j])/p[j],
+                  100*sqrt(var[j])/means[j]);
+      }
+      if (sweep->nsuccess[i] < 0)
+        fprintf(fp, "| %10s\n", "failed");
+      else
+        fprintf(fp, "| %10.2f\n", 100.0*sweep->nsuccess[i]/nsims);
+      break;
+    case OUTPUT_JSONL:
+      fprintf(fp, "{\"point\":%d,\"values\":{", i + 1);
+      for (k = 0; k < ns; k++) {
+        json_number(num, p[swept[k]]);
+        fprintf(fp, "%s\"%s\":%s", k ? "," : "", names[swept[k]],
+                num);
+      }
+      fprintf(fp, "}");
+      if (sweep->nsuccess[i] < 0) {
+        fprintf(fp, ",\"error\":\"the simulations failed\"}\n");
+        break;
+      }
+      fprintf(fp, ",\"params\":[");
+      for (j = 0, k = 0; j < m; j++) {
+        if (!fit[j])
+          continue;
+        json_number(num, means[j]);
+        fprintf(fp, "%s{\"name\":\"%s\",\"mean\":%s", k++ ? "," : "",
+                model->params[j], num);
+        json_number(num, means[j] - p[j]);
+        fprintf(fp, ",\"bias\":%s", num);
+        json_number(num, 100*sqrt(var[j])/means[j]);
+        fprintf(fp, ",\"cv\":%s}", num);
+      }
+      fprintf(fp, "],\"nsuccess\":%d,\"nsims\":%d}\n", sweep->nsuccess[i],
+              nsims);
+      break;
+    case OUTPUT_CSV:
+      fprintf(fp, "%d", i + 1);
+      for (k = 0; k < ns; k++)
+        fprintf(fp, ",%.17g", p[swept[k]]);
+      for (j = 0; j < m; j++) {
+        if (!fit[j])
+          continue;
+        bias = means[j] - p[j];
+        cv = 100*sqrt(var[j])/means[j];
+        if (sweep->nsuccess[i] < 0)
+          fprintf(fp, ",,,");
+        else
+          fprintf(fp, ",%.17g,%.17g,%.17g", means[j], bias, cv);
+      }
+      fprintf(fp, ",%d,%d\n", sweep->nsuccess[i] < 0 ? 0 : sweep->nsuccess[i],
+              nsims);
+      break;
+    }
+  }
+  fclose(fp);
+  writer_write(results, buf, len);
+  writer_flush(results);
+  free(buf);
+}
+
+/* Simulate the points of --data (or --data-file, --grid) at every
+ * combination of the real values of the parameters of --sweep, and maybe of
+ * the error (the others as in --params and --error), and print a map of the
+ * results (see print_sweep). The combinations are simulated at once in the
+ * threads of the pool, as the scenarios of a batch file, and each one with
+ * the same seed, so the differences between them are not due to the random
+ * numbers (with --common-noise, the draws are only done once).
+ *
+ * returns 0 if all the points were simulated, -1 if not
+ */
+int run_sweep_mode(struct arguments *args)
+{
+  struct model *model = get_model(args->model);
+  struct sweep sweep = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                        0, 0, 0, NULL, NULL, NULL};
+  struct mc_options opts = sim_options;
+  struct mc_problem problem = {model, NULL, NULL};
+  struct dataset data, grid;
+  struct mapfile mf;
+  struct sweep_job *job;
+  struct parser p;
+  int m, nfix, nfit, ns, i, j, ret = -1;
+  int maxrunning = 4 * (opts.pool ? pool_size(opts.pool) : 1);
+  if (!model) {
+    fprintf(stderr, "Unrecognized model name: %s\n", args->model);
+    return -1;
+  }
+  m = model->nparams;
+  /* the error is swept as a parameter m */
+  char *names[m + 1];
+  double values[m + 1], *levels[m + 1], *sw_levels[m + 1];
+  int fit[m], nlevels[m + 1], sw_nlevels[m + 1], swept[m + 1];
+  for (j = 0; j < m; j++)
+    names[j] = model->params[j];
+  names[m] = "error";
+  if (get_params(model, args->params, values) ||
+      get_error(model, args->error, &values[m]) ||
+      (nfix = get_fixed_params(model, args->fixed_params, fit)) < 0)
+    return -1;
+  nfit = m - nfix;
+  /* the swept parameters, in the order of the model */
+  parse_init(&p, "--sweep", args->sweep, strlen(args->sweep));
+  if (parse_grid(&p, m + 1, names, levels, nlevels, 0))
+    return -1;
+  for (j = ns = 0; j <= m; j++) {
+    if (levels[j]) {
+      swept[ns] = j;
+      sw_levels[ns] = levels[j];
+      sw_nlevels[ns++] = nlevels[j];
+    }
+  }
+  if (ns == 0) {
+    fprintf(stderr, "Error: --sweep has no parameters.\n");
+    return -1;
+  }
+  if (dataset_grid(&grid, ns, sw_nlevels, sw_levels, 1) < 0)
+    goto end;
+  if (get_dataset(model, args->data, args->datafile, args->grid,
+                  args->replicates, &data, &mf) < 0)
+    goto free_grid;
+  sweep.m = m;
+  sweep.means = malloc((size_t) grid.n * m * sizeof(double));
+  sweep.variances = malloc((size_t) grid.n * m * sizeof(double));
+  sweep.nsuccess = malloc(grid.n * sizeof(int));
+  if (!sweep.means || !sweep.variances || !sweep.nsuccess ||
+      records_begin(1, 0, NULL)) {
+    if (!sweep.means || !sweep.variances || !sweep.nsuccess)
+      fprintf(stderr, "Error: not enough memory for %d points.\n", grid.n);
+    goto free_data;
+  }
+  problem.data = &data;
+  opts.nsims = NREPS;
+  opts.progress = 0;
+  share_noise(&opts, data.n);
+  for (i = 0; i < grid.n; i++) {
+    if (!(job = malloc(sizeof(struct sweep_job)))) {
+      fprintf(stderr, "Error: not enough memory for point %d.\n", i + 1);
+      sweep.nsuccess[i] = -1;
+      sweep.failed++;
+      continue;
+    }
+    job->point = i;
+    job->sweep = &sweep;
+    vcopy(m, job->params, values);
+    job->error = values[m];
+    for (j = 0; j < ns; j++) {
+      if (swept[j] == m)
+        job->error = grid.cols[j][i];
+      else
+        job->params[swept[j]] = grid.cols[j][i];
+    }
+    job->rec.scenario = i + 1;
+    job->rec.nparams = m;
+    opts.record_arg = &job->rec;
+    /* wait until there is room for another point */
+    pthread_mutex_lock(&sweep.lock);
+    while (sweep.running >= maxrunning)
+      pthread_cond_wait(&sweep.cond, &sweep.lock);
+    sweep.running++;
+    pthread_mutex_unlock(&sweep.lock);
+    /* the fits start from the real values of the point, which are known */
+    if (mc_start(&problem, job->params, job->params, job->error, m, nfit,
+                 fit, &opts, sweep_done, job))
+      sweep_done(job, -1, NULL, NULL);
+  }
+  /* wait for the points being simulated */
+  pthread_mutex_lock(&sweep.lock);
+  while (sweep.running > 0)
+    pthread_cond_wait(&sweep.cond, &sweep.lock);
+  pthread_mutex_unlock(&sweep.lock);
+  print_sweep(model, names, values, fit, ns, swept, &grid, &sweep, NREPS);
+  ret = sweep.failed ? -1 : 0;
+
+free_data:
+  free(sweep.means);
+  free(sweep.variances);
+  free(sweep.nsuccess);
+  dataset_free(&data);
+  mapfile_close(&mf);
+free_grid:
+  dataset_free(&grid);
+end:
+  for (j = 0; j < ns; j++)
+    free(sw_levels[j]);
+  return ret;
+}
+
+/* Largest number of replicates (or levels) tried by --plan */
+#define PLAN_MAX 4096
+/* designs simulated by --plan, at most (a search takes much less) */
+#define PLAN_MAXSTEPS 64
+
+/* What --plan grows: the copies of some points (var = -1), or the levels of
+ * a variable of a grid of points, spread between its first and last ones */
+struct plan {
+  struct model *model;
+  struct dataset *base;     /* the points (one copy) */
+  int var;
+  int nlevels[MAX_INDEP];   /* the grid */
+  double *levels[MAX_INDEP];
+  int replicates;
+};
+
+/* A design simulated by --plan */
+struct plan_step {
+  int k;                    /* copies, or levels of the variable */
+  int npoints;
+  int nsuccess;
+  double cv[MAX_PARAMS];    /* CV of each parameter (%) */
+};
+
+/* Build the design of a plan with k copies or levels.
+ * returns the number of points, or -1 on failure */
+static long plan_design(struct plan *pl, int k, struct dataset *data)
+{
+  int nlevels[MAX_INDEP], v;
+  double *levels[MAX_INDEP], grown[k];
+  if (pl->var < 0)
+    return dataset_repeat(data, pl->base, k);
+  for (v = 0; v < pl->model->nvars; v++) {
+    nlevels[v] = pl->nlevels[v];
+    levels[v] = pl->levels[v];
+  }
+  v = pl->var;
+  dataset_levels(levels[v][0], levels[v][nlevels[v] - 1], k, grown);
+  nlevels[v] = k;
+  levels[v] = grown;
+  return dataset_grid(data, pl->model->nvars, nlevels, levels,
+                      pl->replicates);
+}
+
+/* Simulate the design of a plan with k copies or levels (the number of the
+ * step in the records), and set step to its results.
+ * returns 0, or -1 on failure */
+static int plan_step(struct plan *pl, int k, double params[], int fit[],
+                     int nfit, double error, struct mc_options *opts,
+                     int number, struct plan_step *step)
+{
+  struct dataset data;
+  struct mc_problem problem = {pl->model, &data, NULL};
+  struct mc_options o = *opts;
+  int m = pl->model->nparams, j;
+  struct sim_records rec = {number, m};
+  double means[m], variances[m];
+  long n;
+  if ((n = plan_design(pl, k, &data)) < 0)
+    return -1;
+  o.record_arg = &rec;
+  step->k = k;
+  step->npoints = n;
+  step->nsuccess = montecarlo(&problem, params, params, error, m, nfit, fit,
+                              &o, means, variances);
+  dataset_free(&data);
+  if (records)
+    writer_flush(records);
+  if (step->nsuccess < 0) {
+    fprintf(stderr, "Error: the simulations of %d points failed.\n",
+            step->npoints);
+    return -1;
+  }
+  for (j = 0; j < m; j++)
+    step->cv[j] = step->nsuccess ? 100*sqrt(variances[j])/means[j] : NAN;
+  return 0;
+}
+
+static int compare_steps(const void *a, const void *b)
+{
+  const struct plan_step *x = a, *y = b;
+  return x->k < y->k ? -1 : x->k > y->k;
+}
+
+/* Print the curve of the CVs of --plan in the format of --format: a line
+ * (or row) per design simulated, in order of size, with the CV of each
+ * adjusted parameter and whether they reach their targets (target[m], NaN
+ * if there is none), and the smallest design which reaches them (best, or
+ * NULL). over is the name of what grows ("replicates" or a variable). */
+static void print_plan(struct model *model, int fit[], double target[],
+                       char *over, struct plan_step steps[], int nsteps,
+                       struct plan_step *best, int nsims)
+{
+  char *buf = NULL, num[32], *key = strcmp(over, "replicates") ? "levels" :
+                                    "replicates";
+  size_t len = 0;
+  int m = model->nparams, i, j, k, met;
+  FILE *fp;
+
+  if (!(fp = open_memstream(&buf, &len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    return;
+  }
+  if (output_format == OUTPUT_TEXT) {
+    fprintf(fp, "\n%10s %10s |", over, "points");
+    for (j = 0; j < m; j++)
+      if (fit[j])
+        fprintf(fp, " %9.9s", model->params[j]);
+    fprintf(fp, " | success(%%)\n%21s |", "target CV(%)");
+    for (j = 0; j < m; j++) {
+      if (!fit[j])
+        continue;
+      if (isnan(target[j]))
+        fprintf(fp, " %9s", "-");
+      else
+        fprintf(fp, " %9.2f", target[j]);
+    }
+    fprintf(fp, " |\n");
+  } else if (output_format == OUTPUT_CSV) {
+    fprintf(fp, "%s,points", key);
+    for (j = 0; j < m; j++)
+      if (fit[j])
+        fprintf(fp, ",%s_cv", model->params[j]);
+    fprintf(fp, ",nsuccess,nsims,met\n");
+  }
+  for (i = 0; i < nsteps; i++) {
+    for (j = 0, met = 1; j < m; j++)
+      if (!isnan(target[j]) && !(steps[i].cv[j] <= target[j]))
+        met = 0;
+    switch (output_format) {
+    case OUTPUT_TEXT:
+      fprintf(fp, "%10d %10d |", steps[i].k, steps[i].npoints);
+      for (j = 0; j < m; j++)
+        if (fit[j])
+          fprintf(fp, " %9.2f", steps[i].cv[j]);
+      fprintf(fp, " | %10.2f%s\n", 100.0*steps[i].nsuccess/nsims,
+              met ? "  *" : "");
+      break;
+    case OUTPUT_JSONL:
+      fprintf(fp, "{\"%s\":%d,\"points\":%d,\"cv\":{", key, steps[i].k,
+              steps[i].npoints);
+      for (j = 0, k = 0; j < m; j++) {
+        if (!fit[j])
+          continue;
+        json_number(num, steps[i].cv[j]);
+        fprintf(fp, "%s\"%s\":%s", k++ ? "," : "", model->params[j], num);
+      }
+      fprintf(fp, "},\"nsuccess\":%d,\"nsims\":%d,\"met\":%s}\n",
+              steps[i].nsuccess, nsims, met ? "true" : "false");
+      break;
+    case OUTPUT_CSV:
+      fprintf(fp, "%d,%d", steps[i].k, steps[i].npoints);
+      for (j = 0; j < m; j++)
+        if (fit[j])
+          fprintf(fp, ",%.17g", steps[i].cv[j]);
+      fprintf(fp, ",%d,%d,%d\n", steps[i].nsuccess, nsims, met);
+      break;
+    }
+  }
+  if (output_format == OUTPUT_TEXT && best)
+    fprintf(fp, "\nSmallest design reaching the targets: %d %s%s (%d "
+            "points)\n", best->k, strcmp(over, key) ? "levels of " : "",
+            over, best->npoints);
+  else if (output_format == OUTPUT_TEXT)
+    fprintf(fp, "\nThe targets are not reached with up to %d %s%s.\n",
+            PLAN_MAX, strcmp(over, key) ? "levels of " : "", over);
+  else if (output_format == OUTPUT_JSONL && best)
+    fprintf(fp, "{\"smallest\":{\"%s\":%d,\"points\":%d}}\n", key, best->k,
+            best->npoints);
+  else if (output_format == OUTPUT_JSONL)
+    fprintf(fp, "{\"smallest\":null}\n");
+  fclose(fp);
+  writer_write(results, buf, len);
+  writer_flush(results);
+  free(buf);
+}
+
+/* Find the smallest design which reaches the CVs of --plan, growing the
+ * number of copies of the points of --data (or --data-file, --grid), or the
+ * number of levels of a variable of --grid (see --plan-over). Starting from
+ * the design given, the size of the next design is predicted from the CVs of
+ * the last one (which fall as the square root of the number of points) until
+ * one reaches the targets, and then the smallest size is searched between
+ * the largest one which does not reach them and it, the same way (or by
+ * bisection, if the predictions do not narrow the search fast enough). Every design is simulated with the same seed: the copies are
+ * appended after the points, so the noise of a design is also that of its
+ * first points in a larger one (the streams of the simulations are nested),
+ * and the CVs of the sizes differ by the points, not by the random numbers.
+ * With --common-noise, the noise of the first design which reaches the
+ * targets is drawn once and reused by the smaller ones of the bisection.
+ *
+ * returns 0 if a design reaches the targets, -1 if not
+ */
+int run_plan_mode(struct arguments *args)
+{
+  struct model *model = get_model(args->model);
+  struct mc_options opts = sim_options;
+  struct dataset base;
+  struct mapfile mf;
+  struct parser p;
+  struct plan pl;
+  struct plan_step steps[PLAN_MAXSTEPS], *best = NULL;
+  char *over = "replicates";
+  int m, nfix, nfit, ntargets, nsteps = 0, i, j, k, lo, hi = 0, ret = -1;
+  int width = INT_MAX;
+  double error, ratio, r;
+  if (!model) {
+    fprintf(stderr, "Unrecognized model name: %s\n", args->model);
+    return -1;
+  }
+  m = model->nparams;
+  double params[m], target[m];
+  int fit[m];
+  if (get_params(model, args->params, params) ||
+      get_error(model, args->error, &error) ||
+      (nfix = get_fixed_params(model, args->fixed_params, fit)) < 0)
+    return -1;
+  nfit = m - nfix;
+  parse_init(&p, "--plan", args->plan, strlen(args->plan));
+  if (parse_params(&p, m, model->params, target, 0))
+    return -1;
+  for (j = ntargets = 0; j < m; j++) {
+    if (isnan(target[j]))
+      continue;
+    if (!fit[j]) {
+      fprintf(stderr, "Error: %s is fixed, it cannot have a target CV.\n",
+              model->params[j]);
+      return -1;
+    }
+    if (!(target[j] > 0)) {
+      fprintf(stderr, "Error: the target CV of %s must be positive.\n",
+              model->params[j]);
+      return -1;
+    }
+    ntargets++;
+  }
+  if (ntargets == 0) {
+    fprintf(stderr, "Error: --plan has no targets.\n");
+    return -1;
+  }
+  /* what grows, and from which size */
+  memset(&pl, 0, sizeof(pl));
+  pl.model = model;
+  pl.var = -1;
+  pl.replicates = args->replicates;
+  if (args->plan_over && strcmp(args->plan_over, "replicates")) {
+    for (i = 0; i < model->nvars; i++) {
+      if (!strcmp(model->indep_vars[i], args->plan_over))
+        pl.var = i;
+    }
+    if (pl.var < 0) {
+      fprintf(stderr, "Error: %s is not a variable of the model.\n",
+              args->plan_over);
+      return -1;
+    }
+    if (!args->grid) {
+      fprintf(stderr, "Error: --plan-over %s needs the points as a grid "
+              "(--grid).\n", args->plan_over);
+      return -1;
+    }
+    over = args->plan_over;
+    parse_init(&p, "--grid", args->grid, strlen(args->grid));
+    if (parse_grid(&p, model->nvars, model->indep_vars, pl.levels,
+                   pl.nlevels, 1))
+      return -1;
+    k = pl.nlevels[pl.var] > 2 ? pl.nlevels[pl.var] : 2;
+  } else {
+    if (get_dataset(model, args->data, args->datafile, args->grid,
+                    args->replicates, &base, &mf) < 0)
+      return -1;
+    pl.base = &base;
+    k = 1;
+  }
+  if (records_begin(1, 0, NULL))
+    goto end;
+  opts.nsims = NREPS;
+  opts.progress = 0;
+  lo = k - 1;
+  while (nsteps < PLAN_MAXSTEPS) {
+    if (plan_step(&pl, k, params, fit, nfit, error, &opts, nsteps + 1,
+                  &steps[nsteps]))
+      goto end;
+    /* how far the CVs are from their targets (infinite if unknown) */
+    for (j = 0, ratio = 0; j < m; j++) {
+      if (isnan(target[j]))
+        continue;
+      r = steps[nsteps].cv[j] / target[j];
+      ratio = r > ratio ? r : isnan(r) ? INFINITY : ratio;
+    }
+    nsteps++;
+    if (ratio <= 1) {
+      /* the smaller designs reuse the noise of this one */
+      if (!hi && pl.var < 0)
+        share_noise(&opts, steps[nsteps - 1].npoints);
+      hi = k;
+    } else {
+      lo = k;
+    }
+    if (hi ? hi - lo <= 1 : k >= PLAN_MAX)
+      break;
+    /* the size at which the CVs of this design would reach the targets */
+    r = isfinite(ratio) ? ceil(k * ratio * ratio) : 2.0 * k;
+    if (!hi) {
+      r = r < k + 1 ? k + 1 : r > 8.0 * k ? 8.0 * k : r;
+      k = r > PLAN_MAX ? PLAN_MAX : (int) r;
+    } else {
+      /* bisection, if the last prediction did not halve the interval */
+      if (hi - lo > width / 2 || !isfinite(ratio))
+        r = lo + (hi - lo) / 2;
+      k = r < lo + 1 ? lo + 1 : r > hi - 1 ? hi - 1 : (int) r;
+      width = hi - lo;
+    }
+  }
+  qsort(steps, nsteps, sizeof(struct plan_step), compare_steps);
+  for (i = 0; hi && i < nsteps; i++) {
+    if (steps[i].k == hi)
+      best = &steps[i];
+  }
+  print_plan(model, fit, target, over, steps, nsteps, best, NREPS);
+  ret = best ? 0 : -1;
+
+end:
+  if (pl.var < 0) {
+    dataset_free(&base);
+    mapfile_close(&mf);
+  } else {
+    for (i = 0; i < model->nvars; i++)
+      free(pl.levels[i]);
+  }
+  return ret;
+}
+
+/* Levels of each variable of --design, unless given in --ranges, and number
+ * of searches, each one from a random design */
+#define DESIGN_LEVELS 32
+#define DESIGN_STARTS 32
+
+static char *criterion_names[] = {"D", "A", "CV"};
+
+/* Print the values of the variables at the points of a design, as in --data
+ * ("S=[1,2,5] I=[0,0,3]", rounded in text format), or as a JSON object of
+ * arrays, according to format (OUTPUT_...) */
+static void print_points(FILE *fp, struct design_space *sp, struct design *d,
+                         int format)
+{
+  int nvars = sp->model->nvars, json = format == OUTPUT_JSONL, i, v;
+  char num[32];
+  double x;
+  fprintf(fp, json ? "{" : "");
+  for (v = 0; v < nvars; v++) {
+    fprintf(fp, json ? "%s\"%s\":[" : "%s%s=[", v ? (json ? "," : " ") : "",
+            sp->model->indep_vars[v]);
+    for (i = 0; i < sp->npoints; i++) {
+      x = sp->levels[v][d->points[i * nvars + v]];
+      if (format == OUTPUT_TEXT)
+        snprintf(num, sizeof(num), "%.6g", x);
+      else
+        json_number(num, x);
+      fprintf(fp, "%s%s", i ? "," : "", num);
+    }
+    fprintf(fp, "]");
+  }
+  fprintf(fp, json ? "}" : "");
+}
+
+/* Print a design found by --design, in the format of --format: its rank, the
+ * value of the criterion, its points, and the CVs of the parameters as
+ * predicted (predicted[], in %) and as simulated (r) */
+static void print_design(int rank, struct design_space *sp, struct design *d,
+                         double predicted[], struct results *r)
+{
+  static int header = 0;
+  char *buf = NULL, num[32];
+  size_t len = 0;
+  int i;
+  FILE *fp;
+  double cv;
+
+  if (!(fp = open_memstream(&buf, &len))) {
+    fprintf(stderr, "Error: not enough memory for the results.\n");
+    return;
+  }
+  switch (output_format) {
+  case OUTPUT_TEXT:
+    fprintf(fp, "\n- Design %d (criterion %s: %.6g)\n", rank,
+            criterion_names[sp->criterion], d->score);
+    print_points(fp, sp, d, OUTPUT_TEXT);
+    fprintf(fp, "\n\n Parameter     Value    Predicted CV(%%)   Simulated CV(%%)\n");
+    fprintf(fp, "----------------------------------------------------------\n");
+    for (i = 0; i < r->nparams; i++) {
+      cv = 100*sqrt(r->variances[i])/r->means[i];
+      fprintf(fp, "%d | %-6s %10.6g   %10.2f%%        %10.2f%%\n", i,
+              r->names[i], r->params[i], predicted[i], cv);
+      fprintf(fp, "----------------------------------------------------------\n");
+    }
+    fprintf(fp, "Successful simulations: %d of %d\n", r->nsuccess, r->nsims);
+    break;
+  case OUTPUT_JSONL:
+    fprintf(fp, "{\"design\":%d,\"model\":\"%s\",\"criterion\":\"%s\",", rank,
+            sp->model->name, criterion_names[sp->criterion]);
+    json_number(num, d->score);
+    fprintf(fp, "\"score\":%s,\"points\":", num);
+    print_points(fp, sp, d, OUTPUT_JSONL);
+    fprintf(fp, ",\"params\":[");
+    for (i = 0; i < r->nparams; i++) {
+      json_number(num, r->params[i]);
+      fprintf(fp, "%s{\"name\":\"%s\",\"value\":%s", i ? "," : "",
+              r->names[i], num);
+      json_number(num, predicted[i]);
+      fprintf(fp, ",\"predicted_cv\":%s", num);
+      json_number(num, 100*sqrt(r->variances[i])/r->means[i]);
+      fprintf(fp, ",\"cv\":%s}", num);
+    }
+    fprintf(fp, "],\"nsuccess\":%d,\"nsims\":%d}\n", r->nsuccess, r->nsims);
+    break;
+  case OUTPUT_CSV:
+    if (!header) {
+      fprintf(fp, "design,model,criterion,score,points,parameter,value,"
+              "predicted_cv,cv,nsuccess,nsims\n");
+      header = 1;
+    }
+    for (i = 0; i < r->nparams; i++) {
+      fprintf(fp, "%d,%s,%s,%.17g,\"", rank, sp->model->name,
+              criterion_names[sp->criterion], d->score);
+      print_points(fp, sp, d, OUTPUT_CSV);
+      fprintf(fp, "\",%s,%.17g,%.17g,%.17g,%d,%d\n", r->names[i],
+              r->params[i], predicted[i],
+              100*sqrt(r->variances[i])/r->means[i], r->nsuccess, r->nsims);
+    }
+    break;
+  }
+  fclose(fp);
+  writer_write(results, buf, len);
+  writer_flush(results);
+  free(buf);
+}
+
+/* Simulate a design found by --design (as the "scenario" rank of the records),
+ * and print it along with its predicted CVs.
+ *
+ * returns 0, or -1 on failure
+ */
+static int confirm_design(int rank, struct design_space *sp,
+                          struct design *d, int nfit)
+{
+  struct model *model = sp->model;
+  int m = model->nparams, nvars = model->nvars, n = sp->npoints, i, v;
+  struct mc_problem problem = {model, NULL, NULL};
+  struct mc_options opts = sim_options;
+  struct sim_records rec = {rank, m};
+  struct dataset data;
+  double *cols[MAX_INDEP] = {NULL}, *jac = NULL;
+  double covar[m][m], predicted[m], means[m], variances[m], cond;
+  struct results r = {m, model->params, means, variances, 0, NREPS, NULL,
+                      NULL, sp->params, NULL};
+  int ret = -1;
+  for (v = 0; v < nvars; v++) {
+    if (!(cols[v] = malloc(n * sizeof(double))))
+      break;
+  }
+  if (v < nvars || !(jac = malloc(n * m * sizeof(double)))) {
+    fprintf(stderr, "Error: not enough memory for the designs.\n");
+    for (v = 0; v < nvars; v++)
+      free(cols[v]);
+    return -1;
+  }
+  for (i = 0; i < n; i++)
+    for (v = 0; v < nvars; v++)
+      cols[v][i] = sp->levels[v][d->points[i * nvars + v]];
+  dataset_init(&data, nvars, n, cols);
+  problem.data = &data;
+  /* predicted... */
+  if (fisher_jacobian(model, &data, sp->params, jac) ||
+      fisher(n, m, jac, sp->params, sp->fit, sp->error, covar, &cond) < 0)
+    goto end;
+  for (i = 0; i < m; i++)
+    predicted[i] = 100*sqrt(covar[i][i])/sp->params[i];
+  /* ...and simulated */
+  opts.nsims = NREPS;
+  opts.progress = 0;
+  opts.record_arg = &rec;
+  share_noise(&opts, n);
+  r.nsuccess = montecarlo(&problem, sp->params, sp->params, sp->error, m,
+                          nfit, sp->fit, &opts, means, variances);
+  if (r.nsuccess >= 0) {
+    print_design(rank, sp, d, predicted, &r);
+    ret = 0;
+  }
+
+end:
+  free(jac);
+  dataset_free(&data);
+  return ret;
+}
+
+/* Search the designs of --design: the points, with the variables within
+ * --ranges, which give the most precise parameters according to their Fisher
+ * information (see design.h), and confirm the best ones by simulation.
+ *
+ * returns 0, or -1 on failure
+ */
+int run_design_mode(struct arguments *args)
+{
+  struct model *model = get_model(args->model);
+  struct design_space sp;
+  struct design *top;
+  struct parser p;
+  int nvars, nfix, nfit, ntop, i, j, v, ret = -1;
+  if (!model) {
+    fprintf(stderr, "Unrecognized model name: %s\n", args->model);
+    return -1;
+  }
+  nvars = model->nvars;
+  double params[model->nparams], lo[nvars], hi[nvars];
+  int fit[model->nparams];
+  memset(&sp, 0, sizeof(sp));
+  sp.model = model;
+  sp.params = params;
+  sp.fit = fit;
+  sp.npoints = args->design;
+  if (get_params(model, args->params, params) ||
+      get_error(model, args->error, &sp.error) ||
+      (nfix = get_fixed_params(model, args->fixed_params, fit)) < 0)
+    return -1;
+  nfit = model->nparams - nfix;
+  parse_init(&p, "--ranges", args->ranges, strlen(args->ranges));
+  if (parse_ranges(&p, nvars, model->indep_vars, lo, hi, sp.nlevels))
+    return -1;
+  /* the criterion: D, A or the name of an adjusted parameter */
+  if (!strcmp(args->criterion, "D")) {
+    sp.criterion = DESIGN_D;
+  } else if (!strcmp(args->criterion, "A")) {
+    sp.criterion = DESIGN_A;
+  } else {
+    sp.criterion = DESIGN_CV;
+    for (j = 0; j < model->nparams; j++)
+      if (!strcmp(args->criterion, model->params[j]))
+        break;
+    if (j == model->nparams || !fit[j]) {
+      fprintf(stderr, "Error: invalid criterion %s (D, A or the name of an "
+              "adjusted parameter).\n", args->criterion);
+      return -1;
+    }
+    sp.param = j;
+  }
+  if (sp.npoints < nfit) {
+    fprintf(stderr, "Error: a design needs at least as many points as "
+            "parameters to adjust (%d).\n", nfit);
+    return -1;
+  }
+  /* the levels (see dataset_levels) */
+  for (v = 0; v < nvars; v++) {
+    if (hi[v] == lo[v])
+      sp.nlevels[v] = 1;
+    else if (sp.nlevels[v] == 0)
+      sp.nlevels[v] = DESIGN_LEVELS;
+    if (!(sp.levels[v] = malloc(sp.nlevels[v] * sizeof(double)))) {
+      fprintf(stderr, "Error: not enough memory for the levels.\n");
+      goto end;
+    }
+    dataset_levels(lo[v], hi[v], sp.nlevels[v], sp.levels[v]);
+  }
+  if (!(top = calloc(args->designs, sizeof(struct design)))) {
+    fprintf(stderr, "Error: not enough memory for the designs.\n");
+    goto end;
+  }
+  ntop = design_search(&sp, DESIGN_STARTS, sim_options.seed,
+                       sim_options.pool, args->designs, top);
+  if (ntop >= 0 && records_begin(1, 0, NULL) == 0) {
+    for (i = 0, ret = 0; i < ntop && ret == 0; i++)
+      ret = confirm_design(i + 1, &sp, &top[i], nfit);
+  }
+  for (i = 0; i < ntop; i++)
+    design_free(&top[i]);
+  free(top);
+
+end:
+  for (v = 0; v < nvars; v++)
+    free(sp.levels[v]);
+  return ret;
+}
+
+/* A client of the server (see run_serve_mode), served by its own thread */
+struct client {
+  int fd;
+  char *buf;                /* data received and not used yet */
+  size_t len, size;
+  int wake[2];              /* pipe written to when a run is done */
+  struct client *prev, *next; /* live clients (see run_serve_mode) */
+};
+
+/* The live clients, which the server waits for before it stops */
+static pthread_mutex_t clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t clients_gone = PTHREAD_COND_INITIALIZER;
+static struct client *clients;
+
+/* A request of a client being simulated */
+struct request {
+  struct client *client;
+  int nparams;
+  char **names;
+  int nsuccess;
+  double means[MAX_PARAMS];
+  double variances[MAX_PARAMS];
+};
+
+/* receive: reads more data from the client into its buffer.
+ * returns the number of bytes read, 0 if the client closed the connection,
+ * -1 on failure */
+static ssize_t receive(struct client *c)
+{
+  ssize_t n;
+  char *buf;
+  if (c->size - c->len < 4096) {
+    if (!(buf = realloc(c->buf, 2 * c->size + 4096)))
+      return -1;
+    c->buf = buf;
+    c->size = 2 * c->size + 4096;
+  }
+  do {
+    n = read(c->fd, c->buf + c->len, c->size - c->len);
+  } while (n < 0 && errno == EINTR);
+  if (n > 0)
+    c->len += n;
+  return n;
+}
+
+/* consume: removes the first n bytes of the buffer of a client */
+static void consume(struct client *c, size_t n)
+{
+  memmove(c->buf, c->buf + n, c->len - n);
+  c->len -= n;
+}
+
+/* line_end: length of the line starting at pos of the buffer of a client,
+ * with its '\n', or 0 if it has not been received whole yet */
+static size_t line_end(struct client *c, size_t pos)
+{
+  char *nl;
+  if (pos >= c->len)
+    return 0;
+  nl = memchr(c->buf + pos, '\n', c->len - pos);
+  return nl ? nl - (c->buf + pos) + 1 : 0;
+}
+
+/* is_line: whether the line at pos (of length len, see line_end) is "word" */
+static int is_line(struct client *c, size_t pos, size_t len, char *word)
+{
+  size_t n = strlen(word);
+  while (len > 0 && isspace((unsigned char) c->buf[pos + len - 1]))
+    len--;
+  return len == n && !strncmp(c->buf + pos, word, n);
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+  ssize_t n;
+  while (len > 0) {
+    if ((n = write(fd, buf, len)) < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+static void request_done(void *arg, int nsuccess, double means[],
+                         double variances[])
+{
+  struct request *r = arg;
+  char c = 0;
+  if ((r->nsuccess = nsuccess) >= 0) {
+    memcpy(r->means, means, r->nparams * sizeof(double));
+    memcpy(r->variances, variances, r->nparams * sizeof(double));
+  }
+  while (write(r->client->wake[1], &c, 1) < 0 && errno == EINTR)
+    ;
+}
+
+/* serve_request: simulates the scenario of a request (the first len bytes of
+ * the buffer of the client, followed by its last line, "."), and sends the
+ * reply. While the simulations run, a line "cancel" from the client (or the
+ * client closing the connection) stops them.
+ *
+ * returns 0, or -1 if the connection must be closed
+ */
+static int serve_request(struct client *c, size_t len, size_t total)
+{
+  struct parser p, sec[NSECS];
+  struct scenario s;
+  struct mc_options opts = sim_options;
+  struct mc_problem problem;
+  struct request r;
+  struct cache cache;
+  struct pollfd fds[2];
+  FILE *out, *err;
+  char *reply = NULL, *msg = NULL, ch;
+  size_t replylen = 0, msglen = 0, n;
+  int i, cancel = 0, gone = 0, done = 0, ret;
+
+  if (!(out = open_memstream(&reply, &replylen)))
+    return -1;
+  if (!(err = open_memstream(&msg, &msglen))) {
+    fclose(out);
+    free(reply);
+    return -1;
+  }
+  parse_init(&p, "request", c->buf, len);
+  p.err = err;
+  ret = read_sections(&p, sec, 0) < 0 || read_scenario(&p, sec, &s);
+  fclose(err);
+  /* the scenario does not refer to the buffer, which is reused */
+  consume(c, total);
+  if (ret) {
+    fprintf(out, "error\n%s.\n", msg);
+    goto reply;
+  }
+  r.client = c;
+  r.nparams = s.model->nparams;
+  r.names = s.model->params;
+  problem.model = s.model;
+  problem.data = &s.dataset;
+  problem.global = NULL;
+  opts.nsims = s.nsims;
+  opts.seed = s.seeded ? s.seed : (uint64_t) time(NULL);
+  share_noise(&opts, s.dataset.n);
+  opts.progress = 0;
+  opts.cancel = &cancel;
+  cache_begin(&cache, s.model, &s.dataset, s.params, s.fit, s.error, &opts,
+              s.seeded);
+  if (mc_start(&problem, s.params, s.params, s.error, s.model->nparams,
+               s.nfit, s.fit, &opts, request_done, &r)) {
+    cache_end(&cache, -1);
+    dataset_free(&s.dataset);
+    fprintf(out, "error\nError: the simulations could not be started.\n.\n");
+    goto reply;
+  }
+  /* wait for the run, reading the lines of the client meanwhile */
+  fds[0].fd = c->wake[0];
+  fds[0].events = POLLIN;
+  fds[1].fd = c->fd;
+  fds[1].events = POLLIN;
+  while (!done) {
+    if (poll(fds, 2, -1) < 0)
+      continue;
+    if (fds[0].revents) {
+      while (read(c->wake[0], &ch, 1) < 0 && errno == EINTR)
+        ;
+      done = 1;
+    } else if (fds[1].revents) {
+      if (receive(c) <= 0) {
+        gone = 1;
+        __atomic_store_n(&cancel, 1, __ATOMIC_RELAXED);
+        fds[1].fd = -1;
+        continue;
+      }
+      while ((n = line_end(c, 0)) > 0 && is_line(c, 0, n, "cancel")) {
+        consume(c, n);
+        __atomic_store_n(&cancel, 1, __ATOMIC_RELAXED);
+      }
+      /* anything else is the next request, kept until this one is done */
+      if (n > 0)
+        fds[1].fd = -1;
+    }
+  }
+  cache_end(&cache, r.nsuccess);
+  dataset_free(&s.dataset);
+  if (gone) {
+    fclose(out);
+    free(reply);
+    free(msg);
+    return -1;
+  }
+  if (r.nsuccess < 0 && cancel) {
+    fprintf(out, "cancelled\n.\n");
+  } else if (r.nsuccess < 0) {
+    fprintf(out, "error\nError: the simulations failed.\n.\n");
+  } else {
+    /* status, successful adjustments and simulations, and then a line per
+     * parameter: name, mean, standard deviation and CV (%) */
+    fprintf(out, "ok\t%d\t%d\n", r.nsuccess, s.nsims);
+    for (i = 0; i < r.nparams; i++) {
+      fprintf(out, "%s\t%.17g\t%.17g\t%.17g\n", r.names[i], r.means[i],
+              sqrt(r.variances[i]), 100*sqrt(r.variances[i])/r.means[i]);
+    }
+    fprintf(out, ".\n");
+  }
+
+reply:
+  fclose(out);
+  ret = send_all(c->fd, reply, replylen);
+  free(reply);
+  free(msg);
+  return ret;
+}
+
+static void *serve_client(void *arg)
+{
+  struct client *c = arg;
+  size_t pos = 0, n;
+  /* a request goes on until a line "." */
+  for (;;) {
+    while ((n = line_end(c, pos)) > 0) {
+      if (is_line(c, pos, n, ".")) {
+        if (serve_request(c, pos, pos + n))
+          goto end;
+        pos = 0;
+      } else if (pos == 0 && is_line(c, pos, n, "cancel")) {
+        consume(c, n); /* late, the request was already done */
+      } else {
+        pos += n;
+      }
+    }
+    if (receive(c) <= 0)
+      break;
+  }
+end:
+  pthread_mutex_lock(&clients_lock);
+  if (c->prev)
+    c->prev->next = c->next;
+  else
+    clients = c->next;
+  if (c->next)
+    c->next->prev = c->prev;
+  if (!clients)
+    pthread_cond_signal(&clients_gone);
+  pthread_mutex_unlock(&clients_lock);
+  close(c->fd);
+  close(c->wake[0]);
+  close(c->wake[1]);
+  free(c->buf);
+  free(c);
+  return NULL;
+}
+
+static volatile sig_atomic_t serve_stop;
+
+static void serve_signal(int sig)
+{
+  serve_stop = 1;
+}
+
+/* Serve the simulations of the scenarios sent by the clients of a Unix
+ * socket, keeping the threads and the models loaded between them. Each client
+ * sends its scenarios as input files (see create_template), ending each one
+ * with a line ".", and receives the results as
+ *
+ *      ok<TAB>successful adjustments<TAB>simulations
+ *      name<TAB>mean<TAB>standard deviation<TAB>CV(%)   (for each parameter)
+ *      .
+ *
+ * or "error" followed by the messages, or "cancelled" if it sent a line
+ * "cancel" while the simulations were running. Any number of clients may
+ * connect at once. The server runs until it gets SIGINT or SIGTERM, and then
+ * cancels the runs of the clients and waits for them to be gone, since they
+ * use the models and the threads of the program.
+ */
+int run_serve_mode(struct arguments *args)
+{
+  struct sockaddr_un addr;
+  struct sigaction sa;
+  struct stat st;
+  struct client *c;
+  pthread_t thread;
+  pthread_attr_t attr;
+  int fd, cfd;
+
+  if (strlen(args->socket) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Error: the name of the socket is too long: %s\n",
+            args->socket);
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, args->socket);
+  /* a socket left by a previous server is replaced */
+  if (!stat(args->socket, &st) && S_ISSOCK(st.st_mode))
+    unlink(args->socket);
+  if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+      listen(fd, 64) < 0) {
+    fprintf(stderr, "Error: cannot listen on %s: %s\n", args->socket,
+            strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+  /* stop on SIGINT and SIGTERM (interrupting accept), and do not die when
+   * writing to a client which is gone */
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = serve_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  fprintf(stderr, "Serving on %s\n", args->socket);
+  while (!serve_stop) {
+    if ((cfd = accept(fd, NULL, NULL)) < 0) {
+      if (errno != EINTR)
+        fprintf(stderr, "Error: accept: %s\n", strerror(errno));
+      continue;
+    }
+    if (!(c = calloc(1, sizeof(struct client))) || pipe(c->wake)) {
+      fprintf(stderr, "Error: cannot serve a new client.\n");
+      free(c);
+      close(cfd);
+      continue;
+    }
+    c->fd = cfd;
+    pthread_mutex_lock(&clients_lock);
+    if (pthread_create(&thread, &attr, serve_client, c)) {
+      pthread_mutex_unlock(&clients_lock);
+      fprintf(stderr, "Error: cannot serve a new client.\n");
+      close(c->wake[0]);
+      close(c->wake[1]);
+      free(c);
+      close(cfd);
+      continue;
+    }
+    if ((c->next = clients))
+      clients->prev = c;
+    clients = c;
+    pthread_mutex_unlock(&clients_lock);
+  }
+  /* the clients see their connections closed, which cancels their runs */
+  pthread_mutex_lock(&clients_lock);
+  for (c = clients; c; c = c->next)
+    shutdown(c->fd, SHUT_RDWR);
+  while (clients)
+    pthread_cond_wait(&clients_gone, &clients_lock);
+  pthread_mutex_unlock(&clients_lock);
+  pthread_attr_destroy(&attr);
+  close(fd);
+  unlink(args->socket);
+  return 0;
+}
+
+/* Read the sections of an input file, which may come in any order, into
+ * sec[] (the body of each section, with buf = NULL if not given). In a batch
+ * file ("batch" set), stop before the "- Model:" section of the next
+ * scenario.
+ *
+ * returns the number of sections read (0 at the end of the input), or -1 on
+ * failure
+ */
+static int read_sections(struct parser *p, struct parser sec[], int batch)
+{
+  struct parser body;
+  const char *title;
+  size_t len, tlen, pos;
+  int i, ret, nsecs = 0;
+
+  memset(sec, 0, NSECS * sizeof(struct parser));
+  for (pos = p->pos; (ret = parse_section(p, &title, &len, &body)) > 0;
+       pos = p->pos) {
+    for (i = 0; i < NSECS; i++) {
+      tlen = strlen(section_titles[i]);
+      /* allow for notes after the title, as "Error (absolute)" */
+      if (len >= tlen && !strncasecmp(title, section_titles[i], tlen) &&
+          (len == tlen || title[tlen] == ' '))
+        break;
+    }
+    if (i == NSECS)
+      return parse_error(p, title - p->buf, "unknown section %.*s", (int) len,
+                         title);
+    if (batch && i == SEC_MODEL && sec[SEC_MODEL].buf) {
+      p->pos = pos; /* the next scenario */
+      break;
+    }
+    if (sec[i].buf)
+      return parse_error(p, title - p->buf, "section %s given twice",
+                         section_titles[i]);
+    sec[i] = body;
+    nsecs++;
+  }
+  return ret < 0 ? -1 : nsecs;
+}
+
+/* Parse the sections of a scenario into s (see read_sections). p is the
+ * parser of the whole input, just after the sections.
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int read_scenario(struct parser *p, struct parser sec[],
+                         struct scenario *s)
+{
+  struct model *model;
+  double *data[MAX_INDEP];
+  const char *name;
+  char *modelname;
+  size_t len;
+  int i, nfix, npoints, nlevels[MAX_INDEP];
+  double nsims, reps;
+
+  for (i = 0; i < NSECS; i++) {
+    if (!sec[i].buf && i != SEC_FIXED && i != SEC_VARS && i != SEC_DATA &&
+        i != SEC_GRID && i != SEC_REPS && i != SEC_SIMS && i != SEC_SEED)
+      return parse_error(p, p->pos, "missing section \"- %s:\"",
+                         section_titles[i]);
+  }
+  if (!sec[SEC_VARS].buf + !sec[SEC_DATA].buf + !sec[SEC_GRID].buf != 2)
+    return parse_error(p, p->pos, "the points must be given either in "
+                       "\"- %s:\", in \"- %s:\" or in \"- %s:\"",
+                       section_titles[SEC_VARS], section_titles[SEC_DATA],
+                       section_titles[SEC_GRID]);
+  if (sec[SEC_REPS].buf && !sec[SEC_GRID].buf)
+    return parse_error(p, p->pos, "\"- %s:\" is only allowed with \"- %s:\"",
+                       section_titles[SEC_REPS], section_titles[SEC_GRID]);
+  /* model */
+  if (!(len = parse_name(&sec[SEC_MODEL], &name)))
+    return parse_error(&sec[SEC_MODEL], sec[SEC_MODEL].pos, "expected a "
+                       "model name");
+  if (!parse_end(&sec[SEC_MODEL]))
+    return parse_error(&sec[SEC_MODEL], sec[SEC_MODEL].pos, "unexpected "
+                       "characters after the model name");
+  modelname = strndup(name, len);
+  model = s->model = get_model(modelname);
+  free(modelname);
+  if (!model)
+    return parse_error(&sec[SEC_MODEL], name - p->buf, "unrecognized model "
+                       "name %.*s", (int) len, name);
+  /* parameters, fixed parameters and error */
+  if (parse_params(&sec[SEC_PARAMS], model->nparams, model->params,
+                   s->params, 1))
+    return -1;
+  if (sec[SEC_FIXED].buf == NULL) {
+    nfix = 0;
+    memset(s->fit, 0, sizeof(s->fit));
+  } else if ((nfix = parse_names(&sec[SEC_FIXED], model->nparams,
+                                 model->params, s->fit)) < 0) {
+    return -1;
+  }
+  for (i = 0; i < model->nparams; i++) {
+    s->fit[i] = !s->fit[i];
+  }
+  s->nfit = model->nparams - nfix;
+  if (parse_number(&sec[SEC_ERROR], &s->error))
+    return -1;
+  if (!parse_end(&sec[SEC_ERROR]))
+    return parse_error(&sec[SEC_ERROR], sec[SEC_ERROR].pos, "unexpected "
+                       "characters after the error");
+  /* number of simulations */
+  s->nsims = NREPS;
+  if (sec[SEC_SIMS].buf) {
+    if (parse_number(&sec[SEC_SIMS], &nsims))
+      return -1;
+    if (nsims < 1 || nsims > INT_MAX || nsims != (int) nsims ||
+        !parse_end(&sec[SEC_SIMS]))
+      return parse_error(&sec[SEC_SIMS], sec[SEC_SIMS].pos, "expected a "
+                         "positive integer number of simulations");
+    s->nsims = nsims;
+  }
+  /* seed */
+  if ((s->seeded = sec[SEC_SEED].buf != NULL)) {
+    if (parse_integer(&sec[SEC_SEED], &s->seed))
+      return -1;
+    if (!parse_end(&sec[SEC_SEED]))
+      return parse_error(&sec[SEC_SEED], sec[SEC_SEED].pos, "expected a "
+                         "non-negative integer seed");
+  }
+  /* points */
+  if (sec[SEC_GRID].buf) {
+    reps = 1;
+    if (sec[SEC_REPS].buf) {
+      if (parse_number(&sec[SEC_REPS], &reps))
+        return -1;
+      if (reps < 1 || reps > INT_MAX || reps != (int) reps ||
+          !parse_end(&sec[SEC_REPS]))
+        return parse_error(&sec[SEC_REPS], sec[SEC_REPS].pos, "expected a "
+                           "positive integer number of replicates");
+    }
+    if (parse_grid(&sec[SEC_GRID], model->nvars, model->indep_vars, data,
+                   nlevels, 1))
+      return -1;
+    npoints = dataset_grid(&s->dataset, model->nvars, nlevels, data, reps);
+    for (i = 0; i < model->nvars; i++)
+      free(data[i]);
+    return npoints < 0 ? -1 : 0;
+  }
+  if (sec[SEC_VARS].buf)
+    npoints = parse_vars(&sec[SEC_VARS], model->nvars, model->indep_vars,
+                         data);
+  else
+    npoints = parse_table(&sec[SEC_DATA], model->nvars, model->indep_vars,
+                          data);
+  if (npoints < 0)
+    return -1;
+  dataset_init(&s->dataset, model->nvars, npoints, data);
+  return 0;
+}
+
+/* Create a template for the model "modelname" in the file "fileout", to be
+ * filled and read with --file. The points might be given, instead of in
+ * "- Independent variables:", as a table in a "- Data:" section:
+ *
+ *      - Data:
+ *      S     I
+ *      1     0
+ *      2.5   0
+ *      ...
+ */
+int create_template(char *modelname, char *fileout)
+{
+  struct model *model = get_model(modelname);
+  FILE *fp;
+  int i;
+  if (!model) {
+    fprintf(stderr, "Unrecognized model name: %s\n", modelname);
+    return -1;
+  }
+  if (!(fp = fopen(fileout, "w"))) {
+    fprintf(stderr, "Error: cannot create %s\n", fileout);
+    return -1;
+  }
+  fprintf(fp, "- Model: %s\n\n", model->name);
+  fprintf(fp, "- Independent variables:\n\n");
+  for (i = 0; i < model->nvars; i++) {
+    fprintf(fp, "%s=[  ]\n", model->indep_vars[i]);
+  }
+  fprintf(fp, "\n- Parameters:\n\n");
+  for (i = 0; i < model->nparams; i++) {
+    fprintf(fp, "%s=\n", model->params[i]);
+  }
+  fprintf(fp, "\n- Fixed parameters: None\n\n");
+  fprintf(fp, "- Error (absolute):\n");
+  if (fclose(fp)) {
+    fprintf(stderr, "Error: cannot write %s\n", fileout);
+    return -1;
+  }
+  return 0;
+}
+
+/* Given the name of a model, return a ptr to the struct model with all the
+ * information necessary to use the model (see models.h).
+ */
+struct model *get_model(char *modelname)
+{
+  /* the registry holds the models of models.c and those of the plugins */
+  return registry_get(&registry, modelname);
+}
+
+/* Given a struct model and raw data as a string, parse this string and place
+ * the values of the independent variables in a matrix. A reference to this
+ * matrix must be passed as third element.
+ * 
+ * eg. of raw data: a string with the format   "S=[1,2,3,4,5,6] I=[2,2,4,4,5,5]"
+ * eg. of output:   array of arrays type double { {1,2,3,4,5,6}, {2,2,4,4,5,5} }
+ *
+ * returns: the number of points on success
+ *         -1 on failure (the error is reported in stderr, see parse.h)
+ */
+int get_indep_vars(struct model *model, char *raw_data,
+                   double *data[model->nvars])
+{
+  struct parser p;
+  parse_init(&p, "--data", raw_data, strlen(raw_data));
+  return parse_vars(&p, model->nvars, model->indep_vars, data);
+}
+
+/* Given a struct model and the levels of its independent variables as a
+ * string, build the dataset of all their combinations, each one repeated
+ * "replicates" times.
+ *
+ * eg. of raw data: "S=[1,2,5] I=0:20:5" (the values of S, and 5 values of I
+ *                  from 0 to 20)
+ * eg. of output:   the 15 points (1,0), (1,5), ..., (5,20)
+ *
+ * returns: the number of points on success
+ *         -1 on failure (the error is reported in stderr, see parse.h)
+ */
+int get_grid(struct model *model, char *raw_data, int replicates,
+             struct dataset *dataset)
+{
+  struct parser p;
+  double *levels[MAX_INDEP];
+  int nlevels[MAX_INDEP], i;
+  long npoints;
+  parse_init(&p, "--grid", raw_data, strlen(raw_data));
+  if (parse_grid(&p, model->nvars, model->indep_vars, levels, nlevels, 1))
+    return -1;
+  npoints = dataset_grid(dataset, model->nvars, nlevels, levels, replicates);
+  for (i = 0; i < model->nvars; i++)
+    free(levels[i]);
+  return npoints;
+}
+
+/* Given a struct model and raw data as a string, parse this string to find the
+ * values of the parameters of the model. An array of type double must be passed
+ * as third argument, in which the values of the parameters will be placed.
+ * 
+ * eg. of raw data: a string with the format   "Vm=5 Km=17"
+ *
+ * returns: 0 on success
+ *         -1 on failure (the error is reported in stderr)
+ */
+int get_params(struct model *model, char *raw_data, double *params)
+{
+  struct parser p;
+  parse_init(&p, "--params", raw_data, strlen(raw_data));
+  return parse_params(&p, model->nparams, model->params, params, 1);
+}
+
+/* Given a model, and a string containing the error, find the value
+ * and store it in error (double)
+ */
+int get_error(struct model *model, char *raw_data, double *error)
+{
+  struct parser p;
+  parse_init(&p, "--error", raw_data, strlen(raw_data));
+  if (parse_number(&p, error))
+    return -1;
+  if (!parse_end(&p))
+    return parse_error(&p, p.pos, "unexpected characters after the error");
+  return 0;
+}
+
+/* Given a model, and a string containing a list of parameters, find them and
+ * fill the array pointed to by ptr in the following way: 
+ *
+ * *ptr is an int array with the length of model->nparams (one entry for each
+ * parameter). If a given entry is 1, the parameter will be fitted; if it is 0,
+ * it will be kept fixed.
+ *
+ * return the number of parameters to keep fixed, or -1 on failure
+ */
+int get_fixed_params(struct model *model, char *raw_data, int *ptr)
+{
+  struct parser p;
+  int i, nfix;
+  parse_init(&p, "--fixed", raw_data, strlen(raw_data));
+  if ((nfix = parse_names(&p, model->nparams, model->params, ptr)) < 0)
+    return -1;
+  /* parse_names marks the ones in the list (fixed) */
+  for (i = 0; i < model->nparams; i++) {
+    ptr[i] = !ptr[i];
+  }
+  return nfix;
+}
+
+void free_matrix_double(double **matrix[], int n)
+{
+  int i;
+  for (i = 0; i < n; i++) {
+    free((*matrix)[i]);
+  }
+  free(*matrix);
 }
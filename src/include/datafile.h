@@ -0,0 +1 @@
+../misc/datafile.h
\ No newline at end of file
@@ -0,0 +1 @@
+../misc/dataset.h
\ No newline at end of file
@@ -0,0 +1 @@
+../design/design.h
\ No newline at end of file
@@ -1,22 +1,55 @@
 #ifndef __ENZMC_H__
 #define __ENZMC_H__
 
+#include <stdio.h>
 #include <models.h>
+#include <dataset.h>
+#include <mapfile.h>
+#include <sketch.h>
+#include <stdint.h>
 
 /* Stuff directly related to the implementation of the cli */
 
-#define MAX_VALUES 200
-
 /* program modes */
 #define NORMAL_MODE 52
 #define FILE_MODE 55
 #define TEMPLATE_MODE 56
+#define GLOBAL_MODE 57
+#define BATCH_MODE 58
+#define SERVE_MODE 59
+#define DESIGN_MODE 60
+#define SWEEP_MODE 61
+#define PLAN_MODE 62
+
+/* formats of the results (see --format) */
+#define OUTPUT_TEXT 0
+#define OUTPUT_JSONL 1
+#define OUTPUT_CSV 2
+
+/* maximum number of datasets of a global fit */
+#define MAX_SETS 20
+
+/* environment variable with the directory of plugins (see --plugins) */
+#define PLUGINS_ENV "ENZMC_PLUGINS"
 
 /* Error messages */
 #define ERROR_LACK_OPTS "lacking options (model, params, data and error are mandatory"
 #define ERROR_TOO_MANY_ARGS "too many arguments (see --usage)"
+#define ERROR_TOO_MANY_SETS "too many datasets (the maximum is 20)"
+#define ERROR_LACK_SET_OPTS "lacking options (model, params and data (or grid) are mandatory for each dataset, and error for all of them)"
+#define ERROR_LACK_DESIGN_OPTS "lacking options (model, params, error and ranges are mandatory to search designs)"
 #define ERROR_NO_FILENAME "you must specify a file name:\n./enzmc --template model filename"
 
+/* Options of each dataset of a global fit */
+struct set_arguments {
+  char *model;
+  char *params;
+  char *fixed_params;
+  char *data;
+  char *datafile;
+  char *grid;
+};
+
 /* Arguments which must be provided to do the simulation. */
 struct arguments {
   short mode;
@@ -25,29 +58,101 @@ struct arguments {
   char *params;
   char *fixed_params;
   char *data;
+  char *datafile;         /* file with the data points (see datafile.h) */
+  char *grid;             /* levels of the variables of a grid of points */
+  int replicates;         /* replicates of each point of the grid */
+  char *savedata;         /* binary data file to save the data points in */
   char *error;
   char *fileoutput;
   char *fileinput;
+  char *plugins;
+  char *socket;           /* Unix socket of --serve */
+  char *shared;           /* parameters shared in a global fit */
+  int nsets;              /* datasets of the global fit (--model, --params,
+                           * --data and --fixed repeated for each one) */
+  struct set_arguments sets[MAX_SETS];
+  int threads;            /* threads for the simulations (0: one per
+                           * processor) */
+  uint64_t seed;          /* seed of the random numbers... */
+  int seeded;             /* ...and whether it was given (if not, it is taken
+                           * from the time) */
+  int format;             /* format of the results (OUTPUT_...) */
+  char *records;          /* file for the result of each simulation */
+  char *trace;            /* binary trace of the simulations */
+  int trace_covar;        /* whether the trace keeps the covariances */
+  double interval;        /* central interval of the parameters to print
+                           * (%), or 0 */
+  int histogram;          /* bins of their histograms, or 0 */
+  int correlation;        /* print the biases and correlations */
+  int fisher;             /* predict from the Fisher information instead of
+                           * simulating */
+  int design;             /* points of the designs to search (see --design) */
+  char *ranges;           /* ranges of the variables of the designs */
+  char *criterion;        /* criterion of the designs: D, A or a parameter */
+  int designs;            /* number of designs to print */
+  char *sweep;            /* ranges of the real values of the parameters to
+                           * simulate (see --sweep) */
+  int common_noise;       /* share the noise between the runs */
+  int sampling;           /* MC_PLAIN... (see --sampling), or -1 if it is
+                           * not given */
+  char *plan;             /* target CVs of the parameters (see --plan) */
+  char *plan_over;        /* what --plan grows: "replicates" or a variable */
+  char *cache;            /* directory of the cached runs (see --cache) */
+  char *checkpoint;       /* file of the checkpoints (see --checkpoint)... */
+  int checkpoint_every;   /* ...seconds between them... */
+  int resume;             /* ...and whether to go on from it */
+  int shard, nshards;     /* slice of the simulations to run (see --shard),
+                           * 1...nshards, or 0 */
+  char *merge;            /* files of the slices to merge (see --merge) */
+};
+
+/* Results of a run of simulations, as printed by print_results */
+struct results {
+  int nparams;
+  char **names;
+  double *means;
+  double *variances;
+  int nsuccess;
+  int nsims;
+  struct sketch *quantiles;   /* distribution of each parameter, or NULL */
+  struct histogram *hists;    /* (see --interval and --histogram) */
+  double *params;             /* real values of the parameters */
+  double *covariance;         /* covariance[nparams][nparams] of the
+                               * estimates, or NULL (see --correlation) */
+  double *mcerror;            /* standard errors of the means and CVs due to
+                               * the number of simulations, mcerror[2*nparams],
+                               * or NULL (see --sampling) */
 };
 
 /* Program modes */
 int run_cli_mode(struct arguments *);
 int run_file_mode(struct arguments *);
+int run_global_mode(struct arguments *);
+int run_batch_mode(struct arguments *);
+int run_serve_mode(struct arguments *);
+int run_design_mode(struct arguments *);
+int run_sweep_mode(struct arguments *);
+int run_plan_mode(struct arguments *);
 int create_template(char *modelname, char *fileout);
 
 /* Internal functions */
+int simulate(struct model *model, struct dataset *dataset, double *params,
+             int *fit, int nfit, double error, int nsims);
+int get_dataset(struct model *model, char *raw_data, char *datafile,
+                char *grid, int replicates, struct dataset *dataset,
+                struct mapfile *mf);
 struct model *get_model(char *modelname);
 int get_indep_vars(struct model *model, char *raw_data, double *data[model->nvars]);
+int get_grid(struct model *model, char *raw_data, int replicates,
+             struct dataset *dataset);
 int get_params(struct model *model, char *raw_data, double *params);
 int get_error(struct model *model, char *raw_data, double *error);
 int get_fixed_params(struct model *model, char *raw_data, int *fixed_ptr);
 
-void print_output(struct model *model, double *variances, double *means,
-                  int nsuccess);
-int extract_str(char *src, char *dst, char *regexp_str);
-int parse_array_double(char *array_str, double **dst);
-void reorder_data(int nvars, int npoints, double *data[], double ***data_ord);
+void print_output(FILE *fp, int nparams, char *names[], double *variances,
+                  double *means, int nsuccess, int nsims);
+void print_results(int scenario, char *model, struct results *r);
+int in_list(char *list, char *name);
 
 void free_matrix_double(double **array[], int n);
-void copy_array_double(double *dst, double *src, int n);
 #endif /* __ENZMC_H__ */
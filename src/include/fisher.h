@@ -0,0 +1 @@
+../nlr/fisher.h
\ No newline at end of file
@@ -0,0 +1 @@
+../nlr/globalfit.h
\ No newline at end of file
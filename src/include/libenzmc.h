@@ -0,0 +1 @@
+../lib/libenzmc.h
\ No newline at end of file
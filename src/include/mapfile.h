@@ -0,0 +1 @@
+../misc/mapfile.h
\ No newline at end of file
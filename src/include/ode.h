@@ -0,0 +1 @@
+../ode/ode.h
\ No newline at end of file
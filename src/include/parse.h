@@ -0,0 +1 @@
+../parse/parse.h
\ No newline at end of file
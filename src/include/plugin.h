@@ -0,0 +1 @@
+../models/plugin.h
\ No newline at end of file
@@ -0,0 +1 @@
+../misc/pool.h
\ No newline at end of file
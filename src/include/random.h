@@ -1,8 +1,26 @@
 #ifndef __RAND__
 #define __RAND__
 #include <math.h>
+#include <stdint.h>
 
 float ran0(long *seed);
 float boxmuller(long *seed);
 
+/* Generator of random numbers which keeps all its state in the struct (so
+ * that each thread may have its own one). A generator is seeded with a seed
+ * and the number of a stream: the streams of a seed are independent, and
+ * each one is always the same sequence, eg. the one of simulation i.
+ */
+struct rng {
+  uint64_t state;
+  int flag;         /* whether there is a spare gaussian number */
+  double spare;
+};
+
+void rng_seed(struct rng *r, uint64_t seed, uint64_t stream);
+double rng_uniform(struct rng *r);
+double rng_gauss(struct rng *r);
+
+double normal_quantile(double p);
+
 #endif
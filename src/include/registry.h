@@ -0,0 +1 @@
+../models/registry.h
\ No newline at end of file
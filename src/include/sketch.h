@@ -0,0 +1 @@
+../misc/sketch.h
\ No newline at end of file
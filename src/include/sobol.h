@@ -0,0 +1 @@
+../random/sobol.h
\ No newline at end of file
@@ -0,0 +1 @@
+../montecarlo/state.h
\ No newline at end of file
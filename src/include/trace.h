@@ -0,0 +1 @@
+../montecarlo/trace.h
\ No newline at end of file
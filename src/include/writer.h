@@ -0,0 +1 @@
+../misc/writer.h
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <libenzmc.h>
+#include <models.h>
+#include <registry.h>
+#include <dataset.h>
+#include <datafile.h>
+#include <mapfile.h>
+#include <parse.h>
+#include <lvmrq.h>
+#include <montecarlo.h>
+#include <fisher.h>
+#include <pool.h>
+
+/* The handles of libenzmc.h are the structures of enzmc: a model is a
+ * struct model of the registry of its context, and a dataset is a struct
+ * dataset plus the file it might have been read from. */
+struct enzmc_context {
+    pthread_rwlock_t lock;      /* protects the registry (the plugins) */
+    struct registry registry;   /* built-in models, and those of the plugins */
+    struct pool *pool;          /* threads of the simulations, or NULL */
+};
+
+struct enzmc_dataset {
+    struct dataset data;
+    struct mapfile mf;          /* mapped data file, if any */
+};
+
+#define MODEL(model) ((struct model *) (model))
+
+int enzmc_api_version(void)
+{
+    return ENZMC_API_VERSION;
+}
+
+/* enzmc_create: returns a new context, or NULL on failure */
+enzmc_context *enzmc_create(int nthreads)
+{
+    enzmc_context *ctx = calloc(1, sizeof(enzmc_context));
+    if (!ctx) {
+        fprintf(stderr, "Error: not enough memory for a context.\n");
+        return NULL;
+    }
+    if (registry_init(&ctx->registry, models)) {
+        fprintf(stderr, "Error: not enough memory for the models.\n");
+        registry_free(&ctx->registry);
+        free(ctx);
+        return NULL;
+    }
+    if (nthreads != 1 && !(ctx->pool = pool_create(nthreads))) {
+        registry_free(&ctx->registry);
+        free(ctx);
+        return NULL;
+    }
+    pthread_rwlock_init(&ctx->lock, NULL);
+    return ctx;
+}
+
+/* enzmc_load_plugins: adds the models of the plugins (*.so) in a directory
+ * (see plugin.h). The models already returned by the context are still valid.
+ *
+ * returns the number of models added, or -1 on failure
+ */
+int enzmc_load_plugins(enzmc_context *ctx, const char *dir)
+{
+    int n;
+
+    /* the registry grows (and its array is moved) while the models are
+     * looked up from other threads */
+    pthread_rwlock_wrlock(&ctx->lock);
+    n = registry_load_dir(&ctx->registry, dir);
+    pthread_rwlock_unlock(&ctx->lock);
+    return n;
+}
+
+void enzmc_destroy(enzmc_context *ctx)
+{
+    if (!ctx)
+        return;
+    if (ctx->pool)
+        pool_destroy(ctx->pool);
+    registry_free(&ctx->registry);
+    pthread_rwlock_destroy(&ctx->lock);
+    free(ctx);
+}
+
+int enzmc_model_count(enzmc_context *ctx)
+{
+    int n;
+
+    pthread_rwlock_rdlock(&ctx->lock);
+    n = ctx->registry.nmodels;
+    pthread_rwlock_unlock(&ctx->lock);
+    return n;
+}
+
+/* enzmc_model_at: returns the model i (0...count-1, sorted by name), or NULL
+ * if there is none */
+const enzmc_model *enzmc_model_at(enzmc_context *ctx, int i)
+{
+    struct model *model = NULL;
+
+    pthread_rwlock_rdlock(&ctx->lock);
+    if (i >= 0 && i < ctx->registry.nmodels)
+        model = ctx->registry.models[i];
+    pthread_rwlock_unlock(&ctx->lock);
+    return (const enzmc_model *) model;
+}
+
+/* enzmc_model_find: returns the model with that name, or NULL if there is
+ * none */
+const enzmc_model *enzmc_model_find(enzmc_context *ctx, const char *name)
+{
+    struct model *model;
+
+    pthread_rwlock_rdlock(&ctx->lock);
+    model = registry_get(&ctx->registry, name);
+    pthread_rwlock_unlock(&ctx->lock);
+    return (const enzmc_model *) model;
+}
+
+const char *enzmc_model_name(const enzmc_model *model)
+{
+    return MODEL(model)->name;
+}
+
+int enzmc_model_nparams(const enzmc_model *model)
+{
+    return MODEL(model)->nparams;
+}
+
+/* enzmc_model_param: returns the name of the parameter i, or NULL if there
+ * is none */
+const char *enzmc_model_param(const enzmc_model *model, int i)
+{
+    if (i < 0 || i >= MODEL(model)->nparams)
+        return NULL;
+    return MODEL(model)->params[i];
+}
+
+int enzmc_model_nvars(const enzmc_model *model)
+{
+    return MODEL(model)->nvars;
+}
+
+/* enzmc_model_var: returns the name of the independent variable i, or NULL if
+ * there is none */
+const char *enzmc_model_var(const enzmc_model *model, int i)
+{
+    if (i < 0 || i >= MODEL(model)->nvars)
+        return NULL;
+    return MODEL(model)->indep_vars[i];
+}
+
+/* enzmc_model_eval: sets y[npoints] to the values of the model at the points
+ * of the dataset.
+ *
+ * returns 0, or -1 if the dataset is not one of the model
+ */
+int enzmc_model_eval(const enzmc_model *model, const enzmc_dataset *data,
+                     const double params[], double y[])
+{
+    struct model *mod = MODEL(model);
+    const struct dataset *d = &data->data;
+    double p[MAX_PARAMS];
+    int i;
+    if (d->nvars != mod->nvars) {
+        fprintf(stderr, "Error: the dataset is not one of the model %s.\n",
+                mod->name);
+        return -1;
+    }
+    memcpy(p, params, mod->nparams * sizeof(double));
+    if (mod->batch) {
+        mod->batch(d->n, (double **) d->cols, p, y, NULL);
+    } else {
+        for (i = 0; i < d->n; i++)
+            y[i] = mod->function(d->x[i], p);
+    }
+    return 0;
+}
+
+/* new_dataset: returns an empty dataset (to be set by the caller), or NULL if
+ * there is not enough memory */
+static enzmc_dataset *new_dataset(void)
+{
+    enzmc_dataset *data = calloc(1, sizeof(enzmc_dataset));
+    if (!data)
+        fprintf(stderr, "Error: not enough memory for a dataset.\n");
+    return data;
+}
+
+/* finish_dataset: builds the rows of a new dataset if the model needs them,
+ * so that the dataset is not modified once it is in use (see dataset_rows).
+ *
+ * returns the dataset, or NULL on failure (it is then freed)
+ */
+static enzmc_dataset *finish_dataset(const enzmc_model *model,
+                                     enzmc_dataset *data)
+{
+    if (!MODEL(model)->batch && dataset_rows(&data->data)) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n",
+                data->data.n);
+        enzmc_dataset_free(data);
+        return NULL;
+    }
+    return data;
+}
+
+/* enzmc_dataset_create: returns a dataset with a copy of the columns
+ * cols[nvars][npoints], or NULL on failure */
+enzmc_dataset *enzmc_dataset_create(const enzmc_model *model, int npoints,
+                                    const double *const cols[])
+{
+    int i, nvars = MODEL(model)->nvars;
+    double *copy[MAX_INDEP];
+    enzmc_dataset *data;
+    if (npoints < 0) {
+        fprintf(stderr, "Error: invalid number of points (%d).\n", npoints);
+        return NULL;
+    }
+    if (!(data = new_dataset()))
+        return NULL;
+    for (i = 0; i < nvars; i++) {
+        if (!(copy[i] = malloc((npoints ? npoints : 1) * sizeof(double)))) {
+            fprintf(stderr, "Error: not enough memory for %d points.\n",
+                    npoints);
+            while (i--)
+                free(copy[i]);
+            free(data);
+            return NULL;
+        }
+        memcpy(copy[i], cols[i], npoints * sizeof(double));
+    }
+    dataset_init(&data->data, nvars, npoints, copy);
+    return finish_dataset(model, data);
+}
+
+/* enzmc_dataset_parse: returns the dataset given by a text with the syntax of
+ * --data, or NULL on failure */
+enzmc_dataset *enzmc_dataset_parse(const enzmc_model *model, const char *text)
+{
+    struct model *mod = MODEL(model);
+    struct parser p;
+    double *cols[MAX_INDEP];
+    long npoints;
+    enzmc_dataset *data;
+    if (!(data = new_dataset()))
+        return NULL;
+    parse_init(&p, "data", text, strlen(text));
+    if ((npoints = parse_vars(&p, mod->nvars, mod->indep_vars, cols)) < 0) {
+        free(data);
+        return NULL;
+    }
+    dataset_init(&data->data, mod->nvars, npoints, cols);
+    return finish_dataset(model, data);
+}
+
+/* enzmc_dataset_read: returns the dataset of a data file (see datafile.h), or
+ * NULL on failure */
+enzmc_dataset *enzmc_dataset_read(const enzmc_model *model, const char *path)
+{
+    struct model *mod = MODEL(model);
+    enzmc_dataset *data;
+    if (!(data = new_dataset()))
+        return NULL;
+    if (datafile_read(path, mod->nvars, mod->indep_vars, &data->data,
+                      &data->mf) < 0) {
+        free(data);
+        return NULL;
+    }
+    return finish_dataset(model, data);
+}
+
+int enzmc_dataset_size(const enzmc_dataset *data)
+{
+    return data->data.n;
+}
+
+void enzmc_dataset_free(enzmc_dataset *data)
+{
+    if (!data)
+        return;
+    dataset_free(&data->data);
+    mapfile_close(&data->mf);
+    free(data);
+}
+
+/* get_fit: copies the adjustable parameters given by the caller (all if NULL)
+ * to fit[nparams]. returns their number, or -1 if there are none */
+static int get_fit(struct model *model, const int given[], int fit[])
+{
+    int i, nfit = 0;
+    for (i = 0; i < model->nparams; i++) {
+        fit[i] = given ? given[i] != 0 : 1;
+        nfit += fit[i];
+    }
+    if (nfit == 0) {
+        fprintf(stderr, "Error: all the parameters of %s are fixed.\n",
+                model->name);
+        return -1;
+    }
+    return nfit;
+}
+
+int enzmc_fit(const enzmc_model *model, const enzmc_dataset *data,
+              const double y[], const double sig[], double params[],
+              const int fit[], double covar[], double *chisq)
+{
+    struct model *mod = MODEL(model);
+    int m = mod->nparams, mfit, iters;
+    int adjust[MAX_PARAMS];
+    double *sigp[1] = {(double *) sig};
+    double results[2];
+    if (data->data.nvars != mod->nvars) {
+        fprintf(stderr, "Error: the dataset is not one of the model %s.\n",
+                mod->name);
+        return -1;
+    }
+    if ((mfit = get_fit(mod, fit, adjust)) < 0)
+        return -1;
+    {
+        double cov[mfit][mfit];
+        iters = lvmrq(m, mfit, (struct dataset *) &data->data, (double *) y,
+                      params, adjust, mod->function, mod->gradient,
+                      mod->batch, cov, sig ? sigp : NULL, results);
+        if (iters < 0)
+            return -1;
+        if (covar)
+            memcpy(covar, cov, sizeof(cov));
+    }
+    if (chisq)
+        *chisq = results[0];
+    return iters;
+}
+
+int enzmc_montecarlo(enzmc_context *ctx, const enzmc_model *model,
+                     const enzmc_dataset *data, const double params[],
+                     const int fit[], double error, int nsims, uint64_t seed,
+                     double means[], double sds[])
+{
+    struct model *mod = MODEL(model);
+    struct mc_problem problem = {.model = mod,
+                                 .data = (struct dataset *) &data->data};
+    struct mc_options opts = {.nsims = nsims, .seed = seed,
+                              .pool = ctx->pool};
+    int i, m = mod->nparams, mfit, nsuccess;
+    int adjust[MAX_PARAMS];
+    double p[MAX_PARAMS];
+    if (data->data.nvars != mod->nvars) {
+        fprintf(stderr, "Error: the dataset is not one of the model %s.\n",
+                mod->name);
+        return -1;
+    }
+    if ((mfit = get_fit(mod, fit, adjust)) < 0)
+        return -1;
+    memcpy(p, params, m * sizeof(double));
+    nsuccess = montecarlo(&problem, p, p, error, m, mfit, adjust, &opts,
+                          means, sds);
+    if (nsuccess < 0)
+        return -1;
+    for (i = 0; i < m; i++)
+        sds[i] = sqrt(sds[i]);
+    return nsuccess;
+}
+
+int enzmc_fisher(const enzmc_model *model, const enzmc_dataset *data,
+                 const double params[], const int fit[], double error,
+                 double ses[], double covar[], double *cond)
+{
+    struct model *mod = MODEL(model);
+    int i, m = mod->nparams, n = data->data.n, ret;
+    int adjust[MAX_PARAMS];
+    double p[MAX_PARAMS], cov[m][m], c, *jac;
+    if (data->data.nvars != mod->nvars) {
+        fprintf(stderr, "Error: the dataset is not one of the model %s.\n",
+                mod->name);
+        return -1;
+    }
+    if (get_fit(mod, fit, adjust) < 0)
+        return -1;
+    if (!(jac = malloc(n * m * sizeof(double)))) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+        return -1;
+    }
+    memcpy(p, params, m * sizeof(double));
+    if (fisher_jacobian(mod, (struct dataset *) &data->data, p, jac)) {
+        free(jac);
+        return -1;
+    }
+    ret = fisher(n, m, jac, p, adjust, error, cov, &c);
+    free(jac);
+    if (ret < 0)
+        return -1;
+    for (i = 0; i < m; i++)
+        ses[i] = sqrt(cov[i][i]);
+    if (covar)
+        memcpy(covar, cov, sizeof(cov));
+    if (cond)
+        *cond = c;
+    return ret;
+}
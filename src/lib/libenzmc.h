@@ -0,0 +1,120 @@
+#ifndef __LIBENZMC_H__
+#define __LIBENZMC_H__
+
+#include <stdint.h>
+
+/* libenzmc: the models, fits and simulations of enzmc, to be called from
+ * other programs (make lib builds libenzmc.a and libenzmc.so).
+ *
+ * Everything is reached through handles: a context (enzmc_context) holds the
+ * available models and the threads which run the simulations, and there is
+ * no global state, so any number of contexts might be used at once. All the
+ * functions might be called from several threads at once, with the same or
+ * different contexts (plugins might be loaded while the models are looked
+ * up), but a context or a dataset must not be freed while in use.
+ *
+ * Errors are reported in stderr (as "Error: ..."), and the functions return
+ * NULL or a negative number.
+ *
+ * ENZMC_API_VERSION changes whenever a function of this file changes in a way
+ * which is not compatible with the previous versions.
+ */
+#define ENZMC_API_VERSION 1
+
+#if defined(__GNUC__)
+#define ENZMC_API __attribute__((visibility("default")))
+#else
+#define ENZMC_API
+#endif
+
+typedef struct enzmc_context enzmc_context;
+typedef struct enzmc_model enzmc_model;
+typedef struct enzmc_dataset enzmc_dataset;
+
+ENZMC_API int enzmc_api_version(void);
+
+/* contexts: nthreads threads for the simulations (0: one per processor, 1:
+ * the simulations are run in the calling thread) */
+ENZMC_API enzmc_context *enzmc_create(int nthreads);
+ENZMC_API int enzmc_load_plugins(enzmc_context *ctx, const char *dir);
+ENZMC_API void enzmc_destroy(enzmc_context *ctx);
+
+/* models: the built-in ones and those of the plugins loaded, valid while the
+ * context exists */
+ENZMC_API int enzmc_model_count(enzmc_context *ctx);
+ENZMC_API const enzmc_model *enzmc_model_at(enzmc_context *ctx, int i);
+ENZMC_API const enzmc_model *enzmc_model_find(enzmc_context *ctx,
+                                              const char *name);
+ENZMC_API const char *enzmc_model_name(const enzmc_model *model);
+ENZMC_API int enzmc_model_nparams(const enzmc_model *model);
+ENZMC_API const char *enzmc_model_param(const enzmc_model *model, int i);
+ENZMC_API int enzmc_model_nvars(const enzmc_model *model);
+ENZMC_API const char *enzmc_model_var(const enzmc_model *model, int i);
+ENZMC_API int enzmc_model_eval(const enzmc_model *model,
+                               const enzmc_dataset *data,
+                               const double params[], double y[]);
+
+/* datasets: the points of a model, given as a column per variable (in the
+ * order of enzmc_model_var), as the text of --data ("S=[1,2] I=[0,0]"), or
+ * as a data file (a table or a binary data file, see --data-file) */
+ENZMC_API enzmc_dataset *enzmc_dataset_create(const enzmc_model *model,
+                                              int npoints,
+                                              const double *const cols[]);
+ENZMC_API enzmc_dataset *enzmc_dataset_parse(const enzmc_model *model,
+                                             const char *text);
+ENZMC_API enzmc_dataset *enzmc_dataset_read(const enzmc_model *model,
+                                            const char *path);
+ENZMC_API int enzmc_dataset_size(const enzmc_dataset *data);
+ENZMC_API void enzmc_dataset_free(enzmc_dataset *data);
+
+/* enzmc_fit: adjusts the parameters of a model to the values y[] at the
+ * points of a dataset (Levenberg-Marquardt).
+ *
+ * params[nparams] holds the initial guess, and is set to the adjusted values.
+ * fit[nparams] tells what parameters are adjusted (1) or fixed (0), or is
+ * NULL to adjust all of them. sig[npoints] are the deviations of the values,
+ * or NULL if they are not known. If not NULL, covar[nfit*nfit] is set to the
+ * covariances of the adjusted parameters (in their order) and *chisq to the
+ * final chi square.
+ *
+ * returns the number of iterations, or -1 on failure
+ */
+ENZMC_API int enzmc_fit(const enzmc_model *model, const enzmc_dataset *data,
+                        const double y[], const double sig[],
+                        double params[], const int fit[], double covar[],
+                        double *chisq);
+
+/* enzmc_montecarlo: does nsims simulations of the experiment (the values of
+ * the model at the points of the dataset, with gaussian errors of deviation
+ * "error") and fits the model to each one, starting at the real parameters.
+ * The simulations are those of enzmc with the same seed.
+ *
+ * means[nparams] and sds[nparams] are set to the mean of the adjusted
+ * parameters and to the square root of the mean square of their deviations
+ * from the real values.
+ *
+ * returns the number of successful adjustments, or -1 on failure
+ */
+ENZMC_API int enzmc_montecarlo(enzmc_context *ctx, const enzmc_model *model,
+                               const enzmc_dataset *data,
+                               const double params[], const int fit[],
+                               double error, int nsims, uint64_t seed,
+                               double means[], double sds[]);
+
+/* enzmc_fisher: predicts, without simulating, the standard errors of the
+ * adjusted parameters of the experiment of enzmc_montecarlo, from the Fisher
+ * information of the points (as enzmc --fisher).
+ *
+ * ses[nparams] is set to the standard errors (0 for the fixed parameters),
+ * and, if not NULL, covar[nparams*nparams] to the covariances and *cond to
+ * the condition number of the information.
+ *
+ * returns 0, 1 if the parameters cannot be identified with these points (the
+ * standard errors are then infinite), or -1 on failure
+ */
+ENZMC_API int enzmc_fisher(const enzmc_model *model, const enzmc_dataset *data,
+                           const double params[], const int fit[],
+                           double error, double ses[], double covar[],
+                           double *cond);
+
+#endif /* __LIBENZMC_H__ */
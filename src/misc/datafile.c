@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <datafile.h>
+#include <parse.h>
+
+/* The binary files are little endian: on big endian machines the values are
+ * swapped (and so copied), instead of used in place. */
+static int little_endian(void)
+{
+    uint16_t one = 1;
+    return *(uint8_t *) &one;
+}
+
+static uint64_t get_le(const unsigned char *p, int nbytes)
+{
+    uint64_t x = 0;
+    while (--nbytes >= 0)
+        x = (x << 8) | p[nbytes];
+    return x;
+}
+
+static void put_le(unsigned char *p, uint64_t x, int nbytes)
+{
+    int i;
+    for (i = 0; i < nbytes; i++, x >>= 8)
+        p[i] = x & 0xff;
+}
+
+static double get_double(const unsigned char *p)
+{
+    uint64_t bits = get_le(p, 8);
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+/* read_binary: takes the columns names[nvars] of a binary file (see
+ * datafile.h). returns the number of points, or -1 on failure */
+static int read_binary(const char *path, int nvars, char *names[],
+                       struct dataset *data, struct mapfile *mf)
+{
+    const unsigned char *buf = (const unsigned char *) mf->data;
+    uint32_t version, ncols;
+    uint64_t nrows;
+    size_t hdr;
+    const char *name;
+    double *cols[MAX_INDEP];
+    int i, c;
+    uint64_t k;
+
+    if (mf->len < sizeof(struct datafile_header)) {
+        fprintf(stderr, "Error: %s: truncated header\n", path);
+        return -1;
+    }
+    version = get_le(&buf[8], 4);
+    ncols = get_le(&buf[12], 4);
+    nrows = get_le(&buf[16], 8);
+    if (version != DATAFILE_VERSION) {
+        fprintf(stderr, "Error: %s: version %u of the format is not "
+                "supported\n", path, version);
+        return -1;
+    }
+    hdr = sizeof(struct datafile_header) + (size_t) ncols * DATAFILE_NAMELEN;
+    if (ncols == 0 || nrows > INT_MAX || mf->len < hdr ||
+        (mf->len - hdr) / ncols / sizeof(double) < nrows) {
+        fprintf(stderr, "Error: %s: the file is truncated or corrupt\n", path);
+        return -1;
+    }
+    for (i = 0; i < nvars; i++) {
+        for (c = 0; c < (int) ncols; c++) {
+            name = (const char *) &buf[sizeof(struct datafile_header) +
+                                       c * DATAFILE_NAMELEN];
+            if (strlen(names[i]) < DATAFILE_NAMELEN &&
+                !strncmp(name, names[i], DATAFILE_NAMELEN))
+                break;
+        }
+        if (c == (int) ncols) {
+            fprintf(stderr, "Error: %s: there is no column %s\n", path,
+                    names[i]);
+            return -1;
+        }
+        cols[i] = (double *) &buf[hdr + c * nrows * sizeof(double)];
+    }
+    if (little_endian()) {
+        dataset_view(data, nvars, nrows, cols);
+        return nrows;
+    }
+    for (i = 0; i < nvars; i++) {
+        const unsigned char *src = (const unsigned char *) cols[i];
+        if (!(cols[i] = malloc((nrows ? nrows : 1) * sizeof(double)))) {
+            while (--i >= 0)
+                free(cols[i]);
+            fprintf(stderr, "Error: not enough memory for %s\n", path);
+            return -1;
+        }
+        for (k = 0; k < nrows; k++) {
+            cols[i][k] = get_double(&src[k * sizeof(double)]);
+        }
+    }
+    dataset_init(data, nvars, nrows, cols);
+    mapfile_close(mf);
+    return nrows;
+}
+
+/* datafile_read: reads the columns names[nvars] of the file "path", either a
+ * text file (a table with a header line, the values separated by commas, tabs
+ * or spaces; other columns are ignored) or a binary file (see datafile.h), and
+ * builds the dataset "data" with them.
+ *
+ * The file is mapped in "mf", which must be closed (mapfile_close) after
+ * freeing the dataset, as the columns of a binary file are used in place.
+ *
+ * returns the number of points, or -1 on failure
+ */
+int datafile_read(const char *path, int nvars, char *names[],
+                  struct dataset *data, struct mapfile *mf)
+{
+    struct parser p;
+    double *cols[MAX_INDEP];
+    long n;
+    if (mapfile_open(mf, path))
+        return -1;
+    if (mf->len >= 8 && !memcmp(mf->data, DATAFILE_MAGIC, 8)) {
+        if ((n = read_binary(path, nvars, names, data, mf)) < 0)
+            mapfile_close(mf);
+        return n;
+    }
+    /* text: the values are copied, so the file is not needed afterwards */
+    parse_init(&p, path, mf->data, mf->len);
+    n = parse_table(&p, nvars, names, cols);
+    mapfile_close(mf);
+    if (n < 0)
+        return -1;
+    if (n > INT_MAX) {
+        fprintf(stderr, "Error: %s: too many points\n", path);
+        return -1;
+    }
+    dataset_init(data, nvars, n, cols);
+    return n;
+}
+
+/* datafile_write: writes the columns cols[ncols][nrows], named names[ncols],
+ * to the file "path" in the binary format (see datafile.h).
+ *
+ * returns 0 on success, -1 on failure
+ */
+int datafile_write(const char *path, int ncols, char *names[], int nrows,
+                   double *cols[])
+{
+    unsigned char hdr[sizeof(struct datafile_header)], tmp[8];
+    char name[DATAFILE_NAMELEN];
+    uint64_t bits;
+    FILE *fp;
+    int i, k, ok = 1;
+    for (i = 0; i < ncols; i++) {
+        if (strlen(names[i]) >= DATAFILE_NAMELEN) {
+            fprintf(stderr, "Error: the name %s is too long for a data file\n",
+                    names[i]);
+            return -1;
+        }
+    }
+    if (!(fp = fopen(path, "wb"))) {
+        fprintf(stderr, "Error: cannot create %s\n", path);
+        return -1;
+    }
+    memcpy(hdr, DATAFILE_MAGIC, 8);
+    put_le(&hdr[8], DATAFILE_VERSION, 4);
+    put_le(&hdr[12], ncols, 4);
+    put_le(&hdr[16], nrows, 8);
+    ok = fwrite(hdr, sizeof(hdr), 1, fp) == 1;
+    for (i = 0; ok && i < ncols; i++) {
+        memset(name, 0, sizeof(name));
+        strcpy(name, names[i]);
+        ok = fwrite(name, sizeof(name), 1, fp) == 1;
+    }
+    for (i = 0; ok && i < ncols; i++) {
+        if (little_endian()) {
+            ok = fwrite(cols[i], sizeof(double), nrows, fp) == (size_t) nrows;
+            continue;
+        }
+        for (k = 0; ok && k < nrows; k++) {
+            memcpy(&bits, &cols[i][k], sizeof(bits));
+            put_le(tmp, bits, 8);
+            ok = fwrite(tmp, 8, 1, fp) == 1;
+        }
+    }
+    if (fclose(fp) || !ok) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        return -1;
+    }
+    return 0;
+}
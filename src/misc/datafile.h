@@ -0,0 +1,39 @@
+#ifndef __DATAFILE_H__
+#define __DATAFILE_H__
+
+#include <stdint.h>
+#include <dataset.h>
+#include <mapfile.h>
+
+/* Files of points (see --data-file). They might be text files (CSV, TSV...),
+ * with a header line naming the columns, or binary files with the following
+ * format (little endian):
+ *
+ *      char magic[8]                   "ENZMCDAT"
+ *      uint32 version                  DATAFILE_VERSION
+ *      uint32 ncols                    number of columns
+ *      uint64 nrows                    number of points
+ *      char names[ncols][32]           name of each column, padded with '\0'
+ *      double cols[ncols][nrows]       values, column after column
+ *
+ * The columns of a binary file are used as they are in the mapped file, with
+ * no copy (see dataset_view).
+ */
+
+#define DATAFILE_MAGIC "ENZMCDAT"
+#define DATAFILE_VERSION 1
+#define DATAFILE_NAMELEN 32
+
+struct datafile_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t ncols;
+  uint64_t nrows;
+};
+
+int datafile_read(const char *path, int nvars, char *names[],
+                  struct dataset *data, struct mapfile *mf);
+int datafile_write(const char *path, int ncols, char *names[], int nrows,
+                   double *cols[]);
+
+#endif /* __DATAFILE_H__ */
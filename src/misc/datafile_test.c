@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <datafile.h>
+
+/* Checks the data files (see datafile.h): the columns of a binary file are
+ * read back as they were written, bit for bit, those of text files (CSV,
+ * TSV) are found among other columns, and broken files are rejected. The
+ * errors of the files rejected are reported in stderr, as usual.
+ */
+
+#define NROWS 1000
+
+static char dir[] = "/tmp/datafile_testXXXXXX";
+static int failures;
+
+static void check(const char *what, int ok)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+/* reads the columns names[nvars] of the file name (in dir).
+ * returns the number of points, or -1 on failure (data is then empty) */
+static int readfile(const char *name, int nvars, char *names[],
+                    struct dataset *data, struct mapfile *mf)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return datafile_read(path, nvars, names, data, mf);
+}
+
+/* writes len bytes to the file name (in dir) */
+static void writefile(const char *name, const void *buf, size_t len)
+{
+    char path[64];
+    FILE *fp;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if ((fp = fopen(path, "wb"))) {
+        fwrite(buf, 1, len, fp);
+        fclose(fp);
+    }
+}
+
+/* writes the first len bytes of a file of dir as another one */
+static void copyfile(const char *from, const char *to, size_t len)
+{
+    char path[64], *buf = malloc(len);
+    FILE *fp;
+    size_t n;
+    snprintf(path, sizeof(path), "%s/%s", dir, from);
+    if (buf && (fp = fopen(path, "rb"))) {
+        n = fread(buf, 1, len, fp);
+        fclose(fp);
+        writefile(to, buf, n);
+    }
+    free(buf);
+}
+
+/* writes the file name (in dir) with the header of a binary file of a
+ * column S, and as long as the points it claims (a sparse file, so that
+ * those of a huge one take no room) */
+static void header(const char *name, uint32_t version, uint64_t nrows)
+{
+    unsigned char buf[sizeof(struct datafile_header) + DATAFILE_NAMELEN];
+    char path[64];
+    int i;
+    memset(buf, 0, sizeof(buf));
+    memcpy(buf, DATAFILE_MAGIC, 8);
+    for (i = 0; i < 4; i++)
+        buf[8 + i] = version >> 8*i;
+    buf[12] = 1;
+    for (i = 0; i < 8; i++)
+        buf[16 + i] = nrows >> 8*i;
+    buf[24] = 'S';
+    writefile(name, buf, sizeof(buf));
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    truncate(path, sizeof(buf) + nrows * sizeof(double));
+}
+
+static void test_binary(void)
+{
+    char *names[] = {"S", "I", "T"};
+    char *some[] = {"T", "S"};
+    char *missing[] = {"S", "A"};
+    double *cols[3], *want[2];
+    struct dataset data;
+    struct mapfile mf;
+    char path[64];
+    size_t size, hdr;
+    int i, n, ok;
+
+    for (i = 0; i < 3; i++)
+        cols[i] = malloc(NROWS * sizeof(double));
+    for (i = 0; i < NROWS; i++) {
+        cols[0][i] = i * 0.1;
+        cols[1][i] = -1.0 / (i + 3);
+        cols[2][i] = ldexp(i, -1070);  /* subnormal */
+    }
+    cols[1][0] = -0.0;
+    cols[1][1] = INFINITY;
+    cols[1][2] = NAN;
+    snprintf(path, sizeof(path), "%s/points.dat", dir);
+    check("binary file written",
+          datafile_write(path, 3, names, NROWS, cols) == 0);
+
+    /* some of the columns, in another order */
+    n = readfile("points.dat", 2, some, &data, &mf);
+    want[0] = cols[2];
+    want[1] = cols[0];
+    ok = n == NROWS && data.n == NROWS && data.nvars == 2;
+    for (i = 0; ok && i < 2; i++)
+        ok = !memcmp(data.cols[i], want[i], NROWS * sizeof(double));
+    check("binary file read back, bit for bit", ok);
+    if (n >= 0) {
+        dataset_free(&data);
+        mapfile_close(&mf);
+    }
+    n = readfile("points.dat", 3, names, &data, &mf);
+    ok = n == NROWS && !memcmp(data.cols[1], cols[1], NROWS * sizeof(double));
+    check("binary file read back, with -0, inf and nan", ok);
+    if (n >= 0) {
+        dataset_free(&data);
+        mapfile_close(&mf);
+    }
+
+    check("binary file without a column",
+          readfile("points.dat", 2, missing, &data, &mf) < 0);
+    hdr = sizeof(struct datafile_header) + 3 * DATAFILE_NAMELEN;
+    size = hdr + 3 * NROWS * sizeof(double);
+    copyfile("points.dat", "short.dat", size - 1);
+    check("binary file without its last byte",
+          readfile("short.dat", 2, some, &data, &mf) < 0);
+    copyfile("points.dat", "names.dat", hdr - 1);
+    check("binary file truncated in the names",
+          readfile("names.dat", 2, some, &data, &mf) < 0);
+    copyfile("points.dat", "header.dat", sizeof(struct datafile_header) - 1);
+    check("binary file truncated in the header",
+          readfile("header.dat", 2, some, &data, &mf) < 0);
+
+    /* the points of a dataset are counted with an int */
+    header("huge.dat", DATAFILE_VERSION, INT_MAX);
+    n = readfile("huge.dat", 1, names, &data, &mf);
+    check("binary file of INT_MAX points", n == INT_MAX);
+    if (n >= 0) {
+        dataset_free(&data);
+        mapfile_close(&mf);
+    }
+    header("huge.dat", DATAFILE_VERSION, (uint64_t) INT_MAX + 1);
+    check("binary file of more than INT_MAX points",
+          readfile("huge.dat", 1, names, &data, &mf) < 0);
+    header("version.dat", DATAFILE_VERSION + 1, NROWS);
+    check("binary file of another version",
+          readfile("version.dat", 1, names, &data, &mf) < 0);
+    for (i = 0; i < 3; i++)
+        free(cols[i]);
+}
+
+static void test_text(void)
+{
+    const char *csv = "T,S,note,I\n"
+                      "300,1,a,0\n"
+                      "300,2.5,b,5\n"
+                      "310,1e1,c,0.25\n";
+    const char *tsv = "I\tx\tS\n"
+                      "0\t9\t1\n"
+                      "5\t9\t2.5\n"
+                      "0.25\t9\t10\n";
+    char *names[] = {"S", "I"};
+    char *missing[] = {"S", "A"};
+    double S[] = {1, 2.5, 10}, I[] = {0, 5, 0.25};
+    struct dataset data;
+    struct mapfile mf;
+    int n;
+
+    writefile("points.csv", csv, strlen(csv));
+    n = readfile("points.csv", 2, names, &data, &mf);
+    check("CSV file with other columns",
+          n == 3 && !memcmp(data.cols[0], S, sizeof(S)) &&
+          !memcmp(data.cols[1], I, sizeof(I)));
+    if (n >= 0)
+        dataset_free(&data);
+    writefile("points.tsv", tsv, strlen(tsv));
+    n = readfile("points.tsv", 2, names, &data, &mf);
+    check("TSV file with other columns",
+          n == 3 && !memcmp(data.cols[0], S, sizeof(S)) &&
+          !memcmp(data.cols[1], I, sizeof(I)));
+    if (n >= 0)
+        dataset_free(&data);
+    check("CSV file without a column",
+          readfile("points.csv", 2, missing, &data, &mf) < 0);
+}
+
+int main()
+{
+    char cmd[64];
+    if (!mkdtemp(dir)) {
+        fprintf(stderr, "Error: cannot create %s\n", dir);
+        return 1;
+    }
+    test_binary();
+    test_text();
+    snprintf(cmd, sizeof(cmd), "rm -r %s", dir);
+    system(cmd);
+    if (failures)
+        printf("%d checks FAILED\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <dataset.h>
+
+/* dataset_init: given "nvars" columns of "n" values each (cols[nvars][n],
+ * allocated with malloc), builds the dataset. The dataset takes the ownership
+ * of the columns, which are freed by dataset_free.
+ *
+ * returns 0 (kept for the callers, as the rows are not built here)
+ */
+int dataset_init(struct dataset *data, int nvars, int n, double *cols[])
+{
+    dataset_view(data, nvars, n, cols);
+    data->owncols = 1;
+    return 0;
+}
+
+/* dataset_view: as dataset_init, but the columns are only referenced (they
+ * are not freed by dataset_free, and must outlive the dataset)
+ */
+void dataset_view(struct dataset *data, int nvars, int n, double *cols[])
+{
+    int j;
+    data->n = n;
+    data->nvars = nvars;
+    data->x = NULL;
+    for (j = 0; j < nvars; j++) {
+        data->cols[j] = cols[j];
+    }
+    data->owncols = 0;
+}
+
+/* dataset_rows: builds the rows of the dataset (data->x), if they are not
+ * built yet. They are needed to evaluate model->function or model->gradient.
+ *
+ * returns 0 on success, -1 if there is not enough memory
+ */
+int dataset_rows(struct dataset *data)
+{
+    int i, j, n = data->n, nvars = data->nvars;
+    if (data->x != NULL)
+        return 0;
+    /* the rows are stored in a single block, x[i] pointing into it */
+    data->x = malloc((n ? n : 1) * sizeof(double *));
+    if (data->x == NULL || (n && !(data->x[0] = malloc((size_t) n * nvars *
+                                                       sizeof(double))))) {
+        free(data->x);
+        data->x = NULL;
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        data->x[i] = data->x[0] + (size_t) i*nvars;
+        for (j = 0; j < nvars; j++) {
+            data->x[i][j] = data->cols[j][i];
+        }
+    }
+    return 0;
+}
+
+/* dataset_levels: sets levels[n] to n values from lo to hi, evenly spaced in
+ * logarithmic scale if both are positive, or in linear scale if not (lo if
+ * n is 1) */
+void dataset_levels(double lo, double hi, int n, double levels[])
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (n == 1)
+            levels[i] = lo;
+        else if (lo > 0)
+            levels[i] = lo * pow(hi / lo, (double) i / (n - 1));
+        else
+            levels[i] = lo + (hi - lo) * i / (n - 1);
+    }
+    /* exactly, whatever the rounding */
+    if (n > 1)
+        levels[n - 1] = hi;
+}
+
+/* dataset_grid: builds the dataset of all the combinations of the levels of
+ * the variables, levels[nvars][nlevels[v]], each one repeated "replicates"
+ * times. The combinations go in the order of the variables, the last one
+ * changing fastest: with S=[1,2] and I=[0,5], (1,0), (1,5), (2,0), (2,5).
+ * The values are written straight into the columns of the dataset.
+ *
+ * returns the number of points, or -1 on failure (the error is reported in
+ * stderr)
+ */
+long dataset_grid(struct dataset *data, int nvars, int nlevels[],
+                  double *levels[], int replicates)
+{
+    double *cols[MAX_INDEP] = {NULL};
+    long n = replicates, block, k;
+    int v;
+    for (v = 0; v < nvars; v++) {
+        if (nlevels[v] < 1 || n > INT_MAX / nlevels[v]) {
+            fprintf(stderr, "Error: too many points in the grid (the maximum "
+                    "is %d).\n", INT_MAX);
+            return -1;
+        }
+        n *= nlevels[v];
+    }
+    for (v = 0; v < nvars; v++) {
+        if (!(cols[v] = malloc((n ? n : 1) * sizeof(double)))) {
+            fprintf(stderr, "Error: not enough memory for %ld points.\n", n);
+            while (v--)
+                free(cols[v]);
+            return -1;
+        }
+    }
+    /* each level of a variable is repeated for all the combinations of the
+     * following ones (and their replicates) */
+    for (v = nvars - 1, block = replicates; v >= 0; block *= nlevels[v--]) {
+        for (k = 0; k < n; k++)
+            cols[v][k] = levels[v][k / block % nlevels[v]];
+    }
+    dataset_init(data, nvars, n, cols);
+    return n;
+}
+
+/* dataset_repeat: builds a dataset with the points of base repeated "times"
+ * times, one whole copy after another, so that its first points are those of
+ * any smaller number of copies.
+ *
+ * returns the number of points, or -1 on failure (the error is reported in
+ * stderr)
+ */
+long dataset_repeat(struct dataset *data, struct dataset *base, int times)
+{
+    double *cols[MAX_INDEP] = {NULL};
+    long n = base->n, k;
+    int v;
+    if (times < 1 || n > INT_MAX / times) {
+        fprintf(stderr, "Error: too many points (the maximum is %d).\n",
+                INT_MAX);
+        return -1;
+    }
+    n *= times;
+    for (v = 0; v < base->nvars; v++) {
+        if (!(cols[v] = malloc((n ? n : 1) * sizeof(double)))) {
+            fprintf(stderr, "Error: not enough memory for %ld points.\n", n);
+            while (v--)
+                free(cols[v]);
+            return -1;
+        }
+        for (k = 0; base->n && k < n; k += base->n)
+            memcpy(&cols[v][k], base->cols[v], base->n * sizeof(double));
+    }
+    dataset_init(data, base->nvars, n, cols);
+    return n;
+}
+
+void dataset_free(struct dataset *data)
+{
+    int j;
+    if (data->x != NULL && data->n)
+        free(data->x[0]);
+    free(data->x);
+    for (j = 0; data->owncols && j < data->nvars; j++) {
+        free(data->cols[j]);
+    }
+    data->x = NULL;
+    data->n = data->nvars = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef __DATASET_H__
+#define __DATASET_H__
+
+#include <models.h>
+
+/* A set of points (values of the independent variables), kept in the two
+ * orders required by the models: one column per variable, for model->batch,
+ * and one row per point, for model->function. The rows are only built when
+ * they are needed (see dataset_rows), so a model with a batch version can
+ * work straight on columns which are not copied, eg. those of a mapped file.
+ */
+struct dataset {
+  int n;                    /* number of points */
+  int nvars;                /* number of independent variables */
+  double **x;               /* x[n][nvars], NULL until built */
+  double *cols[MAX_INDEP];  /* cols[nvars][n] */
+  int owncols;              /* whether the columns are freed with the dataset */
+};
+
+int dataset_init(struct dataset *data, int nvars, int n, double *cols[]);
+void dataset_view(struct dataset *data, int nvars, int n, double *cols[]);
+int dataset_rows(struct dataset *data);
+void dataset_levels(double lo, double hi, int n, double levels[]);
+long dataset_grid(struct dataset *data, int nvars, int nlevels[],
+                  double *levels[], int replicates);
+long dataset_repeat(struct dataset *data, struct dataset *base, int times);
+void dataset_free(struct dataset *data);
+
+#endif /* __DATASET_H__ */
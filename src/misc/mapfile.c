@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <mapfile.h>
+
+/* mapfile_open: maps the file "path" in memory.
+ *
+ * returns 0 on success, -1 if the file cannot be opened or mapped (the error
+ * is reported in stderr)
+ */
+int mapfile_open(struct mapfile *mf, const char *path)
+{
+    struct stat st;
+    void *addr;
+    int fd;
+    if ((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "Error: cannot open %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    mf->len = st.st_size;
+    if (mf->len == 0) { /* an empty file cannot be mapped */
+        mf->data = "";
+        close(fd);
+        return 0;
+    }
+    addr = mmap(NULL, mf->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping stays after closing the file */
+    if (addr == MAP_FAILED) {
+        fprintf(stderr, "Error: cannot map %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    /* it is read from the beginning to the end */
+    madvise(addr, mf->len, MADV_SEQUENTIAL);
+    mf->data = addr;
+    return 0;
+}
+
+/* mapfile_close: unmaps the file */
+void mapfile_close(struct mapfile *mf)
+{
+    if (mf->len > 0)
+        munmap((void *) mf->data, mf->len);
+    mf->data = NULL;
+    mf->len = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef __MAPFILE_H__
+#define __MAPFILE_H__
+
+#include <stddef.h>
+
+/* A file mapped in memory (read only), to be parsed without reading it into
+ * intermediate buffers. Note that data does not end with '\0'.
+ */
+struct mapfile {
+  const char *data;   /* contents of the file */
+  size_t len;         /* length of the file */
+};
+
+int mapfile_open(struct mapfile *mf, const char *path);
+void mapfile_close(struct mapfile *mf);
+
+#endif /* __MAPFILE_H__ */
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <pool.h>
+
+struct task {
+    void (*run)(void *arg, int thread);
+    void *arg;
+};
+
+/* Queue of tasks, in a ring buffer which grows as needed. The owner takes
+ * the tasks from the bottom (the newest), the thieves from the top. */
+struct deque {
+    pthread_mutex_t lock;
+    struct task *tasks;
+    int size;                   /* size of the buffer */
+    int top;                    /* position of the oldest task */
+    int count;                  /* number of tasks */
+};
+
+struct worker {
+    struct pool *pool;
+    int thread;
+    struct deque deque;
+    unsigned int seed;          /* to choose the threads to steal from */
+};
+
+struct pool {
+    int nthreads;
+    pthread_t *threads;
+    struct worker *workers;
+    struct deque inject;        /* tasks submitted from outside the pool */
+    int pending;                /* tasks in the queues (atomic) */
+    pthread_mutex_t lock;       /* protects the following: */
+    pthread_cond_t cond;        /* signaled when there are tasks, or on exit */
+    int sleeping;               /* threads waiting for tasks */
+    int exit;                   /* set when the pool is destroyed */
+};
+
+/* worker of the calling thread, if it belongs to a pool */
+static __thread struct worker *self;
+
+static void deque_init(struct deque *d)
+{
+    pthread_mutex_init(&d->lock, NULL);
+    d->tasks = NULL;
+    d->size = d->top = d->count = 0;
+}
+
+static void deque_free(struct deque *d)
+{
+    pthread_mutex_destroy(&d->lock);
+    free(d->tasks);
+}
+
+/* push: adds a task at the bottom. returns 0, or -1 if there is no memory */
+static int push(struct deque *d, struct task *task)
+{
+    struct task *tasks;
+    int i, size;
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->size) {
+        size = d->size ? 2 * d->size : 64;
+        if (!(tasks = malloc(size * sizeof(struct task)))) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (i = 0; i < d->count; i++)
+            tasks[i] = d->tasks[(d->top + i) % d->size];
+        free(d->tasks);
+        d->tasks = tasks;
+        d->size = size;
+        d->top = 0;
+    }
+    d->tasks[(d->top + d->count) % d->size] = *task;
+    d->count++;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/* pop: takes the task at the bottom (bottom = 1) or at the top (bottom = 0).
+ * returns 1 if there was a task, 0 if not */
+static int pop(struct deque *d, struct task *task, int bottom)
+{
+    int found = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        if (bottom) {
+            *task = d->tasks[(d->top + d->count - 1) % d->size];
+        } else {
+            *task = d->tasks[d->top];
+            d->top = (d->top + 1) % d->size;
+        }
+        d->count--;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return found;
+}
+
+/* take: finds a task for worker w: the newest one of its own queue, the
+ * oldest one submitted from outside, or the oldest one of another thread,
+ * starting by a random one.
+ * returns 1 if a task was found, 0 if not */
+static int take(struct worker *w, struct task *task)
+{
+    struct pool *pool = w->pool;
+    int i, n = pool->nthreads, start;
+    if (pop(&w->deque, task, 1) || pop(&pool->inject, task, 0))
+        return 1;
+    start = rand_r(&w->seed) % n;
+    for (i = 0; i < n; i++) {
+        if ((start + i) % n != w->thread &&
+            pop(&pool->workers[(start + i) % n].deque, task, 0))
+            return 1;
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg)
+{
+    struct worker *w = arg;
+    struct pool *pool = w->pool;
+    struct task task;
+    int done;
+    self = w;
+    for (;;) {
+        if (take(w, &task)) {
+            __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+            task.run(task.arg, w->thread);
+            continue;
+        }
+        /* a task counted in pending might be being pushed, or taken by
+         * another thread: just look again */
+        pthread_mutex_lock(&pool->lock);
+        while (!__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) &&
+               !pool->exit) {
+            pool->sleeping++;
+            pthread_cond_wait(&pool->cond, &pool->lock);
+            pool->sleeping--;
+        }
+        /* exit, once there are no tasks left */
+        done = pool->exit && !__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE);
+        pthread_mutex_unlock(&pool->lock);
+        if (done)
+            break;
+    }
+    return NULL;
+}
+
+/* pool_create: starts a pool of nthreads threads (if nthreads <= 0, one per
+ * processor).
+ *
+ * returns the pool, or NULL on failure (the error is reported in stderr)
+ */
+struct pool *pool_create(int nthreads)
+{
+    struct pool *pool;
+    int i;
+    if (nthreads <= 0 && (nthreads = sysconf(_SC_NPROCESSORS_ONLN)) <= 0)
+        nthreads = 1;
+    if (!(pool = calloc(1, sizeof(struct pool))) ||
+        !(pool->threads = malloc(nthreads * sizeof(pthread_t))) ||
+        !(pool->workers = calloc(nthreads, sizeof(struct worker)))) {
+        fprintf(stderr, "Error: not enough memory for %d threads.\n",
+                nthreads);
+        if (pool)
+            free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    deque_init(&pool->inject);
+    for (i = 0; i < nthreads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].thread = i;
+        pool->workers[i].seed = i + 1;
+        deque_init(&pool->workers[i].deque);
+    }
+    /* the threads steal from one another as soon as they start */
+    pool->nthreads = nthreads;
+    for (i = 0; i < nthreads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main,
+                           &pool->workers[i]))
+            break;
+    }
+    if (i < nthreads) {
+        pthread_mutex_lock(&pool->lock);
+        pool->nthreads = i; /* threads to join */
+        pthread_mutex_unlock(&pool->lock);
+        fprintf(stderr, "Error: cannot create %d threads.\n", nthreads);
+        pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+int pool_size(struct pool *pool)
+{
+    return pool->nthreads;
+}
+
+/* pool_submit: queues the task run(arg, thread), in the queue of the calling
+ * thread if it belongs to the pool.
+ *
+ * returns 0 on success, -1 if there is not enough memory
+ */
+int pool_submit(struct pool *pool, void (*run)(void *arg, int thread),
+                void *arg)
+{
+    struct task task = {run, arg};
+    struct deque *d = self && self->pool == pool ? &self->deque :
+                      &pool->inject;
+    if (push(d, &task)) {
+        fprintf(stderr, "Error: not enough memory for a new task.\n");
+        return -1;
+    }
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&pool->lock);
+    if (pool->sleeping)
+        pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/* pool_destroy: runs the pending tasks, and stops the threads. */
+void pool_destroy(struct pool *pool)
+{
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pool->exit = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+    for (i = 0; i < pool->nthreads; i++)
+        deque_free(&pool->workers[i].deque);
+    deque_free(&pool->inject);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
@@ -0,0 +1,22 @@
+#ifndef __POOL_H__
+#define __POOL_H__
+
+/* A pool of threads which run the tasks submitted to it. A task is a
+ * function called with its argument and the number of the thread running it
+ * (0...nthreads-1), eg. to use a workspace of each thread.
+ *
+ * Each thread keeps its own queue of tasks: the tasks submitted by a task go
+ * to the queue of its thread, which runs the newest ones first, while the
+ * threads with nothing to do steal the oldest tasks of the others (work
+ * stealing). So a task may split its work into new tasks, and any idle
+ * thread takes part of it. Tasks must not wait for other tasks.
+ */
+struct pool;
+
+struct pool *pool_create(int nthreads);
+int pool_size(struct pool *pool);
+int pool_submit(struct pool *pool, void (*run)(void *arg, int thread),
+                void *arg);
+void pool_destroy(struct pool *pool);
+
+#endif /* __POOL_H__ */
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sketch.h>
+
+/* sketch_init: an empty sketch with relative accuracy alpha (eg. 0.001) */
+void sketch_init(struct sketch *s, double alpha)
+{
+    memset(s, 0, sizeof(struct sketch));
+    s->alpha = alpha;
+    s->lngamma = log((1 + alpha) / (1 - alpha));
+    s->min = INFINITY;
+    s->max = -INFINITY;
+}
+
+/* store_add: adds n values to the bucket "key" of a store, joining the
+ * smallest buckets if there are too many.
+ * returns 0, or -1 if there is not enough memory */
+static int store_add(struct sketch_store *st, int key, int64_t n)
+{
+    int64_t *counts;
+    int lo, hi, i, k;
+    lo = st->len ? (st->offset < key ? st->offset : key) : key;
+    hi = st->len ? (st->offset + st->len - 1 > key ? st->offset + st->len - 1 :
+                    key) : key;
+    if (hi - lo >= SKETCH_MAXBUCKETS)
+        lo = hi - SKETCH_MAXBUCKETS + 1;
+    if (key < lo)
+        key = lo;
+    if (!st->len || lo != st->offset || hi != st->offset + st->len - 1) {
+        if (!(counts = calloc(hi - lo + 1, sizeof(int64_t)))) {
+            fprintf(stderr, "Error: not enough memory for a sketch.\n");
+            return -1;
+        }
+        for (i = 0; i < st->len; i++) {
+            k = st->offset + i;
+            counts[(k < lo ? lo : k) - lo] += st->counts[i];
+        }
+        free(st->counts);
+        st->counts = counts;
+        st->offset = lo;
+        st->len = hi - lo + 1;
+    }
+    st->counts[key - st->offset] += n;
+    return 0;
+}
+
+/* sketch_add: adds a value (NaN and infinite values are ignored).
+ * returns 0, or -1 if there is not enough memory */
+int sketch_add(struct sketch *s, double x)
+{
+    int ret = 0;
+    if (!isfinite(x))
+        return 0;
+    if (x == 0)
+        s->zeros++;
+    else
+        ret = store_add(x > 0 ? &s->pos : &s->neg,
+                        (int) ceil(log(fabs(x)) / s->lngamma), 1);
+    if (ret == 0) {
+        s->count++;
+        if (x < s->min)
+            s->min = x;
+        if (x > s->max)
+            s->max = x;
+    }
+    return ret;
+}
+
+static int store_merge(struct sketch_store *st, const struct sketch_store *o)
+{
+    int i;
+    if (!o->len)
+        return 0;
+    /* grow the store at once, not bucket by bucket */
+    if (store_add(st, o->offset + o->len - 1, 0) ||
+        store_add(st, o->offset, 0))
+        return -1;
+    for (i = 0; i < o->len; i++) {
+        if (o->counts[i] && store_add(st, o->offset + i, o->counts[i]))
+            return -1;
+    }
+    return 0;
+}
+
+/* sketch_merge: adds the values of another sketch (of the same accuracy).
+ * returns 0, or -1 if there is not enough memory */
+int sketch_merge(struct sketch *s, const struct sketch *other)
+{
+    if (store_merge(&s->pos, &other->pos) || store_merge(&s->neg, &other->neg))
+        return -1;
+    s->zeros += other->zeros;
+    s->count += other->count;
+    if (other->min < s->min)
+        s->min = other->min;
+    if (other->max > s->max)
+        s->max = other->max;
+    return 0;
+}
+
+/* sketch_quantile: returns the value with a fraction q (0...1) of the values
+ * below it, or NaN if the sketch is empty */
+double sketch_quantile(const struct sketch *s, double q)
+{
+    double rank, cum = 0, gamma = exp(s->lngamma), x;
+    int i;
+    if (s->count == 0)
+        return NAN;
+    if (q <= 0)
+        return s->min;
+    if (q >= 1)
+        return s->max;
+    rank = q * (s->count - 1);
+    /* negative values, from the largest in absolute value */
+    for (i = s->neg.len - 1; i >= 0; i--) {
+        if ((cum += s->neg.counts[i]) > rank) {
+            x = -2 * exp((s->neg.offset + i) * s->lngamma) / (gamma + 1);
+            goto found;
+        }
+    }
+    if ((cum += s->zeros) > rank)
+        return 0;
+    for (i = 0; i < s->pos.len; i++) {
+        if ((cum += s->pos.counts[i]) > rank) {
+            x = 2 * exp((s->pos.offset + i) * s->lngamma) / (gamma + 1);
+            goto found;
+        }
+    }
+    return s->max;
+
+found:
+    return x < s->min ? s->min : x > s->max ? s->max : x;
+}
+
+void sketch_free(struct sketch *s)
+{
+    free(s->pos.counts);
+    free(s->neg.counts);
+    s->pos.counts = s->neg.counts = NULL;
+    s->pos.len = s->neg.len = 0;
+}
+
+/* index of a bin at a coarser level: i / 2^n, rounded down */
+static int64_t coarser(int64_t i, int n)
+{
+    return i >= 0 ? i >> n : -((-i - 1) >> n) - 1;
+}
+
+/* hist_init: an empty histogram of nbins bins (see sketch.h).
+ * returns 0, or -1 if there is not enough memory */
+int hist_init(struct histogram *h, int nbins, double origin, double width0)
+{
+    h->nbins = nbins;
+    h->origin = origin;
+    h->width0 = width0;
+    h->level = 0;
+    h->lo = h->hi = 0;
+    h->count = 0;
+    if (!(h->counts = calloc(nbins, sizeof(int64_t)))) {
+        fprintf(stderr, "Error: not enough memory for a histogram.\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* coarsen: goes up a level, joining each pair of bins */
+static void coarsen(struct histogram *h)
+{
+    int64_t j, c, lo = coarser(h->lo, 1);
+    for (j = 0; h->count && j <= h->hi - h->lo; j++) {
+        c = h->counts[j];
+        h->counts[j] = 0;
+        h->counts[coarser(h->lo + j, 1) - lo] += c;
+    }
+    h->lo = lo;
+    h->hi = coarser(h->hi, 1);
+    h->level++;
+}
+
+/* add_index: adds n values to the bin i of the grid of level "level" */
+static void add_index(struct histogram *h, int64_t i, int level, int64_t n)
+{
+    int64_t lo, hi;
+    while (h->level < level)
+        coarsen(h);
+    i = coarser(i, h->level - level);
+    if (h->count == 0) {
+        h->lo = h->hi = i;
+    } else {
+        for (;;) {
+            lo = i < h->lo ? i : h->lo;
+            hi = i > h->hi ? i : h->hi;
+            if (hi - lo < h->nbins)
+                break;
+            coarsen(h);
+            i = coarser(i, 1);
+        }
+        if (i < h->lo) {
+            memmove(&h->counts[h->lo - i], h->counts,
+                    (h->hi - h->lo + 1) * sizeof(int64_t));
+            memset(h->counts, 0, (h->lo - i) * sizeof(int64_t));
+            h->lo = i;
+        }
+        if (i > h->hi)
+            h->hi = i;
+    }
+    h->counts[i - h->lo] += n;
+    h->count += n;
+}
+
+/* hist_add: adds a value (NaN and infinite values are ignored) */
+void hist_add(struct histogram *h, double x)
+{
+    double i = floor((x - h->origin) / h->width0);
+    if (!isfinite(i))
+        return;
+    /* indices are kept at level 0, so that a value falls in the same bin
+     * whatever the level when it is added */
+    if (i > 0x1p60)
+        i = 0x1p60;
+    if (i < -0x1p60)
+        i = -0x1p60;
+    add_index(h, (int64_t) i, 0, 1);
+}
+
+/* hist_merge: adds the values of another histogram (of the same origin,
+ * width0 and number of bins) */
+void hist_merge(struct histogram *h, const struct histogram *other)
+{
+    int64_t j;
+    for (j = 0; other->count && j <= other->hi - other->lo; j++) {
+        if (other->counts[j])
+            add_index(h, other->lo + j, other->level, other->counts[j]);
+    }
+}
+
+double hist_start(const struct histogram *h)
+{
+    return h->origin + h->lo * hist_width(h);
+}
+
+double hist_width(const struct histogram *h)
+{
+    return ldexp(h->width0, h->level);
+}
+
+void hist_free(struct histogram *h)
+{
+    free(h->counts);
+    h->counts = NULL;
+}
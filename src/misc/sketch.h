@@ -0,0 +1,64 @@
+#ifndef __SKETCH_H__
+#define __SKETCH_H__
+
+#include <stdint.h>
+
+/* Summaries of the distribution of a stream of values, which take a bounded
+ * amount of memory whatever the number of values, and which can be merged
+ * (eg. those of several threads). Both give the same result whatever the
+ * order in which the values are added or the summaries merged.
+ */
+
+/* Quantile sketch (as DDSketch): the values are counted in buckets of
+ * logarithmic size, so that the quantiles are known with a relative error of
+ * at most alpha. If there were more than SKETCH_MAXBUCKETS buckets of
+ * positive (or negative) values, the smallest ones (in absolute value) are
+ * joined, and only their quantiles lose precision.
+ */
+#define SKETCH_MAXBUCKETS 4096
+
+struct sketch_store {
+  int64_t *counts;        /* counts[len]: values in bucket offset+i */
+  int offset;
+  int len;
+};
+
+struct sketch {
+  double alpha;           /* relative accuracy */
+  double lngamma;         /* log of the ratio between buckets */
+  struct sketch_store pos, neg;
+  int64_t zeros;          /* values too close to 0 for the buckets */
+  int64_t count;
+  double min, max;
+};
+
+void sketch_init(struct sketch *s, double alpha);
+int sketch_add(struct sketch *s, double x);
+int sketch_merge(struct sketch *s, const struct sketch *other);
+double sketch_quantile(const struct sketch *s, double q);
+void sketch_free(struct sketch *s);
+
+/* Histogram of nbins bins which adapts its range to the values: the bins lie
+ * on a grid of width width0*2^level starting at "origin", and the level goes
+ * up (joining each pair of bins) until nbins bins hold all the values. The
+ * histogram covers from hist_start() on, nbins bins of hist_width() each.
+ */
+struct histogram {
+  int nbins;
+  double origin;
+  double width0;          /* width of the bins at level 0 */
+  int level;
+  int64_t lo;             /* index of the first bin in the grid */
+  int64_t hi;             /* index of the last bin with values */
+  int64_t *counts;        /* counts[nbins] */
+  int64_t count;
+};
+
+int hist_init(struct histogram *h, int nbins, double origin, double width0);
+void hist_add(struct histogram *h, double x);
+void hist_merge(struct histogram *h, const struct histogram *other);
+double hist_start(const struct histogram *h);
+double hist_width(const struct histogram *h);
+void hist_free(struct histogram *h);
+
+#endif /* __SKETCH_H__ */
@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <writer.h>
+
+/* size of the chunks (larger writes get a chunk of their own) */
+#define CHUNK (64 * 1024)
+
+struct chunk {
+    struct chunk *next;
+    size_t len;                 /* bytes used */
+    size_t size;                /* bytes allocated */
+    char data[];
+};
+
+struct writer {
+    FILE *fp;
+    pthread_t thread;
+    pthread_mutex_t lock;       /* protects the following: */
+    pthread_cond_t cond;        /* signaled when a chunk is queued, or on
+                                 * close */
+    struct chunk *cur;          /* chunk being filled, or NULL */
+    struct chunk *head, *tail;  /* chunks to be written, in order */
+    struct chunk *spare;        /* a chunk already written, to be reused */
+    int closing;
+    int error;                  /* whether a write failed */
+};
+
+/* queue: moves the current chunk to the chunks to be written */
+static void queue(struct writer *w)
+{
+    struct chunk *c = w->cur;
+    if (!c)
+        return;
+    w->cur = NULL;
+    if (c->len == 0) {
+        if (w->spare)
+            free(c);
+        else
+            w->spare = c;
+        return;
+    }
+    c->next = NULL;
+    if (w->tail)
+        w->tail->next = c;
+    else
+        w->head = c;
+    w->tail = c;
+    pthread_cond_signal(&w->cond);
+}
+
+static void *writer_main(void *arg)
+{
+    struct writer *w = arg;
+    struct chunk *c;
+    int failed;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->head && !w->closing)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (!(c = w->head))
+            break;
+        if (!(w->head = c->next))
+            w->tail = NULL;
+        /* the file is written with the lock released */
+        pthread_mutex_unlock(&w->lock);
+        failed = fwrite(c->data, 1, c->len, w->fp) != c->len ||
+                 fflush(w->fp);
+        pthread_mutex_lock(&w->lock);
+        w->error |= failed;
+        if (!w->spare && c->size == CHUNK) {
+            c->len = 0;
+            w->spare = c;
+        } else {
+            free(c);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/* writer_open: starts a writer of the file fp, which must not be written by
+ * other means until the writer is closed.
+ *
+ * returns the writer, or NULL on failure (the error is reported in stderr)
+ */
+struct writer *writer_open(FILE *fp)
+{
+    struct writer *w = calloc(1, sizeof(struct writer));
+    if (!w) {
+        fprintf(stderr, "Error: not enough memory for a writer.\n");
+        return NULL;
+    }
+    w->fp = fp;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, writer_main, w)) {
+        fprintf(stderr, "Error: cannot create the thread of a writer.\n");
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+/* writer_write: copies len bytes of buf to the writer. They are written once
+ * the chunk they were copied to is full, or on writer_flush.
+ *
+ * returns 0, or -1 if there is not enough memory
+ */
+int writer_write(struct writer *w, const char *buf, size_t len)
+{
+    struct chunk *c;
+    size_t size;
+    pthread_mutex_lock(&w->lock);
+    if (w->cur && w->cur->size - w->cur->len < len)
+        queue(w);
+    if (!w->cur) {
+        if (w->spare && len <= CHUNK) {
+            c = w->spare;
+            w->spare = NULL;
+        } else {
+            size = len > CHUNK ? len : CHUNK;
+            if (!(c = malloc(sizeof(struct chunk) + size))) {
+                pthread_mutex_unlock(&w->lock);
+                fprintf(stderr, "Error: not enough memory for the output.\n");
+                return -1;
+            }
+            c->len = 0;
+            c->size = size;
+        }
+        w->cur = c;
+    }
+    memcpy(w->cur->data + w->cur->len, buf, len);
+    w->cur->len += len;
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+/* writer_printf: as writer_write, with the output of printf.
+ * returns 0, or -1 if there is not enough memory */
+int writer_printf(struct writer *w, const char *fmt, ...)
+{
+    char buf[512], *big;
+    va_list ap;
+    int len, ret;
+    va_start(ap, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0)
+        return -1;
+    if ((size_t) len < sizeof(buf))
+        return writer_write(w, buf, len);
+    if (!(big = malloc(len + 1))) {
+        fprintf(stderr, "Error: not enough memory for the output.\n");
+        return -1;
+    }
+    va_start(ap, fmt);
+    vsnprintf(big, len + 1, fmt, ap);
+    va_end(ap);
+    ret = writer_write(w, big, len);
+    free(big);
+    return ret;
+}
+
+/* writer_flush: hands the data written so far to the thread of the writer,
+ * without waiting for it to be written */
+void writer_flush(struct writer *w)
+{
+    pthread_mutex_lock(&w->lock);
+    queue(w);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* writer_close: writes all the data, stops the writer and frees it (the
+ * file is left open).
+ *
+ * returns 0, or -1 if the file could not be written
+ */
+int writer_close(struct writer *w)
+{
+    int ret;
+    pthread_mutex_lock(&w->lock);
+    queue(w);
+    w->closing = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    ret = w->error || fflush(w->fp) ? -1 : 0;
+    free(w->spare);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    free(w);
+    return ret;
+}
@@ -0,0 +1,20 @@
+#ifndef __WRITER_H__
+#define __WRITER_H__
+
+#include <stdio.h>
+
+/* A buffered writer: the data written to it is copied into large chunks in
+ * memory, which a thread of its own writes to the file. So the threads which
+ * write (eg. those of the simulations) never wait for the file, only for the
+ * copy. The data written by a single call is never split by the data of
+ * other threads.
+ */
+struct writer;
+
+struct writer *writer_open(FILE *fp);
+int writer_write(struct writer *w, const char *buf, size_t len);
+int writer_printf(struct writer *w, const char *fmt, ...);
+void writer_flush(struct writer *w);
+int writer_close(struct writer *w);
+
+#endif /* __WRITER_H__ */
@@ -0,0 +1,838 @@
+/* modelgen: reads a file of model specifications (see models/models.spec) and
+ * writes to stdout the C source of every model:
+ *
+ *      gen_<name>        value of the model at one point
+ *      gen_<name>_grad   value and analytic derivatives with respect to each
+ *                        parameter at one point
+ *      gen_<name>_batch  value (and optionally derivatives) at n points, with
+ *                        the independent variables given as columns
+ *
+ * plus a GENERATED_MODELS macro with the "struct model" entries, to be
+ * placed in the array of models (see models.c).
+ *
+ * The derivatives are obtained symbolically and simplified. Identical
+ * subexpressions are shared (hash-consing), so that every subexpression used
+ * more than once is computed only once, and in the batch variant the ones
+ * depending only on the parameters are moved out of the loop.
+ *
+ * Usage: modelgen models.spec > models_gen.c
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <models.h>
+
+#define MAX_NODES 20000
+#define MAX_LINE 4096
+#define MAX_NAME 64
+#define MAX_EQ 8192
+
+/* types of node of the expression trees */
+enum op { NUM, VAR, PAR, ADD, SUB, MUL, DIV, POW, NEG, EXP, LOG, SQRT };
+
+struct node {
+    enum op op;
+    double val;   /* value of NUM */
+    int idx;      /* index of VAR and PAR */
+    int a, b;     /* operands (index into nodes[]), -1 if not used */
+    /* filled for each block of code being emitted */
+    int count;    /* number of references */
+    int temp;     /* number of the temporary holding it, -1 if none */
+    int inv;      /* 1 if it does not depend on the independent variables */
+    int hoist;    /* 1 if it must be computed out of the loop (batch) */
+};
+
+struct spec {
+    char name[MAX_NAME];
+    char equation[MAX_EQ];
+    int nvars, nparams;
+    char vars[MAX_INDEP][MAX_NAME];
+    char params[MAX_PARAMS][MAX_NAME];
+    int line; /* line of the spec file where the model begins */
+};
+
+static struct node nodes[MAX_NODES];
+static int nnodes;
+static int ntemps;
+
+static const char *spec_file;
+static struct spec *cur; /* model being processed, for error messages */
+
+static void die(const char *msg, const char *detail)
+{
+    fprintf(stderr, "modelgen: %s:%d: model %s: %s%s%s\n", spec_file,
+            cur ? cur->line : 0, cur ? cur->name : "?", msg,
+            detail ? " " : "", detail ? detail : "");
+    exit(1);
+}
+
+/**************************** expression trees ****************************/
+
+/* mk: returns the node (op, val, idx, a, b), creating it only if an identical
+ * one does not exist yet. Thus, identical subexpressions are the same node */
+static int mk(enum op op, double val, int idx, int a, int b)
+{
+    int i;
+    for (i = 0; i < nnodes; i++) {
+        if (nodes[i].op == op && nodes[i].a == a && nodes[i].b == b &&
+            nodes[i].idx == idx && (op != NUM || nodes[i].val == val))
+            return i;
+    }
+    if (nnodes == MAX_NODES)
+        die("expression too large", NULL);
+    nodes[nnodes].op = op;
+    nodes[nnodes].val = op == NUM ? val : 0;
+    nodes[nnodes].idx = idx;
+    nodes[nnodes].a = a;
+    nodes[nnodes].b = b;
+    return nnodes++;
+}
+
+static int num(double v)
+{
+    return mk(NUM, v, -1, -1, -1);
+}
+
+static int isnum(int n, double v)
+{
+    return nodes[n].op == NUM && nodes[n].val == v;
+}
+
+/* the following build simplified nodes */
+
+static int neg(int a)
+{
+    if (nodes[a].op == NUM)
+        return num(-nodes[a].val);
+    if (nodes[a].op == NEG)
+        return nodes[a].a;
+    return mk(NEG, 0, -1, a, -1);
+}
+
+static int add(int a, int b)
+{
+    if (nodes[a].op == NUM && nodes[b].op == NUM)
+        return num(nodes[a].val + nodes[b].val);
+    if (isnum(a, 0))
+        return b;
+    if (isnum(b, 0))
+        return a;
+    if (nodes[b].op == NEG)
+        return mk(SUB, 0, -1, a, nodes[b].a);
+    if (nodes[a].op == NEG)
+        return mk(SUB, 0, -1, b, nodes[a].a);
+    return mk(ADD, 0, -1, a, b);
+}
+
+static int sub(int a, int b)
+{
+    if (nodes[a].op == NUM && nodes[b].op == NUM)
+        return num(nodes[a].val - nodes[b].val);
+    if (a == b)
+        return num(0);
+    if (isnum(b, 0))
+        return a;
+    if (isnum(a, 0))
+        return neg(b);
+    if (nodes[b].op == NEG)
+        return add(a, nodes[b].a);
+    return mk(SUB, 0, -1, a, b);
+}
+
+static int mul(int a, int b)
+{
+    if (nodes[a].op == NUM && nodes[b].op == NUM)
+        return num(nodes[a].val * nodes[b].val);
+    if (isnum(a, 0) || isnum(b, 0))
+        return num(0);
+    if (isnum(a, 1))
+        return b;
+    if (isnum(b, 1))
+        return a;
+    if (isnum(a, -1))
+        return neg(b);
+    if (isnum(b, -1))
+        return neg(a);
+    if (nodes[a].op == NEG)
+        return neg(mul(nodes[a].a, b));
+    if (nodes[b].op == NEG)
+        return neg(mul(a, nodes[b].a));
+    if (nodes[b].op == NUM) /* constants first */
+        return mk(MUL, 0, -1, b, a);
+    return mk(MUL, 0, -1, a, b);
+}
+
+static int dvd(int a, int b)
+{
+    if (isnum(b, 0))
+        die("division by zero", NULL);
+    if (nodes[a].op == NUM && nodes[b].op == NUM)
+        return num(nodes[a].val / nodes[b].val);
+    if (isnum(a, 0))
+        return num(0);
+    if (isnum(b, 1))
+        return a;
+    if (a == b)
+        return num(1);
+    if (nodes[a].op == NEG)
+        return neg(dvd(nodes[a].a, b));
+    if (nodes[b].op == NEG)
+        return neg(dvd(a, nodes[b].a));
+    return mk(DIV, 0, -1, a, b);
+}
+
+static int pw(int a, int b)
+{
+    if (nodes[a].op == NUM && nodes[b].op == NUM)
+        return num(pow(nodes[a].val, nodes[b].val));
+    if (isnum(b, 0))
+        return num(1);
+    if (isnum(b, 1))
+        return a;
+    return mk(POW, 0, -1, a, b);
+}
+
+static int fn(enum op op, int a)
+{
+    if (nodes[a].op == NUM) {
+        switch (op) {
+        case EXP:
+            return num(exp(nodes[a].val));
+        case LOG:
+            return num(log(nodes[a].val));
+        case SQRT:
+            return num(sqrt(nodes[a].val));
+        default:
+            break;
+        }
+    }
+    if (op == LOG && nodes[a].op == EXP)
+        return nodes[a].a;
+    return mk(op, 0, -1, a, -1);
+}
+
+/* deriv: derivative of the expression "n" with respect to parameter k */
+static int deriv(int n, int k)
+{
+    int a = nodes[n].a, b = nodes[n].b;
+    switch (nodes[n].op) {
+    case NUM:
+    case VAR:
+        return num(0);
+    case PAR:
+        return num(nodes[n].idx == k ? 1 : 0);
+    case ADD:
+        return add(deriv(a, k), deriv(b, k));
+    case SUB:
+        return sub(deriv(a, k), deriv(b, k));
+    case MUL:
+        return add(mul(deriv(a, k), b), mul(a, deriv(b, k)));
+    case DIV: /* (a/b)' = a'/b - a*b'/b^2 = (a' - (a/b)*b') / b */
+        return dvd(sub(deriv(a, k), mul(n, deriv(b, k))), b);
+    case NEG:
+        return neg(deriv(a, k));
+    case POW:
+        if (nodes[b].op == NUM) /* (a^c)' = c*a^(c-1)*a' */
+            return mul(mul(b, pw(a, num(nodes[b].val - 1))), deriv(a, k));
+        /* (a^b)' = a^b * (b'*log(a) + b*a'/a) */
+        return mul(n, add(mul(deriv(b, k), fn(LOG, a)),
+                          dvd(mul(b, deriv(a, k)), a)));
+    case EXP:
+        return mul(n, deriv(a, k));
+    case LOG:
+        return dvd(deriv(a, k), a);
+    case SQRT:
+        return dvd(deriv(a, k), mul(num(2), n));
+    }
+    return num(0);
+}
+
+/******************************** parser **********************************/
+
+static const char *pos; /* current position in the equation */
+
+static void skipspace(void)
+{
+    while (isspace((unsigned char) *pos))
+        pos++;
+}
+
+static int parse_expr(void);
+
+static int parse_primary(void)
+{
+    char name[MAX_NAME];
+    int i, n, arg2;
+    char *end;
+    skipspace();
+    if (*pos == '(') {
+        pos++;
+        n = parse_expr();
+        skipspace();
+        if (*pos++ != ')')
+            die("expected ')' in equation", NULL);
+        return n;
+    }
+    if (isdigit((unsigned char) *pos) || *pos == '.') {
+        double v = strtod(pos, &end);
+        if (end == pos)
+            die("bad number in equation", pos);
+        pos = end;
+        return num(v);
+    }
+    if (!isalpha((unsigned char) *pos) && *pos != '_')
+        die("unexpected character in equation:", pos);
+    for (i = 0; (isalnum((unsigned char) *pos) || *pos == '_') &&
+                i < MAX_NAME - 1; i++)
+        name[i] = *pos++;
+    name[i] = '\0';
+    skipspace();
+    if (*pos == '(') { /* function call */
+        pos++;
+        n = parse_expr();
+        skipspace();
+        if (!strcmp(name, "pow")) {
+            if (*pos++ != ',')
+                die("pow() takes two arguments", NULL);
+            arg2 = parse_expr();
+            skipspace();
+            n = pw(n, arg2);
+        } else if (!strcmp(name, "exp")) {
+            n = fn(EXP, n);
+        } else if (!strcmp(name, "log")) {
+            n = fn(LOG, n);
+        } else if (!strcmp(name, "sqrt")) {
+            n = fn(SQRT, n);
+        } else {
+            die("unknown function", name);
+        }
+        if (*pos++ != ')')
+            die("expected ')' after function arguments", NULL);
+        return n;
+    }
+    for (i = 0; i < cur->nvars; i++)
+        if (!strcmp(name, cur->vars[i]))
+            return mk(VAR, 0, i, -1, -1);
+    for (i = 0; i < cur->nparams; i++)
+        if (!strcmp(name, cur->params[i]))
+            return mk(PAR, 0, i, -1, -1);
+    die("unknown variable or parameter", name);
+    return -1;
+}
+
+/* unary := '-' unary | primary ['^' unary] */
+static int parse_unary(void)
+{
+    int n;
+    skipspace();
+    if (*pos == '-') {
+        pos++;
+        return neg(parse_unary());
+    }
+    if (*pos == '+') {
+        pos++;
+        return parse_unary();
+    }
+    n = parse_primary();
+    skipspace();
+    if (*pos == '^') {
+        pos++;
+        n = pw(n, parse_unary());
+    }
+    return n;
+}
+
+static int parse_term(void)
+{
+    int n = parse_unary();
+    for (;;) {
+        skipspace();
+        if (*pos == '*') {
+            pos++;
+            n = mul(n, parse_unary());
+        } else if (*pos == '/') {
+            pos++;
+            n = dvd(n, parse_unary());
+        } else {
+            return n;
+        }
+    }
+}
+
+static int parse_expr(void)
+{
+    int n = parse_term();
+    for (;;) {
+        skipspace();
+        if (*pos == '+') {
+            pos++;
+            n = add(n, parse_term());
+        } else if (*pos == '-') {
+            pos++;
+            n = sub(n, parse_term());
+        } else {
+            return n;
+        }
+    }
+}
+
+/******************************** emitter *********************************/
+
+static const char *opstr[] = { "", "", "", " + ", " - ", "*", "/" };
+
+static int prec(int n)
+{
+    switch (nodes[n].op) {
+    case ADD:
+    case SUB:
+        return 1;
+    case MUL:
+    case DIV:
+        return 2;
+    case NEG:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+static int batch_mode; /* print variables as columns indexed by i */
+
+static void print_expr(FILE *out, int n, int top);
+
+/* print operand "n" of a node with precedence "p"; "right" is set if it is
+ * the right operand of a non-commutative operator */
+static void print_operand(FILE *out, int n, int p, int right)
+{
+    int q = nodes[n].temp >= 0 ? 4 : prec(n);
+    if (q < p || (right && q == p) || (nodes[n].op == NUM &&
+                                       nodes[n].val < 0)) {
+        fputc('(', out);
+        print_expr(out, n, 0);
+        fputc(')', out);
+    } else {
+        print_expr(out, n, 0);
+    }
+}
+
+/* print_expr: prints the expression n; temporaries are used for the nodes
+ * which have one, except for the top node (the one being defined) */
+static void print_expr(FILE *out, int n, int top)
+{
+    struct node *nd = &nodes[n];
+    if (!top && nd->temp >= 0) {
+        fprintf(out, "t%d", nd->temp);
+        return;
+    }
+    switch (nd->op) {
+    case NUM:
+        if (nd->val == (long) nd->val && fabs(nd->val) < 1e15)
+            fprintf(out, "%ld.0", (long) nd->val);
+        else
+            fprintf(out, "%.17g", nd->val);
+        break;
+    case VAR:
+        fprintf(out, batch_mode ? "%s[i]" : "%s", cur->vars[nd->idx]);
+        break;
+    case PAR:
+        fprintf(out, "%s", cur->params[nd->idx]);
+        break;
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+        print_operand(out, nd->a, prec(n), 0);
+        fputs(opstr[nd->op], out);
+        print_operand(out, nd->b, prec(n), nd->op == SUB || nd->op == DIV);
+        break;
+    case NEG:
+        fputc('-', out);
+        print_operand(out, nd->a, prec(n), 1);
+        break;
+    case POW:
+        if (isnum(nd->b, 2) && (nodes[nd->a].temp >= 0 ||
+                                prec(nd->a) == 4)) {
+            print_operand(out, nd->a, 2, 0);
+            fputc('*', out);
+            print_operand(out, nd->a, 2, 1);
+        } else {
+            fputs("pow(", out);
+            print_expr(out, nd->a, 0);
+            fputs(", ", out);
+            print_expr(out, nd->b, 0);
+            fputc(')', out);
+        }
+        break;
+    case EXP:
+    case LOG:
+    case SQRT:
+        fprintf(out, "%s(", nd->op == EXP ? "exp" :
+                            nd->op == LOG ? "log" : "sqrt");
+        print_expr(out, nd->a, 0);
+        fputc(')', out);
+        break;
+    }
+}
+
+static int isleaf(int n)
+{
+    return nodes[n].op == NUM || nodes[n].op == VAR || nodes[n].op == PAR;
+}
+
+/* count: counts the references to each node reachable from n */
+static void count(int n)
+{
+    if (nodes[n].count++ > 0)
+        return;
+    if (nodes[n].a >= 0)
+        count(nodes[n].a);
+    if (nodes[n].b >= 0)
+        count(nodes[n].b);
+}
+
+/* invariant: sets the "inv" flag of the nodes reachable from n */
+static int invariant(int n)
+{
+    int inv = nodes[n].op != VAR;
+    if (nodes[n].a >= 0)
+        inv &= invariant(nodes[n].a);
+    if (nodes[n].b >= 0)
+        inv &= invariant(nodes[n].b);
+    return nodes[n].inv = inv;
+}
+
+/* mark_hoist: marks the largest invariant subexpressions below n */
+static void mark_hoist(int n)
+{
+    if (nodes[n].inv) {
+        if (!isleaf(n))
+            nodes[n].hoist = 1;
+        return;
+    }
+    if (nodes[n].a >= 0)
+        mark_hoist(nodes[n].a);
+    if (nodes[n].b >= 0)
+        mark_hoist(nodes[n].b);
+}
+
+/* emit_temps: emits, in dependency order, the definitions of the temporaries
+ * needed by n. If "hoisted" is set, only the ones computed outside the loop */
+static void emit_temps(FILE *out, int n, int hoisted, const char *indent)
+{
+    struct node *nd = &nodes[n];
+    if (isleaf(n) || nd->temp >= 0)
+        return;
+    /* in the loop, the invariant subexpressions are already computed */
+    if (batch_mode && !hoisted && nd->inv)
+        return;
+    if (nd->a >= 0)
+        emit_temps(out, nd->a, hoisted, indent);
+    if (nd->b >= 0)
+        emit_temps(out, nd->b, hoisted, indent);
+    if (batch_mode && hoisted && !nd->inv)
+        return;
+    if (nd->count > 1 || (batch_mode && nd->hoist)) {
+        fprintf(out, "%sconst double t%d = ", indent, ntemps);
+        print_expr(out, n, 1);
+        fputs(";\n", out);
+        nd->temp = ntemps++;
+    }
+}
+
+/* prepare: resets the per-block bookkeeping and counts the references from
+ * the given roots */
+static void prepare(int roots[], int nroots)
+{
+    int i;
+    for (i = 0; i < nnodes; i++) {
+        nodes[i].count = nodes[i].hoist = 0;
+        nodes[i].temp = -1;
+    }
+    for (i = 0; i < nroots; i++) {
+        count(roots[i]);
+        invariant(roots[i]);
+        mark_hoist(roots[i]);
+    }
+    ntemps = 0;
+}
+
+/* uses: whether any of the roots uses the variable (op VAR) or parameter
+ * (op PAR) with index idx */
+static int uses_rec(int n, enum op op, int idx, char seen[])
+{
+    if (seen[n])
+        return 0;
+    seen[n] = 1;
+    if (nodes[n].op == op && nodes[n].idx == idx)
+        return 1;
+    return (nodes[n].a >= 0 && uses_rec(nodes[n].a, op, idx, seen)) ||
+           (nodes[n].b >= 0 && uses_rec(nodes[n].b, op, idx, seen));
+}
+
+static int uses(int roots[], int nroots, enum op op, int idx)
+{
+    static char seen[MAX_NODES];
+    int i;
+    memset(seen, 0, nnodes);
+    for (i = 0; i < nroots; i++)
+        if (uses_rec(roots[i], op, idx, seen))
+            return 1;
+    return 0;
+}
+
+/* emit_locals: names the used variables and parameters */
+static void emit_locals(FILE *out, int roots[], int nroots, int batch)
+{
+    int i;
+    for (i = 0; i < cur->nvars; i++)
+        if (uses(roots, nroots, VAR, i))
+            fprintf(out, batch ? "    const double *%s = X[%d];\n" :
+                                 "    const double %s = X[%d];\n",
+                    cur->vars[i], i);
+    for (i = 0; i < cur->nparams; i++)
+        if (uses(roots, nroots, PAR, i))
+            fprintf(out, "    const double %s = p[%d];\n", cur->params[i], i);
+}
+
+static void emit_model(FILE *out, int value)
+{
+    int i, grad[MAX_PARAMS + 1], m = cur->nparams;
+    grad[0] = value;
+    for (i = 0; i < m; i++)
+        grad[i + 1] = deriv(value, i);
+
+    fprintf(out, "/* %s: %s */\n", cur->name, cur->equation);
+
+    /* value */
+    batch_mode = 0;
+    prepare(grad, 1);
+    fprintf(out, "double gen_%s(double X[], double p[])\n{\n", cur->name);
+    emit_locals(out, grad, 1, 0);
+    emit_temps(out, value, 0, "    ");
+    fputs("    return ", out);
+    print_expr(out, value, 0);
+    fputs(";\n}\n\n", out);
+
+    /* value and gradient */
+    prepare(grad, m + 1);
+    fprintf(out, "double gen_%s_grad(double X[], double p[], double dyda[])"
+                 "\n{\n", cur->name);
+    emit_locals(out, grad, m + 1, 0);
+    for (i = 0; i <= m; i++)
+        emit_temps(out, grad[i], 0, "    ");
+    for (i = 0; i < m; i++) {
+        fprintf(out, "    dyda[%d] = ", i);
+        print_expr(out, grad[i + 1], 0);
+        fputs(";\n", out);
+    }
+    fputs("    return ", out);
+    print_expr(out, value, 0);
+    fputs(";\n}\n\n", out);
+
+    /* batch: values only, or values and gradient */
+    batch_mode = 1;
+    fprintf(out, "void gen_%s_batch(int n, double *X[], double p[], "
+                 "double y[], double *dyda)\n{\n    int i;\n", cur->name);
+    emit_locals(out, grad, m + 1, 1);
+    fputs("    if (dyda == NULL) {\n", out);
+    prepare(grad, 1);
+    emit_temps(out, value, 1, "        ");
+    fputs("#pragma GCC ivdep\n        for (i = 0; i < n; i++) {\n", out);
+    emit_temps(out, value, 0, "            ");
+    fputs("            y[i] = ", out);
+    print_expr(out, value, 0);
+    fputs(";\n        }\n        return;\n    }\n", out);
+    prepare(grad, m + 1);
+    for (i = 0; i <= m; i++)
+        emit_temps(out, grad[i], 1, "    ");
+    fputs("#pragma GCC ivdep\n    for (i = 0; i < n; i++) {\n", out);
+    for (i = 0; i <= m; i++)
+        emit_temps(out, grad[i], 0, "        ");
+    fputs("        y[i] = ", out);
+    print_expr(out, value, 0);
+    fputs(";\n", out);
+    for (i = 0; i < m; i++) {
+        fprintf(out, "        dyda[i*%d + %d] = ", m, i);
+        print_expr(out, grad[i + 1], 0);
+        fputs(";\n", out);
+    }
+    fputs("    }\n}\n\n", out);
+    batch_mode = 0;
+}
+
+/****************************** spec reader *******************************/
+
+/* names which would collide with the generated code */
+static const char *reserved[] = {
+    "X", "p", "n", "i", "y", "dyda", "exp", "log", "sqrt", "pow", "double",
+    "int", "const", "return", "if", "for", "void", "NULL", NULL
+};
+
+static void check_name(const char *name)
+{
+    int i;
+    if (!isalpha((unsigned char) name[0]) && name[0] != '_')
+        die("invalid name", name);
+    for (i = 0; name[i]; i++)
+        if (!isalnum((unsigned char) name[i]) && name[i] != '_')
+            die("invalid name", name);
+    for (i = 0; reserved[i]; i++)
+        if (!strcmp(name, reserved[i]))
+            die("reserved name", name);
+    if (name[0] == 't' && isdigit((unsigned char) name[1]))
+        die("reserved name", name);
+}
+
+/* split a comma (or space) separated list of names */
+static int split_names(char *s, char names[][MAX_NAME], int max)
+{
+    int n = 0;
+    char *tok;
+    for (tok = strtok(s, ", \t\n"); tok; tok = strtok(NULL, ", \t\n")) {
+        if (n == max)
+            die("too many names in list", NULL);
+        if (strlen(tok) >= MAX_NAME)
+            die("name too long", tok);
+        check_name(tok);
+        strcpy(names[n++], tok);
+    }
+    return n;
+}
+
+static char *trim(char *s)
+{
+    char *end;
+    while (isspace((unsigned char) *s))
+        s++;
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char) end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+/* generate: processes the model in cur and writes its code */
+static void generate(FILE *out)
+{
+    int value;
+    const char *eq = cur->equation;
+    if (!cur->name[0] || !cur->nvars || !cur->nparams || !eq[0])
+        die("Model, Independent variables, Parameters and Equation are "
+            "required", NULL);
+    /* "v0 = expression" or just "expression" */
+    if (strchr(eq, '='))
+        eq = strchr(eq, '=') + 1;
+    nnodes = 0;
+    pos = eq;
+    value = parse_expr();
+    skipspace();
+    if (*pos)
+        die("unexpected text at the end of the equation:", pos);
+    emit_model(out, value);
+}
+
+int main(int argc, char *argv[])
+{
+    static struct spec specs[256];
+    int nspecs = 0, lineno = 0, i, j, in_equation = 0;
+    char line[MAX_LINE], *s, *colon;
+    FILE *fp, *out = stdout;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s models.spec > models_gen.c\n", argv[0]);
+        return 1;
+    }
+    spec_file = argv[1];
+    if (!(fp = fopen(spec_file, "r"))) {
+        perror(spec_file);
+        return 1;
+    }
+    cur = NULL;
+    while (fgets(line, MAX_LINE, fp)) {
+        lineno++;
+        if (line[0] == '#')
+            continue;
+        s = trim(line);
+        if (!*s) { /* blank line: end of block */
+            in_equation = 0;
+            continue;
+        }
+        /* indented lines continue the equation */
+        if (in_equation && isspace((unsigned char) line[0])) {
+            if (strlen(cur->equation) + strlen(s) + 2 >= MAX_EQ)
+                die("equation too long", NULL);
+            strcat(cur->equation, " ");
+            strcat(cur->equation, s);
+            continue;
+        }
+        in_equation = 0;
+        if (!(colon = strchr(s, ':'))) {
+            fprintf(stderr, "modelgen: %s:%d: expected \"Field: value\"\n",
+                    spec_file, lineno);
+            return 1;
+        }
+        *colon = '\0';
+        colon = trim(colon + 1);
+        if (!strcmp(s, "Model")) {
+            if (nspecs == 256) {
+                fprintf(stderr, "modelgen: too many models\n");
+                return 1;
+            }
+            cur = &specs[nspecs++];
+            memset(cur, 0, sizeof(*cur));
+            cur->line = lineno;
+            if (strlen(colon) >= MAX_NAME)
+                die("name too long", colon);
+            strcpy(cur->name, colon);
+            check_name(cur->name);
+            for (i = 0; i < nspecs - 1; i++)
+                if (!strcmp(specs[i].name, cur->name))
+                    die("duplicated model", NULL);
+        } else if (!cur) {
+            fprintf(stderr, "modelgen: %s:%d: \"Model:\" expected first\n",
+                    spec_file, lineno);
+            return 1;
+        } else if (!strcmp(s, "Independent variables")) {
+            cur->nvars = split_names(colon, cur->vars, MAX_INDEP);
+        } else if (!strcmp(s, "Parameters")) {
+            cur->nparams = split_names(colon, cur->params, MAX_PARAMS);
+            for (i = 0; i < cur->nparams; i++)
+                for (j = 0; j < cur->nvars; j++)
+                    if (!strcmp(cur->params[i], cur->vars[j]))
+                        die("name used as variable and parameter",
+                            cur->params[i]);
+        } else if (!strcmp(s, "Equation")) {
+            if (strlen(colon) >= MAX_EQ)
+                die("equation too long", NULL);
+            strcpy(cur->equation, colon);
+            in_equation = 1;
+        } else if (strcmp(s, "Description")) {
+            die("unknown field", s);
+        }
+    }
+    fclose(fp);
+
+    fprintf(out, "/* Generated by modelgen from %s.\n * Do not edit: edit the "
+                 "specification and run \"make models\" instead. */\n"
+                 "#include <math.h>\n#include <stddef.h>\n\n", spec_file);
+    for (i = 0; i < nspecs; i++) {
+        cur = &specs[i];
+        generate(out);
+    }
+    fputs("#define GENERATED_MODELS \\\n", out);
+    for (i = 0; i < nspecs; i++) {
+        cur = &specs[i];
+        fprintf(out, "  { \"%s\", gen_%s, %d, %d, {", cur->name, cur->name,
+                cur->nparams, cur->nvars);
+        for (j = 0; j < cur->nparams; j++)
+            fprintf(out, "%s\"%s\"", j ? ", " : "", cur->params[j]);
+        fputs("}, {", out);
+        for (j = 0; j < cur->nvars; j++)
+            fprintf(out, "%s\"%s\"", j ? ", " : "", cur->vars[j]);
+        fprintf(out, "}, gen_%s_grad, gen_%s_batch }, \\\n",
+                cur->name, cur->name);
+    }
+    fputs("\n", out);
+    return 0;
+}
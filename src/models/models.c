@@ -1,99 +1,81 @@
 #include "models.h"
-#include "enzyme.h"
-#include "enzyme.c"
+#include "models_gen.c"
+#include "progress.h"
+#include "progress.c"
 
 /* How to implement a model?
  *
- * 1. In enzyme.c, define your function
- * 2. In enzyme.h, add the function prototype
- * 3. Here, add a new entry defining the name, name of the function
- * (as in enzyme.c), num of parameters and indep variables, names of the
- * parameters and name of the independent variables.
+ * The simplest way is to add its specification (name, independent variables,
+ * parameters and equation) to models.spec, and run "make models && make".
+ * This generates in models_gen.c the function, its analytic gradient and a
+ * batch version, and the entry of the model, which is placed in the array of
+ * models by GENERATED_MODELS. models.spec is the only definition of those
+ * models.
  *
- * NOTE: enzyme.c and enzyme.h contain enzymatic models. If you want to include
- * models from a field not related to enzymology, you might want to create a
- * couple of files: e.g. phisics.h and phisics.c and place your functions there.
- * Then just include them at the top of this file as follows:
+ * Models which cannot be written as a single equation can be implemented by
+ * hand:
  *
- * #include "phisics.h"
- * #include "phisics.c"
+ * 1. In a couple of files of your own, e.g. physics.h and physics.c, define
+ * your function (and optionally its gradient and batch version, see
+ * models.h)
+ * 2. Include them at the top of this file:
+ *
+ * #include "physics.h"
+ * #include "physics.c"
+ *
+ * 3. Here, add a new entry defining the name, name of the function, num of
+ * parameters and indep variables, names of the parameters and name of the
+ * independent variables.
+ *
+ * Models defined by differential equations (e.g. progress curves) are
+ * implemented in the same way, defining the equations as a struct ode_model
+ * (see ode.h and progress.c).
  *
  * IMPORTANT: leave the last "model" as is: it is used to recognized the end of
  * the array of models. Modifying it will break the program
  */
 
 struct model models[] = {
+  GENERATED_MODELS
   {
-    "michaelis",
-    michaelis,
-    2,
-    1,
-    {"Vmax", "Km"},
-    {"S"}
-  },
-  {
-    "alberty",
-    alberty,
-    3,
-    2,
-    {"Vmax", "KmA", "KmB"},
-    {"A", "B"}
-  },
-  {
-    "pingpong",
-    pingpong,
-    3,
+    "progress_michaelis",
+    progress_michaelis,
     2,
-    {"Vmax", "KmA", "KmB"},
-    {"A", "B"}
-  },
-  {
-    "mixed",
-    mixed,
-    4,
     2,
-    {"Vmax", "Km", "KIa", "KIb"},
-    {"S", "I"}
+    {"Vmax", "Km"},
+    {"t", "S0"},
+    progress_michaelis_grad,
+    progress_michaelis_batch
   },
   {
-    "competitive",
-    competitive,
+    "progress_prodinhib",
+    progress_prodinhib,
     3,
     2,
-    {"Vmax", "Km", "KIa"},
-    {"S", "I"}
+    {"Vmax", "Km", "Kp"},
+    {"t", "S0"},
+    progress_prodinhib_grad,
+    progress_prodinhib_batch
   },
   {
-    "uncompetitive",
-    uncompetitive,
+    "progress_inactiv",
+    progress_inactiv,
     3,
     2,
-    {"Vmax", "Km", "KIb"},
-    {"S", "I"}
+    {"Vmax", "Km", "kt"},
+    {"t", "S0"},
+    progress_inactiv_grad,
+    progress_inactiv_batch
   },
   {
-    "noncompetitive",
-    noncompetitive,
+    "progress_competitive",
+    progress_competitive,
     3,
-    2,
-    {"Vmax", "Km", "KIb"},
-    {"S", "I"}
-  },
-  {
-    "ph",
-    ph,
-    6,
-    2,
-    {"Vmax", "Km", "Ka1", "Ka2", "Ka3", "Ka4"},
-    {"S", "H"}
-  },
-  {
-    "michaelistemp",
-    michaelistemp,
     3,
-    2,
-    {"Ea", "Km", "T1"},
-    {"S", "T"}
+    {"Vmax", "Km", "KIa"},
+    {"t", "S0", "I"},
+    progress_competitive_grad,
+    progress_competitive_batch
   },
   {
     "",
@@ -3,18 +3,27 @@
 
 /* maximum number of independent variables in a model*/
 #define MAX_INDEP 10
-/* max num of chars in the --data option */
-#define MAX_DATA_CHARS 1000
 /* max number of parameters of a model */
 #define MAX_PARAMS 10
 
 struct model {
   char *name;                                  // name of the model
-  double (*function) (double X[], double p[]); // function (ex. see enzyme.h)
+  double (*function) (double X[], double p[]); // function (ex. see models_gen.c)
   int nparams;                                 // number of parameters
   int nvars;                                   // number of indep vars
   char *params[MAX_PARAMS];                    // names of the parameters
   char *indep_vars[MAX_INDEP];                 // names of the indep vars
+  /* optional (NULL if not available, see models_gen.c for examples): */
+  double (*gradient) (double X[], double p[], double dyda[]); // value, and
+                                               // derivatives in dyda[nparams]
+  void (*batch) (int n, double *X[], double p[], double y[], double *dyda);
+                                               // values at n points, X[nvars]
+                                               // holding a column per var,
+                                               // and derivatives in
+                                               // dyda[n][nparams] if not NULL
 };
 
+/* built-in models (models.c), ended by a model with a NULL function */
+extern struct model models[];
+
 #endif /* __MODELS_H__ */
@@ -0,0 +1,79 @@
+# Specification of the models whose code is generated by "make models" (see
+# modelgen/modelgen.c). The generated code is placed in models_gen.c, and the
+# models are added to the array of models in models.c.
+#
+# Each model is a block of lines "Field: value", using the same fields as
+# models.txt:
+#
+#   Model:                  name of the model (as given to --model)
+#   Description:            optional, ignored
+#   Independent variables:  names, separated by commas
+#   Parameters:             names, separated by commas
+#   Equation:               v0 = expression
+#
+# Indented lines after "Equation:" continue the equation. Expressions may use
+# numbers, the names of the variables and parameters, + - * / ^ (power),
+# parentheses and the functions exp(), log(), sqrt() and pow(,).
+#
+# How to add a model: add its block here and run "make models && make".
+
+Model: michaelis
+Description: Michaelis-Menten
+Independent variables: S
+Parameters: Vmax, Km
+Equation: v0 = Vmax*S / (Km + S)
+
+Model: alberty
+Description: Alberty equation (two substrates, ordered)
+Independent variables: A, B
+Parameters: Vmax, KmA, KmB, KsA
+Equation: v0 = Vmax*A*B / (KmA*B + KmB*A + A*B + KsA*KmB)
+
+Model: pingpong
+Description: Double displacement
+Independent variables: A, B
+Parameters: Vmax, KmA, KmB
+Equation: v0 = Vmax*A*B / (KmA*B + KmB*A + A*B)
+
+Model: mixed
+Description: Mixed inhibition
+Independent variables: S, I
+Parameters: Vmax, Km, KIa, KIb
+Equation: v0 = Vmax*S / (Km*(1 + I/KIa) + S*(1 + I/KIb))
+
+Model: competitive
+Description: Competitive inhibition (mixed, with KIb = infinite)
+Independent variables: S, I
+Parameters: Vmax, Km, KIa
+Equation: v0 = Vmax*S / (Km*(1 + I/KIa) + S)
+
+Model: uncompetitive
+Description: Uncompetitive inhibition (mixed, with KIa = infinite)
+Independent variables: S, I
+Parameters: Vmax, Km, KIb
+Equation: v0 = Vmax*S / (Km + S*(1 + I/KIb))
+
+Model: noncompetitive
+Description: Non-competitive inhibition (mixed, with KIa = KIb)
+Independent variables: S, I
+Parameters: Vmax, Km, KIb
+Equation: v0 = Vmax*S / ((Km + S)*(1 + I/KIb))
+
+Model: ph
+Description: Effect of the pH (H = proton concentration = 10^(-pH))
+Independent variables: S, H
+Parameters: Vmax, Km, Ka1, Ka2, Ka3, Ka4
+Equation: v0 = Vmax*S /
+              (Km*(1 + H/Ka1 + Ka3/H) + S*(1 + H/Ka2 + Ka4/H))
+
+Model: michaelis_inactiv
+Description: Michaelis-Menten with first order inactivation of the enzyme
+Independent variables: S, t
+Parameters: Vmax, Km, kt
+Equation: v0 = Vmax*S*exp(-kt*t) / (Km + S)
+
+Model: michaelistemp
+Description: Michaelis-Menten at the temperature T (K), Vmax at T1 (fixed)
+Independent variables: S, T
+Parameters: Vmax, Km, Ea, T1
+Equation: v0 = Vmax*S*exp(Ea/8.3144621*(1/T1 - 1/T)) / (Km + S)
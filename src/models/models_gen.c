@@ -0,0 +1,608 @@
+/* Generated by modelgen from models/models.spec.
+ * Do not edit: edit the specification and run "make models" instead. */
+#include <math.h>
+#include <stddef.h>
+
+/* michaelis: v0 = Vmax*S / (Km + S) */
+double gen_michaelis(double X[], double p[])
+{
+    const double S = X[0];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    return Vmax*S/(Km + S);
+}
+
+double gen_michaelis_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double t0 = Km + S;
+    const double t1 = Vmax*S/t0;
+    dyda[0] = S/t0;
+    dyda[1] = -(t1/t0);
+    return t1;
+}
+
+void gen_michaelis_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/(Km + S[i]);
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = Km + S[i];
+        const double t1 = Vmax*S[i]/t0;
+        y[i] = t1;
+        dyda[i*2 + 0] = S[i]/t0;
+        dyda[i*2 + 1] = -(t1/t0);
+    }
+}
+
+/* alberty: v0 = Vmax*A*B / (KmA*B + KmB*A + A*B + KsA*KmB) */
+double gen_alberty(double X[], double p[])
+{
+    const double A = X[0];
+    const double B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    const double KsA = p[3];
+    return Vmax*A*B/(KmA*B + KmB*A + A*B + KsA*KmB);
+}
+
+double gen_alberty_grad(double X[], double p[], double dyda[])
+{
+    const double A = X[0];
+    const double B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    const double KsA = p[3];
+    const double t0 = A*B;
+    const double t1 = KmA*B + KmB*A + t0 + KsA*KmB;
+    const double t2 = Vmax*A*B/t1;
+    dyda[0] = t0/t1;
+    dyda[1] = -(t2*B/t1);
+    dyda[2] = -(t2*(A + KsA)/t1);
+    dyda[3] = -(t2*KmB/t1);
+    return t2;
+}
+
+void gen_alberty_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *A = X[0];
+    const double *B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    const double KsA = p[3];
+    if (dyda == NULL) {
+        const double t0 = KsA*KmB;
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*A[i]*B[i]/(KmA*B[i] + KmB*A[i] + A[i]*B[i] + t0);
+        }
+        return;
+    }
+    const double t0 = KsA*KmB;
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t1 = A[i]*B[i];
+        const double t2 = KmA*B[i] + KmB*A[i] + t1 + t0;
+        const double t3 = Vmax*A[i]*B[i]/t2;
+        y[i] = t3;
+        dyda[i*4 + 0] = t1/t2;
+        dyda[i*4 + 1] = -(t3*B[i]/t2);
+        dyda[i*4 + 2] = -(t3*(A[i] + KsA)/t2);
+        dyda[i*4 + 3] = -(t3*KmB/t2);
+    }
+}
+
+/* pingpong: v0 = Vmax*A*B / (KmA*B + KmB*A + A*B) */
+double gen_pingpong(double X[], double p[])
+{
+    const double A = X[0];
+    const double B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    return Vmax*A*B/(KmA*B + KmB*A + A*B);
+}
+
+double gen_pingpong_grad(double X[], double p[], double dyda[])
+{
+    const double A = X[0];
+    const double B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    const double t0 = A*B;
+    const double t1 = KmA*B + KmB*A + t0;
+    const double t2 = Vmax*A*B/t1;
+    dyda[0] = t0/t1;
+    dyda[1] = -(t2*B/t1);
+    dyda[2] = -(t2*A/t1);
+    return t2;
+}
+
+void gen_pingpong_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *A = X[0];
+    const double *B = X[1];
+    const double Vmax = p[0];
+    const double KmA = p[1];
+    const double KmB = p[2];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*A[i]*B[i]/(KmA*B[i] + KmB*A[i] + A[i]*B[i]);
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = A[i]*B[i];
+        const double t1 = KmA*B[i] + KmB*A[i] + t0;
+        const double t2 = Vmax*A[i]*B[i]/t1;
+        y[i] = t2;
+        dyda[i*3 + 0] = t0/t1;
+        dyda[i*3 + 1] = -(t2*B[i]/t1);
+        dyda[i*3 + 2] = -(t2*A[i]/t1);
+    }
+}
+
+/* mixed: v0 = Vmax*S / (Km*(1 + I/KIa) + S*(1 + I/KIb)) */
+double gen_mixed(double X[], double p[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    const double KIb = p[3];
+    return Vmax*S/(Km*(1.0 + I/KIa) + S*(1.0 + I/KIb));
+}
+
+double gen_mixed_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    const double KIb = p[3];
+    const double t0 = I/KIa;
+    const double t1 = 1.0 + t0;
+    const double t2 = I/KIb;
+    const double t3 = Km*t1 + S*(1.0 + t2);
+    const double t4 = Vmax*S/t3;
+    dyda[0] = S/t3;
+    dyda[1] = -(t4*t1/t3);
+    dyda[2] = t4*Km*t0/KIa/t3;
+    dyda[3] = t4*S*t2/KIb/t3;
+    return t4;
+}
+
+void gen_mixed_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    const double KIb = p[3];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/(Km*(1.0 + I[i]/KIa) + S[i]*(1.0 + I[i]/KIb));
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = I[i]/KIa;
+        const double t1 = 1.0 + t0;
+        const double t2 = I[i]/KIb;
+        const double t3 = Km*t1 + S[i]*(1.0 + t2);
+        const double t4 = Vmax*S[i]/t3;
+        y[i] = t4;
+        dyda[i*4 + 0] = S[i]/t3;
+        dyda[i*4 + 1] = -(t4*t1/t3);
+        dyda[i*4 + 2] = t4*Km*t0/KIa/t3;
+        dyda[i*4 + 3] = t4*S[i]*t2/KIb/t3;
+    }
+}
+
+/* competitive: v0 = Vmax*S / (Km*(1 + I/KIa) + S) */
+double gen_competitive(double X[], double p[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    return Vmax*S/(Km*(1.0 + I/KIa) + S);
+}
+
+double gen_competitive_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    const double t0 = I/KIa;
+    const double t1 = 1.0 + t0;
+    const double t2 = Km*t1 + S;
+    const double t3 = Vmax*S/t2;
+    dyda[0] = S/t2;
+    dyda[1] = -(t3*t1/t2);
+    dyda[2] = t3*Km*t0/KIa/t2;
+    return t3;
+}
+
+void gen_competitive_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIa = p[2];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/(Km*(1.0 + I[i]/KIa) + S[i]);
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = I[i]/KIa;
+        const double t1 = 1.0 + t0;
+        const double t2 = Km*t1 + S[i];
+        const double t3 = Vmax*S[i]/t2;
+        y[i] = t3;
+        dyda[i*3 + 0] = S[i]/t2;
+        dyda[i*3 + 1] = -(t3*t1/t2);
+        dyda[i*3 + 2] = t3*Km*t0/KIa/t2;
+    }
+}
+
+/* uncompetitive: v0 = Vmax*S / (Km + S*(1 + I/KIb)) */
+double gen_uncompetitive(double X[], double p[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    return Vmax*S/(Km + S*(1.0 + I/KIb));
+}
+
+double gen_uncompetitive_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    const double t0 = I/KIb;
+    const double t1 = Km + S*(1.0 + t0);
+    const double t2 = Vmax*S/t1;
+    dyda[0] = S/t1;
+    dyda[1] = -(t2/t1);
+    dyda[2] = t2*S*t0/KIb/t1;
+    return t2;
+}
+
+void gen_uncompetitive_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/(Km + S[i]*(1.0 + I[i]/KIb));
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = I[i]/KIb;
+        const double t1 = Km + S[i]*(1.0 + t0);
+        const double t2 = Vmax*S[i]/t1;
+        y[i] = t2;
+        dyda[i*3 + 0] = S[i]/t1;
+        dyda[i*3 + 1] = -(t2/t1);
+        dyda[i*3 + 2] = t2*S[i]*t0/KIb/t1;
+    }
+}
+
+/* noncompetitive: v0 = Vmax*S / ((Km + S)*(1 + I/KIb)) */
+double gen_noncompetitive(double X[], double p[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    return Vmax*S/((Km + S)*(1.0 + I/KIb));
+}
+
+double gen_noncompetitive_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    const double t0 = Km + S;
+    const double t1 = I/KIb;
+    const double t2 = 1.0 + t1;
+    const double t3 = t0*t2;
+    const double t4 = Vmax*S/t3;
+    dyda[0] = S/t3;
+    dyda[1] = -(t4*t2/t3);
+    dyda[2] = t4*t0*t1/KIb/t3;
+    return t4;
+}
+
+void gen_noncompetitive_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *I = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double KIb = p[2];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/((Km + S[i])*(1.0 + I[i]/KIb));
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = Km + S[i];
+        const double t1 = I[i]/KIb;
+        const double t2 = 1.0 + t1;
+        const double t3 = t0*t2;
+        const double t4 = Vmax*S[i]/t3;
+        y[i] = t4;
+        dyda[i*3 + 0] = S[i]/t3;
+        dyda[i*3 + 1] = -(t4*t2/t3);
+        dyda[i*3 + 2] = t4*t0*t1/KIb/t3;
+    }
+}
+
+/* ph: v0 = Vmax*S / (Km*(1 + H/Ka1 + Ka3/H) + S*(1 + H/Ka2 + Ka4/H)) */
+double gen_ph(double X[], double p[])
+{
+    const double S = X[0];
+    const double H = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ka1 = p[2];
+    const double Ka2 = p[3];
+    const double Ka3 = p[4];
+    const double Ka4 = p[5];
+    return Vmax*S/(Km*(1.0 + H/Ka1 + Ka3/H) + S*(1.0 + H/Ka2 + Ka4/H));
+}
+
+double gen_ph_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double H = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ka1 = p[2];
+    const double Ka2 = p[3];
+    const double Ka3 = p[4];
+    const double Ka4 = p[5];
+    const double t0 = H/Ka1;
+    const double t1 = 1.0 + t0 + Ka3/H;
+    const double t2 = H/Ka2;
+    const double t3 = Km*t1 + S*(1.0 + t2 + Ka4/H);
+    const double t4 = Vmax*S/t3;
+    const double t5 = 1.0/H;
+    dyda[0] = S/t3;
+    dyda[1] = -(t4*t1/t3);
+    dyda[2] = t4*Km*t0/Ka1/t3;
+    dyda[3] = t4*S*t2/Ka2/t3;
+    dyda[4] = -(t4*Km*t5/t3);
+    dyda[5] = -(t4*S*t5/t3);
+    return t4;
+}
+
+void gen_ph_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *H = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ka1 = p[2];
+    const double Ka2 = p[3];
+    const double Ka3 = p[4];
+    const double Ka4 = p[5];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]/(Km*(1.0 + H[i]/Ka1 + Ka3/H[i]) + S[i]*(1.0 + H[i]/Ka2 + Ka4/H[i]));
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = H[i]/Ka1;
+        const double t1 = 1.0 + t0 + Ka3/H[i];
+        const double t2 = H[i]/Ka2;
+        const double t3 = Km*t1 + S[i]*(1.0 + t2 + Ka4/H[i]);
+        const double t4 = Vmax*S[i]/t3;
+        const double t5 = 1.0/H[i];
+        y[i] = t4;
+        dyda[i*6 + 0] = S[i]/t3;
+        dyda[i*6 + 1] = -(t4*t1/t3);
+        dyda[i*6 + 2] = t4*Km*t0/Ka1/t3;
+        dyda[i*6 + 3] = t4*S[i]*t2/Ka2/t3;
+        dyda[i*6 + 4] = -(t4*Km*t5/t3);
+        dyda[i*6 + 5] = -(t4*S[i]*t5/t3);
+    }
+}
+
+/* michaelis_inactiv: v0 = Vmax*S*exp(-kt*t) / (Km + S) */
+double gen_michaelis_inactiv(double X[], double p[])
+{
+    const double S = X[0];
+    const double t = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double kt = p[2];
+    return Vmax*S*exp(-(kt*t))/(Km + S);
+}
+
+double gen_michaelis_inactiv_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double t = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double kt = p[2];
+    const double t0 = Vmax*S;
+    const double t1 = exp(-(kt*t));
+    const double t2 = Km + S;
+    const double t3 = t0*t1/t2;
+    dyda[0] = S*t1/t2;
+    dyda[1] = -(t3/t2);
+    dyda[2] = -(t0*t1*t/t2);
+    return t3;
+}
+
+void gen_michaelis_inactiv_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *t = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double kt = p[2];
+    if (dyda == NULL) {
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]*exp(-(kt*t[i]))/(Km + S[i]);
+        }
+        return;
+    }
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t0 = Vmax*S[i];
+        const double t1 = exp(-(kt*t[i]));
+        const double t2 = Km + S[i];
+        const double t3 = t0*t1/t2;
+        y[i] = t3;
+        dyda[i*3 + 0] = S[i]*t1/t2;
+        dyda[i*3 + 1] = -(t3/t2);
+        dyda[i*3 + 2] = -(t0*t1*t[i]/t2);
+    }
+}
+
+/* michaelistemp: v0 = Vmax*S*exp(Ea/8.3144621*(1/T1 - 1/T)) / (Km + S) */
+double gen_michaelistemp(double X[], double p[])
+{
+    const double S = X[0];
+    const double T = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ea = p[2];
+    const double T1 = p[3];
+    return Vmax*S*exp(Ea/8.3144621000000001*(1.0/T1 - 1.0/T))/(Km + S);
+}
+
+double gen_michaelistemp_grad(double X[], double p[], double dyda[])
+{
+    const double S = X[0];
+    const double T = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ea = p[2];
+    const double T1 = p[3];
+    const double t0 = Vmax*S;
+    const double t1 = Ea/8.3144621000000001;
+    const double t2 = 1.0/T1;
+    const double t3 = t2 - 1.0/T;
+    const double t4 = exp(t1*t3);
+    const double t5 = Km + S;
+    const double t6 = t0*t4/t5;
+    dyda[0] = S*t4/t5;
+    dyda[1] = -(t6/t5);
+    dyda[2] = t0*t4*0.1202723625380408*t3/t5;
+    dyda[3] = -(t0*t4*t1*t2/T1/t5);
+    return t6;
+}
+
+void gen_michaelistemp_batch(int n, double *X[], double p[], double y[], double *dyda)
+{
+    int i;
+    const double *S = X[0];
+    const double *T = X[1];
+    const double Vmax = p[0];
+    const double Km = p[1];
+    const double Ea = p[2];
+    const double T1 = p[3];
+    if (dyda == NULL) {
+        const double t0 = Ea/8.3144621000000001;
+        const double t1 = 1.0/T1;
+#pragma GCC ivdep
+        for (i = 0; i < n; i++) {
+            y[i] = Vmax*S[i]*exp(t0*(t1 - 1.0/T[i]))/(Km + S[i]);
+        }
+        return;
+    }
+    const double t0 = Ea/8.3144621000000001;
+    const double t1 = 1.0/T1;
+    const double t2 = t0*t1/T1;
+#pragma GCC ivdep
+    for (i = 0; i < n; i++) {
+        const double t3 = Vmax*S[i];
+        const double t4 = t1 - 1.0/T[i];
+        const double t5 = exp(t0*t4);
+        const double t6 = Km + S[i];
+        const double t7 = t3*t5/t6;
+        y[i] = t7;
+        dyda[i*4 + 0] = S[i]*t5/t6;
+        dyda[i*4 + 1] = -(t7/t6);
+        dyda[i*4 + 2] = t3*t5*0.1202723625380408*t4/t6;
+        dyda[i*4 + 3] = -(t3*t5*t2/t6);
+    }
+}
+
+#define GENERATED_MODELS \
+  { "michaelis", gen_michaelis, 2, 1, {"Vmax", "Km"}, {"S"}, gen_michaelis_grad, gen_michaelis_batch }, \
+  { "alberty", gen_alberty, 4, 2, {"Vmax", "KmA", "KmB", "KsA"}, {"A", "B"}, gen_alberty_grad, gen_alberty_batch }, \
+  { "pingpong", gen_pingpong, 3, 2, {"Vmax", "KmA", "KmB"}, {"A", "B"}, gen_pingpong_grad, gen_pingpong_batch }, \
+  { "mixed", gen_mixed, 4, 2, {"Vmax", "Km", "KIa", "KIb"}, {"S", "I"}, gen_mixed_grad, gen_mixed_batch }, \
+  { "competitive", gen_competitive, 3, 2, {"Vmax", "Km", "KIa"}, {"S", "I"}, gen_competitive_grad, gen_competitive_batch }, \
+  { "uncompetitive", gen_uncompetitive, 3, 2, {"Vmax", "Km", "KIb"}, {"S", "I"}, gen_uncompetitive_grad, gen_uncompetitive_batch }, \
+  { "noncompetitive", gen_noncompetitive, 3, 2, {"Vmax", "Km", "KIb"}, {"S", "I"}, gen_noncompetitive_grad, gen_noncompetitive_batch }, \
+  { "ph", gen_ph, 6, 2, {"Vmax", "Km", "Ka1", "Ka2", "Ka3", "Ka4"}, {"S", "H"}, gen_ph_grad, gen_ph_batch }, \
+  { "michaelis_inactiv", gen_michaelis_inactiv, 3, 2, {"Vmax", "Km", "kt"}, {"S", "t"}, gen_michaelis_inactiv_grad, gen_michaelis_inactiv_batch }, \
+  { "michaelistemp", gen_michaelistemp, 4, 2, {"Vmax", "Km", "Ea", "T1"}, {"S", "T"}, gen_michaelistemp_grad, gen_michaelistemp_batch }, \
+
@@ -0,0 +1,35 @@
+#ifndef __PLUGIN_H__
+#define __PLUGIN_H__
+
+#include <models.h>
+
+/* Interface of the model plugins (shared objects loaded with --plugins).
+ *
+ * A plugin exports a variable named "enzmc_plugin" of type
+ * struct enzmc_plugin, describing its table of models:
+ *
+ *   static struct model hill_models[] = {
+ *     {"hill", hill, 3, 1, {"Vmax", "K", "h"}, {"S"}, hill_grad, hill_batch},
+ *   };
+ *
+ *   struct enzmc_plugin enzmc_plugin = {
+ *     ENZMC_PLUGIN_VERSION, sizeof(struct model), "hill", 1, hill_models
+ *   };
+ *
+ * The gradient and batch callbacks are optional (NULL). See plugins/hill.c.
+ *
+ * ENZMC_PLUGIN_VERSION changes whenever struct model or this structure
+ * change, so that plugins built against another version are rejected.
+ */
+#define ENZMC_PLUGIN_VERSION 1
+#define ENZMC_PLUGIN_SYMBOL "enzmc_plugin"
+
+struct enzmc_plugin {
+  int version;          // ENZMC_PLUGIN_VERSION the plugin was built with
+  int model_size;       // sizeof(struct model) the plugin was built with
+  char *name;           // name of the plugin, for messages
+  int nmodels;          // number of models in the table
+  struct model *models; // table of models
+};
+
+#endif /* __PLUGIN_H__ */
@@ -0,0 +1,102 @@
+#include "progress.h"
+#include <stddef.h>
+
+/* For an explanation of the models, please refer to the header file.
+ *
+ * Each model is defined by its right-hand side (and, optionally, its initial
+ * state), which also gives the jacobians dfdx and dfdp when they are not NULL
+ * (they are needed to integrate the sensitivities, see ode.h).
+ */
+
+static void michaelis_rhs(const double c[], double t, const double x[],
+                          const double p[], double dxdt[], double *dfdx,
+                          double *dfdp)
+{
+    /* c[0] = [S0], x[0] = [P]
+     * p[0] = Vmax, p[1] = Km */
+    double S = c[0] - x[0], D = p[1] + S;
+    dxdt[0] = p[0]*S / D;
+    if (dfdx) {
+        dfdx[0] = -p[0]*p[1] / (D*D);
+        dfdp[0] = S / D;
+        dfdp[1] = -dxdt[0] / D;
+    }
+}
+
+static struct ode_model michaelis_ode = {1, 2, 1, NULL, michaelis_rhs};
+ODE_MODEL(progress_michaelis, michaelis_ode)
+
+static void prodinhib_rhs(const double c[], double t, const double x[],
+                          const double p[], double dxdt[], double *dfdx,
+                          double *dfdp)
+{
+    /* c[0] = [S0], x[0] = [P]
+     * p[0] = Vmax, p[1] = Km, p[2] = Kp */
+    double S = c[0] - x[0], inh = 1 + x[0]/p[2], D = p[1]*inh + S;
+    dxdt[0] = p[0]*S / D;
+    if (dfdx) {
+        dfdx[0] = -p[0]*(D + S*(p[1]/p[2] - 1)) / (D*D);
+        dfdp[0] = S / D;
+        dfdp[1] = -dxdt[0]*inh / D;
+        dfdp[2] = dxdt[0]*p[1]*x[0] / (p[2]*p[2]*D);
+    }
+}
+
+static struct ode_model prodinhib_ode = {1, 3, 1, NULL, prodinhib_rhs};
+ODE_MODEL(progress_prodinhib, prodinhib_ode)
+
+static void inactiv_init(const double c[], const double p[], double x0[],
+                         double *dx0dp)
+{
+    int j;
+    x0[0] = 0; /* [P] */
+    x0[1] = 1; /* active fraction of the enzyme */
+    for (j = 0; dx0dp && j < 2*3; j++) {
+        dx0dp[j] = 0;
+    }
+}
+
+static void inactiv_rhs(const double c[], double t, const double x[],
+                        const double p[], double dxdt[], double *dfdx,
+                        double *dfdp)
+{
+    /* c[0] = [S0], x[0] = [P], x[1] = E (active fraction)
+     * p[0] = Vmax, p[1] = Km, p[2] = kt */
+    double S = c[0] - x[0], D = p[1] + S;
+    dxdt[0] = p[0]*x[1]*S / D;
+    dxdt[1] = -p[2]*x[1];
+    if (dfdx) {
+        dfdx[0] = -p[0]*x[1]*p[1] / (D*D);  /* d(dP/dt)/dP */
+        dfdx[1] = p[0]*S / D;               /* d(dP/dt)/dE */
+        dfdx[2] = 0;                        /* d(dE/dt)/dP */
+        dfdx[3] = -p[2];                    /* d(dE/dt)/dE */
+        dfdp[0] = x[1]*S / D;
+        dfdp[1] = -dxdt[0] / D;
+        dfdp[2] = 0;
+        dfdp[3] = 0;
+        dfdp[4] = 0;
+        dfdp[5] = -x[1];
+    }
+}
+
+static struct ode_model inactiv_ode = {2, 3, 1, inactiv_init, inactiv_rhs};
+ODE_MODEL(progress_inactiv, inactiv_ode)
+
+static void competitive_rhs(const double c[], double t, const double x[],
+                            const double p[], double dxdt[], double *dfdx,
+                            double *dfdp)
+{
+    /* c[0] = [S0], c[1] = [I], x[0] = [P]
+     * p[0] = Vmax, p[1] = Km, p[2] = KIa */
+    double S = c[0] - x[0], inh = 1 + c[1]/p[2], D = p[1]*inh + S;
+    dxdt[0] = p[0]*S / D;
+    if (dfdx) {
+        dfdx[0] = -p[0]*p[1]*inh / (D*D);
+        dfdp[0] = S / D;
+        dfdp[1] = -dxdt[0]*inh / D;
+        dfdp[2] = dxdt[0]*p[1]*c[1] / (p[2]*p[2]*D);
+    }
+}
+
+static struct ode_model competitive_ode = {1, 3, 2, NULL, competitive_rhs};
+ODE_MODEL(progress_competitive, competitive_ode)
@@ -0,0 +1,70 @@
+#ifndef _PROGRESS_
+#include <ode.h>
+
+/* Progress curves: concentration of product along time, obtained by
+ * integration of the rate equations (see ode.h). The first independent
+ * variable is the time, and the rest are the constants of each curve. The
+ * observed state is the concentration of product P (P(0) = 0, S = S0 - P).
+ */
+
+double progress_michaelis(double X[], double p[]);
+double progress_michaelis_grad(double X[], double p[], double dyda[]);
+void progress_michaelis_batch(int n, double *X[], double p[], double y[],
+                              double *dyda);
+/* Michaelis-Menten, with substrate depletion
+ *
+ * Equation:
+ *           dP/dt = Vmax*(S0 - P) / (Km + S0 - P)
+ *
+ * Parameters:
+ *           X[2] -> {t, [S0]}
+ *           p[2] -> {Vmax, Km}
+ */
+
+double progress_prodinhib(double X[], double p[]);
+double progress_prodinhib_grad(double X[], double p[], double dyda[]);
+void progress_prodinhib_batch(int n, double *X[], double p[], double y[],
+                              double *dyda);
+/* Michaelis-Menten, with substrate depletion and competitive inhibition by
+ * the product
+ *
+ * Equation:
+ *           dP/dt = Vmax*S / (Km*(1 + P/Kp) + S),  S = S0 - P
+ *
+ * Parameters:
+ *           X[2] -> {t, [S0]}
+ *           p[3] -> {Vmax, Km, Kp}
+ */
+
+double progress_inactiv(double X[], double p[]);
+double progress_inactiv_grad(double X[], double p[], double dyda[]);
+void progress_inactiv_batch(int n, double *X[], double p[], double y[],
+                            double *dyda);
+/* Michaelis-Menten, with substrate depletion and first order inactivation of
+ * the enzyme (as michaelis_inactiv, integrated along time)
+ *
+ * Equation:
+ *           dP/dt = Vmax*E*S / (Km + S),  S = S0 - P
+ *           dE/dt = -kt*E,                E(0) = 1 (active fraction)
+ *
+ * Parameters:
+ *           X[2] -> {t, [S0]}
+ *           p[3] -> {Vmax, Km, kt}
+ */
+
+double progress_competitive(double X[], double p[]);
+double progress_competitive_grad(double X[], double p[], double dyda[]);
+void progress_competitive_batch(int n, double *X[], double p[], double y[],
+                                double *dyda);
+/* Michaelis-Menten, with substrate depletion and a competitive inhibitor
+ *
+ * Equation:
+ *           dP/dt = Vmax*S / (Km*(1 + I/KIa) + S),  S = S0 - P
+ *
+ * Parameters:
+ *           X[3] -> {t, [S0], [I]}
+ *           p[3] -> {Vmax, Km, KIa}
+ */
+
+#define _PROGRESS_
+#endif
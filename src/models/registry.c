@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <registry.h>
+#include <plugin.h>
+
+/* registry_init: builds a registry with the models of the array "builtin",
+ * whose end is marked by a model with a NULL function (see models.c). It
+ * might be NULL, to start with an empty registry.
+ *
+ * returns 0 on success, -1 if there is not enough memory
+ */
+int registry_init(struct registry *reg, struct model builtin[])
+{
+    int i;
+    reg->nmodels = reg->size = reg->nhandles = 0;
+    reg->models = NULL;
+    reg->handles = NULL;
+    reg->paths = NULL;
+    for (i = 0; builtin && builtin[i].function != NULL; i++) {
+        if (registry_add(reg, &builtin[i]) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/* find: binary search of a name. Returns the position of the model with that
+ * name, or -(position where it should be inserted) - 1 if there is none */
+static int find(struct registry *reg, const char *name)
+{
+    int lo = 0, hi = reg->nmodels - 1, mid, cmp;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        cmp = strcmp(reg->models[mid]->name, name);
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return -lo - 1;
+}
+
+/* registry_add: adds a model to the registry. If there is already a model
+ * with the same name, it is replaced (so that plugins may override the
+ * built-in models).
+ *
+ * returns 0 if the model has been added, 1 if it replaced another one, -1 if
+ * there is not enough memory
+ */
+int registry_add(struct registry *reg, struct model *model)
+{
+    struct model **tmp;
+    int pos = find(reg, model->name);
+    if (pos >= 0) {
+        reg->models[pos] = model;
+        return 1;
+    }
+    pos = -pos - 1;
+    if (reg->nmodels == reg->size) {
+        reg->size = reg->size ? 2*reg->size : 32;
+        if (!(tmp = realloc(reg->models, reg->size * sizeof(*tmp))))
+            return -1;
+        reg->models = tmp;
+    }
+    memmove(&reg->models[pos + 1], &reg->models[pos],
+            (reg->nmodels - pos) * sizeof(*reg->models));
+    reg->models[pos] = model;
+    reg->nmodels++;
+    return 0;
+}
+
+/* registry_load_plugin: loads the shared object "path" and adds its models
+ * (see plugin.h).
+ *
+ * returns the number of models added, or -1 on failure
+ */
+int registry_load_plugin(struct registry *reg, const char *path)
+{
+    void *handle, **tmp;
+    char **paths, *copy;
+    struct enzmc_plugin *plugin;
+    struct model *model;
+    int i;
+    if (!(handle = dlopen(path, RTLD_NOW | RTLD_LOCAL))) {
+        fprintf(stderr, "Error: cannot load plugin %s: %s\n", path, dlerror());
+        return -1;
+    }
+    if (!(plugin = dlsym(handle, ENZMC_PLUGIN_SYMBOL))) {
+        fprintf(stderr, "Error: %s is not an enzmc plugin (no symbol %s)\n",
+                path, ENZMC_PLUGIN_SYMBOL);
+        dlclose(handle);
+        return -1;
+    }
+    if (plugin->version != ENZMC_PLUGIN_VERSION ||
+        plugin->model_size != sizeof(struct model)) {
+        fprintf(stderr, "Error: plugin %s was built for version %d of the "
+                "plugin interface (this is version %d)\n", path,
+                plugin->version, ENZMC_PLUGIN_VERSION);
+        dlclose(handle);
+        return -1;
+    }
+    /* check the whole table before adding anything */
+    for (i = 0; i < plugin->nmodels; i++) {
+        model = &plugin->models[i];
+        if (!model->name || !model->function || model->nparams < 1 ||
+            model->nparams > MAX_PARAMS || model->nvars < 1 ||
+            model->nvars > MAX_INDEP) {
+            fprintf(stderr, "Error: plugin %s: invalid model number %d\n",
+                    path, i);
+            dlclose(handle);
+            return -1;
+        }
+    }
+    if ((tmp = realloc(reg->handles, (reg->nhandles + 1) * sizeof(*tmp))))
+        reg->handles = tmp;
+    if ((paths = realloc(reg->paths, (reg->nhandles + 1) * sizeof(*paths))))
+        reg->paths = paths;
+    if (!tmp || !paths || !(copy = strdup(path))) {
+        dlclose(handle);
+        return -1;
+    }
+    reg->handles[reg->nhandles] = handle;
+    reg->paths[reg->nhandles++] = copy;
+    for (i = 0; i < plugin->nmodels; i++) {
+        switch (registry_add(reg, &plugin->models[i])) {
+        case -1:
+            return -1;
+        case 1:
+            fprintf(stderr, "Warning: model %s replaced by the one in plugin "
+                    "%s\n", plugin->models[i].name, path);
+            break;
+        }
+    }
+    return plugin->nmodels;
+}
+
+/* registry_load_dir: loads every plugin (file ending in .so) found in the
+ * directory "dir", in alphabetical order.
+ *
+ * returns the number of models added, or -1 if the directory cannot be read
+ * or some plugin cannot be loaded
+ */
+int registry_load_dir(struct registry *reg, const char *dir)
+{
+    struct dirent **entries;
+    int i, n, len, ret, total = 0;
+    char *path;
+    if ((n = scandir(dir, &entries, NULL, alphasort)) < 0) {
+        fprintf(stderr, "Error: cannot read plugin directory %s\n", dir);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        len = strlen(entries[i]->d_name);
+        if (total >= 0 && len > 3 &&
+            !strcmp(entries[i]->d_name + len - 3, ".so")) {
+            path = malloc(strlen(dir) + len + 2);
+            sprintf(path, "%s/%s", dir, entries[i]->d_name);
+            ret = registry_load_plugin(reg, path);
+            total = ret < 0 ? -1 : total + ret;
+            free(path);
+        }
+        free(entries[i]);
+    }
+    free(entries);
+    return total;
+}
+
+/* registry_get: returns the model named "name", or NULL if there is none */
+struct model *registry_get(struct registry *reg, const char *name)
+{
+    int pos = find(reg, name);
+    return pos >= 0 ? reg->models[pos] : NULL;
+}
+
+/* registry_origin: returns the file of the plugin which the model comes
+ * from, or NULL if it is a built-in one */
+const char *registry_origin(struct registry *reg, struct model *model)
+{
+    struct enzmc_plugin *plugin;
+    int i;
+    for (i = 0; i < reg->nhandles; i++) {
+        plugin = dlsym(reg->handles[i], ENZMC_PLUGIN_SYMBOL);
+        if (model >= plugin->models &&
+            model < plugin->models + plugin->nmodels)
+            return reg->paths[i];
+    }
+    return NULL;
+}
+
+/* registry_free: frees the registry and unloads the plugins. The models
+ * obtained from it must not be used anymore */
+void registry_free(struct registry *reg)
+{
+    int i;
+    for (i = 0; i < reg->nhandles; i++) {
+        dlclose(reg->handles[i]);
+        free(reg->paths[i]);
+    }
+    free(reg->handles);
+    free(reg->paths);
+    free(reg->models);
+    reg->nmodels = reg->size = reg->nhandles = 0;
+    reg->models = NULL;
+    reg->handles = NULL;
+    reg->paths = NULL;
+}
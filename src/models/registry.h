@@ -0,0 +1,27 @@
+#ifndef __REGISTRY_H__
+#define __REGISTRY_H__
+
+#include <models.h>
+
+/* Set of available models: the built-in ones (models.c) plus the ones loaded
+ * from plugins (see plugin.h). Kept sorted by name to find them by binary
+ * search.
+ */
+struct registry {
+  int nmodels;             /* number of models */
+  int size;                /* allocated entries in models */
+  struct model **models;   /* models, sorted by name */
+  int nhandles;            /* number of plugins loaded */
+  void **handles;          /* handles of the plugins (dlopen) */
+  char **paths;            /* files of the plugins */
+};
+
+int registry_init(struct registry *reg, struct model builtin[]);
+int registry_add(struct registry *reg, struct model *model);
+int registry_load_plugin(struct registry *reg, const char *path);
+int registry_load_dir(struct registry *reg, const char *dir);
+struct model *registry_get(struct registry *reg, const char *name);
+const char *registry_origin(struct registry *reg, struct model *model);
+void registry_free(struct registry *reg);
+
+#endif /* __REGISTRY_H__ */
@@ -1,7 +1,13 @@
 #include <lvmrq.h>
 #include <random.h>
+#include <sobol.h>
 #include <stdio.h>
+#include <montecarlo.h>
 #include <matrix.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include <time.h>
 
 /* Input:
@@ -26,77 +32,608 @@
  *      5. Repetir pasos 2-4 N veces
  *      6. Calcular media y varianza
  *
+ * The simulations are split in blocks of MC_BLOCK simulations. The moments
+ * (means and covariances) of the parameters of each block are accumulated
+ * as the simulations are done (as Welford), and the blocks are merged (as
+ * Chan et al.) along a binary tree of the blocks: the one which ends second
+ * of two siblings merges them, and the one which merges the root finishes
+ * the run. The merges are always done in the same order, so the results are
+ * the same with any number of threads, and only the moments of the nodes
+ * waiting for their sibling are kept in memory. The tasks run by the threads are
+ * ranges of blocks: a task with more than one block gives the second half of
+ * its range to the pool (see pool.h) before running the first one, so that
+ * the threads with nothing to do may steal it. So the simulations of a run
+ * whose fits take long are shared by all the threads until the end.
+ *
+ * The sketches and histograms of the parameters (see sketch.h) do not
+ * depend on the order of the values, so each thread keeps its own ones
+ * (slots), and they are merged at the end.
+ *
+ * The blocks are also taken in groups of run->group blocks (the subtrees of
+ * a level of the tree), and the moments of each group are kept when it is
+ * merged, for the error of the results (see mc_options.mcerror): it is the
+ * spread of the results of the groups (as batch means), which are
+ * independent, as each group of Sobol points has its own scrambling and the
+ * antithetic pairs do not cross blocks.
+ *
+ * The results of a run only depend on the moments of the subtrees of its
+ * tree, which do not depend on the number of blocks (a subtree is merged in
+ * the same order in any tree), so the moments of some subtrees (struct
+ * mc_part) are the state of a run: another run goes on from it by placing
+ * them in its own tree as done, and running the rest of the blocks. The
+ * last block of a run might be partial; as the moments of a block are
+ * added one simulation at a time, a longer run goes on from the moments of
+ * that block as well. The state saved at the end of a run (mc_options.save)
+ * is made of the largest subtrees of its full blocks and its last partial
+ * block, whose moments are kept as they are merged. The state of a run which
+ * is not done yet (see mc_options.checkpoint) is made of the nodes of its
+ * tree which are done and wait for their siblings; while it is taken, the
+ * tree is locked.
+ *
+ * A run of a slice of the blocks (see mc_options.nshards) never fills the
+ * root of the tree: it is done once its blocks are, and its state is that
+ * of the nodes done then, none of which has blocks out of the slice. The
+ * parts of the states of all the slices are thus the state of the whole
+ * run, which only has to merge them.
  */
 
 #define abs(x) (x >= 0 ? x : -1*x)
 
-int montecarlo(double model(double X[], double p[]), /* model function */
+/* parts of a state, at most (one per bit of the number of blocks, and a
+ * partial block) */
+#define MAXPARTS 64
+
+/* Moments of the adjusted parameters of some simulations */
+struct moments {
+    int n;                      /* successful simulations */
+    double *mean;               /* mean[m] of the parameters */
+    double *comoment;           /* comoment[m][m]: sums of the products of
+                                 * their deviations from the means */
+};
+
+/* State of a run of simulations, freed once all its blocks are done */
+struct mc_run {
+    struct mc_problem problem;
+    struct mc_options opts;
+    int n, m, mfit, nblocks;
+    double dev;
+    double *params, *guess;     /* copies of those given to mc_start */
+    double *noise;              /* draws of the simulations, or NULL (see
+                                 * mc_options.noise)... */
+    int stride;                 /* ...and of each simulation in noise */
+    int *fit;
+    double *y;                  /* values of the model at the n points */
+    double *sig;                /* deviation of each point */
+    int nleaves;                /* blocks, rounded up to a power of 2 */
+    struct moments **nodes;     /* nodes[2*nleaves] of the tree of the blocks
+                                 * (node 1 is the root, node i has children
+                                 * 2i and 2i+1, and block b is node
+                                 * nleaves+b): moments of the node if it is
+                                 * done, or NULL (also if it is empty) */
+    int *arrived;               /* arrived[nleaves]: children of each node
+                                 * done (updated atomically) */
+    int group;                  /* blocks of each group, a power of 2 */
+    int ngroups;
+    double *groups;             /* groups[ngroups][1 + 2m]: successes, and
+                                 * means and CVs of the parameters of each
+                                 * group, or NULL (see mc_options.mcerror) */
+    int *todo;                  /* blocks to run, in order, if some were done
+                                 * by the state of opts.resume, or NULL */
+    int partial;                /* block partly done by opts.resume, or -1... */
+    struct moments *partial_mo; /* ...its moments... */
+    int partial_sims;           /* ...and simulations done */
+    int nfull;                  /* blocks with all their simulations */
+    int partial_kept;           /* whether a part with the last block (if
+                                 * it is partial) was kept (atomically) */
+    int lo, hi;                 /* blocks of the slice run */
+    int sharded;                /* whether they are not all the blocks... */
+    int left;                   /* ...and then, those not done yet (updated
+                                 * atomically) */
+    int total;                  /* simulations of the slice */
+    struct mc_part *parts;      /* parts of the state of opts.save, or NULL */
+    int nparts;                 /* (updated atomically) */
+    pthread_mutex_t lock;       /* protects the tree, with opts.checkpoint */
+    time_t next_checkpoint;     /* when to call opts.checkpoint again */
+    int checkpointing;          /* whether it is being called (updated
+                                 * atomically) */
+    int nslots;                 /* threads of the pool, plus the calling one */
+    struct sketch *quantiles;   /* quantiles[m*slot...] of each slot, or NULL */
+    struct histogram *hists;    /* hists[m*slot...] of each slot, or NULL */
+    /* updated atomically by the threads: */
+    int done_sims;              /* simulations done */
+    int failed;                 /* whether a block failed */
+    mc_done done;
+    void *arg;
+};
+
+/* argument of a task: the blocks lo+first...lo+last-1 of a run (or those of
+ * run->todo) */
+struct mc_range {
+    struct mc_run *run;
+    int first, last;
+};
+
+static void run_block(struct mc_run *run, int b, int slot);
+static void range_task(void *arg, int thread);
+static void block_done(struct mc_run *run, int b, struct moments *mo);
+static void node_done(struct mc_run *run, int node, struct moments *mo);
+static void checkpoint(struct mc_run *run);
+static void shard_finish(struct mc_run *run);
+static int compare_parts(const void *a, const void *b);
+static int resume(struct mc_run *run, struct mc_state *st);
+static void finish(struct mc_run *run, struct moments *mo);
+static void free_run(struct mc_run *run);
+
+/* moments_new: returns empty moments of m parameters, or NULL if there is
+ * not enough memory */
+static struct moments *moments_new(int m)
+{
+    struct moments *mo = malloc(sizeof(struct moments));
+    if (mo == NULL)
+        return NULL;
+    mo->n = 0;
+    mo->mean = calloc(m, sizeof(double));
+    mo->comoment = calloc(m * m, sizeof(double));
+    if (!mo->mean || !mo->comoment) {
+        free(mo->mean);
+        free(mo->comoment);
+        free(mo);
+        return NULL;
+    }
+    return mo;
+}
+
+static void moments_free(struct moments *mo)
+{
+    if (mo == NULL)
+        return;
+    free(mo->mean);
+    free(mo->comoment);
+    free(mo);
+}
+
+/* moments_of: returns new moments of m parameters with the values given, or
+ * NULL if there is not enough memory */
+static struct moments *moments_of(int m, int n, double mean[],
+                                  double comoment[])
+{
+    struct moments *mo = moments_new(m);
+    if (mo == NULL)
+        return NULL;
+    mo->n = n;
+    vcopy(m, mo->mean, mean);
+    vcopy(m * m, mo->comoment, comoment);
+    return mo;
+}
+
+/* moments_add: adds the parameters x[m] of a simulation */
+static void moments_add(struct moments *mo, int m, double x[m])
+{
+    double d[m];
+    int j, k;
+    mo->n++;
+    for (j = 0; j < m; j++) {
+        d[j] = x[j] - mo->mean[j];
+        mo->mean[j] += d[j] / mo->n;
+    }
+    for (j = 0; j < m; j++)
+        for (k = 0; k < m; k++)
+            mo->comoment[j*m + k] += d[j] * (x[k] - mo->mean[k]);
+}
+
+/* moments_merge: adds the moments of b to those of a */
+static void moments_merge(struct moments *a, struct moments *b, int m)
+{
+    double d[m], f;
+    int j, k, n = a->n + b->n;
+    if (b->n == 0)
+        return;
+    f = (double) a->n * b->n / n;
+    for (j = 0; j < m; j++)
+        d[j] = b->mean[j] - a->mean[j];
+    for (j = 0; j < m; j++) {
+        a->mean[j] += d[j] * b->n / n;
+        for (k = 0; k < m; k++)
+            a->comoment[j*m + k] += b->comoment[j*m + k] + d[j] * d[k] * f;
+    }
+    a->n = n;
+}
+
+/* what montecarlo waits for */
+struct mc_wait {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int finished;
+    int nsuccess;
+    int m;
+    double *params_mean, *variances;
+};
+
+static void wait_done(void *arg, int nsuccess, double params_mean[],
+                      double variances[])
+{
+    struct mc_wait *w = arg;
+    pthread_mutex_lock(&w->lock);
+    if (nsuccess >= 0) {
+        vcopy(w->m, w->params_mean, params_mean);
+        vcopy(w->m, w->variances, variances);
+    }
+    w->nsuccess = nsuccess;
+    w->finished = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/* montecarlo: runs opts->nsims simulations (see mc_start), and waits for them
+ * to finish.
+ *
+ * returns the number of successful adjustments (params_mean and variances
+ * hold the mean of the adjusted parameters and of the squares of their
+ * deviations from the real values), or -1 on failure
+ */
+int montecarlo(struct mc_problem *problem, /* what to simulate */
                 double params[], /* real value of the parameters */
                 double guess[], /* guess of the parameters */
                 double dev, /* an estimation of the deviation */
-                int nsims, /* number of simulations */
-                int n, /* number of points */
-                int nvars, /* number of independent variables of the model */
                 int m, /* number of parameters of the model */
                 int mfit, /* number of adjustable parameters */
                 int fit[m], /* ptr to array which indicates what parameters
                               * will be adjusted (fit[i] = 1) and what ones
                               * will be fixed (fit[i] = 0) */
-                double *xi[nvars], /* data points (indep. variables) */
-                double *params_mean,
-                double *variances,
-                FILE *fp)
-{
-    int i, j, nsuccess, niters, skip;
-    long seed;
-    double y[n]; /* dependent variable values at the n given points */
-    double yi[n]; /* same, with error added */
+                struct mc_options *opts, /* how to run the simulations */
+                double params_mean[m],
+                double variances[m])
+{
+    struct mc_wait w = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                        0, -1, m, params_mean, variances};
+    if (mc_start(problem, params, guess, dev, m, mfit, fit, opts, wait_done,
+                 &w))
+        return -1;
+    pthread_mutex_lock(&w.lock);
+    while (!w.finished)
+        pthread_cond_wait(&w.cond, &w.lock);
+    pthread_mutex_unlock(&w.lock);
+    if (opts->progress)
+        printf("\rRunning simulations: 100%%\n");
+    return w.nsuccess;
+}
+
+/* mc_start: starts the simulations of a problem in the threads of
+ * opts->pool, and returns without waiting for them. Once they are done,
+ * done(arg, ...) is called with the results (from the thread which ran the
+ * last block). The problem (model and dataset) must not be freed before
+ * that, but params, guess, fit and opts are copied.
+ *
+ * returns 0 if the simulations were started, or -1 on failure (then done is
+ * not called)
+ */
+int mc_start(struct mc_problem *problem, double params[], double guess[],
+             double dev, int m, int mfit, int fit[m],
+             struct mc_options *opts, mc_done done, void *arg)
+{
+    struct gfit *global = problem->global;
+    struct dataset *data = problem->data;
+    struct model *model = problem->model;
+    struct mc_run *run;
+    struct mc_range *range;
+    int n = global ? global->npoints : data->n;
+    int i, b, torun, sharded;
+    int nblocks = (opts->nsims + MC_BLOCK - 1) / MC_BLOCK;
+    int *todo;
+
+    if (!(run = calloc(1, sizeof(struct mc_run))))
+        goto nomem;
+    run->problem = *problem;
+    run->opts = *opts;
+    if (opts->checkpoint) {
+        pthread_mutex_init(&run->lock, NULL);
+        run->next_checkpoint = time(NULL) + opts->checkpoint_secs;
+    }
+    run->n = n;
+    run->m = m;
+    run->mfit = mfit;
+    run->dev = dev;
+    if (opts->noise && opts->noise->seed == opts->seed &&
+        opts->noise->nsims == opts->nsims && opts->noise->n >= n) {
+        run->noise = opts->noise->draws;
+        run->stride = opts->noise->n;
+    }
+    run->nblocks = nblocks;
+    for (run->nleaves = 1; run->nleaves < nblocks; run->nleaves *= 2)
+        ;
+    for (run->group = 1; run->group * 2 * MC_GROUPS <= nblocks; run->group *= 2)
+        ;
+    run->ngroups = (nblocks + run->group - 1) / run->group;
+    run->nfull = opts->nsims / MC_BLOCK;
+    run->partial = -1;
+    run->lo = 0;
+    run->hi = nblocks;
+    if (opts->nshards > 1) {
+        run->lo = (long) opts->shard * nblocks / opts->nshards;
+        run->hi = (long) (opts->shard + 1) * nblocks / opts->nshards;
+    }
+    run->sharded = run->hi - run->lo < nblocks;
+    run->total = ((long) run->hi * MC_BLOCK < opts->nsims ?
+                  run->hi * MC_BLOCK : opts->nsims) - run->lo * MC_BLOCK;
+    if (opts->sampling == MC_SOBOL && n > SOBOL_MAXDIM) {
+        fprintf(stderr, "Error: Sobol sampling is only available for up to %d "
+                "points.\n", SOBOL_MAXDIM);
+        free(run);
+        return -1;
+    }
+    run->done = done;
+    run->arg = arg;
+    run->params = malloc(m * sizeof(double));
+    run->guess = malloc(m * sizeof(double));
+    run->fit = malloc(m * sizeof(int));
+    /* the arrays of points are kept in the heap, as there might be many */
+    run->y = malloc(n * sizeof(double));
+    run->sig = malloc(n * sizeof(double));
+    run->nodes = calloc(2 * run->nleaves, sizeof(struct moments *));
+    run->arrived = calloc(run->nleaves, sizeof(int));
+    if (opts->mcerror)
+        run->groups = calloc((size_t) run->ngroups * (1 + 2*m),
+                             sizeof(double));
+    /* a part per bit of the number of full blocks, and the last block */
+    if (opts->save) {
+        memset(opts->save, 0, sizeof(struct mc_state));
+        run->parts = calloc(MAXPARTS, sizeof(struct mc_part));
+    }
+    if (!run->params || !run->guess || !run->fit || !run->y || !run->sig ||
+        !run->nodes || !run->arrived || (opts->mcerror && !run->groups) ||
+        (opts->save && !run->parts))
+        goto nomem;
+    /* the nodes whose second child is empty only wait for the first one */
+    for (i = 1; i < run->nleaves; i++) {
+        for (b = 2*i + 1; b < run->nleaves; b *= 2)
+            ;
+        if (b - run->nleaves >= nblocks)
+            run->arrived[i] = 1;
+    }
+    run->nslots = opts->pool ? pool_size(opts->pool) + 1 : 1;
+    if (opts->quantiles) {
+        if (!(run->quantiles = malloc(run->nslots * m * sizeof(struct sketch))))
+            goto nomem;
+        for (i = 0; i < run->nslots * m; i++)
+            sketch_init(&run->quantiles[i], opts->quantiles[i % m].alpha);
+    }
+    if (opts->hists) {
+        if (!(run->hists = calloc(run->nslots * m, sizeof(struct histogram))))
+            goto nomem;
+        for (i = 0; i < run->nslots * m; i++) {
+            if (hist_init(&run->hists[i], opts->hists[i % m].nbins,
+                          opts->hists[i % m].origin,
+                          opts->hists[i % m].width0))
+                goto nomem;
+        }
+    }
+    vcopy(m, run->params, params);
+    vcopy(m, run->guess, guess);
+    for (i = 0; i < m; i++)
+        run->fit[i] = fit[i];
+    /* the models without batch version need the rows of the points */
+    if (global != NULL) {
+        for (i = 0; i < global->nsets; i++) {
+            if (!global->sets[i].model->batch &&
+                dataset_rows(global->sets[i].data))
+                goto nomem;
+        }
+    } else if (!model->batch && dataset_rows(data)) {
+        goto nomem;
+    }
+    /* build array of y values and array of deviations */
+    if (global != NULL) {
+        gfit_eval(global, params, run->y);
+    } else if (model->batch != NULL) {
+        model->batch(n, data->cols, params, run->y, NULL);
+    } else {
+        for (i = 0; i < n; i++) {
+            run->y[i] = model->function(data->x[i], params);
+        }
+    }
+    for (i = 0; i < n; i++) {
+        run->sig[i] = dev;
+    }
+    if (opts->fp != NULL) {
+        fprintf(opts->fp, "y = ");
+        vector_printf(opts->fp, n, run->y);
+    }
+    if (nblocks == 0) {
+        finish(run, NULL);
+        return 0;
+    }
+    /* the parts of the state are done at once; if there are no other
+     * blocks, the last one finishes the run */
+    run->left = torun = run->hi - run->lo;
+    sharded = run->sharded;
+    if (opts->resume && (torun = resume(run, opts->resume)) < 0)
+        return -1;
+    /* a slice whose blocks are all done is finished here; a whole run, by
+     * the last part of the state (which frees it) */
+    if (torun == 0) {
+        if (sharded)
+            shard_finish(run);
+        return 0;
+    }
+    todo = run->todo;
+    /* with debug output, the simulations are printed in order */
+    if (opts->pool == NULL || opts->fp != NULL) {
+        for (b = 0; b < torun; b++)
+            run_block(run, todo ? todo[b] : run->lo + b, run->nslots - 1);
+        return 0;
+    }
+    /* a task with all the blocks, which is split by the threads; if it
+     * cannot be submitted, it is run here */
+    if (!(range = malloc(sizeof(struct mc_range)))) {
+        for (b = 0; b < torun; b++)
+            run_block(run, todo ? todo[b] : run->lo + b, run->nslots - 1);
+        return 0;
+    }
+    range->run = run;
+    range->first = 0;
+    range->last = torun;
+    if (pool_submit(opts->pool, range_task, range))
+        range_task(range, run->nslots - 1);
+    return 0;
+
+nomem:
+    fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+    if (run)
+        free_run(run);
+    return -1;
+}
+
+/* range_task: runs the blocks of a range, after giving the second half of
+ * the range (while it has more than one block) to the pool. "thread" is the
+ * slot of the thread running it.
+ */
+static void range_task(void *arg, int thread)
+{
+    struct mc_range *range = arg, *half;
+    struct mc_run *run = range->run;
+    int b, first = range->first, last = range->last, mid;
+    while (last - first > 1) {
+        if (!(half = malloc(sizeof(struct mc_range))))
+            break;
+        mid = (first + last) / 2;
+        half->run = run;
+        half->first = mid;
+        half->last = last;
+        /* another thread might take (and free) half at once */
+        if (pool_submit(run->opts.pool, range_task, half)) {
+            free(half);
+            break;
+        }
+        last = mid;
+    }
+    free(range);
+    /* the run is freed once its last block is done */
+    for (b = first; b < last; b++)
+        run_block(run, run->todo ? run->todo[b] : run->lo + b, thread);
+}
+
+/* run_block: runs the simulations of block b in the thread of a slot, and
+ * adds their moments to the tree of the blocks (see block_done).
+ */
+static void run_block(struct mc_run *run, int b, int slot)
+{
+    struct mc_problem *problem = &run->problem;
+    struct gfit *global = problem->global;
+    struct model *model = problem->model;
+    FILE *fp = run->opts.fp;
+    int n = run->n, m = run->m, mfit = run->mfit, nsims = run->opts.nsims;
+    int first = b * MC_BLOCK, last = first + MC_BLOCK;
+    int i, j, niters, skip, done;
+    double *params = run->params;
+    struct moments *mo;
+    double *yi; /* y values, with error added */
     double params_guess[m];
-    double sig[n];
-    double *sigp[n];
+    double *sigp[1] = {run->sig};
     double covar[mfit][mfit];
+    double var[m]; /* variances of the adjusted parameters */
     double results[2];
-    /* build array of y values and array of deviations */
-    for (i = 0; i < n; i++) {
-        y[i] = model(xi[i], params);
-        sig[i] = dev;
+    double cov[m][m]; /* covar, in the order of the parameters */
+    int adj[mfit];    /* position of each adjustable parameter */
+    struct rng rng;
+    struct mc_sim sim;
+    struct sobol sobol;
+    double u[n];      /* a Sobol point */
+    int sampling = run->opts.sampling, pair;
+    double sign;
+
+    if (last > nsims)
+        last = nsims;
+    if (sampling == MC_SOBOL) {
+        /* the points of the group, from its first one */
+        rng_seed(&rng, run->opts.seed, b / run->group);
+        sobol_init(&sobol, n, &rng);
+    }
+    for (i = j = 0; i < m; i++) {
+        if (run->fit[i])
+            adj[j++] = i;
     }
-    *sigp = sig;
-    for (i = 0; i < m; i++) {
-        params_mean[i] = variances[i] = 0;
+    /* the block partly done by the state goes on from its moments */
+    if (b == run->partial) {
+        first += run->partial_sims;
+        mo = run->partial_mo;
+        run->partial_mo = NULL;
+    } else {
+        mo = moments_new(m);
     }
-    if (fp != NULL) {
-        fprintf(fp, "y = ");
-        vector_printf(fp, n, y);
+    if (!mo || !(yi = malloc(n * sizeof(double)))) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+        __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+        goto end;
     }
-    seed = time(NULL); /* set seed */
-    for (i = nsuccess = 0; i < nsims; i++) {
-        printf("\rRunning simulations: %d%%",  i*100 / nsims);
+    for (i = first; i < last; i++) {
+        if (run->opts.cancel &&
+            __atomic_load_n(run->opts.cancel, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
         if (fp != NULL)
             fprintf(fp, "\n- Sim. num. %d\n", i);
         /* add error */
-        for (j = 0; j < n; j++) {
-            yi[j] = y[j] + boxmuller(&seed) * dev;
+        pair = sampling == MC_ANTITHETIC ? i / 2 : i;
+        sign = sampling == MC_ANTITHETIC && i % 2 ? -1 : 1;
+        if (sampling == MC_SOBOL) {
+            sobol_point(&sobol, i - b / run->group * run->group * MC_BLOCK, u);
+            for (j = 0; j < n; j++)
+                yi[j] = run->y[j] + normal_quantile(u[j]) * run->dev;
+        } else if (run->noise) {
+            for (j = 0; j < n; j++)
+                yi[j] = run->y[j] + sign * run->dev *
+                                    run->noise[(size_t) pair*run->stride + j];
+        } else {
+            rng_seed(&rng, run->opts.seed, pair);
+            for (j = 0; j < n; j++)
+                yi[j] = run->y[j] + sign * rng_gauss(&rng) * run->dev;
         }
         if (fp != NULL) {
             fprintf(fp, "yi = ");
             vector_printf(fp, n, yi);
         }
-        vcopy(m, params_guess, guess); /* original guess array */
-        niters = lvmrq(n, m, mfit, nvars, xi, yi, params_guess, fit, model, covar, sigp, results);
+        vcopy(m, params_guess, run->guess); /* original guess array */
+        if (global != NULL) {
+            niters = gfit_lvmrq(global, yi, params_guess, run->fit, run->sig,
+                                var, results);
+        } else {
+            niters = lvmrq(m, mfit, problem->data, yi, params_guess, run->fit,
+                           model->function, model->gradient, model->batch,
+                           covar, sigp, results);
+            /* lvmrq gives them with the adjustable parameters first */
+            for (j = 0; j < m * m; j++)
+                cov[j / m][j % m] = 0;
+            for (j = 0; j < mfit * mfit; j++)
+                cov[adj[j / mfit]][adj[j % mfit]] = covar[j / mfit][j % mfit];
+            for (j = 0; j < m; j++)
+                var[j] = cov[j][j];
+        }
         /* Check whether the result is valid. A large variance (in the
          * covariance matrix) indicates that something went wrong */
-        skip = 0;
+        skip = niters < 0;
         for (j = 0; j < m; j++)
-            if (covar[j][j] > 10*params[j] || abs(params_guess[j]) > 100*abs(params[j]))
+            if (var[j] > 10*params[j] || abs(params_guess[j]) > 100*abs(params[j]))
                 skip = 1;
+        if (run->opts.record != NULL) {
+            sim.sim = i;
+            sim.status = niters < 0 ? MC_FAILED : skip ? MC_REJECTED : MC_OK;
+            sim.iters = niters;
+            sim.chisq = results[0];
+            sim.params = params_guess;
+            sim.var = var;
+            sim.covar = global == NULL && niters >= 0 ? &cov[0][0] : NULL;
+            run->opts.record(run->opts.record_arg, &sim);
+        }
         if (skip)
             continue;
-        nsuccess++;
+        moments_add(mo, m, params_guess);
         for (j = 0; j < m; j++) {
-            params_mean[j] += params_guess[j]; /* add new value */
-            variances[j] += (params_guess[j] - params[j])*
-                            (params_guess[j] - params[j]);
+            if (run->quantiles &&
+                sketch_add(&run->quantiles[slot*m + j], params_guess[j]))
+                __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+            if (run->hists)
+                hist_add(&run->hists[slot*m + j], params_guess[j]);
         }
         if (fp != NULL) {
             fprintf(fp, "- Number of iterations:  %d\n", niters);
@@ -104,14 +641,487 @@ int montecarlo(double model(double X[], double p[]), /* model function */
             vector_printf(fp, m, params_guess);
             fprintf(fp, "- Chi2: %.4e\n", results[0]);
             fprintf(fp, "- Chi2(niters) - Chi2(niters-1):  %.4e\n", results[1]);
-            fprintf(fp, "- Matrix of covariances:\n");
-            mfprint(fp, mfit, mfit, covar);
+            if (global != NULL) {
+                fprintf(fp, "- Variances:\n");
+                vector_printf(fp, m, var);
+            } else {
+                fprintf(fp, "- Matrix of covariances:\n");
+                mfprint(fp, mfit, mfit, covar);
+            }
+        }
+    }
+    free(yi);
+
+end:
+    done = __atomic_add_fetch(&run->done_sims, last - first, __ATOMIC_RELAXED);
+    if (run->opts.progress && done * 100L / run->total >
+                              (done - (last - first)) * 100L / run->total)
+        printf("\rRunning simulations: %ld%%", done * 100L / run->total);
+    block_done(run, b, mo);
+}
+
+/* group_done: keeps the results of the moments of a group (see
+ * run->groups), once all its blocks are merged */
+static void group_done(struct mc_run *run, int g, struct moments *mo)
+{
+    int m = run->m, j, n = mo ? mo->n : 0;
+    double *res = &run->groups[(size_t) g * (1 + 2*m)], bias;
+    res[0] = n;
+    for (j = 0; n && j < m; j++) {
+        bias = mo->mean[j] - run->params[j];
+        res[1 + j] = mo->mean[j];
+        res[1 + m + j] = 100 * sqrt(mo->comoment[j*m + j] / n + bias * bias) /
+                         mo->mean[j];
+    }
+}
+
+/* set_part: sets a part to a copy of the moments of a node of the tree.
+ * returns 0, or -1 if there is not enough memory */
+static int set_part(struct mc_run *run, struct mc_part *part, int node,
+                    struct moments *mo)
+{
+    int m = run->m, first = node, size = 1, nsims = run->opts.nsims;
+    while (first < run->nleaves) {
+        first *= 2;
+        size *= 2;
+    }
+    first -= run->nleaves;
+    part->first = first;
+    part->nblocks = size;
+    part->nsims = ((long) first + size) * MC_BLOCK < nsims ?
+                  size * MC_BLOCK : nsims - first * MC_BLOCK;
+    part->n = mo ? mo->n : 0;
+    part->mean = malloc(m * sizeof(double));
+    part->comoment = malloc(m * m * sizeof(double));
+    if (!part->mean || !part->comoment) {
+        fprintf(stderr, "Error: not enough memory for the state of a run.\n");
+        return -1;
+    }
+    if (mo) {
+        vcopy(m, part->mean, mo->mean);
+        vcopy(m * m, part->comoment, mo->comoment);
+    } else {
+        memset(part->mean, 0, m * sizeof(double));
+        memset(part->comoment, 0, m * m * sizeof(double));
+    }
+    return 0;
+}
+
+/* keep_part: keeps a copy of the moments of a node of the tree as a part of
+ * the state of opts.save, if it is one (see mc_part): the largest subtrees
+ * of the full blocks, and the first node kept with the last block, if it is
+ * partial (the block itself, unless it was placed by the state of
+ * opts.resume inside a larger one) */
+static void keep_part(struct mc_run *run, int node, struct moments *mo)
+{
+    struct mc_part *part;
+    int first = node, size = 1, last;
+    while (first < run->nleaves) {
+        first *= 2;
+        size *= 2;
+    }
+    first -= run->nleaves;
+    last = first + size;
+    if (last <= run->nfull) {
+        if (node > 1 && first / (2*size) * (2*size) + 2*size <= run->nfull)
+            return;
+    } else if (first > run->nfull || run->nfull == run->nblocks ||
+               __atomic_exchange_n(&run->partial_kept, 1, __ATOMIC_RELAXED)) {
+        return;
+    }
+    part = &run->parts[__atomic_fetch_add(&run->nparts, 1, __ATOMIC_RELAXED)];
+    if (set_part(run, part, node, mo))
+        __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+}
+
+/* shard_finish: finishes the run of a slice of the blocks, once they are
+ * all done, with the moments of the nodes done, merged in order, which are
+ * the parts of its state (see mc_options.nshards) */
+static void shard_finish(struct mc_run *run)
+{
+    struct moments *mo = NULL, *next;
+    int b, node, found, size;
+    for (b = 0; b < run->nleaves; b += size) {
+        /* the largest node done of those starting at block b */
+        for (node = run->nleaves + b, found = 0; node > 1; node /= 2) {
+            if (run->nodes[node])
+                found = node;
+            if (node & 1)
+                break;
         }
+        for (size = 1, node = found; found && node < run->nleaves; node *= 2)
+            size *= 2;
+        if (!found)
+            continue;
+        next = run->nodes[found];
+        run->nodes[found] = NULL;
+        if (run->parts && set_part(run, &run->parts[run->nparts++], found,
+                                   next))
+            run->failed = 1;
+        if (mo == NULL) {
+            mo = next;
+        } else {
+            moments_merge(mo, next, run->m);
+            moments_free(next);
+        }
+    }
+    finish(run, mo);
+}
+
+/* checkpoint: calls opts.checkpoint with the state of the nodes of the tree
+ * which are done, if it is time to and it is not being called already */
+static void checkpoint(struct mc_run *run)
+{
+    struct mc_state st;
+    struct moments *mo;
+    int i, n;
+    if (time(NULL) < __atomic_load_n(&run->next_checkpoint, __ATOMIC_RELAXED) ||
+        __atomic_exchange_n(&run->checkpointing, 1, __ATOMIC_ACQUIRE))
+        return;
+    memset(&st, 0, sizeof(st));
+    st.seed = run->opts.seed;
+    st.sampling = run->opts.sampling;
+    st.m = run->m;
+    st.nsims = run->opts.nsims;
+    pthread_mutex_lock(&run->lock);
+    for (i = 2, n = 0; i < 2 * run->nleaves; i++)
+        n += run->nodes[i] != NULL;
+    if (!(st.parts = calloc(n ? n : 1, sizeof(struct mc_part)))) {
+        fprintf(stderr, "Error: not enough memory for the state of a run.\n");
+        goto nomem;
     }
-    printf("\rRunning simulations: 100%%\n");
-    for (i = 0; i < m; i++) {
-        params_mean[i] /= nsuccess;
-        variances[i] /= nsuccess;
+    for (i = 2; i < 2 * run->nleaves; i++) {
+        if ((mo = run->nodes[i]) &&
+            set_part(run, &st.parts[st.nparts++], i, mo))
+            goto nomem;
     }
-    return nsuccess;
+    pthread_mutex_unlock(&run->lock);
+    qsort(st.parts, st.nparts, sizeof(struct mc_part), compare_parts);
+    run->opts.checkpoint(run->opts.checkpoint_arg, &st);
+    goto end;
+
+nomem:
+    pthread_mutex_unlock(&run->lock);
+end:
+    mc_state_free(&st);
+    __atomic_store_n(&run->next_checkpoint,
+                     time(NULL) + run->opts.checkpoint_secs, __ATOMIC_RELAXED);
+    __atomic_store_n(&run->checkpointing, 0, __ATOMIC_RELEASE);
+}
+
+/* block_done: sets the moments of block b (NULL if it failed) in the tree
+ * of the blocks (see node_done) */
+static void block_done(struct mc_run *run, int b, struct moments *mo)
+{
+    int sharded = run->sharded;
+    /* before the block is set, as the last one frees the run */
+    if (run->opts.checkpoint)
+        checkpoint(run);
+    node_done(run, run->nleaves + b, mo);
+    /* the tree of a slice is never filled */
+    if (sharded && __atomic_sub_fetch(&run->left, 1, __ATOMIC_ACQ_REL) == 0)
+        shard_finish(run);
+}
+
+/* node_done: sets the moments of a node of the tree of the blocks which is
+ * done, and goes up the tree while the sibling of the node is done, merging
+ * them. Calls finish with the moments of all the blocks once the root is
+ * done.
+ */
+static void node_done(struct mc_run *run, int node, struct moments *mo)
+{
+    struct moments *sib;
+    int top = run->nleaves / run->group;
+    if (run->opts.checkpoint)
+        pthread_mutex_lock(&run->lock);
+    while (node > 1) {
+        if (run->groups && node >= top && node < 2 * top)
+            group_done(run, node - top, mo);
+        if (run->parts && !run->sharded)
+            keep_part(run, node, mo);
+        __atomic_store_n(&run->nodes[node], mo, __ATOMIC_RELEASE);
+        if (__atomic_fetch_add(&run->arrived[node / 2], 1,
+                               __ATOMIC_ACQ_REL) == 0) {
+            if (run->opts.checkpoint)
+                pthread_mutex_unlock(&run->lock);
+            return; /* the sibling will merge them */
+        }
+        sib = __atomic_exchange_n(&run->nodes[node ^ 1], NULL,
+                                  __ATOMIC_ACQUIRE);
+        run->nodes[node] = NULL;
+        /* the moments of the first child come first */
+        if (node & 1) {
+            struct moments *t = mo;
+            mo = sib;
+            sib = t;
+        }
+        if (mo == NULL) {
+            mo = sib;
+        } else if (sib != NULL) {
+            moments_merge(mo, sib, run->m);
+            moments_free(sib);
+        }
+        node /= 2;
+    }
+    if (run->groups && top == 1)
+        group_done(run, 0, mo);
+    if (run->parts)
+        keep_part(run, 1, mo);
+    if (run->opts.checkpoint)
+        pthread_mutex_unlock(&run->lock);
+    finish(run, mo);
+}
+
+/* mc_error: sets run->opts.mcerror to the standard errors of the means and
+ * CVs of the parameters (means and variances, as those of montecarlo), from
+ * the spread of those of the groups around them, weighted by their
+ * successes */
+static void mc_error(struct mc_run *run, double means[], double variances[])
+{
+    int m = run->m, g, j, k = 0, n = 0;
+    double *res, d, cv, sum[2*m];
+    for (j = 0; j < 2*m; j++)
+        sum[j] = 0;
+    for (g = 0; g < run->ngroups; g++) {
+        res = &run->groups[(size_t) g * (1 + 2*m)];
+        if (res[0] == 0)
+            continue;
+        k++;
+        n += res[0];
+        for (j = 0; j < m; j++) {
+            cv = 100 * sqrt(variances[j]) / means[j];
+            d = res[1 + j] - means[j];
+            sum[j] += res[0] * d * d;
+            d = res[1 + m + j] - cv;
+            sum[m + j] += res[0] * d * d;
+        }
+    }
+    for (j = 0; j < 2*m; j++)
+        run->opts.mcerror[j] = k > 1 ? sqrt(sum[j] / ((k - 1) * (double) n)) :
+                                       NAN;
+}
+
+static int compare_parts(const void *a, const void *b)
+{
+    const struct mc_part *x = a, *y = b;
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+/* finish: calls run->done with the results of the moments of all the
+ * blocks (NULL if there are none), and frees the run.
+ */
+static void finish(struct mc_run *run, struct moments *mo)
+{
+    int m = run->m;
+    int b, j, k, nsuccess = mo ? mo->n : 0;
+    double params_mean[m], variances[m], bias;
+    for (j = 0; j < m; j++) {
+        /* the mean of the squares of the deviations from the real value is
+         * the variance plus the square of the bias */
+        bias = nsuccess ? mo->mean[j] - run->params[j] : NAN;
+        params_mean[j] = nsuccess ? mo->mean[j] : NAN;
+        variances[j] = nsuccess ? mo->comoment[j*m + j] / nsuccess +
+                                  bias * bias : NAN;
+    }
+    if (run->opts.covariance) {
+        for (j = 0; j < m; j++)
+            for (k = 0; k < m; k++)
+                run->opts.covariance[j*m + k] =
+                    nsuccess ? mo->comoment[j*m + k] / nsuccess : NAN;
+    }
+    moments_free(mo);
+    if (run->opts.mcerror)
+        mc_error(run, params_mean, variances);
+    /* the sketches and histograms of the slots */
+    for (b = 0; b < run->nslots; b++) {
+        for (j = 0; j < m; j++) {
+            if (run->quantiles && sketch_merge(&run->opts.quantiles[j],
+                                               &run->quantiles[b*m + j]))
+                run->failed = 1;
+            if (run->hists)
+                hist_merge(&run->opts.hists[j], &run->hists[b*m + j]);
+        }
+    }
+    if (run->parts && !run->failed) {
+        qsort(run->parts, run->nparts, sizeof(struct mc_part), compare_parts);
+        run->opts.save->seed = run->opts.seed;
+        run->opts.save->sampling = run->opts.sampling;
+        run->opts.save->m = m;
+        run->opts.save->nsims = run->opts.nsims;
+        run->opts.save->nparts = run->nparts;
+        run->opts.save->parts = run->parts;
+        run->parts = NULL;
+    }
+    run->done(run->arg, run->failed ? -1 : nsuccess, params_mean, variances);
+    free_run(run);
+}
+
+static void free_run(struct mc_run *run)
+{
+    int i;
+    for (i = 0; run->parts && i < run->nparts; i++) {
+        free(run->parts[i].mean);
+        free(run->parts[i].comoment);
+    }
+    free(run->parts);
+    free(run->todo);
+    if (run->opts.checkpoint)
+        pthread_mutex_destroy(&run->lock);
+    moments_free(run->partial_mo);
+    for (i = 0; run->quantiles && i < run->nslots * run->m; i++)
+        sketch_free(&run->quantiles[i]);
+    for (i = 0; run->hists && i < run->nslots * run->m; i++)
+        hist_free(&run->hists[i]);
+    free(run->quantiles);
+    free(run->hists);
+    free(run->groups);
+    free(run->params);
+    free(run->guess);
+    free(run->fit);
+    free(run->y);
+    free(run->sig);
+    for (i = 0; run->nodes && i < 2 * run->nleaves; i++)
+        moments_free(run->nodes[i]);
+    free(run->nodes);
+    free(run->arrived);
+    free(run);
+}
+
+/* resume: places the parts of a state (see mc_options.resume) in the tree of
+ * the blocks of a run, as done, unless the run cannot go on from it. A part
+ * is taken if it has all the simulations of its blocks in the run, and
+ * they are in its slice; if not, but it is a single block, the block goes
+ * on from its moments.
+ *
+ * returns the number of blocks left to run (all those of the slice if the
+ * state is not used), 0 if there are none (a whole run is then finished
+ * and freed), or -1 if there is not enough memory (the run is freed)
+ */
+static int resume(struct mc_run *run, struct mc_state *st)
+{
+    struct mc_options *opts = &run->opts;
+    struct mc_part *part;
+    struct moments **mos;
+    int i, b, k, nblocks = run->nblocks, torun = run->hi - run->lo, end = 0;
+    long last;
+    if (st->seed != opts->seed || st->sampling != opts->sampling ||
+        st->m != run->m || st->nsims > opts->nsims || opts->quantiles ||
+        opts->hists || opts->mcerror || opts->record || opts->fp ||
+        (opts->sampling == MC_SOBOL && st->nsims != opts->nsims))
+        return torun;
+    /* aligned subtrees with the simulations of their blocks, in order */
+    for (i = 0; i < st->nparts; i++) {
+        part = &st->parts[i];
+        last = (long) (part->first + part->nblocks) * MC_BLOCK;
+        if (part->nblocks < 1 || part->nblocks & (part->nblocks - 1) ||
+            part->nblocks > run->nleaves || part->first < end ||
+            part->first % part->nblocks || part->n < 0 ||
+            part->n > part->nsims || part->nsims < 1 ||
+            part->nsims != (last < st->nsims ? last : st->nsims) -
+                           (long) part->first * MC_BLOCK)
+            return torun;
+        end = part->first + part->nblocks;
+    }
+    if (!(mos = calloc(st->nparts ? st->nparts : 1, sizeof(struct moments *))))
+        goto nomem;
+    for (i = 0; i < st->nparts; i++) {
+        part = &st->parts[i];
+        last = (long) (part->first + part->nblocks) * MC_BLOCK;
+        if ((part->nsims != (last < opts->nsims ? last : opts->nsims) -
+                            (long) part->first * MC_BLOCK &&
+             part->nblocks > 1) ||
+            part->first < run->lo || (part->first + part->nblocks < nblocks ?
+                part->first + part->nblocks : nblocks) > run->hi)
+            continue; /* its last block is longer in this run, or it is not
+                       * in the slice */
+        if (!(mos[i] = moments_of(run->m, part->n, part->mean,
+                                  part->comoment)))
+            goto nomem;
+        run->done_sims += part->nsims;
+        if (part->nsims < (last < opts->nsims ? last : opts->nsims) -
+                          (long) part->first * MC_BLOCK) {
+            run->partial = part->first;
+            run->partial_sims = part->nsims;
+            run->partial_mo = mos[i];
+            mos[i] = NULL;
+        } else {
+            torun -= part->first + part->nblocks < nblocks ?
+                     part->nblocks : nblocks - part->first;
+        }
+    }
+    if (torun > 0) {
+        if (!(run->todo = malloc(torun * sizeof(int))))
+            goto nomem;
+        for (b = run->lo, i = k = 0; b < run->hi; b++) {
+            while (i < st->nparts &&
+                   st->parts[i].first + st->parts[i].nblocks <= b)
+                i++;
+            if (i == st->nparts || b < st->parts[i].first || !mos[i])
+                run->todo[k++] = b;
+        }
+    }
+    /* a whole run is finished by the last part if there are no other
+     * blocks */
+    run->left = torun;
+    for (i = 0; i < st->nparts; i++) {
+        if (mos[i])
+            node_done(run, (run->nleaves + st->parts[i].first) /
+                           st->parts[i].nblocks, mos[i]);
+    }
+    free(mos);
+    return torun;
+
+nomem:
+    fprintf(stderr, "Error: not enough memory for the state of a run.\n");
+    for (i = 0; mos && i < st->nparts; i++)
+        moments_free(mos[i]);
+    free(mos);
+    free_run(run);
+    return -1;
+}
+
+void mc_state_free(struct mc_state *st)
+{
+    int i;
+    for (i = 0; st->parts && i < st->nparts; i++) {
+        free(st->parts[i].mean);
+        free(st->parts[i].comoment);
+    }
+    free(st->parts);
+    st->parts = NULL;
+    st->nparts = 0;
+}
+
+/* mc_noise_new: draws the noise of nsims simulations of n points with a
+ * seed, as the simulations do (simulation i from the stream i of the seed).
+ *
+ * returns the noise, to be freed with mc_noise_free, or NULL if there is not
+ * enough memory
+ */
+struct mc_noise *mc_noise_new(uint64_t seed, int nsims, int n)
+{
+    struct mc_noise *noise = malloc(sizeof(struct mc_noise));
+    struct rng rng;
+    int i, j;
+    if (!noise ||
+        !(noise->draws = malloc((size_t) nsims * n * sizeof(double)))) {
+        free(noise);
+        return NULL;
+    }
+    noise->seed = seed;
+    noise->nsims = nsims;
+    noise->n = n;
+    for (i = 0; i < nsims; i++) {
+        rng_seed(&rng, seed, i);
+        for (j = 0; j < n; j++)
+            noise->draws[(size_t) i*n + j] = rng_gauss(&rng);
+    }
+    return noise;
+}
+
+void mc_noise_free(struct mc_noise *noise)
+{
+    if (noise)
+        free(noise->draws);
+    free(noise);
 }
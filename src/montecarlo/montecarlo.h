@@ -1,16 +1,207 @@
-int montecarlo(double model(double X[], double p[]), /* model function */
+#ifndef __MONTECARLO_H__
+#define __MONTECARLO_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <models.h>
+#include <dataset.h>
+#include <globalfit.h>
+#include <pool.h>
+#include <sketch.h>
+
+/* What montecarlo simulates: a model with the points of a dataset, or a
+ * global fit of several datasets sharing parameters (see globalfit.h) */
+struct mc_problem {
+  struct model *model;    /* model... */
+  struct dataset *data;   /* ...and its points, or */
+  struct gfit *global;    /* a global fit (if not NULL, model and data are
+                           * not used, and the parameters are those of the
+                           * global fit) */
+};
+
+/* Result of a single simulation (see mc_options.record) */
+#define MC_OK 0                 /* successful adjustment */
+#define MC_FAILED 1             /* the adjustment failed */
+#define MC_REJECTED 2           /* the adjustment was rejected (too large
+                                 * variances or parameters) */
+
+struct mc_sim {
+  int sim;                /* number of the simulation (0...nsims-1) */
+  int status;             /* MC_OK, MC_FAILED or MC_REJECTED */
+  int iters;              /* iterations of the adjustment */
+  double chisq;           /* final chi square */
+  double *params;         /* adjusted parameters */
+  double *var;            /* their variances (0 for the fixed ones) */
+  double *covar;          /* covariances of the parameters, covar[m][m] in
+                           * their order (0 for the fixed ones), or NULL in
+                           * a global fit */
+};
+
+typedef void (*mc_record)(void *arg, struct mc_sim *sim);
+
+/* How the noise of the simulations is drawn (see mc_options.sampling) */
+#define MC_PLAIN 0              /* independent gaussian draws */
+#define MC_ANTITHETIC 1         /* in pairs: simulation 2k+1 has the noise of
+                                 * simulation 2k with the opposite sign */
+#define MC_SOBOL 2              /* the points of a scrambled Sobol sequence
+                                 * (see sobol.h) through the inverse of the
+                                 * normal distribution, scrambled again for
+                                 * each group of simulations; for at most
+                                 * SOBOL_MAXDIM points */
+
+/* simulations of each block: the unit in which the simulations are run and
+ * their moments merged (see montecarlo.c and mc_part) */
+#define MC_BLOCK 64
+
+/* The simulations are split in up to 2*MC_GROUPS groups (of MC_BLOCK
+ * simulations at least, a power of 2), whose results are independent of
+ * each other, to estimate the error of the results due to the number of
+ * simulations (see mc_options.mcerror) */
+#define MC_GROUPS 16
+
+/* The standard normal draws of the simulations of a seed (those added to
+ * the points, times the deviation), drawn once to be shared, read only, by
+ * any number of runs with the same seed and number of simulations, and the
+ * same number of points or fewer (the draws of the first points of a
+ * simulation do not depend on how many points it has; see mc_noise_new and
+ * mc_options.noise) */
+struct mc_noise {
+  uint64_t seed;
+  int nsims;
+  int n;                  /* number of points */
+  double *draws;          /* draws[nsims][n] */
+};
+
+/* Version of the simulations: changed whenever the same problem and options
+ * would give other results (eg. a change of the fits or of the random
+ * numbers), so that the saved states (see mc_state) are not taken for those
+ * of the new version */
+#define MC_ENGINE 1
+
+/* Part of a run: the moments of the adjusted parameters of the simulations
+ * of some blocks (of MC_BLOCK simulations, a subtree of their tree, see
+ * montecarlo.c) */
+struct mc_part {
+  int first;              /* first block */
+  int nblocks;            /* number of blocks: a power of 2, and first is a
+                           * multiple of it */
+  int nsims;              /* simulations of the blocks, fewer than
+                           * nblocks*MC_BLOCK only if the last block of the run
+                           * is one of them (the blocks after it are
+                           * empty) */
+  int n;                  /* successful adjustments, and their moments: */
+  double *mean;           /* mean[m] of the parameters */
+  double *comoment;       /* comoment[m][m]: sums of the products of their
+                           * deviations from the means */
+};
+
+/* State of a run: the moments of its simulations, kept as those of the
+ * largest subtrees of the blocks it filled (or, while it runs, of those
+ * done so far, see mc_options.checkpoint). A run with the same problem,
+ * seed and sampling, and the same or more simulations, may go on from it
+ * (see mc_options.resume): it merges the parts as if it had run them
+ * itself, so its results are exactly those of a run from scratch, and it
+ * only runs the simulations which are not in the state. */
+struct mc_state {
+  uint64_t seed;
+  int sampling;
+  int m;                  /* parameters */
+  int nsims;              /* simulations of the run */
+  int nparts;
+  struct mc_part *parts;  /* parts[nparts], in order of their blocks */
+};
+
+typedef void (*mc_checkpoint)(void *arg, struct mc_state *st);
+
+/* How the simulations are run */
+struct mc_options {
+  int nsims;              /* number of simulations */
+  uint64_t seed;          /* seed of the random numbers. Simulation i uses
+                           * the stream i of the seed (see random.h), so the
+                           * results do not depend on the number of threads */
+  struct pool *pool;      /* threads to run the simulations, or NULL to run
+                           * them in the calling thread */
+  int progress;           /* print the percentage of simulations done */
+  FILE *fp;               /* debug output of each simulation, or NULL (the
+                           * simulations are then run in the calling thread) */
+  int *cancel;            /* if not NULL, the simulations stop as soon as
+                           * *cancel is set, and the run fails */
+  mc_record record;       /* if not NULL, called with record_arg after each
+                           * simulation, from the thread which ran it (so
+                           * not in order), and before the run is done */
+  void *record_arg;
+  struct sketch *quantiles; /* if not NULL, the values of each adjusted
+                           * parameter are added to quantiles[m] (empty
+                           * sketches, see sketch_init) */
+  struct histogram *hists;  /* the same with histograms[m] (see hist_init),
+                           * if not NULL */
+  struct mc_noise *noise; /* if not NULL, and drawn for the seed and nsims
+                           * of the run and at least its points, the draws
+                           * of the simulations are taken from it instead
+                           * of being drawn again (they are the same) */
+  double *covariance;     /* if not NULL, set to the covariances of the
+                           * adjusted parameters, covariance[m][m] (divided
+                           * by the number of successful adjustments, so the
+                           * variances plus the squares of the biases are
+                           * the variances of montecarlo) */
+  int sampling;           /* MC_PLAIN, MC_ANTITHETIC or MC_SOBOL */
+  double *mcerror;        /* if not NULL, set to the standard errors of the
+                           * means of the parameters, mcerror[m], and of
+                           * their CVs (%), mcerror[m...2m-1], estimated from
+                           * the spread between the groups of simulations
+                           * (NaN if there are less than two groups) */
+  struct mc_state *resume;  /* if not NULL, the state of a previous run of
+                           * the problem, whose simulations are not run
+                           * again. It is ignored (all the simulations are
+                           * run) if it is not of this seed and sampling, it
+                           * has more simulations, or the run needs what
+                           * the state does not keep: quantiles, hists,
+                           * mcerror, or the records or debug output of its
+                           * simulations, or a Sobol sampling of other
+                           * number of simulations */
+  struct mc_state *save;  /* if not NULL, set to the state of the run once it
+                           * is done successfully (to be freed with
+                           * mc_state_free; it is left empty until then) */
+  mc_checkpoint checkpoint; /* if not NULL, called with checkpoint_arg every
+                           * checkpoint_secs seconds while the simulations
+                           * run, from the thread of one of them, with the
+                           * state of those done (freed once it returns), so
+                           * that a run which is stopped might be resumed */
+  void *checkpoint_arg;
+  int checkpoint_secs;
+  int shard, nshards;     /* if nshards is more than 1, only the slice shard
+                           * (0...nshards-1) of the simulations is run, and
+                           * the results are those of its simulations. The
+                           * parts of the states saved (see save) of all the
+                           * slices are a state of the whole run, which
+                           * gives its results without running any */
+};
+
+/* Called once all the simulations of mc_start are done, with the results as
+ * those of montecarlo (nsuccess is -1 on failure) */
+typedef void (*mc_done)(void *arg, int nsuccess, double params_mean[],
+                        double variances[]);
+
+int montecarlo(struct mc_problem *problem, /* what to simulate */
                 double params[], /* real value of the parameters */
                 double guess[], /* guess of the parameters */
                 double dev, /* an estimation of the deviation */
-                int nsims, /* number of simulations */
-                int n, /* number of points */
-                int nvars, /* number of independent variables of the model */
                 int m, /* number of parameters of the model */
                 int mfit, /* number of adjustable parameters */
                 int fit[m],  /* array which indicates what parameters
                               * will be adjusted (fit[i] = 1) and what ones
                               * will be fixed (fit[i] = 0) */
-                double *xi[nvars], /* data points (indep. variables) */
-                double params_mean[m], 
-                double variances[m],
-                FILE *fp);
+                struct mc_options *opts, /* how to run the simulations */
+                double params_mean[m],
+                double variances[m]);
+
+int mc_start(struct mc_problem *problem, double params[], double guess[],
+             double dev, int m, int mfit, int fit[m],
+             struct mc_options *opts, mc_done done, void *arg);
+
+void mc_state_free(struct mc_state *st);
+
+struct mc_noise *mc_noise_new(uint64_t seed, int nsims, int n);
+void mc_noise_free(struct mc_noise *noise);
+
+#endif /* __MONTECARLO_H__ */
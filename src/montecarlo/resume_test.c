@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <montecarlo.h>
+#include <state.h>
+#include <models.h>
+#include <dataset.h>
+#include <pool.h>
+
+/* Checks that the results of a run do not depend on how its simulations
+ * were run: all at once, stopped and resumed from a checkpoint, topped up
+ * from the state of a run of fewer simulations (as --cache does), or in
+ * slices merged in any order (--shard and --merge). The means and variances
+ * must be the same, bit for bit. The last checks run ../enzmc, so build it
+ * first ("make test" in this directory).
+ */
+
+#define NSIMS 1000      /* 15 full blocks and a partial one */
+#define NSHARDS 3
+#define STOP_AT 6       /* checkpoint at which the run is stopped */
+#define ENZMC "../enzmc"
+#define KEY "resume_test"
+
+static struct model *model;
+static struct dataset data;
+static double params[] = {5, 17, 3};    /* Vmax, Km, KIa */
+static int fit[] = {1, 1, 1};
+static char dir[] = "/tmp/resume_testXXXXXX";
+static int failures;
+
+/* a run of n simulations of the model, resuming from st if not NULL, and
+ * keeping its state in save if not NULL */
+static int run(int n, struct pool *pool, struct mc_state *st,
+               struct mc_state *save, double means[], double variances[])
+{
+    struct mc_problem problem = {.model = model, .data = &data};
+    struct mc_options opts = {.nsims = n, .seed = 7, .pool = pool,
+                              .resume = st, .save = save};
+    return montecarlo(&problem, params, params, 0.1, 3, 3, fit, &opts, means,
+                      variances);
+}
+
+static void check(const char *what, int ok)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+/* whether the results are those of the run of all the simulations */
+static int same(int n, double means[], double variances[], int n0,
+                double means0[], double variances0[])
+{
+    return n == n0 && !memcmp(means, means0, 3 * sizeof(double)) &&
+           !memcmp(variances, variances0, 3 * sizeof(double));
+}
+
+/* the checkpoints of the run which is stopped */
+struct stopper {
+    int cancel;
+    int calls;
+    char path[64];
+};
+
+static void stop(void *arg, struct mc_state *st)
+{
+    struct stopper *s = arg;
+    if (s->cancel)
+        return;
+    mc_state_write(s->path, KEY, st);
+    if (++s->calls == STOP_AT)
+        s->cancel = 1;
+}
+
+/* the state of the slices of the files order[n], as --merge puts them
+ * together */
+static int merge(int n, int order[], struct mc_state *all)
+{
+    struct mc_state st;
+    char path[64];
+    int i;
+    memset(all, 0, sizeof(struct mc_state));
+    for (i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%d.state", dir, order[i]);
+        if (mc_state_read(path, KEY, &st))
+            return -1;
+        all->parts = realloc(all->parts, (all->nparts + st.nparts) *
+                                         sizeof(struct mc_part));
+        memcpy(&all->parts[all->nparts], st.parts,
+               st.nparts * sizeof(struct mc_part));
+        all->nparts += st.nparts;
+        all->seed = st.seed;
+        all->sampling = st.sampling;
+        all->m = st.m;
+        all->nsims = st.nsims;
+        free(st.parts);
+    }
+    return 0;
+}
+
+static int compare_parts(const void *a, const void *b)
+{
+    const struct mc_part *x = a, *y = b;
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+static void test_engine(void)
+{
+    struct mc_problem problem = {.model = model, .data = &data};
+    struct mc_options opts = {.nsims = NSIMS, .seed = 7};
+    struct mc_state st, save;
+    struct stopper s = {0};
+    struct pool *pool = pool_create(4);
+    double means0[3], variances0[3], means[3], variances[3];
+    char path[64], what[80];
+    int order[][NSHARDS] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, {1, 2, 0},
+                            {2, 0, 1}, {2, 1, 0}};
+    int i, k, n0, n;
+
+    n0 = run(NSIMS, NULL, NULL, NULL, means0, variances0);
+    check("all the simulations", n0 > 0);
+    n = run(NSIMS, pool, NULL, NULL, means, variances);
+    check("all the simulations, in 4 threads",
+          same(n, means, variances, n0, means0, variances0));
+
+    /* stopped at a checkpoint, and resumed from its file */
+    snprintf(s.path, sizeof(s.path), "%s/stopped.state", dir);
+    opts.cancel = &s.cancel;
+    opts.checkpoint = stop;
+    opts.checkpoint_arg = &s;
+    opts.checkpoint_secs = 0;
+    n = montecarlo(&problem, params, params, 0.1, 3, 3, fit, &opts, means,
+                   variances);
+    check("stopped run fails", n < 0 && s.calls == STOP_AT);
+    n = -1;
+    if (mc_state_read(s.path, KEY, &st) == 0) {
+        /* which must have kept some simulations */
+        if (st.nparts > 0)
+            n = run(NSIMS, pool, &st, NULL, means, variances);
+        mc_state_free(&st);
+    }
+    check("stopped and resumed",
+          same(n, means, variances, n0, means0, variances0));
+
+    /* topped up from the states of runs of fewer simulations */
+    for (k = 100; k < NSIMS; k += 450) {
+        snprintf(path, sizeof(path), "%s/cache.state", dir);
+        n = run(k, NULL, NULL, &save, means, variances);
+        if (n >= 0)
+            mc_state_write(path, KEY, &save);
+        mc_state_free(&save);
+        n = -1;
+        if (mc_state_read(path, KEY, &st) == 0) {
+            n = run(NSIMS, pool, &st, NULL, means, variances);
+            mc_state_free(&st);
+        }
+        snprintf(what, sizeof(what), "topped up from %d simulations", k);
+        check(what, same(n, means, variances, n0, means0, variances0));
+    }
+
+    /* in slices, merged in every order */
+    opts = (struct mc_options) {.nsims = NSIMS, .seed = 7, .pool = pool,
+                                .nshards = NSHARDS, .save = &save};
+    for (i = 0; i < NSHARDS; i++) {
+        opts.shard = i;
+        n = montecarlo(&problem, params, params, 0.1, 3, 3, fit, &opts, means,
+                       variances);
+        snprintf(path, sizeof(path), "%s/%d.state", dir, i);
+        if (n >= 0)
+            mc_state_write(path, KEY, &save);
+        mc_state_free(&save);
+    }
+    for (i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        n = -1;
+        if (merge(NSHARDS, order[i], &st) == 0) {
+            qsort(st.parts, st.nparts, sizeof(struct mc_part), compare_parts);
+            n = run(NSIMS, NULL, &st, NULL, means, variances);
+        }
+        mc_state_free(&st);
+        snprintf(what, sizeof(what), "slices merged in the order %d %d %d",
+                 order[i][0], order[i][1], order[i][2]);
+        check(what, same(n, means, variances, n0, means0, variances0));
+    }
+    pool_destroy(pool);
+}
+
+/* runs a command, given as in printf, with its output in buf[size].
+ * returns its exit status (as pclose), or -1 if it could not be run */
+static int output(char *buf, size_t size, const char *fmt, ...)
+{
+    char cmd[1024];
+    va_list ap;
+    FILE *fp;
+    size_t n;
+    va_start(ap, fmt);
+    vsnprintf(cmd, sizeof(cmd), fmt, ap);
+    va_end(ap);
+    if (!(fp = popen(cmd, "r")))
+        return -1;
+    n = fread(buf, 1, size - 1, fp);
+    buf[n] = '\0';
+    return pclose(fp);
+}
+
+/* writes the file name (in dir) of a scenario of n simulations, with or
+ * without its seed */
+static void scenario(const char *name, int n, int seeded)
+{
+    char path[64];
+    FILE *fp;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (!(fp = fopen(path, "w")))
+        return;
+    fprintf(fp, "- Model: competitive\n\n"
+            "- Independent variables:\n"
+            "S=[1,2,5,10,20,40,80,1,2,5,10,20,40,80]\n"
+            "I=[0,0,0,0,0,0,0,5,5,5,5,5,5,5]\n\n"
+            "- Parameters:\nVmax=5\nKm=17\nKIa=3\n\n"
+            "- Error (absolute):\n0.1\n\n"
+            "- Simulations: %d\n", n);
+    if (seeded)
+        fprintf(fp, "\n- Seed: 7\n");
+    fclose(fp);
+}
+
+static void test_enzmc(void)
+{
+    char all[4096], out[4096], what[80];
+    int order[][NSHARDS] = {{1, 2, 3}, {3, 1, 2}, {2, 3, 1}};
+    int i, ret;
+
+    if (access(ENZMC, X_OK)) {
+        check("enzmc is built", 0);
+        return;
+    }
+    scenario("scenario.txt", NSIMS, 1);
+    scenario("fewer.txt", 300, 1);
+    scenario("seedless.txt", NSIMS, 0);
+    ret = output(all, sizeof(all), ENZMC " -f %s/scenario.txt --format csv",
+                 dir);
+    check("enzmc: all the simulations", ret == 0 && all[0]);
+
+    for (i = 1; i <= NSHARDS; i++) {
+        output(out, sizeof(out), ENZMC " -f %s/scenario.txt --shard %d/%d "
+               "--checkpoint %s/enzmc%d.state", dir, i, NSHARDS, dir, i);
+    }
+    for (i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        ret = output(out, sizeof(out), ENZMC " -f %s/scenario.txt --format csv"
+                     " --merge \"%s/enzmc%d.state %s/enzmc%d.state "
+                     "%s/enzmc%d.state\"", dir, dir, order[i][0], dir,
+                     order[i][1], dir, order[i][2]);
+        snprintf(what, sizeof(what), "enzmc: slices merged in the order "
+                 "%d %d %d", order[i][0], order[i][1], order[i][2]);
+        check(what, ret == 0 && !strcmp(out, all));
+    }
+    /* the seed is taken from the slices */
+    ret = output(out, sizeof(out), ENZMC " -f %s/seedless.txt --format csv "
+                 "--merge \"%s/enzmc1.state %s/enzmc2.state %s/enzmc3.state\"",
+                 dir, dir, dir, dir);
+    check("enzmc: slices merged without the seed",
+          ret == 0 && !strcmp(out, all));
+    ret = output(out, sizeof(out), ENZMC " -f %s/scenario.txt --merge "
+                 "\"%s/enzmc1.state %s/enzmc3.state\" 2>&1", dir, dir, dir);
+    check("enzmc: a missing slice is rejected", ret != 0);
+    ret = output(out, sizeof(out), ENZMC " -f %s/scenario.txt --merge "
+                 "\"%s/enzmc1.state %s/enzmc2.state %s/enzmc2.state "
+                 "%s/enzmc3.state\" 2>&1", dir, dir, dir, dir, dir);
+    check("enzmc: a duplicate slice is rejected", ret != 0);
+
+    /* the cache is topped up by a run of more simulations */
+    output(out, sizeof(out), ENZMC " -f %s/fewer.txt --cache %s/cache", dir,
+           dir);
+    ret = output(out, sizeof(out), ENZMC " -f %s/scenario.txt --format csv "
+                 "--cache %s/cache", dir, dir);
+    check("enzmc: topped up from the cache", ret == 0 && !strcmp(out, all));
+    ret = output(out, sizeof(out), ENZMC " -f %s/scenario.txt --format csv "
+                 "--cache %s/cache", dir, dir);
+    check("enzmc: taken from the cache", ret == 0 && !strcmp(out, all));
+}
+
+int main()
+{
+    double S[] = {1, 2, 5, 10, 20, 40, 80, 1, 2, 5, 10, 20, 40, 80};
+    double I[] = {0, 0, 0, 0, 0, 0, 0, 5, 5, 5, 5, 5, 5, 5};
+    double *cols[] = {S, I};
+    char cmd[64];
+
+    for (model = models; model->function; model++) {
+        if (!strcmp(model->name, "competitive"))
+            break;
+    }
+    if (!model->function || !mkdtemp(dir)) {
+        fprintf(stderr, "Error: cannot set up the tests.\n");
+        return 1;
+    }
+    dataset_view(&data, 2, 14, cols);
+    test_engine();
+    test_enzmc();
+    dataset_free(&data);
+    snprintf(cmd, sizeof(cmd), "rm -r %s", dir);
+    system(cmd);
+    if (failures)
+        printf("%d checks FAILED\n", failures);
+    return failures != 0;
+}
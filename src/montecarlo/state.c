@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <state.h>
+
+/* bytes of the header, before the key */
+#define HEADER 40
+
+static void put_le(unsigned char *p, uint64_t x, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        p[i] = x & 0xff;
+        x >>= 8;
+    }
+}
+
+static uint64_t get_le(const unsigned char *p, int n)
+{
+    uint64_t x = 0;
+    while (n--)
+        x = x << 8 | p[n];
+    return x;
+}
+
+/* write_doubles: writes x[n] to a file. returns 0, or -1 on failure */
+static int write_doubles(FILE *fp, int n, double x[])
+{
+    unsigned char b[8];
+    uint64_t bits;
+    int i;
+    for (i = 0; i < n; i++) {
+        memcpy(&bits, &x[i], sizeof(bits));
+        put_le(b, bits, 8);
+        if (fwrite(b, 8, 1, fp) != 1)
+            return -1;
+    }
+    return 0;
+}
+
+/* read_doubles: reads x[n] from a file. returns 0, or -1 on failure */
+static int read_doubles(FILE *fp, int n, double x[])
+{
+    unsigned char b[8];
+    uint64_t bits;
+    int i;
+    for (i = 0; i < n; i++) {
+        if (fread(b, 8, 1, fp) != 1)
+            return -1;
+        bits = get_le(b, 8);
+        memcpy(&x[i], &bits, sizeof(bits));
+    }
+    return 0;
+}
+
+/* mc_state_write: writes a state to a file, with the key which tells what
+ * it is the state of.
+ *
+ * returns 0, or -1 if the file could not be written (the error is reported
+ * in stderr)
+ */
+int mc_state_write(const char *path, const char *key, struct mc_state *st)
+{
+    static int ntmp;
+    unsigned char hdr[HEADER], p[16];
+    struct mc_part *part;
+    size_t len = strlen(key);
+    int i, m = st->m, ok;
+    FILE *fp;
+    /* one temporary file per writer, so that several threads might write
+     * the same state */
+    char tmp[strlen(path) + 32];
+    sprintf(tmp, "%s.%ld.%d.tmp", path, (long) getpid(),
+            __atomic_fetch_add(&ntmp, 1, __ATOMIC_RELAXED));
+    if (!(fp = fopen(tmp, "wb"))) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        return -1;
+    }
+    memcpy(hdr, STATE_MAGIC, 8);
+    put_le(&hdr[8], STATE_VERSION, 4);
+    put_le(&hdr[12], st->sampling, 4);
+    put_le(&hdr[16], m, 4);
+    put_le(&hdr[20], st->nsims, 4);
+    put_le(&hdr[24], st->nparts, 4);
+    put_le(&hdr[28], len, 4);
+    put_le(&hdr[32], st->seed, 8);
+    ok = fwrite(hdr, HEADER, 1, fp) == 1 && fwrite(key, 1, len, fp) == len;
+    for (i = 0; ok && i < st->nparts; i++) {
+        part = &st->parts[i];
+        put_le(&p[0], part->first, 4);
+        put_le(&p[4], part->nblocks, 4);
+        put_le(&p[8], part->nsims, 4);
+        put_le(&p[12], part->n, 4);
+        ok = fwrite(p, 16, 1, fp) == 1 &&
+             !write_doubles(fp, m, part->mean) &&
+             !write_doubles(fp, m * m, part->comoment);
+    }
+    if (fclose(fp) || !ok || rename(tmp, path)) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* mc_state_read: reads the state of a file, if it is that of key (the
+ * parts are allocated, see mc_state_free).
+ *
+ * returns 0, 1 if there is no such file or it is the state of another key
+ * (st is left empty), or -1 on failure (the error is reported in stderr)
+ */
+int mc_state_read(const char *path, const char *key, struct mc_state *st)
+{
+    unsigned char hdr[HEADER], p[16];
+    struct mc_part *part;
+    size_t len = strlen(key), keylen;
+    int i, m, ret = 1;
+    FILE *fp;
+    char *k = NULL;
+    memset(st, 0, sizeof(struct mc_state));
+    if (!(fp = fopen(path, "rb")))
+        return 1;
+    if (fread(hdr, HEADER, 1, fp) != 1 || memcmp(hdr, STATE_MAGIC, 8) ||
+        get_le(&hdr[8], 4) != STATE_VERSION)
+        goto end;  /* not a state of this version: taken as missing */
+    keylen = get_le(&hdr[28], 4);
+    if (keylen != len || !(k = malloc(len + 1)) ||
+        fread(k, 1, len, fp) != len || memcmp(k, key, len))
+        goto end;
+    st->sampling = get_le(&hdr[12], 4);
+    st->m = m = get_le(&hdr[16], 4);
+    st->nsims = get_le(&hdr[20], 4);
+    st->nparts = get_le(&hdr[24], 4);
+    st->seed = get_le(&hdr[32], 8);
+    ret = -1;
+    /* a state has a part per block of its run, at most */
+    if (m < 1 || m > 1024 || st->nsims < 0 || st->nparts < 0 ||
+        st->nparts > st->nsims / MC_BLOCK + 1)
+        goto corrupt;
+    if (!(st->parts = calloc(st->nparts ? st->nparts : 1,
+                             sizeof(struct mc_part)))) {
+        fprintf(stderr, "Error: not enough memory for the state of %s\n",
+                path);
+        goto end;
+    }
+    for (i = 0; i < st->nparts; i++) {
+        part = &st->parts[i];
+        part->mean = malloc(m * sizeof(double));
+        part->comoment = malloc(m * m * sizeof(double));
+        if (!part->mean || !part->comoment) {
+            st->nparts = i + 1;
+            fprintf(stderr, "Error: not enough memory for the state of %s\n",
+                    path);
+            goto end;
+        }
+        if (fread(p, 16, 1, fp) != 1 ||
+            read_doubles(fp, m, part->mean) ||
+            read_doubles(fp, m * m, part->comoment)) {
+            st->nparts = i + 1;
+            goto corrupt;
+        }
+        part->first = get_le(&p[0], 4);
+        part->nblocks = get_le(&p[4], 4);
+        part->nsims = get_le(&p[8], 4);
+        part->n = get_le(&p[12], 4);
+    }
+    ret = 0;
+    goto end;
+
+corrupt:
+    fprintf(stderr, "Error: %s: the file is truncated or corrupt\n", path);
+end:
+    fclose(fp);
+    free(k);
+    if (ret) {
+        mc_state_free(st);
+        memset(st, 0, sizeof(struct mc_state));
+    }
+    return ret;
+}
+
+/* mc_state_seed: reads the seed of the state of a file, whatever its key (eg.
+ * to go on from a run whose seed was taken from the time).
+ *
+ * returns 0, or 1 if there is no such file or it is not a state
+ */
+int mc_state_seed(const char *path, uint64_t *seed)
+{
+    unsigned char hdr[HEADER];
+    FILE *fp;
+    int ret = 1;
+    if (!(fp = fopen(path, "rb")))
+        return 1;
+    if (fread(hdr, HEADER, 1, fp) == 1 && !memcmp(hdr, STATE_MAGIC, 8) &&
+        get_le(&hdr[8], 4) == STATE_VERSION) {
+        *seed = get_le(&hdr[32], 8);
+        ret = 0;
+    }
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,32 @@
+#ifndef __STATE_H__
+#define __STATE_H__
+
+#include <montecarlo.h>
+
+/* Files of the states of runs (see struct mc_state and --cache). The
+ * format is (little endian):
+ *
+ *      char magic[8]           STATE_MAGIC
+ *      uint32_t version        STATE_VERSION
+ *      uint32_t sampling
+ *      uint32_t m
+ *      uint32_t nsims
+ *      uint32_t nparts
+ *      uint32_t keylen
+ *      uint64_t seed
+ *      char key[keylen]        what the state is of, as given by the caller
+ *      parts[nparts]           uint32_t first, nblocks, nsims, n, and the
+ *                              doubles mean[m] and comoment[m][m]
+ *
+ * A file is written to a temporary one which is then renamed, so a reader
+ * never sees it half written.
+ */
+
+#define STATE_MAGIC "ENZMCSTA"
+#define STATE_VERSION 1
+
+int mc_state_write(const char *path, const char *key, struct mc_state *st);
+int mc_state_read(const char *path, const char *key, struct mc_state *st);
+int mc_state_seed(const char *path, uint64_t *seed);
+
+#endif /* __STATE_H__ */
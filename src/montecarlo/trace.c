@@ -0,0 +1,310 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <pthread.h>
+#include <trace.h>
+
+/* bytes of each of the two buffers of records */
+#define BUFSIZE (1024 * 1024)
+
+/* The records are copied into one buffer while the thread of the trace
+ * writes the other one (double buffering), so the threads of the
+ * simulations only wait if they fill a buffer before the other one has been
+ * written. */
+struct trace {
+    FILE *fp;
+    char *path;
+    int nparams, flags;
+    size_t size;                /* bytes of a record */
+    size_t cap;                 /* records of a buffer */
+    pthread_t thread;
+    pthread_mutex_t lock;       /* protects the following: */
+    pthread_cond_t cond;        /* signaled when a buffer is full or has been
+                                 * written, and on close */
+    unsigned char *buf[2];
+    int fill;                   /* buffer being filled... */
+    size_t len;                 /* ...and its records */
+    size_t full;                /* records of the other buffer to be written,
+                                 * or 0 if it is free */
+    uint64_t nrecords;          /* records written */
+    int closing;
+    int error;                  /* whether a write failed */
+};
+
+static void put_le(unsigned char *p, uint64_t x, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        p[i] = x & 0xff;
+        x >>= 8;
+    }
+}
+
+static void put_double(unsigned char *p, double x)
+{
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    put_le(p, bits, 8);
+}
+
+static int little_endian(void)
+{
+    uint16_t x = 1;
+    return *(unsigned char *) &x == 1;
+}
+
+/* swap: hands the buffer being filled to the thread of the trace (the other
+ * one must be free) */
+static void swap(struct trace *t)
+{
+    t->full = t->len;
+    t->fill = !t->fill;
+    t->len = 0;
+    pthread_cond_broadcast(&t->cond);
+}
+
+static void *trace_main(void *arg)
+{
+    struct trace *t = arg;
+    size_t n;
+    int failed;
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while (!t->full && !t->closing)
+            pthread_cond_wait(&t->cond, &t->lock);
+        if (!(n = t->full))
+            break;
+        /* the buffer is written with the lock released: it is not used
+         * until full is reset */
+        pthread_mutex_unlock(&t->lock);
+        failed = fwrite(t->buf[!t->fill], t->size, n, t->fp) != n;
+        pthread_mutex_lock(&t->lock);
+        t->error |= failed;
+        t->nrecords += n;
+        t->full = 0;
+        pthread_cond_broadcast(&t->cond);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+/* trace_create: creates a trace of the results of simulations with nparams
+ * parameters, named names[] (or p1, p2... if names is NULL). flags might be
+ * TRACE_COVAR, to keep their covariances too.
+ *
+ * returns the trace, or NULL on failure (the error is reported in stderr)
+ */
+struct trace *trace_create(const char *path, int nparams, char *names[],
+                           int flags)
+{
+    struct trace *t;
+    unsigned char hdr[sizeof(struct trace_header)];
+    char name[TRACE_NAMELEN];
+    size_t nvalues = nparams;
+    int i, ok;
+    for (i = 0; names && i < nparams; i++) {
+        if (strlen(names[i]) >= TRACE_NAMELEN) {
+            fprintf(stderr, "Error: the name %s is too long for a trace\n",
+                    names[i]);
+            return NULL;
+        }
+    }
+    if (flags & TRACE_COVAR)
+        nvalues += nparams * (nparams + 1) / 2;
+    if (!(t = calloc(1, sizeof(struct trace)))) {
+        fprintf(stderr, "Error: not enough memory for a trace\n");
+        return NULL;
+    }
+    t->nparams = nparams;
+    t->flags = flags;
+    t->size = sizeof(struct trace_record) + nvalues * sizeof(double);
+    t->cap = BUFSIZE / t->size > 0 ? BUFSIZE / t->size : 1;
+    t->buf[0] = malloc(t->cap * t->size);
+    t->buf[1] = malloc(t->cap * t->size);
+    t->path = strdup(path);
+    if (!t->buf[0] || !t->buf[1] || !t->path) {
+        fprintf(stderr, "Error: not enough memory for a trace\n");
+        goto fail;
+    }
+    if (!(t->fp = fopen(path, "wb"))) {
+        fprintf(stderr, "Error: cannot create %s\n", path);
+        goto fail;
+    }
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, TRACE_MAGIC, 8);
+    put_le(&hdr[offsetof(struct trace_header, version)], TRACE_VERSION, 4);
+    put_le(&hdr[offsetof(struct trace_header, flags)], flags, 4);
+    put_le(&hdr[offsetof(struct trace_header, nparams)], nparams, 4);
+    put_le(&hdr[offsetof(struct trace_header, size)], t->size, 4);
+    ok = fwrite(hdr, sizeof(hdr), 1, t->fp) == 1;
+    for (i = 0; ok && i < nparams; i++) {
+        memset(name, 0, sizeof(name));
+        if (names)
+            strcpy(name, names[i]);
+        else
+            snprintf(name, sizeof(name), "p%d", i + 1);
+        ok = fwrite(name, sizeof(name), 1, t->fp) == 1;
+    }
+    if (!ok) {
+        fprintf(stderr, "Error: cannot write %s\n", path);
+        fclose(t->fp);
+        goto fail;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+    if (pthread_create(&t->thread, NULL, trace_main, t)) {
+        fprintf(stderr, "Error: cannot create the thread of a trace\n");
+        pthread_mutex_destroy(&t->lock);
+        pthread_cond_destroy(&t->cond);
+        fclose(t->fp);
+        goto fail;
+    }
+    return t;
+
+fail:
+    free(t->buf[0]);
+    free(t->buf[1]);
+    free(t->path);
+    free(t);
+    return NULL;
+}
+
+/* trace_add: adds the result of a simulation with nparams parameters (at
+ * most those of the trace) of scenario number "scenario" (or 0). Might be
+ * called from several threads at once.
+ *
+ * returns 0
+ */
+int trace_add(struct trace *t, int scenario, int nparams, struct mc_sim *sim)
+{
+    unsigned char rec[t->size], *v;
+    int i, j, np = t->nparams;
+    double x;
+    put_le(&rec[offsetof(struct trace_record, scenario)], scenario, 4);
+    put_le(&rec[offsetof(struct trace_record, sim)], sim->sim, 4);
+    put_le(&rec[offsetof(struct trace_record, status)], (uint32_t) sim->status,
+           4);
+    put_le(&rec[offsetof(struct trace_record, iters)], (uint32_t) sim->iters,
+           4);
+    put_double(&rec[offsetof(struct trace_record, chisq)], sim->chisq);
+    v = &rec[offsetof(struct trace_record, values)];
+    for (i = 0; i < np; i++, v += 8)
+        put_double(v, i < nparams ? sim->params[i] : NAN);
+    for (i = 0; (t->flags & TRACE_COVAR) && i < np; i++) {
+        for (j = 0; j <= i; j++, v += 8) {
+            if (i >= nparams)
+                x = NAN;
+            else if (sim->covar)
+                x = sim->covar[i * nparams + j];
+            else /* only the variances are known */
+                x = i == j ? sim->var[i] : NAN;
+            put_double(v, x);
+        }
+    }
+    pthread_mutex_lock(&t->lock);
+    /* wait for a free buffer only if both are full */
+    while (t->len == t->cap) {
+        if (!t->full)
+            swap(t);
+        else
+            pthread_cond_wait(&t->cond, &t->lock);
+    }
+    memcpy(t->buf[t->fill] + t->len * t->size, rec, t->size);
+    if (++t->len == t->cap && !t->full)
+        swap(t);
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+}
+
+/* trace_close: writes the records left, sets their number in the header,
+ * and frees the trace.
+ *
+ * returns 0, or -1 if the file could not be written (the error is reported
+ * in stderr)
+ */
+int trace_close(struct trace *t)
+{
+    unsigned char n[8];
+    int ret = 0;
+    pthread_mutex_lock(&t->lock);
+    while (t->full)
+        pthread_cond_wait(&t->cond, &t->lock);
+    if (t->len)
+        swap(t);
+    t->closing = 1;
+    pthread_cond_broadcast(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+    put_le(n, t->nrecords, 8);
+    if (t->error ||
+        fseek(t->fp, offsetof(struct trace_header, nrecords), SEEK_SET) ||
+        fwrite(n, 8, 1, t->fp) != 1)
+        ret = -1;
+    if (fclose(t->fp) || ret) {
+        fprintf(stderr, "Error: cannot write %s\n", t->path);
+        ret = -1;
+    }
+    pthread_mutex_destroy(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    free(t->buf[0]);
+    free(t->buf[1]);
+    free(t->path);
+    free(t);
+    return ret;
+}
+
+/* trace_map: maps the trace of a file in memory.
+ *
+ * returns 0, or -1 on failure (the error is reported in stderr)
+ */
+int trace_map(const char *path, struct trace_view *v)
+{
+    const struct trace_header *h;
+    size_t start;
+    if (!little_endian()) {
+        fprintf(stderr, "Error: %s: traces can only be read in little endian "
+                "machines\n", path);
+        return -1;
+    }
+    if (mapfile_open(&v->mf, path))
+        return -1;
+    h = (const struct trace_header *) v->mf.data;
+    if (v->mf.len < sizeof(struct trace_header) ||
+        memcmp(h->magic, TRACE_MAGIC, 8)) {
+        fprintf(stderr, "Error: %s is not a trace\n", path);
+        goto fail;
+    }
+    if (h->version != TRACE_VERSION) {
+        fprintf(stderr, "Error: %s: version %u of the format is not "
+                "supported\n", path, h->version);
+        goto fail;
+    }
+    start = sizeof(struct trace_header) + (size_t) h->nparams * TRACE_NAMELEN;
+    if (h->size < sizeof(struct trace_record) + h->nparams * sizeof(double) ||
+        v->mf.len < start) {
+        fprintf(stderr, "Error: %s: the file is truncated or corrupt\n", path);
+        goto fail;
+    }
+    v->header = h;
+    v->names = v->mf.data + sizeof(struct trace_header);
+    v->records = v->mf.data + start;
+    v->nrecords = (v->mf.len - start) / h->size;
+    return 0;
+
+fail:
+    mapfile_close(&v->mf);
+    return -1;
+}
+
+/* trace_get: returns the record i (0...v->nrecords-1) of a mapped trace */
+const struct trace_record *trace_get(struct trace_view *v, uint64_t i)
+{
+    return (const struct trace_record *) (v->records + i * v->header->size);
+}
+
+void trace_unmap(struct trace_view *v)
+{
+    mapfile_close(&v->mf);
+}
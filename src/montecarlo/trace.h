@@ -0,0 +1,74 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include <mapfile.h>
+#include <montecarlo.h>
+
+/* Traces: files with the result of each simulation (see --trace), as fixed
+ * size records, so that they might be mapped in memory and read in place.
+ * The format is (little endian):
+ *
+ *      struct trace_header
+ *      char names[nparams][32]         name of each parameter, padded with
+ *                                      '\0'
+ *      records[nrecords]               struct trace_record, of header.size
+ *                                      bytes each
+ *
+ * The records are written as the simulations are done, so not in order. The
+ * number of records is set in the header once the trace is closed; the
+ * records of a trace which was not closed are still read.
+ */
+
+#define TRACE_MAGIC "ENZMCTRC"
+#define TRACE_VERSION 1
+#define TRACE_NAMELEN 32
+
+/* flags of the header */
+#define TRACE_COVAR 1           /* the records hold the covariances */
+
+struct trace_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t nparams;
+  uint32_t size;          /* bytes of a record */
+  uint64_t nrecords;      /* 0 until the trace is closed */
+};
+
+struct trace_record {
+  uint32_t scenario;      /* number of the scenario of a batch file, or 0 */
+  uint32_t sim;           /* number of the simulation */
+  int32_t status;         /* MC_OK, MC_FAILED or MC_REJECTED */
+  int32_t iters;          /* iterations of the adjustment */
+  double chisq;           /* final chi square */
+  double values[];        /* the adjusted parameters (nparams), and with
+                           * TRACE_COVAR their covariances: the lower
+                           * triangle of the matrix, row after row
+                           * (nparams*(nparams+1)/2 values). The values
+                           * which are not known (eg. of the parameters
+                           * missing in a scenario) are NaN */
+};
+
+/* writing */
+struct trace;
+
+struct trace *trace_create(const char *path, int nparams, char *names[],
+                           int flags);
+int trace_add(struct trace *t, int scenario, int nparams, struct mc_sim *sim);
+int trace_close(struct trace *t);
+
+/* reading (only in little endian machines) */
+struct trace_view {
+  struct mapfile mf;
+  const struct trace_header *header;
+  const char *names;      /* names[nparams][TRACE_NAMELEN] */
+  const char *records;
+  uint64_t nrecords;
+};
+
+int trace_map(const char *path, struct trace_view *v);
+const struct trace_record *trace_get(struct trace_view *v, uint64_t i);
+void trace_unmap(struct trace_view *v);
+
+#endif /* __TRACE_H__ */
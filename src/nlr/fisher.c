@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <fisher.h>
+#include <lvmrq.h>
+#include <gaussjbs.h>
+#include <mathlib.h>
+
+/* fisher_jacobian: derivatives of the model at the points of a dataset with
+ * respect to each parameter, in jac[data->n][model->nparams] (analytic if the
+ * model has them, numeric if not).
+ *
+ * returns 0, or -1 if there is not enough memory
+ */
+int fisher_jacobian(struct model *model, struct dataset *data,
+                    double params[], double *jac)
+{
+    int i, k, m = model->nparams, n = data->n;
+    double *y, p[m];
+    if (model->batch) {
+        if (!(y = malloc(n * sizeof(double)))) {
+            fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+            return -1;
+        }
+        model->batch(n, data->cols, params, y, jac);
+        free(y);
+        return 0;
+    }
+    if (dataset_rows(data))
+        return -1;
+    for (k = 0; k < m; k++)
+        p[k] = params[k];
+    for (i = 0; i < n; i++) {
+        if (model->gradient) {
+            model->gradient(data->x[i], p, &jac[i*m]);
+        } else {
+            for (k = 0; k < m; k++)
+                jac[i*m + k] = dfda(data->x[i], p, model->function, k);
+        }
+    }
+    return 0;
+}
+
+/* eigenvalues: eigenvalues of a symmetric matrix a (which is destroyed) in
+ * ev[n], by Jacobi rotations */
+static void eigenvalues(int n, double a[n][n], double ev[n])
+{
+    int i, j, k, sweep;
+    double off, theta, t, c, s, aki, akj;
+    for (sweep = 0; sweep < 50; sweep++) {
+        for (i = 0, off = 0; i < n; i++)
+            for (j = i + 1; j < n; j++)
+                off += a[i][j] * a[i][j];
+        if (off == 0)
+            break;
+        for (i = 0; i < n; i++) {
+            for (j = i + 1; j < n; j++) {
+                if (a[i][j] == 0)
+                    continue;
+                theta = (a[j][j] - a[i][i]) / (2 * a[i][j]);
+                t = (theta >= 0 ? 1 : -1) /
+                    (fabs(theta) + sqrt(theta * theta + 1));
+                c = 1 / sqrt(t * t + 1);
+                s = t * c;
+                for (k = 0; k < n; k++) {
+                    aki = a[k][i];
+                    akj = a[k][j];
+                    a[k][i] = c * aki - s * akj;
+                    a[k][j] = s * aki + c * akj;
+                }
+                for (k = 0; k < n; k++) {
+                    aki = a[i][k];
+                    akj = a[j][k];
+                    a[i][k] = c * aki - s * akj;
+                    a[j][k] = s * aki + c * akj;
+                }
+            }
+        }
+    }
+    for (i = 0; i < n; i++)
+        ev[i] = a[i][i];
+}
+
+/* fisher: predicts the covariances of the adjusted parameters of an
+ * experiment, given the jacobian of the model at its points, jac[n][m] (see
+ * fisher_jacobian), at the real values of the parameters, and the deviation
+ * of the points. The covariances of the fixed parameters are 0. cond is set
+ * to the condition number of the information of the relative parameters
+ * (each one divided by its value), which does not depend on their units.
+ *
+ * returns 0, 1 if the parameters cannot be identified (cond is larger than
+ * FISHER_MAXCOND; the variances are then infinite), or -1 if there is not
+ * enough memory
+ */
+int fisher(int n, int m, double *jac, double params[m], int fit[m],
+           double sig, double covar[m][m], double *cond)
+{
+    int i, j, k, mfit = 0, adj[m];
+    double scale[m], ev[m], lo, hi;
+    for (i = 0; i < m; i++) {
+        if (fit[i]) {
+            scale[mfit] = params[i] ? fabs(params[i]) : 1;
+            adj[mfit++] = i;
+        }
+    }
+    for (i = 0; i < m; i++)
+        for (j = 0; j < m; j++)
+            covar[i][j] = 0;
+    *cond = 1;
+    if (mfit == 0)
+        return 0;
+    double alpha[mfit][mfit], beta[mfit][1], inv[mfit][mfit], tmp[mfit][mfit];
+    double (*dyda)[mfit] = malloc(n * sizeof(*dyda)),
+           *sigs = malloc(n * sizeof(double)),
+           *zero = calloc(n, sizeof(double));
+    if (!dyda || !sigs || !zero) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+        free(dyda); free(sigs); free(zero);
+        return -1;
+    }
+    /* derivatives with respect to the relative parameters */
+    for (k = 0; k < n; k++) {
+        sigs[k] = sig;
+        for (j = 0; j < mfit; j++)
+            dyda[k][j] = jac[k*m + adj[j]] * scale[j];
+    }
+    buildAlphaBeta(n, mfit, 0, dyda, alpha, beta, sigs, zero, zero);
+    free(dyda);
+    free(sigs);
+    free(zero);
+    mcopy(mfit, mfit, tmp, alpha);
+    eigenvalues(mfit, tmp, ev);
+    for (i = 0, lo = INFINITY, hi = 0; i < mfit; i++) {
+        if (ev[i] < lo)
+            lo = ev[i];
+        if (ev[i] > hi)
+            hi = ev[i];
+    }
+    *cond = lo > 0 ? hi / lo : INFINITY;
+    if (*cond > FISHER_MAXCOND) {
+        for (i = 0; i < mfit; i++)
+            covar[adj[i]][adj[i]] = INFINITY;
+        return 1;
+    }
+    for (i = 0; i < mfit; i++)
+        for (j = 0; j < mfit; j++)
+            inv[i][j] = i == j;
+    gaussj(mfit, mfit, alpha, inv);
+    for (i = 0; i < mfit; i++)
+        for (j = 0; j < mfit; j++)
+            covar[adj[i]][adj[j]] = (inv[i][j] + inv[j][i]) / 2 *
+                                    scale[i] * scale[j];
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef __FISHER_H__
+#define __FISHER_H__
+
+#include <models.h>
+#include <dataset.h>
+
+/* Fisher information of an experiment: with the jacobian J of the model at
+ * the real values of the parameters and a deviation sig of the points, the
+ * information is J'J/sig^2, and its inverse predicts the covariances of the
+ * adjusted parameters without doing any simulation (see --fisher). It is the
+ * matrix alpha of lvmrq with lambda = 0 (see buildAlphaBeta).
+ */
+
+/* the information of a design is taken as singular (some parameter cannot be
+ * identified) if its condition number is larger than this */
+#define FISHER_MAXCOND 1e12
+
+int fisher_jacobian(struct model *model, struct dataset *data,
+                    double params[], double *jac);
+
+int fisher(int n, int m, double *jac, double params[m], int fit[m],
+           double sig, double covar[m][m], double *cond);
+
+#endif /* __FISHER_H__ */
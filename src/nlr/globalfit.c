@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <globalfit.h>
+#include <gaussjbs.h>
+#include <mathlib.h>
+
+/* Same settings as lvmrq (see lvmrq.c) */
+#define CONVERGENCE 1e-20
+#define ITERLIM 500
+#define LAMBDA_FACTOR 10
+#define LAMBDA_START 1e-3
+
+/* Structure of the normal equations of a global fit (see globalfit.h) */
+struct blocks {
+    int ns;         /* number of shared parameters (adjusted ones only) */
+    int *owner;     /* owner[nparams]: dataset owning each parameter, -1 if
+                     * it is shared, -2 if it is not adjusted (or not used) */
+    int *pos;       /* pos[nparams]: position of each adjusted parameter in
+                     * its block */
+    int *shared;    /* shared[ns]: the shared parameters */
+    int *nown;      /* nown[nsets]: number of own parameters of each set */
+    int *first;     /* first[nsets]: position of the first own parameter of
+                     * each set in "own" (and of its rows in D, B, E...) */
+    int *own;       /* own parameters of each set, one set after another */
+    int nown_all;   /* total number of own parameters */
+    int *dfirst;    /* dfirst[nsets]: position of each block D in D */
+    double *A;      /* A[ns][ns] */
+    double *gs;     /* gs[ns]: (-1/2)*gradient, shared parameters */
+    double *B;      /* B[nown_all][ns], B' of each set, one after another */
+    double *D;      /* D of each set (nown[k] x nown[k]) */
+    double *gl;     /* gl[nown_all]: (-1/2)*gradient, own parameters */
+    double *E;      /* E[nown_all][ns]: inv(D)*B' of each set */
+    double *h;      /* h[nown_all]: inv(D)*gl of each set */
+};
+
+/* eval_set: values of the model of a set at its points, with the parameters
+ * of the global fit a[]; if dyda is not NULL, the derivatives with respect to
+ * the parameters of the model are stored in dyda[n][model->nparams]
+ */
+static void eval_set(struct gfit_set *set, double a[], double y[],
+                     double *dyda)
+{
+    struct model *model = set->model;
+    struct dataset *data = set->data;
+    int i, k, m = model->nparams;
+    double p[m];
+    for (k = 0; k < m; k++) {
+        p[k] = a[set->map[k]];
+    }
+    if (model->batch) {
+        model->batch(data->n, data->cols, p, y, dyda);
+    } else if (dyda && model->gradient) {
+        for (i = 0; i < data->n; i++) {
+            y[i] = model->gradient(data->x[i], p, &dyda[i*m]);
+        }
+    } else {
+        for (i = 0; i < data->n; i++) {
+            y[i] = model->function(data->x[i], p);
+            for (k = 0; dyda && k < m; k++) {
+                dyda[i*m + k] = dfda(data->x[i], p, model->function, k);
+            }
+        }
+    }
+}
+
+/* gfit_eval: values of all the datasets (one after another) in y[g->npoints],
+ * with the parameters a[g->nparams] */
+void gfit_eval(struct gfit *g, double a[], double y[])
+{
+    int k;
+    for (k = 0; k < g->nsets; k++) {
+        eval_set(&g->sets[k], a, y, NULL);
+        y += g->sets[k].data->n;
+    }
+}
+
+/* eval_all: values and derivatives of all the datasets. jac holds the
+ * derivatives of each set (n x model->nparams), one set after another */
+static void eval_all(struct gfit *g, double a[], double y[], double *jac)
+{
+    int k;
+    for (k = 0; k < g->nsets; k++) {
+        eval_set(&g->sets[k], a, y, jac);
+        y += g->sets[k].data->n;
+        jac += g->sets[k].data->n * g->sets[k].model->nparams;
+    }
+}
+
+/* gfit_jacobian: derivatives of all the datasets (one after another) with
+ * respect to the parameters of the global fit, in jac[g->npoints][g->nparams]
+ *
+ * returns 0, or -1 if there is not enough memory
+ */
+int gfit_jacobian(struct gfit *g, double a[], double *jac)
+{
+    int i, j, k, m, n, P = g->nparams;
+    double *y = malloc(g->npoints * sizeof(double));
+    double *dyda = malloc(g->npoints * MAX_PARAMS * sizeof(double));
+    if (!y || !dyda) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n",
+                g->npoints);
+        free(y);
+        free(dyda);
+        return -1;
+    }
+    for (i = 0; i < g->npoints * P; i++)
+        jac[i] = 0;
+    for (k = 0; k < g->nsets; k++) {
+        m = g->sets[k].model->nparams;
+        n = g->sets[k].data->n;
+        if (!g->sets[k].model->batch && dataset_rows(g->sets[k].data)) {
+            free(y);
+            free(dyda);
+            return -1;
+        }
+        eval_set(&g->sets[k], a, y, dyda);
+        for (i = 0; i < n; i++, jac += P)
+            for (j = 0; j < m; j++)
+                jac[g->sets[k].map[j]] += dyda[i*m + j];
+    }
+    free(y);
+    free(dyda);
+    return 0;
+}
+
+static double chisq_all(int n, double yi[], double yfit[], double w[])
+{
+    int i;
+    double chisq = 0, tmp;
+    for (i = 0; i < n; i++) {
+        tmp = yi[i] - yfit[i];
+        chisq += tmp * tmp * w[i];
+    }
+    return chisq;
+}
+
+/* blocks_init: classifies the adjusted parameters into shared (used by
+ * several sets) and own ones, and allocates the blocks.
+ * returns 0 on success, -1 if there is not enough memory
+ */
+static int blocks_init(struct blocks *b, struct gfit *g, int fit[])
+{
+    int P = g->nparams, i, k, j, q, nd = 0;
+    memset(b, 0, sizeof(*b));
+    b->owner = malloc(P * sizeof(int));
+    b->pos = malloc(P * sizeof(int));
+    b->shared = malloc(P * sizeof(int));
+    b->own = malloc(P * sizeof(int));
+    b->nown = malloc(g->nsets * sizeof(int));
+    b->first = malloc(g->nsets * sizeof(int));
+    b->dfirst = malloc(g->nsets * sizeof(int));
+    if (!b->owner || !b->pos || !b->shared || !b->own || !b->nown ||
+        !b->first || !b->dfirst)
+        return -1;
+    for (i = 0; i < P; i++) {
+        b->owner[i] = -2;
+    }
+    for (k = 0; k < g->nsets; k++) {
+        for (j = 0; j < g->sets[k].model->nparams; j++) {
+            q = g->sets[k].map[j];
+            if (!fit[q])
+                continue;
+            if (b->owner[q] == -2)
+                b->owner[q] = k;
+            else if (b->owner[q] != k)
+                b->owner[q] = -1;
+        }
+    }
+    for (i = b->ns = 0; i < P; i++) {
+        if (b->owner[i] == -1) {
+            b->pos[i] = b->ns;
+            b->shared[b->ns++] = i;
+        }
+    }
+    for (k = b->nown_all = 0; k < g->nsets; k++) {
+        b->first[k] = b->nown_all;
+        b->dfirst[k] = nd;
+        for (i = b->nown[k] = 0; i < P; i++) {
+            if (b->owner[i] == k) {
+                b->pos[i] = b->nown[k]++;
+                b->own[b->nown_all++] = i;
+            }
+        }
+        nd += b->nown[k] * b->nown[k];
+    }
+    b->A = malloc((b->ns * b->ns + 1) * sizeof(double));
+    b->gs = malloc((b->ns + 1) * sizeof(double));
+    b->B = malloc((b->nown_all * b->ns + 1) * sizeof(double));
+    b->D = malloc((nd + 1) * sizeof(double));
+    b->gl = malloc((b->nown_all + 1) * sizeof(double));
+    b->E = malloc((b->nown_all * b->ns + 1) * sizeof(double));
+    b->h = malloc((b->nown_all + 1) * sizeof(double));
+    if (!b->A || !b->gs || !b->B || !b->D || !b->gl || !b->E || !b->h)
+        return -1;
+    return 0;
+}
+
+static void blocks_free(struct blocks *b)
+{
+    free(b->owner);
+    free(b->pos);
+    free(b->shared);
+    free(b->own);
+    free(b->nown);
+    free(b->first);
+    free(b->dfirst);
+    free(b->A);
+    free(b->gs);
+    free(b->B);
+    free(b->D);
+    free(b->gl);
+    free(b->E);
+    free(b->h);
+}
+
+/* build_blocks: builds the blocks of alpha (1/2*hessian) and beta
+ * (-1/2*gradient) from the derivatives of every set. Only the non-zero blocks
+ * are built: A, and B, D for each set.
+ */
+static void build_blocks(struct blocks *b, struct gfit *g, double yi[],
+                         double yfit[], double w[], double *jac)
+{
+    int ns = b->ns, k, i, j, l, q, r, m, n, nk;
+    double *dy, *D, *B, *gl, res;
+    memset(b->A, 0, ns * ns * sizeof(double));
+    memset(b->gs, 0, ns * sizeof(double));
+    memset(b->B, 0, b->nown_all * ns * sizeof(double));
+    memset(b->gl, 0, b->nown_all * sizeof(double));
+    for (k = 0; k < g->nsets; k++) {
+        m = g->sets[k].model->nparams;
+        n = g->sets[k].data->n;
+        nk = b->nown[k];
+        D = &b->D[b->dfirst[k]];
+        B = &b->B[b->first[k] * ns];
+        gl = &b->gl[b->first[k]];
+        memset(D, 0, nk * nk * sizeof(double));
+        for (i = 0; i < n; i++, jac += m) {
+            dy = jac;
+            res = (yi[i] - yfit[i]) * w[i];
+            for (j = 0; j < m; j++) {
+                q = g->sets[k].map[j];
+                if (b->owner[q] == -2 || dy[j] == 0)
+                    continue;
+                for (l = 0; l < m; l++) {
+                    r = g->sets[k].map[l];
+                    if (b->owner[r] == -2)
+                        continue;
+                    if (b->owner[q] == -1 && b->owner[r] == -1)
+                        b->A[b->pos[q]*ns + b->pos[r]] += dy[j]*dy[l]*w[i];
+                    else if (b->owner[q] == k && b->owner[r] == k)
+                        D[b->pos[q]*nk + b->pos[r]] += dy[j]*dy[l]*w[i];
+                    else if (b->owner[q] == k)
+                        B[b->pos[q]*ns + b->pos[r]] += dy[j]*dy[l]*w[i];
+                }
+                if (b->owner[q] == -1)
+                    b->gs[b->pos[q]] += res * dy[j];
+                else
+                    gl[b->pos[q]] += res * dy[j];
+            }
+        }
+        yi += n;
+        yfit += n;
+        w += n;
+    }
+}
+
+/* reduce: eliminates the own parameters of every set, with the diagonal of
+ * alpha multiplied by (1 + lambda). Stores E = inv(D)*B' and h = inv(D)*gl of
+ * each set, and leaves the Schur complement S = A - sum(B*E) in S[ns][ns] and
+ * gs - sum(B*h) in r[ns]. If dinv is not NULL, the diagonal of each inv(D) is
+ * stored in it.
+ * returns 0 on success, -1 if some block is singular
+ */
+static int reduce(struct blocks *b, struct gfit *g, double lambda,
+                  double S[], double r[], double dinv[])
+{
+    int ns = b->ns, k, i, j, l, nk, c;
+    double *D, *B, *E, *h;
+    for (i = 0; i < ns; i++) {
+        for (j = 0; j < ns; j++) {
+            S[i*ns + j] = b->A[i*ns + j];
+        }
+        S[i*ns + i] *= 1 + lambda;
+        r[i] = b->gs[i];
+    }
+    for (k = 0; k < g->nsets; k++) {
+        if ((nk = b->nown[k]) <= 0)
+            continue;
+        c = ns + 1 + (dinv ? nk : 0); /* columns of the right-hand side */
+        double M[nk][nk], R[nk][c];
+        D = &b->D[b->dfirst[k]];
+        B = &b->B[b->first[k] * ns];
+        E = &b->E[b->first[k] * ns];
+        h = &b->h[b->first[k]];
+        for (l = 0; l < nk; l++) {
+            for (j = 0; j < nk; j++) {
+                M[l][j] = D[l*nk + j];
+            }
+            M[l][l] *= 1 + lambda;
+            for (i = 0; i < ns; i++) {
+                R[l][i] = B[l*ns + i];
+            }
+            R[l][ns] = b->gl[b->first[k] + l];
+            for (j = ns + 1; j < c; j++) {
+                R[l][j] = (j - ns - 1 == l);
+            }
+        }
+        if (gaussj(nk, c, M, R))
+            return -1;
+        for (l = 0; l < nk; l++) {
+            for (i = 0; i < ns; i++) {
+                E[l*ns + i] = R[l][i];
+            }
+            h[l] = R[l][ns];
+            if (dinv)
+                dinv[b->first[k] + l] = R[l][ns + 1 + l];
+        }
+        /* S -= B*E, r -= B*h (B of the set is stored transposed) */
+        for (i = 0; i < ns; i++) {
+            for (l = 0; l < nk; l++) {
+                for (j = 0; j < ns; j++) {
+                    S[i*ns + j] -= B[l*ns + i] * E[l*ns + j];
+                }
+                r[i] -= B[l*ns + i] * h[l];
+            }
+        }
+    }
+    return 0;
+}
+
+/* solve: solves the damped normal equations, and stores the increment of
+ * every parameter in delta[nparams] (0 for the fixed ones).
+ * returns 0 on success, -1 if the equations are singular
+ */
+static int solve(struct blocks *b, struct gfit *g, double lambda,
+                 double delta[])
+{
+    int ns = b->ns, i, l;
+    double S[ns ? ns*ns : 1], r[ns ? ns : 1], tmp;
+    if (reduce(b, g, lambda, S, r, NULL))
+        return -1;
+    if (ns > 0 && gaussj(ns, 1, (double (*)[ns]) S, (double (*)[1]) r))
+        return -1;
+    memset(delta, 0, g->nparams * sizeof(double));
+    for (i = 0; i < ns; i++) {
+        delta[b->shared[i]] = r[i];
+    }
+    /* back-substitution of the own parameters: inv(D)*(gl - B'*ds) */
+    for (l = 0; l < b->nown_all; l++) {
+        tmp = b->h[l];
+        for (i = 0; i < ns; i++) {
+            tmp -= b->E[l*ns + i] * r[i];
+        }
+        delta[b->own[l]] = tmp;
+    }
+    return 0;
+}
+
+/* variances: diagonal of inv(alpha), from the inverse of the Schur complement
+ * (the covariances of the shared parameters) and the blocks of each set:
+ *
+ *      cov(own, own) = inv(D) + E'*inv(S)*E
+ *
+ * returns 0 on success, -1 if alpha is singular
+ */
+static int variances(struct blocks *b, struct gfit *g, double var[])
+{
+    int ns = b->ns, i, j, l;
+    double S[ns ? ns*ns : 1], r[ns ? ns : 1], Sinv[ns ? ns*ns : 1];
+    double dinv[b->nown_all + 1], tmp;
+    memset(var, 0, g->nparams * sizeof(double));
+    if (reduce(b, g, 0, S, r, dinv))
+        return -1;
+    for (i = 0; i < ns; i++) {
+        for (j = 0; j < ns; j++) {
+            Sinv[i*ns + j] = (i == j);
+        }
+    }
+    if (ns > 0 && gaussj(ns, ns, (double (*)[ns]) S, (double (*)[ns]) Sinv))
+        return -1;
+    for (i = 0; i < ns; i++) {
+        var[b->shared[i]] = Sinv[i*ns + i];
+    }
+    for (l = 0; l < b->nown_all; l++) {
+        tmp = dinv[l];
+        for (i = 0; i < ns; i++) {
+            for (j = 0; j < ns; j++) {
+                tmp += b->E[l*ns + i] * Sinv[i*ns + j] * b->E[l*ns + j];
+            }
+        }
+        var[b->own[l]] = tmp;
+    }
+    return 0;
+}
+
+/* gfit_lvmrq: global fit of several datasets (see globalfit.h), using the
+ * Levenberg-Marquardt method as lvmrq, but solving the normal equations by
+ * blocks.
+ *
+ * Once the function has been called, "a" contains the adjusted parameters and
+ * "var" the variances of the parameters (the diagonal of the matrix of
+ * covariances, which is not built).
+ *
+ * returns the number of iterations, or -1 if there is not enough memory
+ */
+int gfit_lvmrq(struct gfit *g, double yi[], double a[], int fit[],
+               double sig[], double var[], double results[2])
+{
+    int n = g->npoints, P = g->nparams, i, iters = 0, size = 0;
+    struct blocks b;
+    double *yfit, *ytry, *jac, *jtry, *w, *swap;
+    double anew[P], delta[P], lambda, chisq, tmp, conv;
+
+    for (i = 0; i < g->nsets; i++) {
+        size += g->sets[i].data->n * g->sets[i].model->nparams;
+    }
+    yfit = malloc(n * sizeof(double));
+    ytry = malloc(n * sizeof(double));
+    w = malloc(n * sizeof(double));
+    jac = malloc(size * sizeof(double));
+    jtry = malloc(size * sizeof(double));
+    if (blocks_init(&b, g, fit) || !yfit || !ytry || !w || !jac || !jtry) {
+        blocks_free(&b);
+        free(yfit); free(ytry); free(w); free(jac); free(jtry);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        w[i] = sig ? 1 / (sig[i] * sig[i]) : 1;
+    }
+
+    eval_all(g, a, yfit, jac);
+    chisq = chisq_all(n, yi, yfit, w);
+    lambda = LAMBDA_START;
+    conv = CONVERGENCE + 1;
+    while (iters < ITERLIM && (conv > CONVERGENCE || conv < 0) && chisq) {
+        iters++;
+        build_blocks(&b, g, yi, yfit, w, jac);
+        if (solve(&b, g, lambda, delta)) {
+            lambda *= LAMBDA_FACTOR;
+            conv = -1;
+            continue;
+        }
+        for (i = 0; i < P; i++) {
+            anew[i] = a[i] + delta[i];
+        }
+        eval_all(g, anew, ytry, jtry);
+        tmp = chisq_all(n, yi, ytry, w);
+        conv = chisq - tmp;
+        if (isnan(tmp) || conv <= 0) { /* worse fit */
+            lambda *= LAMBDA_FACTOR;
+            if (isnan(tmp))
+                conv = -1;
+        } else { /* better fit */
+            memcpy(a, anew, P * sizeof(double));
+            swap = yfit; yfit = ytry; ytry = swap;
+            swap = jac; jac = jtry; jtry = swap;
+            chisq = tmp;
+            lambda /= LAMBDA_FACTOR;
+        }
+    }
+
+    /* covariances with lambda = 0. If the deviations were not known, they are
+     * estimated as the variance of the residues */
+    build_blocks(&b, g, yi, yfit, w, jac);
+    if (variances(&b, g, var)) {
+        for (i = 0; i < P; i++) {
+            var[i] = fit[i] ? INFINITY : 0;
+        }
+    }
+    if (!sig) {
+        for (i = 0; i < P; i++) {
+            var[i] *= chisq / n;
+        }
+    }
+    blocks_free(&b);
+    free(yfit); free(ytry); free(w); free(jac); free(jtry);
+    results[0] = chisq;
+    results[1] = -conv;
+    return iters;
+}
@@ -0,0 +1,55 @@
+#ifndef __GLOBALFIT_H__
+#define __GLOBALFIT_H__
+
+#include <models.h>
+#include <dataset.h>
+
+/* Global fit: several datasets, each with its own model, fitted at once.
+ * Every parameter of each model is an entry of the vector of parameters of
+ * the global fit (map[]); the entries used by several datasets are shared
+ * by them, the rest belong to a single dataset.
+ *
+ * The jacobian is block-sparse (each dataset depends on the shared
+ * parameters and on its own ones), so the normal equations have an arrow
+ * shape:
+ *
+ *          | A    B1   B2  ... |   shared
+ *          | B1'  D1           |   own parameters of dataset 1
+ *          | B2'       D2      |   own parameters of dataset 2
+ *          | ...           ... |
+ *
+ * and are solved by means of the Schur complement of the blocks D,
+ * S = A - sum(B*inv(D)*B'), which is only as large as the number of shared
+ * parameters.
+ */
+
+struct gfit_set {
+  struct model *model;    /* model of the dataset */
+  struct dataset *data;   /* points of the dataset */
+  int map[MAX_PARAMS];    /* index of each parameter of the model in the
+                           * vector of parameters of the global fit */
+};
+
+struct gfit {
+  int nsets;              /* number of datasets */
+  struct gfit_set *sets;  /* the datasets */
+  int nparams;            /* number of parameters of the global fit */
+  int npoints;            /* total number of points (sum of the datasets) */
+};
+
+void gfit_eval(struct gfit *g, double a[], double y[]);
+int gfit_jacobian(struct gfit *g, double a[], double *jac);
+
+int gfit_lvmrq(
+           struct gfit *g,
+           double yi[],           /* data, dataset after dataset */
+           double a[],            /* parameters (guess), g->nparams */
+           int fit[],             /* fit[i]=1 --> adjust a[i].
+                                   * fit[i]=0 --> keep a[i] fixed. */
+           double sig[],          /* deviation of each point, or NULL */
+           double var[],          /* variances of the parameters (0 for the
+                                   * fixed ones) */
+           double results[2]);    /* results[0] = final chi2.
+                                   * results[1] = final increment in chi2 */
+
+#endif /* __GLOBALFIT_H__ */
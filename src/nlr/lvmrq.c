@@ -1,4 +1,7 @@
+#include <stdio.h>
+#include <stdlib.h>
 #include "lvmrq.h"
+#include <stddef.h>
 #include <gaussjbs.h>
 #include <matrix.h>
 #include <mathlib.h>
@@ -15,10 +18,8 @@
  *
  * Input parameters:
  *
- * "n"                     -> number of data points
  * "m"                     -> number of parameters of the model
- * "nvars"                 -> number of independent variables in the model
- * "xi[n][nvars]","yi[n]"  -> data points
+ * "data", "yi[n]"         -> data points (n = data->n)
  * "a[m]" -> is the set of "m" parameters, from which the first "mfit" will
  *           be adjusted, and the next (m - mfit) will be kept fixed.
  * "*fit[m]" -> pointer to array indicating what parameters to adjust. If fit[i]
@@ -26,6 +27,10 @@
  * "f(double xi[], double params[])" -> the model function, which accepts an
  *                                      array of independent variables "xi[]"
  *                                      and an array of parameters "params[]"
+ * "df", "fbatch" -> optional analytic versions of the model (gradient at one
+ *                   point and values/gradients at all the points, as
+ *                   model->gradient and model->batch in models.h). Set them to
+ *                   NULL to obtain the derivatives numerically.
  * "covar[mfit][mfit]" -> a matrix into which the covariances will be stored
  * "knownsig" -> set it to 1 if an array of standard deviations is passed. If
  *               not, set it to 0.
@@ -39,23 +44,26 @@
  * results[2] holds the value of chi2 and the convergence value
  */
 double lvmrq(
-           int n,                     /* number of points */
            int m,                     /* number of parameters */
            int mfit,
-           int nvars,                 /* number of independent variables */
-           double *xi[nvars],       /* data points */
-           double yi[n],
+           struct dataset *data,      /* data points */
+           double yi[],
            double a0[m],               /* parameters (guess) */
            int fit[m],                 /* array indicating what parameters
                                        * to fix (0) and what ones to adjust (1)
                                        */
            double f(double x[], double params[]), /* model function */
+           double (*df)(double x[], double params[], double dyda[]),
+           void (*fbatch)(int n, double *x[], double params[], double y[],
+                          double *dyda),
            double covar[][mfit],
-           double *sigp[n],           /* pointer to array of deviations, set
+           double *sigp[],              /* pointer to array of deviations, set
                                          it to NULL if they are not known */
            double results[2])
 {
     /* definitions here */
+    int n = data->n, nvars = data->nvars;
+    double **xi = data->x;
     int i, j, iters = 0;
     int a_order[m];   /* indicates the original order of the params */
 
@@ -63,12 +71,22 @@ double lvmrq(
            a[m],               /* reordered parameters, adjustable first */
            alpha[mfit][mfit],  /* (1/2) * hessian matrix */
            beta[mfit][1],      /* (-1/2)*gradient vector */
-           yfit[n],            /* will hold the fitted values for each xi */
-           dyda[n][mfit],      /* derivatives. Each row contains the derivatives
-                                * at one point with respect to each parameter */
            anew[m],            /* new values of the parameters (a + ainc) */
-           sig[n],             /* array of standard deviations */
            lambda, tmp, conv;
+    /* the arrays with a value per point are kept in the heap, as there might
+     * be many points */
+    double *yfit = malloc(n * sizeof(double)), /* fitted values for each xi */
+           (*dyda)[mfit] = malloc(n * sizeof(*dyda)),
+                               /* derivatives. Each row contains the derivatives
+                                * at one point with respect to each parameter */
+           *dyda_all = (fbatch || df) ? malloc(n * m * sizeof(double)) : NULL,
+           *sig = malloc(n * sizeof(double)); /* standard deviations */
+    if (!yfit || !dyda || !sig || ((fbatch || df) && !dyda_all)) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+        free(yfit); free(dyda); free(dyda_all); free(sig);
+        results[0] = results[1] = NAN;
+        return -1;
+    }
     /* Build the array of deviations */
     if (sigp != NULL) { /* if deviations are known */
         for (i = 0; i < n; i++) {
@@ -104,7 +122,24 @@ double lvmrq(
         int i, k;
         double a_local[m];
         for (i = 0; i < m; i++) {
-            a_local[i] = a[a_order[i]];
+            a_local[a_order[i]] = a[i];
+        }
+        /* with analytic derivatives, obtain those with respect to all the
+         * parameters, and take the adjustable ones */
+        if (fbatch) {
+            fbatch(n, data->cols, a_local, yfit, dyda_all);
+        } else if (df) {
+            for (i = 0; i < n; i++) {
+                yfit[i] = df(xi[i], a_local, &dyda_all[i*m]);
+            }
+        }
+        if (fbatch || df) {
+            for (i = 0; i < n; i++) {
+                for (k = 0; k < mfit; k++) {
+                    dyda[i][k] = dyda_all[i*m + a_order[k]];
+                }
+            }
+            return;
         }
         for (i = 0; i < n; i++) {
             /* obtain fitted ys */
@@ -160,8 +195,9 @@ double lvmrq(
      * residues */
     if (!sigp) {
         tmp = 0;
+        func(n, m, mfit, nvars, xi, yi, a, dyda, yfit);
         for (i = 0; i < n; i++) {
-            sig[0] = (yi[i] - f(xi[i], a));
+            sig[0] = (yi[i] - yfit[i]);
             sig[0] *= sig[0];
             tmp += sig[0];
         }
@@ -204,6 +240,10 @@ double lvmrq(
         mprint(mfit, mfit, covar);
         printf("****************************************\n");
     }
+    free(yfit);
+    free(dyda);
+    free(dyda_all);
+    free(sig);
     results[0] = chisq;
     results[1] = -conv;
     return iters;
@@ -1,22 +1,26 @@
 #define VERBOSE 0
 #ifndef __NLR__
   #define __NLR__
+#include <dataset.h>
 
 double chisquare(int n, double yi[n], double yfit[n], double sig[n]);
 
 double lvmrq(
-           int n,                       /* number of points */
            int m,                       /* number of parameters */
            int mfit,                    /* number of parameters to adjust */
-           int nvars,                   /* number of independent variables */
-           double *xi[nvars],         /* data points */
-           double yi[n],
+           struct dataset *data,        /* data points */
+           double yi[],
            double a[m],                 /* parameters (guess) */
            int fit[m],                  /* fit[i]=1 --> adjust a[i].
                                          * fit[i]=0 --> keep a[i] fixed. */
            double f(double x[], double params[]), /* model function */
+           double (*df)(double x[], double params[], double dyda[]),
+                                        /* analytic gradient, or NULL */
+           void (*fbatch)(int n, double *x[], double params[], double y[],
+                          double *dyda),
+                                        /* batch version, or NULL */
            double covar[][mfit],
-           double *sigp[n],             /* pointer to array of deviations, set
+           double *sigp[],              /* pointer to array of deviations, set
                                            to NULL if they are not known */
            double results[2]);          /* results[0] = final chi2.
                                          * results[1] = final increment in chi2
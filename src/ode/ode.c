@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ode.h>
+
+/* Integration of the models defined by ODEs (see ode.h), with the
+ * Dormand-Prince embedded Runge-Kutta method of order 5(4) and adaptive step
+ * size. The error of the sensitivities is controlled along with the error of
+ * the states, so that the derivatives are as accurate as the values.
+ */
+
+#define RTOL 1e-8       /* relative tolerance */
+#define ATOL 1e-12      /* absolute tolerance */
+#define MAXSTEPS 100000 /* maximum number of steps per curve */
+#define SAFETY 0.9      /* safety factor for the new step size */
+#define MINFAC 0.2      /* limits to the change of the step size */
+#define MAXFAC 5.0
+
+/* Dormand-Prince coefficients */
+static const double c[7] = {0, 1.0/5, 3.0/10, 4.0/5, 8.0/9, 1, 1};
+static const double a[7][6] = {
+    {0},
+    {1.0/5},
+    {3.0/40, 9.0/40},
+    {44.0/45, -56.0/15, 32.0/9},
+    {19372.0/6561, -25360.0/2187, 64448.0/6561, -212.0/729},
+    {9017.0/3168, -355.0/33, 46732.0/5247, 49.0/176, -5103.0/18656},
+    {35.0/384, 0, 500.0/1113, 125.0/192, -2187.0/6784, 11.0/84}
+};
+/* difference between the solutions of order 5 and 4 */
+static const double e[7] = {71.0/57600, 0, -71.0/16695, 71.0/1920,
+                            -17253.0/339200, 22.0/525, -1.0/40};
+
+/* deriv: right-hand side of the extended system z = {x, dx/dp}. The
+ * sensitivities are integrated only if "sens" is set */
+static void deriv(struct ode_model *om, const double cst[], double t,
+                  const double z[], const double p[], double dz[], int sens)
+{
+    int d = om->nstates, m = om->nparams, i, j, k;
+    double dfdx[d*d], dfdp[d*m];
+    if (!sens) {
+        om->rhs(cst, t, z, p, dz, NULL, NULL);
+        return;
+    }
+    om->rhs(cst, t, z, p, dz, dfdx, dfdp);
+    /* dS/dt = df/dx * S + df/dp, with S[d][m] placed after the states */
+    for (i = 0; i < d; i++) {
+        for (j = 0; j < m; j++) {
+            dz[d + i*m + j] = dfdp[i*m + j];
+            for (k = 0; k < d; k++) {
+                dz[d + i*m + j] += dfdx[i*d + k] * z[d + k*m + j];
+            }
+        }
+    }
+}
+
+/* ode_solve: integrates the model for the curve with constants c[], from
+ * t = 0 up to the times t[nt] (sorted in ascending order), and stores in y[nt]
+ * the value of the observed state at each time. If dydp is not NULL, its
+ * derivatives with respect to the parameters are stored in dydp[nt][nparams].
+ *
+ * returns 0 on success, -1 if the integration failed (the values not reached
+ * are set to NAN)
+ */
+int ode_solve(struct ode_model *om, const double cst[], const double p[],
+              int nt, const double t[], double y[], double *dydp)
+{
+    int d = om->nstates, m = om->nparams, sens = dydp != NULL;
+    int dim = sens ? d*(1 + m) : d;
+    int i, j, s, out = 0, steps = 0, hit;
+    double z[dim], znew[dim], k[7][dim], tcur = 0, h, hstep, err, tmp, fac;
+
+    if (om->init) {
+        om->init(cst, p, z, sens ? &z[d] : NULL);
+    } else {
+        memset(z, 0, dim * sizeof(double));
+    }
+    if (sens && om->init == NULL) {
+        memset(&z[d], 0, d*m * sizeof(double));
+    }
+    /* first guess of the step size, adjusted by the error control */
+    h = (nt > 0 && t[nt - 1] > 0 ? t[nt - 1] : 1) * 1e-4;
+    deriv(om, cst, tcur, z, p, k[0], sens);
+    for (;;) {
+        /* store the outputs at the current time */
+        while (out < nt && t[out] <= tcur) {
+            y[out] = z[0];
+            for (j = 0; sens && j < m; j++) {
+                dydp[out*m + j] = z[d + j];
+            }
+            out++;
+        }
+        if (out == nt)
+            return 0;
+        if (++steps > MAXSTEPS || h < 1e-14 * (fabs(tcur) + 1e-300))
+            break;
+        /* do not step over the next output time */
+        hstep = h;
+        hit = tcur + hstep >= t[out];
+        if (hit)
+            hstep = t[out] - tcur;
+        /* stages 2...7 (k[0] is the derivative at tcur) */
+        for (s = 1; s < 7; s++) {
+            for (i = 0; i < dim; i++) {
+                tmp = z[i];
+                for (j = 0; j < s; j++) {
+                    tmp += hstep * a[s][j] * k[j][i];
+                }
+                znew[i] = tmp;
+            }
+            deriv(om, cst, tcur + c[s]*hstep, znew, p, k[s], sens);
+        }
+        /* znew is now the solution of order 5 (a[6] are its weights); the
+         * error is estimated with the embedded solution of order 4 */
+        err = 0;
+        for (i = 0; i < dim; i++) {
+            tmp = 0;
+            for (s = 0; s < 7; s++) {
+                tmp += e[s] * k[s][i];
+            }
+            tmp *= hstep / (ATOL + RTOL*fmax(fabs(z[i]), fabs(znew[i])));
+            err += tmp * tmp;
+        }
+        err = sqrt(err / dim);
+        if (err <= 1) { /* accept the step */
+            tcur = hit ? t[out] : tcur + hstep;
+            memcpy(z, znew, dim * sizeof(double));
+            memcpy(k[0], k[6], dim * sizeof(double)); /* first same as last */
+        }
+        if (!isfinite(err))
+            fac = MINFAC;
+        else
+            fac = err > 0 ? fmin(MAXFAC, fmax(MINFAC,
+                                 SAFETY * pow(err, -0.2))) : MAXFAC;
+        /* a step shortened to hit an output time must not reduce the step
+         * size proposed for the next ones */
+        if (hit && err <= 1)
+            h = fmax(h, hstep * fac);
+        else
+            h = hstep * fac;
+    }
+    for (; out < nt; out++) {
+        y[out] = NAN;
+        for (j = 0; sens && j < m; j++) {
+            dydp[out*m + j] = NAN;
+        }
+    }
+    return -1;
+}
+
+/* ode_point: value of the model at one point X = {t, c...}; if dyda is not
+ * NULL, its derivatives are stored in dyda[nparams] */
+double ode_point(struct ode_model *om, double X[], double p[], double dyda[])
+{
+    double y;
+    ode_solve(om, &X[1], p, 1, &X[0], &y, dyda);
+    return y;
+}
+
+struct points {
+    int nvars;
+    double **X;
+};
+
+/* order of the points: by constants of the curve, then by time */
+static int cmp_points(const void *pa, const void *pb, void *arg)
+{
+    struct points *pts = arg;
+    int i = *(const int *) pa, j = *(const int *) pb, k;
+    for (k = 1; k <= pts->nvars; k++) {
+        /* constants (k = 1...nvars-1) first, time (k = nvars -> 0) last */
+        double xi = pts->X[k % pts->nvars][i];
+        double xj = pts->X[k % pts->nvars][j];
+        if (xi != xj)
+            return xi < xj ? -1 : 1;
+    }
+    return i - j;
+}
+
+/* ode_batch: values of the model at n points, given as the columns X[0] (t)
+ * X[1]... (constants). If dyda is not NULL, their derivatives are stored in
+ * dyda[n][nparams]. Each curve is integrated only once.
+ *
+ * returns 0, or -1 if there is not enough memory (the values are then set to
+ * NAN, as those of a failed integration)
+ */
+int ode_batch(struct ode_model *om, int n, double *X[], double p[],
+              double y[], double *dyda)
+{
+    int nvars = om->nconst + 1, m = om->nparams;
+    int i, j, first, last, k;
+    int *order = malloc(n * sizeof(int));
+    double *t = malloc(n * sizeof(double));
+    double *yc = malloc(n * sizeof(double));
+    double *dc = dyda ? malloc(n * m * sizeof(double)) : NULL;
+    double cst[om->nconst > 0 ? om->nconst : 1];
+    struct points pts = {nvars, X};
+
+    if (n > 0 && (!order || !t || !yc || (dyda && !dc))) {
+        fprintf(stderr, "Error: not enough memory for %d points.\n", n);
+        for (i = 0; i < n; i++) {
+            y[i] = NAN;
+            for (j = 0; dyda && j < m; j++) {
+                dyda[i*m + j] = NAN;
+            }
+        }
+        free(order);
+        free(t);
+        free(yc);
+        free(dc);
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    qsort_r(order, n, sizeof(int), cmp_points, &pts);
+
+    for (first = 0; first < n; first = last) {
+        /* the points [first, last) belong to the same curve */
+        for (j = 0; j < om->nconst; j++) {
+            cst[j] = X[j + 1][order[first]];
+        }
+        for (last = first; last < n; last++) {
+            for (j = 0; j < om->nconst; j++) {
+                if (X[j + 1][order[last]] != cst[j])
+                    break;
+            }
+            if (j < om->nconst)
+                break;
+            t[last - first] = X[0][order[last]];
+        }
+        ode_solve(om, cst, p, last - first, t, yc, dc);
+        for (k = first; k < last; k++) {
+            y[order[k]] = yc[k - first];
+            for (j = 0; dyda && j < m; j++) {
+                dyda[order[k]*m + j] = dc[(k - first)*m + j];
+            }
+        }
+    }
+    free(order);
+    free(t);
+    free(yc);
+    free(dc);
+    return 0;
+}
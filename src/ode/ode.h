@@ -0,0 +1,53 @@
+#ifndef __ODE_H__
+#define __ODE_H__
+
+/* Models defined by a system of ordinary differential equations, such as
+ * progress curves. Each data point is X = {t, c[0], c[1], ...}: the time and
+ * the constants of its curve (e.g. the initial substrate concentration).
+ * The points with the same constants belong to the same curve, which is
+ * integrated once for all of them.
+ *
+ * Along with the states, the integration gives their derivatives with
+ * respect to the parameters (forward sensitivities), by integrating
+ *
+ *      d(dx/dp)/dt = (df/dx)*(dx/dp) + df/dp
+ *
+ * so the derivatives of the model are obtained without finite differences.
+ */
+struct ode_model {
+  int nstates;   /* number of state variables; the first one is observed */
+  int nparams;   /* number of parameters */
+  int nconst;    /* number of constants of each curve */
+  /* initial state x0[nstates] and its derivatives dx0dp[nstates][nparams]
+   * (if dx0dp is not NULL). If NULL, the initial state is zero. */
+  void (*init)(const double c[], const double p[], double x0[],
+               double *dx0dp);
+  /* right-hand side: dxdt[nstates] = f(t, x). If dfdx is not NULL, the
+   * jacobians dfdx[nstates][nstates] and dfdp[nstates][nparams] too. */
+  void (*rhs)(const double c[], double t, const double x[], const double p[],
+              double dxdt[], double *dfdx, double *dfdp);
+};
+
+int ode_solve(struct ode_model *om, const double c[], const double p[],
+              int nt, const double t[], double y[], double *dydp);
+double ode_point(struct ode_model *om, double X[], double p[], double dyda[]);
+int ode_batch(struct ode_model *om, int n, double *X[], double p[],
+              double y[], double *dyda);
+
+/* Defines the functions required by struct model (see models.h) for the
+ * ode_model "om": name, name_grad and name_batch */
+#define ODE_MODEL(name, om) \
+  double name(double X[], double p[]) \
+  { \
+    return ode_point(&(om), X, p, NULL); \
+  } \
+  double name##_grad(double X[], double p[], double dyda[]) \
+  { \
+    return ode_point(&(om), X, p, dyda); \
+  } \
+  void name##_batch(int n, double *X[], double p[], double y[], double *dyda) \
+  { \
+    ode_batch(&(om), n, X, p, y, dyda); \
+  }
+
+#endif /* __ODE_H__ */
@@ -0,0 +1,682 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <parse.h>
+#include <dataset.h>
+
+/* maximum number of columns of a table */
+#define MAX_COLUMNS 256
+
+/* parse_init: prepares the parser to read the "len" characters of buf. "name"
+ * is used in the error messages (eg. "--data", or the name of a file) */
+void parse_init(struct parser *p, const char *name, const char *buf,
+                size_t len)
+{
+    p->name = name;
+    p->buf = buf;
+    p->pos = 0;
+    p->end = len;
+    p->err = stderr;
+}
+
+/* parse_error: prints an error found at the position "pos" of the input, with
+ * a printf-like message.
+ * returns -1, so that it can be returned by the caller
+ */
+int parse_error(struct parser *p, size_t pos, const char *fmt, ...)
+{
+    va_list ap;
+    size_t i, line = 1, col = 1;
+    /* the line and column are only needed here, so they are not kept
+     * while parsing */
+    for (i = 0; i < pos; i++) {
+        if (p->buf[i] == '\n') {
+            line++;
+            col = 1;
+        } else {
+            col++;
+        }
+    }
+    fprintf(p->err, "Error: %s:%zu:%zu: ", p->name, line, col);
+    va_start(ap, fmt);
+    vfprintf(p->err, fmt, ap);
+    va_end(ap);
+    fprintf(p->err, "\n");
+    return -1;
+}
+
+static void skip_blanks(struct parser *p)
+{
+    while (p->pos < p->end && isspace((unsigned char) p->buf[p->pos]))
+        p->pos++;
+}
+
+/* skip_inline: skips the blanks and commas which separate the values of a
+ * line, but not the end of the line */
+static void skip_inline(struct parser *p)
+{
+    while (p->pos < p->end && p->buf[p->pos] != '\n' &&
+           (isspace((unsigned char) p->buf[p->pos]) || p->buf[p->pos] == ','))
+        p->pos++;
+}
+
+/* skip_field: skips a value of a line, which might be other than a number
+ * (eg. a quoted text) */
+static void skip_field(struct parser *p)
+{
+    if (p->buf[p->pos] == '"') {
+        for (p->pos++; p->pos < p->end && p->buf[p->pos] != '"'; p->pos++)
+            ;
+        p->pos += p->pos < p->end;
+        return;
+    }
+    while (p->pos < p->end && !strchr(",\t \r\n", p->buf[p->pos]))
+        p->pos++;
+}
+
+static int end_of_line(struct parser *p)
+{
+    return p->pos == p->end || p->buf[p->pos] == '\n';
+}
+
+/* parse_end: returns 1 if there is nothing but blanks left, 0 if not */
+int parse_end(struct parser *p)
+{
+    skip_blanks(p);
+    return p->pos == p->end;
+}
+
+/* parse_char: returns 1 and skips the character c if it is the next one, 0 if
+ * not */
+int parse_char(struct parser *p, char c)
+{
+    skip_blanks(p);
+    if (p->pos < p->end && p->buf[p->pos] == c) {
+        p->pos++;
+        return 1;
+    }
+    return 0;
+}
+
+/* parse_name: reads a name (letters, digits and '_', not starting with a
+ * digit), and points *name to it.
+ * returns its length, 0 if the next token is not a name
+ */
+size_t parse_name(struct parser *p, const char **name)
+{
+    size_t start;
+    skip_blanks(p);
+    start = p->pos;
+    if (p->pos < p->end && (isalpha((unsigned char) p->buf[p->pos]) ||
+                            p->buf[p->pos] == '_')) {
+        while (p->pos < p->end && (isalnum((unsigned char) p->buf[p->pos]) ||
+                                   p->buf[p->pos] == '_'))
+            p->pos++;
+    }
+    *name = &p->buf[start];
+    return p->pos - start;
+}
+
+/* parse_number: reads a number, in decimal or exponential notation, with the
+ * precision of strtod.
+ * returns 0 on success, -1 if the next token is not a number
+ */
+int parse_number(struct parser *p, double *x)
+{
+    size_t start, len;
+    char tmp[64], *str, *endptr;
+    skip_blanks(p);
+    start = p->pos;
+    while (p->pos < p->end && (isdigit((unsigned char) p->buf[p->pos]) ||
+                               strchr(".eE+-", p->buf[p->pos])))
+        p->pos++;
+    len = p->pos - start;
+    if (len == 0)
+        return parse_error(p, start, "expected a number");
+    /* strtod needs a string ending with '\0', which the input might not be */
+    str = len < sizeof(tmp) ? tmp : malloc(len + 1);
+    if (!str)
+        return parse_error(p, start, "not enough memory");
+    memcpy(str, &p->buf[start], len);
+    str[len] = '\0';
+    *x = strtod(str, &endptr);
+    if (str != tmp)
+        free(str);
+    if ((size_t) (endptr - str) != len)
+        return parse_error(p, start, "invalid number");
+    return 0;
+}
+
+/* parse_integer: reads a non-negative integer, in decimal notation, which
+ * fits in 64 bits (eg. a seed), without going through a double.
+ * returns 0 on success, -1 if the next token is not such an integer
+ */
+int parse_integer(struct parser *p, uint64_t *x)
+{
+    size_t start, len;
+    char tmp[32];
+    skip_blanks(p);
+    start = p->pos;
+    while (p->pos < p->end && isdigit((unsigned char) p->buf[p->pos]))
+        p->pos++;
+    len = p->pos - start;
+    if (len == 0)
+        return parse_error(p, start, "expected a non-negative integer");
+    /* strtoull needs a string ending with '\0', as strtod */
+    if (len >= sizeof(tmp))
+        return parse_error(p, start, "integer out of range");
+    memcpy(tmp, &p->buf[start], len);
+    tmp[len] = '\0';
+    errno = 0;
+    *x = strtoull(tmp, NULL, 10);
+    if (errno == ERANGE)
+        return parse_error(p, start, "integer out of range");
+    return 0;
+}
+
+/* parse_array: reads an array of numbers, separated by commas or blanks,
+ * between brackets (eg. "[1, 2.5, 1e3]"). *values is set to a new array
+ * holding them (NULL if there is none), which must be freed.
+ * returns the number of values, or -1 on failure
+ */
+long parse_array(struct parser *p, double **values)
+{
+    size_t n = 0, size = 0;
+    double *tmp;
+    *values = NULL;
+    if (!parse_char(p, '['))
+        return parse_error(p, p->pos, "expected '['");
+    while (!parse_char(p, ']')) {
+        if (parse_end(p)) {
+            free(*values);
+            *values = NULL;
+            return parse_error(p, p->pos, "expected ']'");
+        }
+        if (n == size) {
+            size = size ? 2*size : 64;
+            if (!(tmp = realloc(*values, size * sizeof(double)))) {
+                free(*values);
+                *values = NULL;
+                return parse_error(p, p->pos, "not enough memory");
+            }
+            *values = tmp;
+        }
+        if (parse_number(p, &(*values)[n])) {
+            free(*values);
+            *values = NULL;
+            return -1;
+        }
+        n++;
+        parse_char(p, ',');
+    }
+    return n;
+}
+
+/* starts_section: whether a section of a template starts at "pos": a line
+ * whose first character (other than blanks) is '-', followed by blanks and a
+ * letter (so that it is not taken for a negative number)
+ */
+static int starts_section(struct parser *p, size_t pos)
+{
+    while (pos < p->end && (p->buf[pos] == ' ' || p->buf[pos] == '\t'))
+        pos++;
+    if (pos == p->end || p->buf[pos++] != '-')
+        return 0;
+    while (pos < p->end && (p->buf[pos] == ' ' || p->buf[pos] == '\t'))
+        pos++;
+    return pos < p->end && isalpha((unsigned char) p->buf[pos]);
+}
+
+/* parse_section: reads a section of a template, as
+ *
+ *      - Title: body
+ *
+ * where the body goes on until the next section or the end of the input.
+ * *title is pointed to the title (of length *len, with no blanks around) and
+ * "body" is set to parse the body.
+ * returns 1 if a section has been read, 0 at the end of the input, -1 on
+ * failure
+ */
+int parse_section(struct parser *p, const char **title, size_t *len,
+                  struct parser *body)
+{
+    size_t start, pos;
+    if (parse_end(p))
+        return 0;
+    start = p->pos;
+    if (!parse_char(p, '-') || !starts_section(p, start))
+        return parse_error(p, start, "expected a section (\"- Title:\")");
+    skip_blanks(p);
+    *title = &p->buf[p->pos];
+    while (p->pos < p->end && p->buf[p->pos] != ':' && p->buf[p->pos] != '\n')
+        p->pos++;
+    if (p->pos == p->end || p->buf[p->pos] != ':')
+        return parse_error(p, p->pos, "expected ':'");
+    *len = &p->buf[p->pos] - *title;
+    while (*len > 0 && isspace((unsigned char) (*title)[*len - 1]))
+        (*len)--;
+    p->pos++;
+    /* the body ends at the beginning of the next section */
+    *body = *p;
+    for (pos = p->pos; pos < p->end; pos++) {
+        if (p->buf[pos] == '\n' && starts_section(p, pos + 1))
+            break;
+    }
+    body->end = pos;
+    p->pos = pos;
+    return 1;
+}
+
+/* find: position of a name (of length len) in names[n], -1 if it is not there
+ */
+static int find(int n, char *names[], const char *name, size_t len)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (strlen(names[i]) == len && !strncmp(names[i], name, len))
+            return i;
+    }
+    return -1;
+}
+
+/* parse_vars: reads the values of the variables names[nvars], given as
+ *
+ *      S=[1,2,3,4,5,6] I=[2,2,4,4,5,5]
+ *
+ * Every variable must be given once, with the same number of values. The
+ * values of each variable are stored in a new array cols[i] (in the order of
+ * names[], not that of the input).
+ * returns the number of values, or -1 on failure (then no array is left)
+ */
+long parse_vars(struct parser *p, int nvars, char *names[], double *cols[])
+{
+    int i;
+    long n, npoints = -1;
+    size_t len, pos;
+    const char *name;
+    for (i = 0; i < nvars; i++) {
+        cols[i] = NULL;
+    }
+    while (!parse_end(p)) {
+        pos = p->pos;
+        if (!(len = parse_name(p, &name))) {
+            parse_error(p, pos, "expected the name of a variable");
+            goto fail;
+        }
+        if ((i = find(nvars, names, name, len)) < 0) {
+            parse_error(p, pos, "unknown variable %.*s", (int) len, name);
+            goto fail;
+        }
+        if (cols[i]) {
+            parse_error(p, pos, "variable %s given twice", names[i]);
+            goto fail;
+        }
+        if (!parse_char(p, '=')) {
+            parse_error(p, p->pos, "expected '='");
+            goto fail;
+        }
+        if ((n = parse_array(p, &cols[i])) < 0)
+            goto fail;
+        if (n == 0) {
+            parse_error(p, pos, "variable %s has no values", names[i]);
+            goto fail;
+        }
+        if (npoints >= 0 && n != npoints) {
+            parse_error(p, pos, "variable %s has %ld values, but the previous "
+                        "ones have %ld", names[i], n, npoints);
+            goto fail;
+        }
+        npoints = n;
+        parse_char(p, ',');
+    }
+    for (i = 0; i < nvars; i++) {
+        if (!cols[i]) {
+            parse_error(p, p->pos, "variable %s is missing", names[i]);
+            goto fail;
+        }
+    }
+    return npoints;
+
+fail:
+    for (i = 0; i < nvars; i++) {
+        free(cols[i]);
+        cols[i] = NULL;
+    }
+    return -1;
+}
+
+/* parse_table: reads the values of the variables names[nvars] as a table,
+ * with a line holding the names of the columns (in any order, and maybe other
+ * columns, which are skipped) followed by a line per point:
+ *
+ *      S     I
+ *      1     0
+ *      2.5   0
+ *
+ * The values may be separated by blanks or commas. The values of each variable
+ * are stored in a new array cols[i].
+ * returns the number of points, or -1 on failure (then no array is left)
+ */
+long parse_table(struct parser *p, int nvars, char *names[], double *cols[])
+{
+    int i, c, ncols = 0, nfound = 0, quoted, order[MAX_COLUMNS];
+    size_t n = 0, size = 0, len, pos;
+    const char *name;
+    double *tmp;
+    for (i = 0; i < nvars; i++) {
+        cols[i] = NULL;
+    }
+    /* header */
+    if (parse_end(p)) {
+        parse_error(p, p->pos, "expected the names of the columns");
+        return -1;
+    }
+    for (skip_inline(p); !end_of_line(p); skip_inline(p)) {
+        /* the names might be quoted, as in some CSV files */
+        quoted = p->buf[p->pos] == '"';
+        p->pos += quoted;
+        pos = p->pos;
+        if (!(len = parse_name(p, &name))) {
+            parse_error(p, pos, "expected the name of a column");
+            return -1;
+        }
+        if (quoted && !parse_char(p, '"')) {
+            parse_error(p, p->pos, "expected '\"'");
+            return -1;
+        }
+        if (ncols == MAX_COLUMNS) {
+            parse_error(p, pos, "too many columns");
+            return -1;
+        }
+        /* the columns which are not variables are skipped (order = -1) */
+        i = find(nvars, names, name, len);
+        for (c = 0; i >= 0 && c < ncols; c++) {
+            if (order[c] == i) {
+                parse_error(p, pos, "variable %s given twice", names[i]);
+                return -1;
+            }
+        }
+        order[ncols++] = i;
+        nfound += i >= 0;
+    }
+    if (nfound < nvars) {
+        for (i = 0; i < nvars; i++) {
+            for (c = 0; c < ncols && order[c] != i; c++)
+                ;
+            if (c == ncols)
+                break;
+        }
+        parse_error(p, p->pos, "variable %s is missing in the header",
+                    names[i]);
+        return -1;
+    }
+    /* a line per point */
+    while (!parse_end(p)) {
+        if (n == size) {
+            size = size ? 2*size : 1024;
+            for (i = 0; i < nvars; i++) {
+                if (!(tmp = realloc(cols[i], size * sizeof(double)))) {
+                    parse_error(p, p->pos, "not enough memory");
+                    goto fail;
+                }
+                cols[i] = tmp;
+            }
+        }
+        for (c = 0; c < ncols; c++) {
+            skip_inline(p);
+            if (end_of_line(p)) {
+                parse_error(p, p->pos, "expected %d values in this line",
+                            ncols);
+                goto fail;
+            }
+            if (order[c] < 0)
+                skip_field(p);
+            else if (parse_number(p, &cols[order[c]][n]))
+                goto fail;
+        }
+        skip_inline(p);
+        if (!end_of_line(p)) {
+            parse_error(p, p->pos, "too many values in this line");
+            goto fail;
+        }
+        n++;
+    }
+    if (n == 0) {
+        parse_error(p, p->pos, "the table has no values");
+        goto fail;
+    }
+    return n;
+
+fail:
+    for (i = 0; i < nvars; i++) {
+        free(cols[i]);
+        cols[i] = NULL;
+    }
+    return -1;
+}
+
+/* parse_params: reads the values of the parameters names[nparams], given as
+ *
+ *      Vmax=5 Km=17
+ *
+ * Every parameter must be given once, or at most once if not "all" (those
+ * not given are set to NaN).
+ * returns 0 on success, -1 on failure
+ */
+int parse_params(struct parser *p, int nparams, char *names[],
+                 double values[], int all)
+{
+    int i, found[nparams];
+    size_t len, pos;
+    const char *name;
+    memset(found, 0, sizeof(found));
+    while (!parse_end(p)) {
+        pos = p->pos;
+        if (!(len = parse_name(p, &name)))
+            return parse_error(p, pos, "expected the name of a parameter");
+        if ((i = find(nparams, names, name, len)) < 0)
+            return parse_error(p, pos, "unknown parameter %.*s", (int) len,
+                               name);
+        if (found[i]++)
+            return parse_error(p, pos, "parameter %s given twice", names[i]);
+        if (!parse_char(p, '='))
+            return parse_error(p, p->pos, "expected '='");
+        if (parse_number(p, &values[i]))
+            return -1;
+        parse_char(p, ',');
+    }
+    for (i = 0; i < nparams; i++) {
+        if (!found[i] && all)
+            return parse_error(p, p->pos, "parameter %s is missing", names[i]);
+        if (!found[i])
+            values[i] = NAN;
+    }
+    return 0;
+}
+
+/* parse_ranges: reads the ranges of the variables names[nvars], given as
+ *
+ *      S=1:100 I=0:20:5
+ *
+ * (lowest and highest value, and optionally the number of levels, or 0 if
+ * it is not given). Every variable must be given once.
+ * returns 0 on success, -1 on failure
+ */
+int parse_ranges(struct parser *p, int nvars, char *names[], double lo[],
+                 double hi[], int nlevels[])
+{
+    int i, found[nvars];
+    size_t len, pos;
+    const char *name;
+    double x;
+    memset(found, 0, sizeof(found));
+    while (!parse_end(p)) {
+        pos = p->pos;
+        if (!(len = parse_name(p, &name)))
+            return parse_error(p, pos, "expected the name of a variable");
+        if ((i = find(nvars, names, name, len)) < 0)
+            return parse_error(p, pos, "unknown variable %.*s", (int) len,
+                               name);
+        if (found[i]++)
+            return parse_error(p, pos, "variable %s given twice", names[i]);
+        if (!parse_char(p, '='))
+            return parse_error(p, p->pos, "expected '='");
+        if (parse_number(p, &lo[i]))
+            return -1;
+        if (!parse_char(p, ':'))
+            return parse_error(p, p->pos, "expected ':'");
+        pos = p->pos;
+        if (parse_number(p, &hi[i]))
+            return -1;
+        if (!(hi[i] >= lo[i]))
+            return parse_error(p, pos, "the range of %s is empty", names[i]);
+        nlevels[i] = 0;
+        if (parse_char(p, ':')) {
+            pos = p->pos;
+            if (parse_number(p, &x))
+                return -1;
+            if (x != (int) x || x < 1)
+                return parse_error(p, pos, "invalid number of levels");
+            nlevels[i] = x;
+        }
+        parse_char(p, ',');
+    }
+    for (i = 0; i < nvars; i++) {
+        if (!found[i])
+            return parse_error(p, p->pos, "variable %s is missing", names[i]);
+    }
+    return 0;
+}
+
+/* parse_grid: reads the levels of the variables names[nvars] of a grid (see
+ * dataset_grid), each one given either as a list or as a range with the
+ * number of levels, spaced as in dataset_levels:
+ *
+ *      S=[1,2,5,10] I=0:20:5
+ *
+ * Every variable must be given once if "all" is set; if not, the levels of
+ * those not given are left NULL (eg. the parameters of --sweep). The levels
+ * of each variable are stored in a new array levels[i], and their number in
+ * nlevels[i].
+ * returns 0 on success, -1 on failure (then no array is left)
+ */
+int parse_grid(struct parser *p, int nvars, char *names[], double *levels[],
+               int nlevels[], int all)
+{
+    int i;
+    long n;
+    size_t len, pos;
+    const char *name;
+    double lo, hi, x;
+    for (i = 0; i < nvars; i++) {
+        levels[i] = NULL;
+    }
+    while (!parse_end(p)) {
+        pos = p->pos;
+        if (!(len = parse_name(p, &name))) {
+            parse_error(p, pos, "expected a name");
+            goto fail;
+        }
+        if ((i = find(nvars, names, name, len)) < 0) {
+            parse_error(p, pos, "unknown name %.*s", (int) len, name);
+            goto fail;
+        }
+        if (levels[i]) {
+            parse_error(p, pos, "%s given twice", names[i]);
+            goto fail;
+        }
+        if (!parse_char(p, '=')) {
+            parse_error(p, p->pos, "expected '='");
+            goto fail;
+        }
+        skip_blanks(p);
+        if (p->pos < p->end && p->buf[p->pos] == '[') {
+            if ((n = parse_array(p, &levels[i])) < 0)
+                goto fail;
+            if (n == 0 || n > INT_MAX) {
+                parse_error(p, pos, "invalid number of levels of %s",
+                            names[i]);
+                goto fail;
+            }
+            nlevels[i] = n;
+        } else {
+            if (parse_number(p, &lo))
+                goto fail;
+            if (!parse_char(p, ':')) {
+                parse_error(p, p->pos, "expected ':' or '['");
+                goto fail;
+            }
+            pos = p->pos;
+            if (parse_number(p, &hi))
+                goto fail;
+            if (!(hi >= lo)) {
+                parse_error(p, pos, "the range of %s is empty", names[i]);
+                goto fail;
+            }
+            if (!parse_char(p, ':')) {
+                parse_error(p, p->pos, "expected ':' and the number of "
+                            "levels");
+                goto fail;
+            }
+            pos = p->pos;
+            if (parse_number(p, &x))
+                goto fail;
+            if (x != (int) x || x < 1 || (x > 1 && hi == lo)) {
+                parse_error(p, pos, "invalid number of levels");
+                goto fail;
+            }
+            nlevels[i] = x;
+            if (!(levels[i] = malloc(nlevels[i] * sizeof(double)))) {
+                parse_error(p, pos, "not enough memory");
+                goto fail;
+            }
+            dataset_levels(lo, hi, nlevels[i], levels[i]);
+        }
+        parse_char(p, ',');
+    }
+    for (i = 0; all && i < nvars; i++) {
+        if (!levels[i]) {
+            parse_error(p, p->pos, "%s is missing", names[i]);
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    for (i = 0; i < nvars; i++) {
+        free(levels[i]);
+        levels[i] = NULL;
+    }
+    return -1;
+}
+
+/* parse_names: reads a list of names, out of names[nnames], separated by
+ * commas or blanks (eg. "Vmax Km"). found[i] is set to 1 if names[i] is in
+ * the list, 0 if not. "None" stands for an empty list.
+ * returns the number of names found, or -1 on failure
+ */
+int parse_names(struct parser *p, int nnames, char *names[], int found[])
+{
+    int i, n = 0;
+    size_t len, pos;
+    const char *name;
+    memset(found, 0, nnames * sizeof(int));
+    while (!parse_end(p)) {
+        pos = p->pos;
+        if (!(len = parse_name(p, &name)))
+            return parse_error(p, pos, "expected a name");
+        if ((i = find(nnames, names, name, len)) >= 0) {
+            n += !found[i];
+            found[i] = 1;
+        } else if (len != 4 || strncmp(name, "None", 4)) {
+            return parse_error(p, pos, "unknown name %.*s", (int) len, name);
+        }
+        parse_char(p, ',');
+    }
+    return n;
+}
@@ -0,0 +1,52 @@
+#ifndef __PARSE_H__
+#define __PARSE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Parser of the input of enzmc: the syntax of the options (--data, --params,
+ * --fixed) and the template files (see README). The input is read in a single
+ * pass, straight from a buffer which need not end with '\0' (eg. a mapped
+ * file), so there are no limits to its length.
+ *
+ * Blanks (spaces, tabs and newlines) are allowed between any two tokens.
+ * Errors are reported in stderr as "Error: name:line:column: message" (or
+ * in p->err, see below).
+ */
+
+struct parser {
+    const char *name;   /* name of the input, for the error messages */
+    const char *buf;    /* whole input */
+    size_t pos;         /* current position in buf */
+    size_t end;         /* end of the part being parsed */
+    FILE *err;          /* where the errors are reported (stderr, unless
+                         * changed after parse_init) */
+};
+
+void parse_init(struct parser *p, const char *name, const char *buf,
+                size_t len);
+int parse_error(struct parser *p, size_t pos, const char *fmt, ...);
+
+/* tokens */
+int parse_end(struct parser *p);
+int parse_char(struct parser *p, char c);
+size_t parse_name(struct parser *p, const char **name);
+int parse_number(struct parser *p, double *x);
+int parse_integer(struct parser *p, uint64_t *x);
+long parse_array(struct parser *p, double **values);
+int parse_section(struct parser *p, const char **title, size_t *len,
+                  struct parser *body);
+
+/* syntax of the options */
+long parse_vars(struct parser *p, int nvars, char *names[], double *cols[]);
+long parse_table(struct parser *p, int nvars, char *names[], double *cols[]);
+int parse_params(struct parser *p, int nparams, char *names[],
+                 double values[], int all);
+int parse_names(struct parser *p, int nnames, char *names[], int found[]);
+int parse_grid(struct parser *p, int nvars, char *names[], double *levels[],
+               int nlevels[], int all);
+int parse_ranges(struct parser *p, int nvars, char *names[], double lo[],
+                 double hi[], int nlevels[]);
+
+#endif /* __PARSE_H__ */
@@ -0,0 +1,17 @@
+/* Example of model plugin (see plugin.h). The code of the models is
+ * generated from hill.spec by modelgen, as for the built-in models.
+ */
+#include <plugin.h>
+#include "hill_gen.c"
+
+static struct model hill_models[] = {
+  GENERATED_MODELS
+};
+
+struct enzmc_plugin enzmc_plugin = {
+  ENZMC_PLUGIN_VERSION,
+  sizeof(struct model),
+  "hill",
+  sizeof(hill_models) / sizeof(hill_models[0]),
+  hill_models
+};
@@ -0,0 +1,12 @@
+# Example of plugin: the models specified here (see models/models.spec for the
+# format) are compiled into hill.so, which is loaded with
+#
+#   enzmc --plugins plugins ...
+#
+# or setting the environment variable ENZMC_PLUGINS=plugins
+
+Model: hill
+Description: Hill equation (cooperative binding)
+Independent variables: S
+Parameters: Vmax, K, h
+Equation: v0 = Vmax*S^h / (K^h + S^h)
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <math.h>
+#include "random.h"
 
 #define IA 16807
 #define IM 2147483647
@@ -44,3 +45,89 @@ float boxmuller(long *seed)
     flag = 1;
     return y1;
 }
+
+/* splitmix64: a new state is obtained by adding a constant, and the output is
+ * a mix of the bits of the state, so that any state (eg. one built from the
+ * number of a stream) gives a good sequence.
+ */
+#define GOLDEN_GAMMA 0x9e3779b97f4a7c15ULL
+
+static uint64_t mix64(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(struct rng *r, uint64_t seed, uint64_t stream)
+{
+    r->state = mix64(seed + GOLDEN_GAMMA) ^ mix64((stream + 1) * GOLDEN_GAMMA);
+    r->flag = 0;
+}
+
+/* uniform in (0, 1) */
+double rng_uniform(struct rng *r)
+{
+    r->state += GOLDEN_GAMMA;
+    return ((mix64(r->state) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+/* gaussian with mean 0 and deviation 1 (polar Box-Muller, as boxmuller) */
+double rng_gauss(struct rng *r)
+{
+    double x1, x2, rsq, fac;
+    if (r->flag) {
+        r->flag = 0;
+        return r->spare;
+    }
+    do {
+        x1 = rng_uniform(r)*2 - 1;
+        x2 = rng_uniform(r)*2 - 1;
+        rsq = x1*x1 + x2*x2;
+    } while (rsq >= 1 || rsq == 0);
+    fac = sqrt(-2*log(rsq)/rsq);
+    r->spare = x2*fac;
+    r->flag = 1;
+    return x1*fac;
+}
+
+/* normal_quantile: the value below which there is a fraction p (0...1) of a
+ * gaussian with mean 0 and deviation 1 (the inverse of its cumulative
+ * distribution), by the rational approximation of Acklam refined by a step
+ * of Halley's method */
+double normal_quantile(double p)
+{
+    static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                               -2.759285104469687e+02, 1.383577518672690e+02,
+                               -3.066479806614716e+01, 2.506628277459239e+00};
+    static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                               -1.556989798598866e+02, 6.680131188771972e+01,
+                               -1.328068155288572e+01};
+    static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                               -2.400758277161838e+00, -2.549732539343734e+00,
+                               4.374664141464968e+00, 2.938163982698783e+00};
+    static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+                               2.445134137142996e+00, 3.754408661907416e+00};
+    double q, r, x, e, u;
+    if (p <= 0)
+        return -INFINITY;
+    if (p >= 1)
+        return INFINITY;
+    if (p < 0.02425) {
+        q = sqrt(-2 * log(p));
+        x = (((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+            ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+    } else if (p <= 1 - 0.02425) {
+        q = p - 0.5;
+        r = q * q;
+        x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5])*q /
+            (((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1);
+    } else {
+        q = sqrt(-2 * log(1 - p));
+        x = -(((((c[0]*q + c[1])*q + c[2])*q + c[3])*q + c[4])*q + c[5]) /
+             ((((d[0]*q + d[1])*q + d[2])*q + d[3])*q + 1);
+    }
+    e = 0.5 * erfc(-x / sqrt(2)) - p;
+    u = e * sqrt(2 * M_PI) * exp(x * x / 2);
+    return x - u / (1 + x * u / 2);
+}
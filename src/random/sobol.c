@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include "sobol.h"
+
+/* primitive polynomial (degree s, coefficients a) and initial direction
+ * numbers m[s] of the dimensions 2...SOBOL_MAXDIM (the first one is the van
+ * der Corput sequence) */
+static const struct {
+    int s, a, m[7];
+} dirs[SOBOL_MAXDIM - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4, {1, 3, 7, 13, 13, 15, 69}},
+};
+
+/* random 32 bits */
+static uint32_t rng_bits(struct rng *rng)
+{
+    return (uint32_t) (rng_uniform(rng) * 4294967296.0);
+}
+
+static int parity(uint32_t x)
+{
+    return __builtin_parity(x);
+}
+
+/* sobol_init: the Sobol points of dim dimensions, scrambled with the random
+ * numbers of rng (or not scrambled, if it is NULL).
+ * returns 0, or -1 if dim is larger than SOBOL_MAXDIM */
+int sobol_init(struct sobol *s, int dim, struct rng *rng)
+{
+    int d, k, i, r, deg;
+    uint32_t v, mask, rows[SOBOL_BITS];
+    if (dim > SOBOL_MAXDIM) {
+        fprintf(stderr, "Error: Sobol points of at most %d dimensions.\n",
+                SOBOL_MAXDIM);
+        return -1;
+    }
+    s->dim = dim;
+    for (d = 0; d < dim; d++) {
+        /* the digit k (from the most significant) is bit 31-k */
+        if (d == 0) {
+            for (k = 0; k < SOBOL_BITS; k++)
+                s->v[d][k] = 1u << (31 - k);
+        } else {
+            deg = dirs[d - 1].s;
+            for (k = 0; k < deg; k++)
+                s->v[d][k] = (uint32_t) dirs[d - 1].m[k] << (31 - k);
+            for (k = deg; k < SOBOL_BITS; k++) {
+                v = s->v[d][k - deg] ^ (s->v[d][k - deg] >> deg);
+                for (i = 1; i < deg; i++)
+                    if ((dirs[d - 1].a >> (deg - 1 - i)) & 1)
+                        v ^= s->v[d][k - i];
+                s->v[d][k] = v;
+            }
+        }
+        s->shift[d] = 0;
+        if (!rng)
+            continue;
+        /* a lower triangular matrix with ones in its diagonal: the digit r
+         * becomes itself plus a random combination of the previous ones */
+        for (r = 0; r < SOBOL_BITS; r++) {
+            mask = r ? ~0u << (32 - r) : 0;
+            rows[r] = (rng_bits(rng) & mask) | 1u << (31 - r);
+        }
+        for (k = 0; k < SOBOL_BITS; k++) {
+            for (r = 0, v = 0; r < SOBOL_BITS; r++)
+                v |= (uint32_t) parity(s->v[d][k] & rows[r]) << (31 - r);
+            s->v[d][k] = v;
+        }
+        s->shift[d] = rng_bits(rng);
+    }
+    return 0;
+}
+
+/* sobol_point: sets x[dim] to the point k (0, 1...) of the sequence, in
+ * (0, 1) */
+void sobol_point(struct sobol *s, uint32_t k, double x[])
+{
+    uint32_t gray = k ^ (k >> 1), p;
+    int d, b;
+    for (d = 0; d < s->dim; d++) {
+        p = s->shift[d];
+        for (b = 0; gray >> b; b++)
+            if ((gray >> b) & 1)
+                p ^= s->v[d][b];
+        x[d] = (p + 0.5) * (1.0 / 4294967296.0);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef __SOBOL_H__
+#define __SOBOL_H__
+#include <stdint.h>
+#include "random.h"
+
+/* Scrambled Sobol points, for randomized quasi-Monte Carlo: the first 2^k
+ * points of a Sobol sequence of dim dimensions fill the unit cube much more
+ * evenly than random ones. A scrambling (a random linear scramble of the
+ * binary digits of each coordinate, and a random digital shift) keeps that
+ * spread while making each point uniform in the cube, so the averages over
+ * the points are unbiased, and the spread between the averages of several
+ * scramblings estimates their error.
+ *
+ * The direction numbers are those of Joe and Kuo (new-joe-kuo-6.21201), for
+ * up to SOBOL_MAXDIM dimensions.
+ */
+
+#define SOBOL_MAXDIM 21
+#define SOBOL_BITS 32
+
+struct sobol {
+  int dim;
+  uint32_t v[SOBOL_MAXDIM][SOBOL_BITS];  /* (scrambled) direction numbers */
+  uint32_t shift[SOBOL_MAXDIM];          /* digital shift */
+};
+
+int sobol_init(struct sobol *s, int dim, struct rng *rng);
+void sobol_point(struct sobol *s, uint32_t k, double x[]);
+
+#endif